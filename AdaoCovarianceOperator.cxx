@@ -0,0 +1,77 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#include "AdaoCovarianceOperator.hxx"
+#include "AdaoNativeLinearAlgebra.hxx"
+
+#include <cmath>
+#include <algorithm>
+
+const char AdaoCovarianceOperator::CAPSULE_NAME[]="AdaoCovarianceOperator";
+
+const double AdaoCovarianceOperator::SOLVE_RELATIVE_TOLERANCE=1e-12;
+
+/*!
+ * Conjugate gradient : at most getSize() iterations, stops when residual is lower than SOLVE_RELATIVE_TOLERANCE times |v|.
+ * Throws if it is not reached after getSize() iterations (operator ill conditioned or not symmetric) : solve has to be overridden.
+ */
+void AdaoCovarianceOperator::solve(const double *v, double *out) const
+{
+  std::size_t n(getSize());
+  std::vector<double> r(v,v+n),p(v,v+n),bp(n);
+  std::fill(out,out+n,0.);
+  double rr(AdaoNative::Dot(n,r.data(),r.data()));
+  double threshold(SOLVE_RELATIVE_TOLERANCE*SOLVE_RELATIVE_TOLERANCE*rr);
+  for(std::size_t it=0;it<n && rr>threshold;++it)
+    {
+      multiply(p.data(),bp.data());
+      double pbp(AdaoNative::Dot(n,p.data(),bp.data()));
+      if(pbp<=0.)
+        throw AdaoExchangeLayerException("AdaoCovarianceOperator::solve : operator is not positive definite !");
+      double alpha(rr/pbp);
+      AdaoNative::Axpy(n,alpha,p.data(),out);
+      AdaoNative::Axpy(n,-alpha,bp.data(),r.data());
+      double rrNew(AdaoNative::Dot(n,r.data(),r.data()));
+      for(std::size_t i=0;i<n;++i)
+        p[i] = r[i]+(rrNew/rr)*p[i];
+      rr = rrNew;
+    }
+  if(rr>threshold)
+    throw AdaoExchangeLayerException("AdaoCovarianceOperator::solve : conjugate gradient has not converged, solve has to be overridden !");
+}
+
+void AdaoCovarianceOperator::multiplySquareRoot(const double *v, double *out) const
+{
+  throw AdaoExchangeLayerException("AdaoCovarianceOperator::multiplySquareRoot : square root is not provided by this operator !");
+}
+
+std::vector<double> AdaoCovarianceOperator::diagonal() const
+{
+  std::size_t n(getSize());
+  std::vector<double> ret(n),e(n,0.),col(n);
+  for(std::size_t i=0;i<n;++i)
+    {
+      e[i] = 1.;
+      multiply(e.data(),col.data());
+      ret[i] = col[i];
+      e[i] = 0.;
+    }
+  return ret;
+}
@@ -0,0 +1,82 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include "AdaoExchangeLayerException.hxx"
+
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+/*!
+ * Error covariance matrix (symmetric positive definite) known only through its action on vectors : nothing of size n^2 is stored.
+ * Only multiply is mandatory. solve defaults to conjugate gradient on multiply and diagonal to n products with unit vectors :
+ * override them when the operator knows better (diffusion operators, banded matrices...).
+ * multiplySquareRoot applies L such that B = L.L^T. Needed only by algorithms perturbing the state (ensemble methods).
+ *
+ * Given to ADAO as an "Object" covariance with AdaoExchangeLayer::setCovarianceOperatorInModel.
+ */
+class AdaoCovarianceOperator
+{
+public:
+  virtual ~AdaoCovarianceOperator() { }
+  virtual std::size_t getSize() const = 0;
+  virtual void multiply(const double *v, double *out) const = 0;
+  virtual void solve(const double *v, double *out) const;
+  virtual bool hasSquareRoot() const { return false; }
+  virtual void multiplySquareRoot(const double *v, double *out) const;
+  virtual std::vector<double> diagonal() const;
+public:
+  static const char CAPSULE_NAME[];
+  static const double SOLVE_RELATIVE_TOLERANCE;
+};
+
+/*!
+ * Covariance operator given by C++ functions. \a solve and \a squareRoot may be empty.
+ */
+class AdaoFunctionCovarianceOperator : public AdaoCovarianceOperator
+{
+public:
+  typedef std::function< void(const double *, double *) > Function;
+  AdaoFunctionCovarianceOperator(std::size_t size, Function multiply, Function solve = Function(), Function squareRoot = Function())
+    :_size(size),_multiply(multiply),_solve(solve),_square_root(squareRoot) { }
+  std::size_t getSize() const override { return _size; }
+  void multiply(const double *v, double *out) const override { _multiply(v,out); }
+  void solve(const double *v, double *out) const override
+  {
+    if(_solve)
+      _solve(v,out);
+    else
+      AdaoCovarianceOperator::solve(v,out);
+  }
+  bool hasSquareRoot() const override { return (bool)_square_root; }
+  void multiplySquareRoot(const double *v, double *out) const override
+  {
+    if(!_square_root)
+      AdaoCovarianceOperator::multiplySquareRoot(v,out);
+    _square_root(v,out);
+  }
+private:
+  std::size_t _size = 0;
+  Function _multiply;
+  Function _solve;
+  Function _square_root;
+};
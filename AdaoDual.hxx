@@ -0,0 +1,178 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+
+#pragma once
+
+#include "AdaoEvaluator.hxx"
+
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <sstream>
+
+/*!
+ * Forward mode automatic differentiation : value of a scalar and its derivatives along \a N directions at the same time.
+ * Loops on directions have a length known at compile time and are vectorized by the compiler.
+ * A C++ function written as a template over its scalar type, called with AdaoDual<N> instead of double, returns its tangent along \a N directions.
+ */
+template<std::size_t N>
+class AdaoDual
+{
+public:
+  AdaoDual(double val = 0.):_val(val) { std::fill(_der,_der+N,0.); }
+  //! Input variable whose derivative along \a direction is 1
+  static AdaoDual Variable(double val, std::size_t direction) { AdaoDual ret(val); ret._der[direction] = 1.; return ret; }
+  double getValue() const { return _val; }
+  double getDerivative(std::size_t direction) const { return _der[direction]; }
+  //! d(f(this)) knowing f(this)=\a val and f'(this)=\a dval
+  AdaoDual chain(double val, double dval) const { AdaoDual ret(val); for(std::size_t i=0;i<N;++i) ret._der[i] = dval*_der[i]; return ret; }
+  //! d(f(this,other)) knowing f=\a val and partial derivatives \a dthis and \a dother
+  AdaoDual chain(const AdaoDual& other, double val, double dthis, double dother) const
+  {
+    AdaoDual ret(val);
+    for(std::size_t i=0;i<N;++i)
+      ret._der[i] = dthis*_der[i]+dother*other._der[i];
+    return ret;
+  }
+  AdaoDual& operator+=(const AdaoDual& other) { _val += other._val; for(std::size_t i=0;i<N;++i) _der[i] += other._der[i]; return *this; }
+  AdaoDual& operator-=(const AdaoDual& other) { _val -= other._val; for(std::size_t i=0;i<N;++i) _der[i] -= other._der[i]; return *this; }
+  AdaoDual& operator*=(const AdaoDual& other) { *this = chain(other,_val*other._val,other._val,_val); return *this; }
+  AdaoDual& operator/=(const AdaoDual& other) { double inv(1./other._val); *this = chain(other,_val*inv,inv,-_val*inv*inv); return *this; }
+  AdaoDual& operator+=(double other) { _val += other; return *this; }
+  AdaoDual& operator-=(double other) { _val -= other; return *this; }
+  AdaoDual& operator*=(double other) { _val *= other; for(std::size_t i=0;i<N;++i) _der[i] *= other; return *this; }
+  AdaoDual& operator/=(double other) { return (*this) *= 1./other; }
+private:
+  double _val;
+  double _der[N];
+};
+
+template<std::size_t N> AdaoDual<N> operator+(const AdaoDual<N>& a) { return a; }
+template<std::size_t N> AdaoDual<N> operator-(const AdaoDual<N>& a) { return a.chain(-a.getValue(),-1.); }
+template<std::size_t N> AdaoDual<N> operator+(AdaoDual<N> a, const AdaoDual<N>& b) { return a += b; }
+template<std::size_t N> AdaoDual<N> operator-(AdaoDual<N> a, const AdaoDual<N>& b) { return a -= b; }
+template<std::size_t N> AdaoDual<N> operator*(AdaoDual<N> a, const AdaoDual<N>& b) { return a *= b; }
+template<std::size_t N> AdaoDual<N> operator/(AdaoDual<N> a, const AdaoDual<N>& b) { return a /= b; }
+template<std::size_t N> AdaoDual<N> operator+(AdaoDual<N> a, double b) { return a += b; }
+template<std::size_t N> AdaoDual<N> operator-(AdaoDual<N> a, double b) { return a -= b; }
+template<std::size_t N> AdaoDual<N> operator*(AdaoDual<N> a, double b) { return a *= b; }
+template<std::size_t N> AdaoDual<N> operator/(AdaoDual<N> a, double b) { return a /= b; }
+template<std::size_t N> AdaoDual<N> operator+(double a, AdaoDual<N> b) { return b += a; }
+template<std::size_t N> AdaoDual<N> operator-(double a, const AdaoDual<N>& b) { return b.chain(a-b.getValue(),-1.); }
+template<std::size_t N> AdaoDual<N> operator*(double a, AdaoDual<N> b) { return b *= a; }
+template<std::size_t N> AdaoDual<N> operator/(double a, const AdaoDual<N>& b) { double inv(1./b.getValue()); return b.chain(a*inv,-a*inv*inv); }
+
+// comparisons are done on values : branches of the function are followed like with double
+template<std::size_t N> bool operator<(const AdaoDual<N>& a, const AdaoDual<N>& b) { return a.getValue()<b.getValue(); }
+template<std::size_t N> bool operator>(const AdaoDual<N>& a, const AdaoDual<N>& b) { return a.getValue()>b.getValue(); }
+template<std::size_t N> bool operator<=(const AdaoDual<N>& a, const AdaoDual<N>& b) { return a.getValue()<=b.getValue(); }
+template<std::size_t N> bool operator>=(const AdaoDual<N>& a, const AdaoDual<N>& b) { return a.getValue()>=b.getValue(); }
+template<std::size_t N> bool operator==(const AdaoDual<N>& a, const AdaoDual<N>& b) { return a.getValue()==b.getValue(); }
+template<std::size_t N> bool operator!=(const AdaoDual<N>& a, const AdaoDual<N>& b) { return a.getValue()!=b.getValue(); }
+template<std::size_t N> bool operator<(const AdaoDual<N>& a, double b) { return a.getValue()<b; }
+template<std::size_t N> bool operator>(const AdaoDual<N>& a, double b) { return a.getValue()>b; }
+template<std::size_t N> bool operator<=(const AdaoDual<N>& a, double b) { return a.getValue()<=b; }
+template<std::size_t N> bool operator>=(const AdaoDual<N>& a, double b) { return a.getValue()>=b; }
+template<std::size_t N> bool operator<(double a, const AdaoDual<N>& b) { return a<b.getValue(); }
+template<std::size_t N> bool operator>(double a, const AdaoDual<N>& b) { return a>b.getValue(); }
+template<std::size_t N> bool operator<=(double a, const AdaoDual<N>& b) { return a<=b.getValue(); }
+template<std::size_t N> bool operator>=(double a, const AdaoDual<N>& b) { return a>=b.getValue(); }
+
+// found by argument dependent lookup when a templated function calls them unqualified (sqrt(x), not std::sqrt(x))
+template<std::size_t N> AdaoDual<N> sqrt(const AdaoDual<N>& a) { double v(std::sqrt(a.getValue())); return a.chain(v,0.5/v); }
+template<std::size_t N> AdaoDual<N> exp(const AdaoDual<N>& a) { double v(std::exp(a.getValue())); return a.chain(v,v); }
+template<std::size_t N> AdaoDual<N> log(const AdaoDual<N>& a) { return a.chain(std::log(a.getValue()),1./a.getValue()); }
+template<std::size_t N> AdaoDual<N> sin(const AdaoDual<N>& a) { return a.chain(std::sin(a.getValue()),std::cos(a.getValue())); }
+template<std::size_t N> AdaoDual<N> cos(const AdaoDual<N>& a) { return a.chain(std::cos(a.getValue()),-std::sin(a.getValue())); }
+template<std::size_t N> AdaoDual<N> tan(const AdaoDual<N>& a) { double v(std::tan(a.getValue())); return a.chain(v,1.+v*v); }
+template<std::size_t N> AdaoDual<N> atan(const AdaoDual<N>& a) { return a.chain(std::atan(a.getValue()),1./(1.+a.getValue()*a.getValue())); }
+template<std::size_t N> AdaoDual<N> tanh(const AdaoDual<N>& a) { double v(std::tanh(a.getValue())); return a.chain(v,1.-v*v); }
+template<std::size_t N> AdaoDual<N> abs(const AdaoDual<N>& a) { return a.getValue()<0.?-a:a; }
+template<std::size_t N> AdaoDual<N> fabs(const AdaoDual<N>& a) { return abs(a); }
+template<std::size_t N> AdaoDual<N> pow(const AdaoDual<N>& a, double b) { double v(std::pow(a.getValue(),b)); return a.chain(v,b==0.?0.:b*std::pow(a.getValue(),b-1.)); }
+template<std::size_t N> AdaoDual<N> pow(double a, const AdaoDual<N>& b) { double v(std::pow(a,b.getValue())); return b.chain(v,v*std::log(a)); }
+template<std::size_t N> AdaoDual<N> pow(const AdaoDual<N>& a, const AdaoDual<N>& b)
+{
+  double v(std::pow(a.getValue(),b.getValue()));
+  return a.chain(b,v,b.getValue()*std::pow(a.getValue(),b.getValue()-1.),a.getValue()>0.?v*std::log(a.getValue()):0.);
+}
+
+/*!
+ * Differentiable evaluator built on \a FUNC, a functor whose call operator is a template over the scalar type :
+ *
+ * struct MyOperator { template<class T> std::vector<T> operator()(const std::vector<T>& x) const; };
+ *
+ * Direct evaluations call it with double. The tangent at x is given by calls with AdaoDual<N>, \a N input directions at a time :
+ * one call instead of n+1 finite differences evaluations as soon as the input size n is lower than or equal to \a N.
+ */
+template<class FUNC, std::size_t N = 4>
+class AdaoForwardDiffEvaluator : public AdaoDifferentiableEvaluator
+{
+public:
+  AdaoForwardDiffEvaluator(const FUNC& func = FUNC()):_func(func) { }
+  void evaluateBatch(const AdaoConstSampleMatrix& inputs, const AdaoSampleMatrix& outputs) override
+  {
+    std::size_t outputSize(outputs.getSampleSize());
+    std::vector<double> sample(inputs.getSampleSize());
+    for(std::size_t i=0;i<inputs.getNumberOfSamples();++i)
+      {
+        for(std::size_t j=0;j<sample.size();++j)
+          sample[j] = inputs(i,j);
+        std::vector<double> res(_func(sample));
+        CheckOutputSize(res.size(),outputSize);
+        for(std::size_t j=0;j<outputSize;++j)
+          outputs(i,j) = res[j];
+      }
+  }
+  void transposeOfTangent(std::size_t inputSize, const double *x, std::size_t outputSize, double *hx, double *ht) override
+  {
+    std::vector< AdaoDual<N> > xd(x,x+inputSize);
+    for(std::size_t first=0;first==0 || first<inputSize;first+=N)
+      {
+        std::size_t last(std::min(first+N,inputSize));
+        for(std::size_t j=first;j<last;++j)
+          xd[j] = AdaoDual<N>::Variable(x[j],j-first);
+        std::vector< AdaoDual<N> > yd(_func(xd));
+        CheckOutputSize(yd.size(),outputSize);
+        if(first==0)
+          for(std::size_t k=0;k<outputSize;++k)
+            hx[k] = yd[k].getValue();
+        for(std::size_t j=first;j<last;++j)
+          {
+            for(std::size_t k=0;k<outputSize;++k)
+              ht[j*outputSize+k] = yd[k].getDerivative(j-first);
+            xd[j] = AdaoDual<N>(x[j]);
+          }
+      }
+  }
+private:
+  static void CheckOutputSize(std::size_t size, std::size_t outputSize)
+  {
+    if(size!=outputSize)
+      {
+        std::ostringstream oss; oss << "AdaoForwardDiffEvaluator : function returned " << size << " values whereas " << outputSize << " are expected !";
+        throw AdaoExchangeLayerException(oss.str());
+      }
+  }
+private:
+  FUNC _func;
+};
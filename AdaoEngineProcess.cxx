@@ -0,0 +1,191 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+// Helper process of the out of process engine (see AdaoRemoteEngine). Holds its own python interpreter running the ADAO case.
+// Usage : AdaoEngineProcess <name of shared memory segment>
+
+#include "AdaoShmChannel.hxx"
+#include "AdaoPyConversion.hxx"
+#include "AdaoExchangeLayerException.hxx"
+#include "PyObjectRAII.hxx"
+#include "Python.h"
+
+#include <iostream>
+
+static AdaoShmChannel *THE_CHANNEL = nullptr;
+
+/*!
+ * Returns the message of the current python exception and clears it.
+ */
+static std::string CurrentPythonError()
+{
+  PyObject *type(nullptr),*value(nullptr),*traceback(nullptr);
+  PyErr_Fetch(&type,&value,&traceback);
+  PyErr_NormalizeException(&type,&value,&traceback);
+  std::string ret("unknown python error");
+  if(value)
+    {
+      PyObjectRAII str(PyObjectRAII::FromNew(PyObject_Str(value)));
+      if(!str.isNull())
+        ret = PyUnicode_AsUTF8(str);
+    }
+  if(type)
+    {
+      PyObjectRAII name(PyObjectRAII::FromNew(PyObject_GetAttrString(type,"__name__")));
+      if(!name.isNull())
+        ret = std::string(PyUnicode_AsUTF8(name)) + " : " + ret;
+    }
+  PyErr_Restore(type,value,traceback);
+  PyErr_Print();
+  return ret;
+}
+
+/*!
+ * Observation operator seen by ADAO : samples are sent to the host that gives back the result.
+ */
+static PyObject *AdaoRemoteCallback(PyObject *self, PyObject *args)
+{
+  PyObject *samples(nullptr);
+  if(!PyArg_ParseTuple(args,"O",&samples))
+    return nullptr;
+  try
+    {
+      THE_CHANNEL->send(AdaoShmMessage::Samples,PickleToString(samples));
+      std::string payload;
+      if(THE_CHANNEL->recv(payload)!=AdaoShmMessage::Result)
+        {
+          PyErr_SetString(PyExc_RuntimeError,"AdaoRemoteCallback : result expected from host !");
+          return nullptr;
+        }
+      PyObject *ret(UnpickleFromString(payload));
+      if(ret && PyExceptionInstance_Check(ret))
+        {// exception given to setResult by host
+          PyErr_SetObject((PyObject *)Py_TYPE(ret),ret);
+          Py_DECREF(ret);
+          return nullptr;
+        }
+      return ret;
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      PyErr_SetString(PyExc_RuntimeError,e.what());
+      return nullptr;
+    }
+}
+
+static PyMethodDef AdaoRemoteCallbackDef = {"AdaoRemoteCallback",AdaoRemoteCallback,METH_VARARGS,"Observation operator evaluated by host process"};
+
+static bool RunScript(PyObject *context, const std::string& script, std::string& error)
+{
+  PyObjectRAII res(PyObjectRAII::FromNew(PyRun_String(script.c_str(),Py_file_input,context,context)));
+  if(res.isNull())
+    {
+      error = CurrentPythonError();
+      return false;
+    }
+  return true;
+}
+
+static void Serve(AdaoShmChannel& channel, PyObject *context)
+{
+  std::string payload,error;
+  while(true)
+    {
+      AdaoShmMessage kind(channel.recv(payload));
+      try
+        {
+          switch(kind)
+            {
+            case AdaoShmMessage::Variables:
+              {
+                PyObjectRAII vars(PyObjectRAII::FromNew(UnpickleFromString(payload)));
+                if(PyDict_Update(context,vars)!=0)
+                  channel.send(AdaoShmMessage::Error,CurrentPythonError());
+                else
+                  channel.send(AdaoShmMessage::Data,std::string());
+                break;
+              }
+            case AdaoShmMessage::Setup:
+              {
+                if(RunScript(context,payload,error))
+                  channel.send(AdaoShmMessage::Data,std::string());
+                else
+                  channel.send(AdaoShmMessage::Error,error);
+                break;
+              }
+            case AdaoShmMessage::Execute:
+              {
+                if(RunScript(context,"case.execute()\n",error))
+                  channel.send(AdaoShmMessage::Finished,std::string());
+                else
+                  channel.send(AdaoShmMessage::Error,error);
+                break;
+              }
+            case AdaoShmMessage::Eval:
+              {
+                PyObjectRAII res(PyObjectRAII::FromNew(PyRun_String(payload.c_str(),Py_eval_input,context,context)));
+                if(res.isNull())
+                  channel.send(AdaoShmMessage::Error,CurrentPythonError());
+                else
+                  channel.send(AdaoShmMessage::Data,PickleToString(res));
+                break;
+              }
+            case AdaoShmMessage::Quit:
+              return ;
+            default:
+              channel.send(AdaoShmMessage::Error,"AdaoEngineProcess : unexpected message !");
+            }
+        }
+      catch(AdaoExchangeLayerException& e)
+        {
+          channel.send(AdaoShmMessage::Error,e.what());
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc!=2)
+    {
+      std::cerr << "Usage : " << argv[0] << " <name of shared memory segment>" << std::endl;
+      return 1;
+    }
+  try
+    {
+      AdaoShmChannel channel(AdaoShmChannel::Open(argv[1]));
+      THE_CHANNEL = &channel;
+      Py_Initialize();
+      {
+        PyObjectRAII context(PyObjectRAII::FromNew(PyDict_New()));
+        PyDict_SetItemString(context,"__builtins__",PyEval_GetBuiltins());
+        PyObjectRAII callback(PyObjectRAII::FromNew(PyCFunction_New(&AdaoRemoteCallbackDef,nullptr)));
+        PyDict_SetItemString(context,"AdaoRemoteCallback",callback);
+        channel.send(AdaoShmMessage::Ready,std::string());
+        Serve(channel,context);
+      }
+      Py_Finalize();
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      std::cerr << "AdaoEngineProcess : " << e.what() << std::endl;
+      return 1;
+    }
+  return 0;
+}
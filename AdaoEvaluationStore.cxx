@@ -0,0 +1,258 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#include "AdaoEvaluationStore.hxx"
+#include "AdaoExchangeLayerException.hxx"
+
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace
+{
+  const char MAGIC[8]={'A','D','A','O','S','T','O','1'};
+  constexpr std::size_t HEADER_SIZE = 16;
+
+  struct RecordHeader
+  {
+    std::uint64_t _hash;
+    std::uint64_t _tag_hash;
+    std::uint32_t _input_size;
+    std::uint32_t _output_size;
+  };
+
+  std::uint64_t FNV1a(const void *data, std::size_t len, std::uint64_t h = 14695981039346656037ULL)
+  {
+    const unsigned char *pt(reinterpret_cast<const unsigned char *>(data));
+    for(std::size_t i=0;i<len;++i)
+      {
+        h ^= pt[i];
+        h *= 1099511628211ULL;
+      }
+    return h;
+  }
+
+  std::size_t SizeOfRecord(const RecordHeader& rh)
+  {
+    return sizeof(RecordHeader)+(std::size_t(rh._input_size)+std::size_t(rh._output_size))*sizeof(double);
+  }
+
+  /*!
+   * flock based lock, released at destruction.
+   */
+  class FileLock
+  {
+  public:
+    FileLock(int fd, int op):_fd(fd)
+    {
+      if(flock(_fd,op)!=0)
+        throw AdaoExchangeLayerException("AdaoEvaluationStore : fail to lock store file !");
+    }
+    ~FileLock() { flock(_fd,LOCK_UN); }
+  private:
+    int _fd;
+  };
+
+  std::size_t FileSize(int fd)
+  {
+    struct stat st;
+    if(fstat(fd,&st)!=0)
+      throw AdaoExchangeLayerException("AdaoEvaluationStore : fstat failed on store file !");
+    return st.st_size;
+  }
+
+  void WriteAll(int fd, const char *data, std::size_t len, std::size_t offset)
+  {
+    while(len>0)
+      {
+        ssize_t nb(pwrite(fd,data,len,offset));
+        if(nb<=0)
+          throw AdaoExchangeLayerException("AdaoEvaluationStore : write failed on store file !");
+        data+=nb; len-=nb; offset+=nb;
+      }
+  }
+}
+
+AdaoEvaluationStore::AdaoEvaluationStore(const std::string& fileName, const std::string& modelVersionTag):_file_name(fileName)
+{
+  _tag_hash = FNV1a(modelVersionTag.data(),modelVersionTag.size());
+  _fd = open(fileName.c_str(),O_RDWR | O_CREAT,0644);
+  if(_fd<0)
+    {
+      std::ostringstream oss; oss << "AdaoEvaluationStore : impossible to open \"" << fileName << "\" !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+  FileLock lock(_fd,LOCK_EX);
+  std::size_t sz(FileSize(_fd));
+  if(sz==0)
+    {
+      char header[HEADER_SIZE]={0};
+      std::memcpy(header,MAGIC,sizeof(MAGIC));
+      WriteAll(_fd,header,HEADER_SIZE,0);
+      sz = HEADER_SIZE;
+    }
+  char magic[sizeof(MAGIC)];
+  if(sz<HEADER_SIZE || pread(_fd,magic,sizeof(MAGIC),0)!=sizeof(MAGIC) || std::memcmp(magic,MAGIC,sizeof(MAGIC))!=0)
+    {
+      close(_fd);
+      std::ostringstream oss; oss << "AdaoEvaluationStore : \"" << fileName << "\" is not an evaluation store !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+  _indexed_up_to = HEADER_SIZE;
+  refreshLocked();
+}
+
+AdaoEvaluationStore::~AdaoEvaluationStore()
+{
+  if(_map)
+    munmap(_map,_map_size);
+  if(_fd>=0)
+    close(_fd);
+}
+
+std::uint64_t AdaoEvaluationStore::hashOf(std::size_t inputSize, const double *input) const
+{
+  return FNV1a(input,inputSize*sizeof(double),_tag_hash);
+}
+
+void AdaoEvaluationStore::remapLocked(std::size_t fileSize)
+{
+  if(fileSize<=_map_size)
+    return ;
+  if(_map)
+    munmap(_map,_map_size);
+  _map = nullptr; _map_size = 0;
+  void *pt(mmap(nullptr,fileSize,PROT_READ,MAP_SHARED,_fd,0));
+  if(pt==MAP_FAILED)
+    throw AdaoExchangeLayerException("AdaoEvaluationStore : mmap failed on store file !");
+  _map = reinterpret_cast<char *>(pt);
+  _map_size = fileSize;
+}
+
+/*!
+ * Index records appended since last call. File lock is expected to be held by caller.
+ * Stops at the first incomplete record.
+ */
+void AdaoEvaluationStore::refreshLocked()
+{
+  std::size_t sz(FileSize(_fd));
+  if(sz<=_indexed_up_to)
+    return ;
+  remapLocked(sz);
+  while(_indexed_up_to+sizeof(RecordHeader)<=sz)
+    {
+      RecordHeader rh;
+      std::memcpy(&rh,_map+_indexed_up_to,sizeof(RecordHeader));
+      std::size_t recSize(SizeOfRecord(rh));
+      if(_indexed_up_to+recSize>sz)
+        break;
+      if(rh._tag_hash==_tag_hash)
+        _index.emplace(rh._hash,_indexed_up_to);
+      _indexed_up_to+=recSize;
+    }
+}
+
+/*!
+ * Returns true and fills \a output if an evaluation of \a input has already been stored with the same model version tag.
+ */
+bool AdaoEvaluationStore::find(std::size_t inputSize, const double *input, std::vector<double>& output)
+{
+  std::lock_guard<std::mutex> guard(_mutex);
+  {
+    FileLock lock(_fd,LOCK_SH);
+    refreshLocked();
+  }
+  std::uint64_t h(hashOf(inputSize,input));
+  auto range(_index.equal_range(h));
+  for(auto it=range.first;it!=range.second;++it)
+    {
+      RecordHeader rh;
+      std::memcpy(&rh,_map+it->second,sizeof(RecordHeader));
+      if(rh._input_size!=inputSize)
+        continue;
+      const char *data(_map+it->second+sizeof(RecordHeader));
+      if(std::memcmp(data,input,inputSize*sizeof(double))!=0)
+        continue;
+      output.resize(rh._output_size);
+      std::memcpy(output.data(),data+inputSize*sizeof(double),rh._output_size*sizeof(double));
+      return true;
+    }
+  return false;
+}
+
+void AdaoEvaluationStore::append(std::size_t inputSize, const double *input, std::size_t outputSize, const double *output)
+{
+  std::lock_guard<std::mutex> guard(_mutex);
+  RecordHeader rh;
+  rh._hash = hashOf(inputSize,input);
+  rh._tag_hash = _tag_hash;
+  rh._input_size = inputSize;
+  rh._output_size = outputSize;
+  std::vector<char> rec(SizeOfRecord(rh));
+  std::memcpy(rec.data(),&rh,sizeof(RecordHeader));
+  std::memcpy(rec.data()+sizeof(RecordHeader),input,inputSize*sizeof(double));
+  std::memcpy(rec.data()+sizeof(RecordHeader)+inputSize*sizeof(double),output,outputSize*sizeof(double));
+  FileLock lock(_fd,LOCK_EX);
+  refreshLocked();
+  if(FileSize(_fd)!=_indexed_up_to)
+    {// garbage left by a crashed writer
+      if(ftruncate(_fd,_indexed_up_to)!=0)
+        throw AdaoExchangeLayerException("AdaoEvaluationStore : fail to truncate store file !");
+    }
+  WriteAll(_fd,rec.data(),rec.size(),_indexed_up_to);
+  refreshLocked();
+}
+
+std::size_t AdaoEvaluationStore::getNumberOfRecords()
+{
+  std::lock_guard<std::mutex> guard(_mutex);
+  FileLock lock(_fd,LOCK_SH);
+  refreshLocked();
+  return _index.size();
+}
+
+void AdaoEvaluatorWithStore::evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs)
+{
+  std::vector<std::size_t> misses;
+  std::vector<double> out;
+  for(std::size_t i=0;i<nbOfSamples;++i)
+    {
+      if(_store->find(inputSize,inputs+i*inputSize,out) && out.size()==outputSize)
+        std::copy(out.begin(),out.end(),outputs+i*outputSize);
+      else
+        misses.push_back(i);
+    }
+  if(misses.empty())
+    return ;
+  std::vector<double> missInputs(misses.size()*inputSize),missOutputs(misses.size()*outputSize);
+  for(std::size_t i=0;i<misses.size();++i)
+    std::copy(inputs+misses[i]*inputSize,inputs+(misses[i]+1)*inputSize,missInputs.begin()+i*inputSize);
+  _evaluator->evaluate(misses.size(),inputSize,missInputs.data(),outputSize,missOutputs.data());
+  for(std::size_t i=0;i<misses.size();++i)
+    {
+      _store->append(inputSize,missInputs.data()+i*inputSize,outputSize,missOutputs.data()+i*outputSize);
+      std::copy(missOutputs.begin()+i*outputSize,missOutputs.begin()+(i+1)*outputSize,outputs+misses[i]*outputSize);
+    }
+}
@@ -0,0 +1,76 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include "AdaoEvaluator.hxx"
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+
+/*!
+ * Persistent append-only store of evaluations of the observation operator, shared across runs and processes.
+ * Each record is keyed by the exact input vector and by a user provided model version tag : changing the tag invalidates
+ * all previous records without removing them.
+ *
+ * File is memory mapped for lookups. Appends are serialized between processes using an exclusive lock on the file,
+ * lookups take a shared lock only to catch up with records appended by other processes.
+ * A record partially written by a crashed process is ignored and overwritten by the next append.
+ */
+class AdaoEvaluationStore
+{
+public:
+  AdaoEvaluationStore(const std::string& fileName, const std::string& modelVersionTag);
+  ~AdaoEvaluationStore();
+  const std::string& getFileName() const { return _file_name; }
+  bool find(std::size_t inputSize, const double *input, std::vector<double>& output);
+  void append(std::size_t inputSize, const double *input, std::size_t outputSize, const double *output);
+  std::size_t getNumberOfRecords();
+private:
+  void refreshLocked();
+  void remapLocked(std::size_t fileSize);
+  std::uint64_t hashOf(std::size_t inputSize, const double *input) const;
+private:
+  std::string _file_name;
+  std::uint64_t _tag_hash = 0;
+  int _fd = -1;
+  char *_map = nullptr;
+  std::size_t _map_size = 0;
+  //! offset in file of the first byte not yet indexed
+  std::size_t _indexed_up_to = 0;
+  std::unordered_multimap<std::uint64_t,std::size_t> _index;
+  std::mutex _mutex;
+};
+
+/*!
+ * Evaluator answering from \a store the samples already computed and calling \a evaluator (not owned) for the others.
+ */
+class AdaoEvaluatorWithStore : public AdaoEvaluator
+{
+public:
+  AdaoEvaluatorWithStore(AdaoEvaluator *evaluator, AdaoEvaluationStore *store):_evaluator(evaluator),_store(store) { }
+  void evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs) override;
+private:
+  AdaoEvaluator *_evaluator = nullptr;
+  AdaoEvaluationStore *_store = nullptr;
+};
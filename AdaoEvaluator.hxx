@@ -0,0 +1,182 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include "AdaoExchangeLayerException.hxx"
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <sstream>
+
+/*!
+ * C++ evaluator of the observation operator. No python is involved.
+ * \a inputs contains \a nbOfSamples samples of size \a inputSize stored row by row.
+ * \a outputs is allocated by caller and has to be filled row by row with \a nbOfSamples results of size \a outputSize.
+ */
+class AdaoEvaluator
+{
+public:
+  virtual ~AdaoEvaluator() { }
+  virtual void evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs) = 0;
+};
+
+/*!
+ * Order of the values of a batch of samples : SampleMajor stores each sample contiguously (like AdaoEvaluator::evaluate), ComponentMajor stores
+ * each component of all samples contiguously, so that an operator can be vectorized across samples.
+ */
+enum class AdaoBatchLayout
+{
+    SampleMajor,
+    ComponentMajor
+};
+
+/*!
+ * Strided view (not owning) on a batch of samples : component \a j of sample \a i is at data()[i*getSampleStride()+j*getComponentStride()].
+ */
+template<class T>
+class AdaoStridedMatrix
+{
+public:
+  AdaoStridedMatrix(std::size_t nbOfSamples, std::size_t sampleSize, T *data, std::size_t sampleStride, std::size_t componentStride):_nb_of_samples(nbOfSamples),_sample_size(sampleSize),_data(data),_sample_stride(sampleStride),_component_stride(componentStride) { }
+  static AdaoStridedMatrix Dense(std::size_t nbOfSamples, std::size_t sampleSize, T *data, AdaoBatchLayout layout)
+  {
+    if(layout==AdaoBatchLayout::SampleMajor)
+      return AdaoStridedMatrix(nbOfSamples,sampleSize,data,sampleSize,1);
+    return AdaoStridedMatrix(nbOfSamples,sampleSize,data,1,nbOfSamples);
+  }
+  std::size_t getNumberOfSamples() const { return _nb_of_samples; }
+  std::size_t getSampleSize() const { return _sample_size; }
+  std::size_t getSampleStride() const { return _sample_stride; }
+  std::size_t getComponentStride() const { return _component_stride; }
+  T *data() const { return _data; }
+  T& operator()(std::size_t sampleId, std::size_t componentId) const { return _data[sampleId*_sample_stride+componentId*_component_stride]; }
+private:
+  std::size_t _nb_of_samples;
+  std::size_t _sample_size;
+  T *_data;
+  std::size_t _sample_stride;
+  std::size_t _component_stride;
+};
+
+using AdaoConstSampleMatrix = AdaoStridedMatrix<const double>;
+using AdaoSampleMatrix = AdaoStridedMatrix<double>;
+
+/*!
+ * Evaluator seeing the whole batch at once, in its preferred layout : samples given row by row to evaluate are transposed if needed.
+ * \a outputs of evaluateBatch is allocated by caller, with the same number of samples than \a inputs.
+ */
+class AdaoBatchEvaluator : public AdaoEvaluator
+{
+public:
+  virtual AdaoBatchLayout getPreferredLayout() const { return AdaoBatchLayout::SampleMajor; }
+  virtual void evaluateBatch(const AdaoConstSampleMatrix& inputs, const AdaoSampleMatrix& outputs) = 0;
+  void evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs) override
+  {
+    if(getPreferredLayout()==AdaoBatchLayout::SampleMajor)
+      {
+        evaluateBatch(AdaoConstSampleMatrix::Dense(nbOfSamples,inputSize,inputs,AdaoBatchLayout::SampleMajor),
+                      AdaoSampleMatrix::Dense(nbOfSamples,outputSize,outputs,AdaoBatchLayout::SampleMajor));
+        return ;
+      }
+    std::vector<double> transposedInputs(nbOfSamples*inputSize),transposedOutputs(nbOfSamples*outputSize);
+    AdaoSampleMatrix in(AdaoSampleMatrix::Dense(nbOfSamples,inputSize,transposedInputs.data(),AdaoBatchLayout::ComponentMajor));
+    for(std::size_t i=0;i<nbOfSamples;++i)
+      for(std::size_t j=0;j<inputSize;++j)
+        in(i,j) = inputs[i*inputSize+j];
+    AdaoSampleMatrix out(AdaoSampleMatrix::Dense(nbOfSamples,outputSize,transposedOutputs.data(),AdaoBatchLayout::ComponentMajor));
+    evaluateBatch(AdaoConstSampleMatrix(nbOfSamples,inputSize,transposedInputs.data(),in.getSampleStride(),in.getComponentStride()),out);
+    for(std::size_t i=0;i<nbOfSamples;++i)
+      for(std::size_t j=0;j<outputSize;++j)
+        outputs[i*outputSize+j] = out(i,j);
+  }
+};
+
+/*!
+ * Evaluator also giving the tangent of the operator, used instead of finite differences with AdaoModel::EnumJacobianMode::Exact.
+ * transposeOfTangent fills \a hx (size \a outputSize) with H(x) and \a ht (\a inputSize rows of \a outputSize) with the transpose of the tangent at \a x :
+ * row \a i is the derivative of H along component \a i of the input.
+ */
+class AdaoDifferentiableEvaluator : public AdaoBatchEvaluator
+{
+public:
+  virtual void transposeOfTangent(std::size_t inputSize, const double *x, std::size_t outputSize, double *hx, double *ht) = 0;
+};
+
+/*!
+ * Lift of a per sample C++ function writing its result in place : no allocation per sample when samples are contiguous.
+ */
+class AdaoPerSampleEvaluator : public AdaoBatchEvaluator
+{
+public:
+  AdaoPerSampleEvaluator(std::function< void(std::size_t inputSize, const double *input, std::size_t outputSize, double *output) > cppFunction):_cpp_function(cppFunction) { }
+  void evaluateBatch(const AdaoConstSampleMatrix& inputs, const AdaoSampleMatrix& outputs) override
+  {
+    std::size_t inputSize(inputs.getSampleSize()),outputSize(outputs.getSampleSize());
+    std::vector<double> input(inputs.getComponentStride()==1?0:inputSize),output(outputs.getComponentStride()==1?0:outputSize);
+    for(std::size_t i=0;i<inputs.getNumberOfSamples();++i)
+      {
+        const double *in(&inputs(i,0));
+        if(!input.empty())
+          {
+            for(std::size_t j=0;j<inputSize;++j)
+              input[j] = inputs(i,j);
+            in = input.data();
+          }
+        double *out(output.empty()?&outputs(i,0):output.data());
+        _cpp_function(inputSize,in,outputSize,out);
+        if(!output.empty())
+          for(std::size_t j=0;j<outputSize;++j)
+            outputs(i,j) = output[j];
+      }
+  }
+private:
+  std::function< void(std::size_t, const double *, std::size_t, double *) > _cpp_function;
+};
+
+/*!
+ * Evaluator calling a per sample C++ function.
+ */
+class AdaoFunctionEvaluator : public AdaoBatchEvaluator
+{
+public:
+  AdaoFunctionEvaluator(std::function< std::vector<double>(const std::vector<double>&) > cppFunction):_cpp_function(cppFunction) { }
+  void evaluateBatch(const AdaoConstSampleMatrix& inputs, const AdaoSampleMatrix& outputs) override
+  {
+    std::size_t outputSize(outputs.getSampleSize());
+    std::vector<double> sample(inputs.getSampleSize());
+    for(std::size_t i=0;i<inputs.getNumberOfSamples();++i)
+      {
+        for(std::size_t j=0;j<sample.size();++j)
+          sample[j] = inputs(i,j);
+        std::vector<double> res(_cpp_function(sample));
+        if(res.size()!=outputSize)
+          {
+            std::ostringstream oss; oss << "AdaoFunctionEvaluator : function returned " << res.size() << " values whereas " << outputSize << " are expected !";
+            throw AdaoExchangeLayerException(oss.str());
+          }
+        for(std::size_t j=0;j<outputSize;++j)
+          outputs(i,j) = res[j];
+      }
+  }
+private:
+  std::function< std::vector<double>(const std::vector<double>&) > _cpp_function;
+};
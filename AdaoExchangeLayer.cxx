@@ -21,27 +21,70 @@
 #include "AdaoExchangeLayer.hxx"
 #include "AdaoExchangeLayerException.hxx"
 #include "AdaoModelKeyVal.hxx"
+#include "AdaoNativeEngine.hxx"
+#include "AdaoEvaluationStore.hxx"
+#include "AdaoSurrogate.hxx"
+#include "AdaoSpeculation.hxx"
+#include "AdaoPyConversion.hxx"
+#include "AdaoRemoteEngine.hxx"
+#include "AdaoMemoryAccounting.hxx"
+#include "AdaoExchangeLog.hxx"
+#include "AdaoSerieExport.hxx"
+#include "AdaoStoragePolicy.hxx"
+#include "AdaoCovarianceOperator.hxx"
+#include "AdaoPartition.hxx"
 #include "PyObjectRAII.hxx"
 #include "Python.h"
 
 #include <semaphore.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
 #include <iostream>
 #include <sstream>
 #include <clocale>
 #include <cstdlib>
 #include <thread>
+#include <chrono>
 #include <future>
+#include <memory>
+#include <mutex>
+#include <map>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 struct DataExchangedBetweenThreads // data written by subthread and read by calling thread
 {
 public:
   DataExchangedBetweenThreads();
   ~DataExchangedBetweenThreads();
+public:
+  void notifyCallingThread();
 public:
   sem_t _sem;
   sem_t _sem_result_is_here;
+  //! optional eventfd signaled with _sem (see AdaoExchangeLayer::getEventFileDescriptor)
+  int _event_fd = -1;
   volatile bool _finished = false;
   volatile PyObject *_data = nullptr;
+  //! operator to be evaluated with _data
+  volatile AdaoOperatorKind _requested_operator = AdaoOperatorKind::ObservationOperator;
+  AdaoEvaluationStore *_store = nullptr;
+  AdaoSurrogate *_surrogate = nullptr;
+  //! push mode : evaluator called directly by the ADAO thread, no hand off
+  AdaoEvaluator *_evaluator = nullptr;
+  //! push mode with EnumJacobianMode::Exact : evaluator given to setEvaluatorInModel, _evaluator being possibly wrapped by store or surrogate
+  AdaoDifferentiableEvaluator *_differentiable_evaluator = nullptr;
+  std::size_t _output_size = 0;
+  //! push mode with 4DVAR : evaluator of the evolution model, whose output has the size of the state
+  AdaoEvaluator *_evolution_evaluator = nullptr;
+  std::size_t _state_size = 0;
+  AdaoMemoryAccounting *_memory = nullptr;
+  AdaoExchangeRecorder *_recorder = nullptr;
+  //! calls of the callbacks are serialized : hand off slot, store, surrogate and evaluators are not reentrant (no GIL to rely on in free-threaded builds)
+  std::mutex _call_mutex;
 };
 
 /////////////////////////////////////////////
@@ -50,8 +93,301 @@ struct AdaoCallbackSt
 {
   PyObject_HEAD
   DataExchangedBetweenThreads *_data;
+  AdaoOperatorKind _kind;
 };
 
+/*!
+ * Give \a input to the thread calling AdaoExchangeLayer::next and wait for the result given by AdaoExchangeLayer::setResult.
+ */
+static PyObject *HandOffToCallingThread(DataExchangedBetweenThreads *data, PyObject *input)
+{
+  volatile PyObject *ret(nullptr);
+  PyThreadState *tstate(PyEval_SaveThread());// GIL is acquired (see ExecuteAsync). Before entering into non python section. Release lock
+  {
+    data->_finished = false;
+    data->_data = input;
+    data->notifyCallingThread();
+    sem_wait(&data->_sem_result_is_here);
+    ret = data->_data;
+  }
+  PyEval_RestoreThread(tstate);//End of parallel section. Reaquire the GIL and restore the thread state
+  PyObject *result((PyObject *)ret);
+  if(result && PyExceptionInstance_Check(result))
+    {// exception given to setResult (see AdaoExchangeLayer::evaluateAndSetResult) : ADAO is interrupted by it
+      PyErr_SetObject((PyObject *)Py_TYPE(result),result);
+      Py_DECREF(result);
+      return nullptr;
+    }
+  return result;
+}
+
+/*!
+ * Return the samples of \a samples (\a fastSamples being its PySequence_Fast) whose ids are \a ids, in a sequence of the same kind.
+ */
+template<class T>
+static PyObjectRAII ExtractSamples(PyObject *samples, PyObject *fastSamples, const std::vector<T>& ids)
+{
+  if(ids.size()==(std::size_t)PySequence_Fast_GET_SIZE(fastSamples))
+    return PyObjectRAII::FromBorrowed(samples);
+  PyObjectRAII ret;
+  if(PyList_Check(samples) || PyTuple_Check(samples))
+    {
+      ret = PyObjectRAII::FromNew(PyList_New(ids.size()));
+      for(std::size_t i=0;i<ids.size();++i)
+        {
+          PyObject *elt(PySequence_Fast_GET_ITEM(fastSamples,ids[i]));
+          Py_XINCREF(elt); PyList_SetItem(ret,i,elt);
+        }
+    }
+  else
+    {// numpy array (float32 transport) : keep the same type for the calling thread
+      PyObjectRAII pyIds(PyObjectRAII::FromNew(PyList_New(ids.size())));
+      for(std::size_t i=0;i<ids.size();++i)
+        PyList_SetItem(pyIds,i,PyLong_FromSsize_t(ids[i]));
+      ret = PyObjectRAII::FromNew(PyObject_GetItem(samples,pyIds));
+    }
+  if(ret.isNull())
+    throw AdaoExchangeLayerException("ExtractSamples : fail to extract samples to compute !");
+  return ret;
+}
+
+/*!
+ * Samples of \a samples found in store are not given to the calling thread. Only missing ones are handed off, then stored.
+ * Throws on failure (see CallUsingStore).
+ */
+static PyObject *CallUsingStoreUnguarded(DataExchangedBetweenThreads *data, PyObject *samples)
+{
+  PyObjectRAII fastSamples(PyObjectRAII::FromNew(PySequence_Fast(samples,"samples are not a sequence")));
+  if(fastSamples.isNull())
+    throw AdaoExchangeLayerException("CallUsingStore : samples are expected to be a sequence !");
+  Py_ssize_t nbOfSamples(PySequence_Fast_GET_SIZE(fastSamples.operator PyObject *()));
+  std::vector< std::vector<double> > inputs(nbOfSamples),outputs(nbOfSamples);
+  std::vector<Py_ssize_t> misses;
+  for(Py_ssize_t i=0;i<nbOfSamples;++i)
+    {
+      PyToDoubles(PySequence_Fast_GET_ITEM(fastSamples.operator PyObject *(),i),inputs[i]);
+      if(!data->_store->find(inputs[i].size(),inputs[i].data(),outputs[i]))
+        misses.push_back(i);
+    }
+  PyObjectRAII resultOfMisses;
+  PyObjectRAII fastResultOfMisses;
+  if(!misses.empty())
+    {
+      PyObjectRAII samplesToCompute(ExtractSamples(samples,fastSamples,misses));
+      resultOfMisses = PyObjectRAII::FromNew(HandOffToCallingThread(data,samplesToCompute));
+      if(resultOfMisses.isNull())
+        return nullptr;
+      fastResultOfMisses = PyObjectRAII::FromNew(PySequence_Fast(resultOfMisses,"result is not a sequence"));
+      if(fastResultOfMisses.isNull() || PySequence_Fast_GET_SIZE(fastResultOfMisses.operator PyObject *())!=(Py_ssize_t)misses.size())
+        throw AdaoExchangeLayerException("CallUsingStore : result given by setResult is expected to be a sequence with one element per requested sample !");
+      for(std::size_t i=0;i<misses.size();++i)
+        {
+          std::vector<double>& input(inputs[misses[i]]),& output(outputs[misses[i]]);
+          PyToDoubles(PySequence_Fast_GET_ITEM(fastResultOfMisses.operator PyObject *(),i),output);
+          data->_store->append(input.size(),input.data(),output.size(),output.data());
+        }
+    }
+  PyObject *ret(PyList_New(nbOfSamples));
+  std::size_t posInMisses(0);
+  for(Py_ssize_t i=0;i<nbOfSamples;++i)
+    {
+      if(posInMisses<misses.size() && misses[posInMisses]==i)
+        {
+          PyObject *elt(PySequence_Fast_GET_ITEM(fastResultOfMisses.operator PyObject *(),posInMisses++));
+          Py_XINCREF(elt); PyList_SetItem(ret,i,elt);
+        }
+      else
+        PyList_SetItem(ret,i,DoublesToPyList(outputs[i].data(),outputs[i].size()));
+    }
+  return ret;
+}
+
+/*!
+ * CallUsingStoreUnguarded called in a python call : failures (bad result given to setResult, store append failure...) are turned into a python exception.
+ */
+static PyObject *CallUsingStore(DataExchangedBetweenThreads *data, PyObject *samples)
+{
+  std::string error;
+  try
+    {
+      return CallUsingStoreUnguarded(data,samples);
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      error = e.what();
+    }
+  catch(std::exception& e)
+    {
+      error = e.what();
+    }
+  catch(...)
+    {
+      error = "CallUsingStore : unknown exception !";
+    }
+  PyErr_SetString(PyExc_RuntimeError,error.c_str());
+  return nullptr;
+}
+
+/*!
+ * Samples the surrogate is confident about are not given to the calling thread (nor to the store if any).
+ * Throws on failure (see CallUsingSurrogate).
+ */
+static PyObject *CallUsingSurrogateUnguarded(DataExchangedBetweenThreads *data, PyObject *samples)
+{
+  PyObjectRAII fastSamples(PyObjectRAII::FromNew(PySequence_Fast(samples,"samples are not a sequence")));
+  if(fastSamples.isNull())
+    throw AdaoExchangeLayerException("CallUsingSurrogate : samples are expected to be a sequence !");
+  Py_ssize_t nbOfSamples(PySequence_Fast_GET_SIZE(fastSamples.operator PyObject *()));
+  std::vector< std::vector<double> > inputs(nbOfSamples),outputs;
+  for(Py_ssize_t i=0;i<nbOfSamples;++i)
+    PyToDoubles(PySequence_Fast_GET_ITEM(fastSamples.operator PyObject *(),i),inputs[i]);
+  bool isOK(data->_surrogate->evaluate(inputs,outputs,[data,samples,&fastSamples](const std::vector<std::size_t>& ids, std::vector< std::vector<double> >& res)
+                                       {
+                                         PyObjectRAII samplesToCompute(ExtractSamples(samples,fastSamples,ids));
+                                         PyObjectRAII result(PyObjectRAII::FromNew(data->_store?CallUsingStore(data,samplesToCompute):HandOffToCallingThread(data,samplesToCompute)));
+                                         if(result.isNull())
+                                           return false;
+                                         PyObjectRAII fastResult(PyObjectRAII::FromNew(PySequence_Fast(result,"result is not a sequence")));
+                                         if(fastResult.isNull() || PySequence_Fast_GET_SIZE(fastResult.operator PyObject *())!=(Py_ssize_t)ids.size())
+                                           throw AdaoExchangeLayerException("CallUsingSurrogate : result given by setResult is expected to be a sequence with one element per requested sample !");
+                                         for(std::size_t i=0;i<ids.size();++i)
+                                           {
+                                             res[ids[i]].clear();
+                                             PyToDoubles(PySequence_Fast_GET_ITEM(fastResult.operator PyObject *(),i),res[ids[i]]);
+                                           }
+                                         return true;
+                                       }));
+  if(!isOK)
+    return nullptr;
+  PyObject *ret(PyList_New(nbOfSamples));
+  for(Py_ssize_t i=0;i<nbOfSamples;++i)
+    PyList_SetItem(ret,i,DoublesToPyList(outputs[i].data(),outputs[i].size()));
+  return ret;
+}
+
+/*!
+ * CallUsingSurrogateUnguarded called in a python call : failures (bad result given to setResult, prediction or learning failure...)
+ * are turned into a python exception.
+ */
+static PyObject *CallUsingSurrogate(DataExchangedBetweenThreads *data, PyObject *samples)
+{
+  std::string error;
+  try
+    {
+      return CallUsingSurrogateUnguarded(data,samples);
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      error = e.what();
+    }
+  catch(std::exception& e)
+    {
+      error = e.what();
+    }
+  catch(...)
+    {
+      error = "CallUsingSurrogate : unknown exception !";
+    }
+  PyErr_SetString(PyExc_RuntimeError,error.c_str());
+  return nullptr;
+}
+
+/*!
+ * Copy the batch \a samples (sequence of samples of the same size) row by row into \a inputs. Returns the number of samples.
+ * GIL is expected to be held by caller.
+ */
+static std::size_t ReadSamples(PyObject *samples, std::vector<double>& inputs, std::size_t& inputSize)
+{
+  PyObjectRAII fastSamples(PyObjectRAII::FromNew(PySequence_Fast(samples,"samples are not a sequence")));
+  if(fastSamples.isNull())
+    throw AdaoExchangeLayerException("ReadSamples : samples are expected to be a sequence !");
+  std::size_t nbOfSamples(PySequence_Fast_GET_SIZE(fastSamples.operator PyObject *()));
+  inputs.clear();
+  inputSize = 0;
+  for(std::size_t i=0;i<nbOfSamples;++i)
+    {
+      PyToDoubles(PySequence_Fast_GET_ITEM(fastSamples.operator PyObject *(),i),inputs);
+      if(i==0)
+        inputSize = inputs.size();
+      if(inputs.size()!=(i+1)*inputSize)
+        throw AdaoExchangeLayerException("ReadSamples : samples are expected to have the same size !");
+    }
+  return nbOfSamples;
+}
+
+/*!
+ * Returns a new reference on a list of \a nbOfSamples lists of floats. GIL is expected to be held by caller.
+ */
+static PyObject *WriteSamples(std::size_t nbOfSamples, std::size_t sampleSize, const double *samples)
+{
+  PyObject *ret(PyList_New(nbOfSamples));
+  for(std::size_t i=0;i<nbOfSamples;++i)
+    PyList_SetItem(ret,i,DoublesToPyList(samples+i*sampleSize,sampleSize));
+  return ret;
+}
+
+/*!
+ * Push mode : samples are evaluated by the AdaoEvaluator in the ADAO thread itself, GIL being released during evaluation.
+ */
+static PyObject *CallEvaluatorDirectly(AdaoEvaluator *evaluator, std::size_t outputSize, PyObject *samples)
+{
+  std::size_t inputSize(0),nbOfSamples(0);
+  std::vector<double> inputs,outputs;
+  std::string error;
+  try
+    {
+      nbOfSamples = ReadSamples(samples,inputs,inputSize);
+      outputs.resize(nbOfSamples*outputSize);
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      error = e.what();
+    }
+  catch(std::exception& e)
+    {
+      error = e.what();
+    }
+  if(error.empty())
+    {
+      AutoSaveThread ast;
+      try
+        {
+          evaluator->evaluate(nbOfSamples,inputSize,inputs.data(),outputSize,outputs.data());
+        }
+      catch(AdaoExchangeLayerException& e)
+        {
+          error = e.what();
+        }
+      catch(std::exception& e)
+        {
+          error = e.what();
+        }
+      catch(...)
+        {
+          error = "push mode : unknown exception in evaluate";
+        }
+    }
+  if(!error.empty())
+    {// ADAO is interrupted by a python exception
+      PyErr_SetString(PyExc_RuntimeError,error.c_str());
+      return nullptr;
+    }
+  return WriteSamples(nbOfSamples,outputSize,outputs.data());
+}
+
+/*!
+ * Write the batch \a samples and its answer \a result in the exchange log. GIL is expected to be held by caller.
+ */
+static void RecordExchange(AdaoExchangeRecorder *recorder, AdaoOperatorKind kind, PyObject *samples, PyObject *result, double evaluationSeconds)
+{
+  std::size_t inputSize(0),outputSize(0);
+  std::vector<double> inputs,outputs;
+  std::size_t nbOfSamples(ReadSamples(samples,inputs,inputSize));
+  if(ReadSamples(result,outputs,outputSize)!=nbOfSamples)
+    throw AdaoExchangeLayerException("RecordExchange : result is expected to have one element per requested sample !");
+  recorder->record(kind,nbOfSamples,inputSize,inputs.data(),outputSize,outputs.data(),evaluationSeconds);
+}
+
 static PyObject *adaocallback_call(AdaoCallbackSt *self, PyObject *args, PyObject *kw)
 {
   if(!PyTuple_Check(args))
@@ -61,17 +397,55 @@ static PyObject *adaocallback_call(AdaoCallbackSt *self, PyObject *args, PyObjec
   PyObjectRAII zeobj(PyObjectRAII::FromBorrowed(PyTuple_GetItem(args,0)));
   if(zeobj.isNull())
     throw AdaoExchangeLayerException("Retrieve of elt #0 of input tuple has failed !");
-  volatile PyObject *ret(nullptr);
-  PyThreadState *tstate(PyEval_SaveThread());// GIL is acquired (see ExecuteAsync). Before entering into non python section. Release lock
-  {
-    self->_data->_finished = false;
-    self->_data->_data = zeobj;
-    sem_post(&self->_data->_sem);
-    sem_wait(&self->_data->_sem_result_is_here);
-    ret = self->_data->_data;
-  }
-  PyEval_RestoreThread(tstate);//End of parallel section. Reaquire the GIL and restore the thread state
-  return (PyObject *)ret;
+  std::unique_lock<std::mutex> lock(self->_data->_call_mutex,std::try_to_lock);
+  if(!lock.owns_lock())
+    {// thread state is detached while waiting : the owner may need it (GIL builds)
+      AutoSaveThread ast;
+      lock.lock();
+    }
+  PyObject *ret(nullptr);
+  auto start(std::chrono::steady_clock::now());
+  self->_data->_requested_operator = self->_kind;
+  if(self->_kind==AdaoOperatorKind::EvolutionModel)
+    {// store and surrogate are dedicated to the observation operator
+      if(self->_data->_evaluator)
+        ret = CallEvaluatorDirectly(self->_data->_evolution_evaluator,self->_data->_state_size,zeobj);
+      else
+        ret = HandOffToCallingThread(self->_data,zeobj);
+    }
+  else if(self->_data->_evaluator)
+    ret = CallEvaluatorDirectly(self->_data->_evaluator,self->_data->_output_size,zeobj);
+  else if(self->_data->_surrogate)
+    ret = CallUsingSurrogate(self->_data,zeobj);
+  else if(self->_data->_store)
+    ret = CallUsingStore(self->_data,zeobj);
+  else
+    ret = HandOffToCallingThread(self->_data,zeobj);
+  if(self->_data->_memory && ret)
+    self->_data->_memory->sample(zeobj,ret);
+  if(self->_data->_recorder && ret)
+    {
+      std::string error;
+      try
+        {
+          RecordExchange(self->_data->_recorder,self->_kind,zeobj,ret,std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count());
+        }
+      catch(AdaoExchangeLayerException& e)
+        {
+          error = e.what();
+        }
+      catch(std::exception& e)
+        {
+          error = e.what();
+        }
+      if(!error.empty())
+        {// never let a C++ exception go through python : ADAO is interrupted by a python exception
+          Py_DECREF(ret);
+          PyErr_SetString(PyExc_RuntimeError,error.c_str());
+          return nullptr;
+        }
+    }
+  return ret;
 }
 
 static int adaocallback___init__(PyObject *self, PyObject *args, PyObject *kwargs) { return 0; }
@@ -86,6 +460,9 @@ static void adaocallback_dealloc(PyObject *self)
   Py_TYPE(self)->tp_free(self);
 }
 
+// no python object held
+static int adaocallback_traverse(PyObject *self, visitproc visit, void *arg) { return 0; }
+
 PyTypeObject AdaoCallbackType = {
   PyVarObject_HEAD_INIT(&PyType_Type, 0)
   "adaocallbacktype",
@@ -108,7 +485,7 @@ PyTypeObject AdaoCallbackType = {
   0,                          /*tp_as_buffer*/
   Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC | Py_TPFLAGS_BASETYPE,  /*tp_flags*/
   0,                          /*tp_doc*/
-  0,                          /*tp_traverse*/
+  adaocallback_traverse,      /*tp_traverse*/
   0,                          /*tp_clear*/
   0,                          /*tp_richcompare*/
   0,                          /*tp_weaklistoffset*/
@@ -142,18 +519,52 @@ DataExchangedBetweenThreads::~DataExchangedBetweenThreads()
 {
   sem_destroy(&_sem);
   sem_destroy(&_sem_result_is_here);
+  if(_event_fd>=0)
+    close(_event_fd);
+}
+
+/*!
+ * Data (or end of execution) is available for AdaoExchangeLayer::next / AdaoExchangeLayer::tryNext.
+ */
+void DataExchangedBetweenThreads::notifyCallingThread()
+{
+  sem_post(&_sem);
+  if(_event_fd>=0)
+    {// written after posting _sem : see AdaoExchangeLayer::tryNext
+      std::uint64_t one(1);
+      while(write(_event_fd,&one,sizeof(one))<0 && errno==EINTR);
+    }
+}
+
+/*!
+ * Ready AdaoCallbackType once for all layers of the process. GIL is expected to be held by caller.
+ */
+static void ReadyAdaoCallbackType()
+{
+  static std::once_flag flag;
+  std::call_once(flag,[]()
+                 {
+                   if(PyType_Ready(&AdaoCallbackType)<0)
+                     {
+                       PyErr_Print();
+                       throw AdaoExchangeLayerException("Fail to ready adaocallbacktype !");
+                     }
+                 });
 }
 
 class AdaoCallbackKeeper
 {
 public:
-  void assign(AdaoCallbackSt *pt, DataExchangedBetweenThreads *data)
+  void assign(AdaoCallbackSt *pt, DataExchangedBetweenThreads *data, AdaoOperatorKind kind)
   {
     release();
     _pt = pt;
     _pt->_data = data;
+    _pt->_kind = kind;
   }
   PyObject *getPyObject() const { return reinterpret_cast<PyObject*>(_pt); }
+  //! GIL is expected to be held by caller
+  void reset() { release(); _pt = nullptr; }
   ~AdaoCallbackKeeper() { release(); }
 private:
   void release() { if(_pt) { Py_XDECREF(_pt); } }
@@ -164,9 +575,10 @@ private:
 class AdaoExchangeLayer::Internal
 {
 public:
-  Internal():_context(PyObjectRAII::FromNew(PyDict_New()))
+  Internal()
   {
     AutoGIL agil;
+    _context = PyObjectRAII::FromNew(PyDict_New());
     PyObject *mainmod(PyImport_AddModule("__main__"));
     PyObject *globals(PyModule_GetDict(mainmod));
     PyObject *bltins(PyEval_GetBuiltins());
@@ -176,14 +588,104 @@ public:
   PyObjectRAII _context;
   PyObjectRAII _generate_case_func;
   PyObjectRAII _decorator_func;
+  //! 4DVAR only
+  PyObjectRAII _evolution_decorator_func;
   PyObjectRAII _adao_case;
   PyObjectRAII _execute_func;
   AdaoCallbackKeeper _py_call_back;
+  AdaoCallbackKeeper _py_evolution_call_back;
   std::future< void > _fut;
   PyThreadState *_tstate = nullptr;
+  //! GIL given back to the calling thread by waitForEndOfExecution : released again by next execute for the ADAO thread
+  bool _gil_restored = false;
   DataExchangedBetweenThreads _data_btw_threads;
+  bool _single_precision = false;
+  AdaoEvaluator *_evaluator = nullptr;
+  AdaoEvaluator *_evolution_evaluator = nullptr;
+  std::unique_ptr<AdaoNative::Engine> _native_engine;
+  std::unique_ptr<AdaoEvaluationStore> _store;
+  std::unique_ptr<AdaoRemoteEngine> _remote_engine;
+  std::unique_ptr<AdaoEvaluatorWithStore> _evaluator_with_store;
+  std::unique_ptr<AdaoSurrogate> _surrogate;
+  std::unique_ptr<AdaoEvaluatorWithSurrogate> _evaluator_with_surrogate;
+  std::unique_ptr<AdaoSpeculation> _speculation;
+  std::unique_ptr<AdaoEvaluatorWithSpeculation> _evaluator_with_speculation;
+  std::unique_ptr<AdaoMemoryAccounting> _memory;
+  std::unique_ptr<AdaoExchangeRecorder> _recorder;
+  //! built at first request of posterior covariance by native engine
+  std::unique_ptr<AdaoNative::PosteriorCovariance> _posterior;
+  //! variables stored by ADAO in case, see AdaoExchangeLayer::getStoredVariablesSizes
+  std::vector<std::string> _stored_variables;
+  std::map<std::string,AdaoStoragePolicy> _storage_policies;
+  //! variable name -> npy file written while ADAO computes
+  std::map<std::string,std::string> _serie_exports;
+  std::unique_ptr<AdaoSerieExporter> _exporter;
+  std::vector<AdaoPartition> _partitions;
+  std::size_t _max_nb_of_concurrent_partitions = 0;
+  //! see AdaoNative::Engine::setSamplingStreaming
+  std::size_t _sampling_chunk_size = 1024;
+  std::size_t _max_nb_of_concurrent_chunks = 1;
+  std::string _sampling_result_file_name;
+  //! last samples given by next with out of process engine
+  PyObjectRAII _remote_input;
+  //! namespace of TRANSPORT_FUNCS, see transportFunction
+  PyObjectRAII _transport_funcs;
+public:
+  void waitForEndOfExecution();
+  void releaseCase();
+  void loadOutOfProcess(AdaoModel::MainModel *model);
+  void readOperatorSizes(AdaoModel::MainModel *model);
+  //! why the size of the observation operator result (or of the state) could not be read by readOperatorSizes. Reported by push mode
+  std::string _output_size_diagnostic;
+  std::string _state_size_diagnostic;
+  void preparePushMode(AdaoModel::MainModel *model);
+  void executeSynchronously();
+  void installStoragePolicies();
+  void installSerieExports();
+  PyObjectRAII transportFunction(const char *funcName);
+  PyObjectRAII toTransport(const char *funcName, PyObject *obj);
+  PyObjectRAII buildDecorator(AdaoCallbackKeeper& callBack, AdaoOperatorKind kind);
+  void setFunctionCallbackInModel(AdaoModel::MainModel *model, AdaoEvaluator *evaluator);
+  void prepareSurrogate(AdaoModel::MainModel *model);
+  bool consumeNotification(PyObject *& inputRequested);
+  const AdaoNative::PosteriorCovariance& posteriorCovariance();
 };
 
+/*!
+ * Wait for the end of ADAO thread and give back GIL to the calling thread (released in AdaoExchangeLayer::initPythonIfNeeded).
+ * Can be called several times.
+ */
+void AdaoExchangeLayer::Internal::waitForEndOfExecution()
+{
+  if(_fut.valid())
+    _fut.wait();
+  if(_tstate)
+    {
+      PyEval_RestoreThread(_tstate);
+      _tstate = nullptr;
+      _gil_restored = true;
+    }
+  if(_exporter)
+    _exporter->flush();
+}
+
+/*!
+ * Run \a script in \a context and return the function \a funcName defined by it.
+ */
+static PyObjectRAII LocateFunctionInContext(PyObject *context, const char *script, const char *funcName)
+{
+  PyObjectRAII res(PyObjectRAII::FromNew(PyRun_String(script,Py_file_input,context,context)));
+  if(res.isNull())
+    {
+      PyErr_Print();
+      throw AdaoExchangeLayerException(std::string("Fail to run script defining ") + funcName + " function !");
+    }
+  PyObjectRAII func(PyObjectRAII::FromDictItem(context,funcName));
+  if(func.isNull())
+    throw AdaoExchangeLayerException(std::string("Fail to locate ") + funcName + " function !");
+  return func;
+}
+
 wchar_t **ConvertToWChar(int argc, const char *argv[])
 {
   wchar_t **ret(new wchar_t*[argc]);
@@ -210,6 +712,8 @@ AdaoExchangeLayer::AdaoExchangeLayer()
 
 AdaoExchangeLayer::~AdaoExchangeLayer()
 {
+  if(_internal)// GIL released by init is given back to the calling thread, even if no case has been run
+    _internal->waitForEndOfExecution();
   AutoGIL agil;
   delete _internal;
 }
@@ -219,6 +723,234 @@ void AdaoExchangeLayer::init()
   initPythonIfNeeded();
 }
 
+/*!
+ * Opt-in float32 transport. When activated :
+ * - samples given to the C++ side by next are narrowed into one float32 array (one row per sample),
+ * - outputs given back by setResult are widened to float64 before being handed to ADAO,
+ * - arrays returned by getResult and getSerie are float32.
+ * ADAO itself keeps computing in float64.
+ *
+ * Has to be called before setFunctionCallbackInModel or setEvaluatorInModel.
+ */
+void AdaoExchangeLayer::setSinglePrecisionTransport(bool val)
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("setSinglePrecisionTransport : not initialized !");
+  _internal->_single_precision = val;
+}
+
+bool AdaoExchangeLayer::isSinglePrecisionTransport() const
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("isSinglePrecisionTransport : not initialized !");
+  return _internal->_single_precision;
+}
+
+/*!
+ * Activate the persistent evaluation store \a fileName (created if needed). Samples already evaluated with the same
+ * \a modelVersionTag (by this run, a previous one or another process) are no more given by next : their stored
+ * result is directly given back to ADAO. Change \a modelVersionTag each time the observation operator changes.
+ *
+ * Has to be called before execute.
+ */
+void AdaoExchangeLayer::setEvaluationStore(const std::string& fileName, const std::string& modelVersionTag)
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("setEvaluationStore : not initialized !");
+  _internal->_store.reset(new AdaoEvaluationStore(fileName,modelVersionTag));
+  _internal->_data_btw_threads._store = _internal->_store.get();
+}
+
+/*!
+ * Activate a surrogate of the observation operator (see AdaoSurrogate) answering the finite difference points when its estimated
+ * relative error is lower than \a relativeTolerance. Those points are no more given by next (nor to the evaluator in push mode).
+ * Native and python engines. Has to be called before loadTemplate.
+ */
+void AdaoExchangeLayer::setSurrogate(double relativeTolerance)
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("setSurrogate : not initialized !");
+  _internal->_surrogate.reset(new AdaoSurrogate(relativeTolerance));
+}
+
+/*!
+ * Counters are written by ADAO thread : read them after getResult.
+ */
+const AdaoSurrogate& AdaoExchangeLayer::getSurrogate() const
+{
+  if(!_internal || !_internal->_surrogate)
+    throw AdaoExchangeLayerException("getSurrogate : surrogate is not activated !");
+  return *_internal->_surrogate;
+}
+
+/*!
+ * Push mode with python engine : while ADAO computes, the finite difference points around the last evaluated iterate are
+ * evaluated \a chunkSize at a time (0 meaning all at once) and kept to answer the next request (see AdaoSpeculation).
+ * Has to be called before loadTemplate.
+ */
+void AdaoExchangeLayer::setSpeculation(std::size_t chunkSize)
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("setSpeculation : not initialized !");
+  _internal->_speculation.reset(new AdaoSpeculation(chunkSize));
+}
+
+/*!
+ * Counters are written by ADAO thread : read them after getResult.
+ */
+const AdaoSpeculation& AdaoExchangeLayer::getSpeculation() const
+{
+  if(!_internal || !_internal->_speculation)
+    throw AdaoExchangeLayerException("getSpeculation : speculation is not activated !");
+  return *_internal->_speculation;
+}
+
+/*!
+ * Opt-in memory accounting : tracemalloc is started by execute and one AdaoMemorySample is recorded each time ADAO
+ * calls the observation operator (python engine only). If not already tracing, tracemalloc is stopped when accounting
+ * is turned off, by releaseCase and by the destructor.
+ *
+ * Has to be called before execute.
+ */
+void AdaoExchangeLayer::setMemoryAccounting(bool val)
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("setMemoryAccounting : not initialized !");
+  if(val && !_internal->_memory)
+    _internal->_memory.reset(new AdaoMemoryAccounting);
+  if(!val)
+    {
+      AutoGIL gil;
+      _internal->_memory.reset();
+    }
+  _internal->_data_btw_threads._memory = _internal->_memory.get();
+}
+
+/*!
+ * Opt-in recording of every batch exchanged with the operators (samples, results and timings) in the log \a fileName,
+ * overwritten if it exists. An empty \a fileName stops recording. The log is read by AdaoExchangeLog and replayed
+ * by AdaoReplayEvaluator. Python engine only.
+ *
+ * Has to be called before execute.
+ */
+void AdaoExchangeLayer::setExchangeRecording(const std::string& fileName)
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("setExchangeRecording : not initialized !");
+  _internal->_recorder.reset();
+  if(!fileName.empty())
+    _internal->_recorder.reset(new AdaoExchangeRecorder(fileName));
+  _internal->_data_btw_threads._recorder = _internal->_recorder.get();
+}
+
+/*!
+ * Samples are written by ADAO thread : read them between next and setResult, or after getResult.
+ */
+const AdaoMemoryAccounting& AdaoExchangeLayer::getMemoryAccounting() const
+{
+  if(!_internal || !_internal->_memory)
+    throw AdaoExchangeLayerException("getMemoryAccounting : memory accounting is not activated !");
+  return *_internal->_memory;
+}
+
+/*!
+ * Variables whose stored values are read back by ADAO algorithms, by index or as [-1], or by getResult : CurrentState
+ * and the *AtCurrentState series (indexed by the minimum of CostFunctionJ), cost functions except the *AtCurrentOptimum ones,
+ * and Analysis (last value read by sequential algorithms and getResult). KeepLast would shift their indexes and KeepEvery
+ * would make [-1] a stale value.
+ */
+static bool IsReadBackByAdao(const std::string& varName)
+{
+  if(varName=="CurrentState" || varName=="Analysis")
+    return true;
+  if(varName.find("AtCurrentState")!=std::string::npos)
+    return true;
+  return varName.compare(0,12,"CostFunction")==0 && varName.find("AtCurrentOptimum")==std::string::npos;
+}
+
+/*!
+ * Bound the memory used by ADAO to store \a varName (one of StoreSupplementaryCalculations) : see AdaoStoragePolicy.
+ * Variables read back by ADAO algorithms themselves are refused (see IsReadBackByAdao).
+ * Python engine only. Has to be called before loadTemplate.
+ */
+void AdaoExchangeLayer::setStoragePolicy(const std::string& varName, const AdaoStoragePolicy& policy)
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("setStoragePolicy : not initialized !");
+  if(IsReadBackByAdao(varName))
+    throw AdaoExchangeLayerException(std::string("setStoragePolicy : ") + varName + " is read back by ADAO and has to be fully stored !");
+  _internal->_storage_policies.erase(varName);
+  _internal->_storage_policies.insert(std::make_pair(varName,policy));
+}
+
+/*!
+ * Each value of \a varName ("Analysis" or one of StoreSupplementaryCalculations) is appended to the 2D npy file \a npyFileName
+ * as soon as ADAO stores it (observer installed by loadTemplate), a background thread doing the writes (see AdaoSerieExporter).
+ * Files are complete once getResult has returned. With native engine only "Analysis" is available, written at the end of execute.
+ * An empty \a npyFileName cancels the export of \a varName. Has to be called before loadTemplate.
+ */
+void AdaoExchangeLayer::setSerieExport(const std::string& varName, const std::string& npyFileName)
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("setSerieExport : not initialized !");
+  _internal->_serie_exports.erase(varName);
+  if(!npyFileName.empty())
+    _internal->_serie_exports.insert(std::make_pair(varName,npyFileName));
+}
+
+/*!
+ * Native engine solves the case as independent sub-cases, one per partition, several at the same time (see AdaoPartition).
+ * Global analysis gathers the values of the state components of each partition. Has to be called before loadTemplate.
+ */
+void AdaoExchangeLayer::addPartition(const AdaoPartition& partition)
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("addPartition : not initialized !");
+  _internal->_partitions.push_back(partition);
+}
+
+void AdaoExchangeLayer::clearPartitions()
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("clearPartitions : not initialized !");
+  _internal->_partitions.clear();
+}
+
+/*!
+ * 0 (default) means as many as cores.
+ */
+void AdaoExchangeLayer::setMaximumNumberOfConcurrentPartitions(std::size_t nb)
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("setMaximumNumberOfConcurrentPartitions : not initialized !");
+  _internal->_max_nb_of_concurrent_partitions = nb;
+}
+
+/*!
+ * Sampling tasks (SamplingTest, EnsembleOfSimulationGenerationTask) with native engine : samples are given to the evaluator
+ * \a chunkSize at a time, \a maxNbOfConcurrentChunks chunks at most being evaluated at the same time (see AdaoNative::Engine::setSamplingStreaming).
+ * Outputs are gathered in an array preallocated in memory, or memory mapped on \a resultFileName if not empty.
+ * Has to be called before loadTemplate.
+ */
+void AdaoExchangeLayer::setSamplingStreaming(std::size_t chunkSize, std::size_t maxNbOfConcurrentChunks, const std::string& resultFileName)
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("setSamplingStreaming : not initialized !");
+  _internal->_sampling_chunk_size = chunkSize;
+  _internal->_max_nb_of_concurrent_chunks = maxNbOfConcurrentChunks;
+  _internal->_sampling_result_file_name = resultFileName;
+}
+
+/*!
+ * Outputs (and cost functions for SamplingTest) of a sampling task run by native engine, after execute.
+ */
+const AdaoSamplingResult& AdaoExchangeLayer::getSamplingResult() const
+{
+  if(!_internal || !_internal->_native_engine)
+    throw AdaoExchangeLayerException("getSamplingResult : sampling tasks are streamed by native engine only !");
+  return _internal->_native_engine->getSamplingResult();
+}
+
 PyObject *AdaoExchangeLayer::getPythonContext() const
 {
   if(!_internal)
@@ -247,6 +979,36 @@ std::string AdaoExchangeLayer::printContext() const
   return oss.str();
 }
 
+/*!
+ * Program name and argv are given through PyConfig : Py_SetProgramName, PySys_SetArgv and PyEval_InitThreads are deprecated
+ * (the GIL, if any, is created by Py_Initialize since python 3.7). GIL is held by calling thread at the end.
+ */
+static void InitializePython()
+{
+  const char *TAB[]={"AdaoExchangeLayer"};
+#if PY_VERSION_HEX >= 0x03080000
+  PyConfig config;
+  PyConfig_InitPythonConfig(&config);
+  config.parse_argv = 0;
+  PyStatus status(PyConfig_SetBytesString(&config,&config.program_name,TAB[0]));
+  if(!PyStatus_Exception(status))
+    status = PyConfig_SetBytesArgv(&config,1,const_cast<char * const *>(TAB));
+  if(!PyStatus_Exception(status))
+    status = Py_InitializeFromConfig(&config);
+  PyConfig_Clear(&config);
+  if(PyStatus_Exception(status))
+    throw AdaoExchangeLayerException("Fail to initialize python interpretor !");
+  PyRun_SimpleString("import sys\nsys.path.insert(0,'')\n");// current directory first, as set by PySys_SetArgv
+#else
+  wchar_t **TABW(ConvertToWChar(1,TAB));
+  Py_SetProgramName(const_cast<wchar_t *>(TABW[0]));
+  Py_Initialize(); // Initialize the interpreter
+  PySys_SetArgv(1,TABW);
+  FreeWChar(1,TABW);
+  PyEval_InitThreads();
+#endif
+}
+
 /*!
  * AdaoExchangeLayer is based on multithreaded paradigm.
  * Master thread (thread calling this method) and slave thread (thread calling ADAO algo)
@@ -257,51 +1019,60 @@ std::string AdaoExchangeLayer::printContext() const
  * This method initialize python interpretor if not already the case.
  * At the end of this method the lock is released to be ready to perform RAII on GIL
  * easily. 
+ *
+ * With free-threaded python builds (Py_GIL_DISABLED) there is no lock : AutoGIL only attaches a thread state to the calling thread,
+ * and several layers (one per thread) run their cases and python evaluators in parallel.
  */
 void AdaoExchangeLayer::initPythonIfNeeded()
 {
-  if (!Py_IsInitialized())
-    {
-      const char *TAB[]={"AdaoExchangeLayer"};
-      wchar_t **TABW(ConvertToWChar(1,TAB));
-      // Python is not initialized
-      Py_SetProgramName(const_cast<wchar_t *>(TABW[0]));
-      Py_Initialize(); // Initialize the interpreter
-      PySys_SetArgv(1,TABW);
-      FreeWChar(1,TABW);
-      PyEval_InitThreads();
-      delete _internal;
-      _internal = new Internal;
-      _internal->_tstate=PyEval_SaveThread(); // release the lock acquired in AdaoExchangeLayer::initPythonIfNeeded by PyEval_InitThreads()
-    }
-  else
-    {
+  static std::mutex initializationMutex;// interpretor may be initialized concurrently by several threads
+  {// mutex is never held while waiting for the GIL (Internal constructor) : a thread holding the GIL may be waiting for it
+    std::lock_guard<std::mutex> lock(initializationMutex);
+    if (!Py_IsInitialized())
+      InitializePython();// GIL is now held by this thread
+  }
+  if(_internal)
+    {// GIL released by previous initialization is given back first
+      _internal->waitForEndOfExecution();
+      AutoGIL agil;
       delete _internal;
-      _internal = new Internal;
-      if( PyGILState_Check() )// is the GIL already acquired (typically by a PyEval_InitThreads) ?
-        _internal->_tstate=PyEval_SaveThread(); // release the lock acquired upstream
+      _internal = nullptr;
     }
+  _internal = new Internal;
+  if( PyGILState_Check() )// is the GIL already acquired (by Py_Initialize above or upstream) ?
+    _internal->_tstate=PyEval_SaveThread(); // release the lock acquired upstream
 }
 
 class Visitor1 : public AdaoModel::PythonLeafVisitor
 {
 public:
-  Visitor1(PyObjectRAII func, PyObject *context):_func(func),_context(context)
+  Visitor1(PyObjectRAII func, PyObjectRAII threeFuncs, PyObjectRAII evolutionFunc, PyObject *context):_func(func),_three_funcs(threeFuncs),_evolution_func(evolutionFunc),_context(context)
   {
   }
   
   void visit(AdaoModel::MainModel *godFather, AdaoModel::PyObjKeyVal *obj) override
   {
-    if(obj->getKey()=="Matrix" || obj->getKey()=="DiagonalSparseMatrix")
+    if(obj->getKey()=="OneFunction" && godFather->findPathOf(obj)==std::string(AdaoModel::EvolutionModel::KEY) + "/OneFunction")
       {
+        if(_evolution_func.isNull())
+          return ;
         std::ostringstream oss; oss << "__" << _cnt++;
         std::string varname(oss.str());
-        obj->setVal(Py_None);
-        PyDict_SetItemString(_context,varname.c_str(),Py_None);
+        obj->setVal(_evolution_func);
+        PyDict_SetItemString(_context,varname.c_str(),_evolution_func);
         obj->setVarName(varname);
         return ;
       }
-    if(obj->getKey()=="OneFunction")
+    if(obj->getKey()=="Matrix" || obj->getKey()=="DiagonalSparseMatrix")
+      {
+        std::ostringstream oss; oss << "__" << _cnt++;
+        std::string varname(oss.str());
+        obj->setVal(Py_None);
+        PyDict_SetItemString(_context,varname.c_str(),Py_None);
+        obj->setVarName(varname);
+        return ;
+      }
+    if(obj->getKey()=="OneFunction" && _three_funcs.isNull())
       {
         std::ostringstream oss; oss << "__" << _cnt++;
         std::string varname(oss.str());
@@ -310,50 +1081,1007 @@ public:
         obj->setVarName(varname);
         return ;
       }
+    if(obj->getKey()=="ThreeFunctions" && !_three_funcs.isNull())
+      {
+        std::ostringstream oss; oss << "__" << _cnt++;
+        std::string varname(oss.str());
+        obj->setVal(_three_funcs);
+        PyDict_SetItemString(_context,varname.c_str(),_three_funcs);
+        obj->setVarName(varname);
+        return ;
+      }
   }
 private:
   unsigned int _cnt = 0;
   PyObjectRAII _func;
+  PyObjectRAII _three_funcs;
+  PyObjectRAII _evolution_func;
   PyObject *_context = nullptr;
 };
 
-void AdaoExchangeLayer::setFunctionCallbackInModel(AdaoModel::MainModel *model)
+const char BROYDEN_FUNC[]="def BroydenAdao(evaluator, increment, centered, tolerance):\n"
+    "    import numpy as np\n"
+    "    increment = float(increment) if abs(float(increment)) > 1.e-15 else 0.01\n"
+    "    class BroydenJacobian:\n"
+    "        def __init__(self):\n"
+    "            self._x = None\n"
+    "            self._hx = None\n"
+    "            self._jac = None\n"
+    "            self._evaluated = {}\n"
+    "        def _remember(self, x, hx):\n"
+    "            self._evaluated[x.tobytes()] = hx\n"
+    "            if len(self._evaluated) > 16:\n"
+    "                del self._evaluated[next(iter(self._evaluated))]\n"
+    "        def direct(self, xserie):\n"
+    "            yserie = evaluator(xserie)\n"
+    "            for x,hx in zip(xserie,yserie):\n"
+    "                self._remember(np.asarray(x,dtype=np.float64).ravel(),np.asarray(hx,dtype=np.float64).ravel())\n"
+    "            return yserie\n"
+    "        def _finiteDifferences(self, x, hx):\n"
+    "            dx = increment * x\n"
+    "            if (dx == 0.).any():\n"
+    "                mean = dx.mean()\n"
+    "                dx = np.where(dx == 0., increment if mean == 0. else mean, dx)\n"
+    "            xserie = []\n"
+    "            for i in range(x.size):\n"
+    "                xp = x.copy() ; xp[i] += dx[i] ; xserie.append(xp)\n"
+    "                if centered:\n"
+    "                    xm = x.copy() ; xm[i] -= dx[i] ; xserie.append(xm)\n"
+    "            yserie = [np.asarray(elt,dtype=np.float64).ravel() for elt in evaluator(xserie)]\n"
+    "            jac = np.empty((hx.size,x.size))\n"
+    "            for i in range(x.size):\n"
+    "                if centered:\n"
+    "                    jac[:,i] = (yserie[2*i]-yserie[2*i+1])/(2.*dx[i])\n"
+    "                else:\n"
+    "                    jac[:,i] = (yserie[i]-hx)/dx[i]\n"
+    "            return jac\n"
+    "        def jacobianAt(self, x):\n"
+    "            x = np.asarray(x,dtype=np.float64).ravel()\n"
+    "            if self._jac is not None and np.array_equal(x,self._x):\n"
+    "                return self._jac\n"
+    "            hx = self._evaluated.get(x.tobytes())\n"
+    "            if hx is None:\n"
+    "                hx = np.asarray(self.direct([x])[0],dtype=np.float64).ravel()\n"
+    "            if self._jac is None:\n"
+    "                self._jac = self._finiteDifferences(x,hx)\n"
+    "            else:\n"
+    "                dx = x - self._x\n"
+    "                dy = hx - self._hx\n"
+    "                residual = dy - self._jac.dot(dx)\n"
+    "                if np.linalg.norm(residual) > tolerance*max(np.linalg.norm(dy),np.finfo(float).tiny):\n"
+    "                    self._jac = self._finiteDifferences(x,hx)\n"
+    "                else:\n"
+    "                    self._jac = self._jac + np.outer(residual,dx)/dx.dot(dx)\n"
+    "            self._x, self._hx = x, hx\n"
+    "            return self._jac\n"
+    "        def tangent(self, paires):\n"
+    "            return [self.jacobianAt(x).dot(np.asarray(dx,dtype=np.float64).ravel()) for x,dx in paires]\n"
+    "        def adjoint(self, paires):\n"
+    "            return [self.jacobianAt(x).T.dot(np.asarray(y,dtype=np.float64).ravel()) for x,y in paires]\n"
+    "    bj = BroydenJacobian()\n"
+    "    return {\"Direct\":bj.direct, \"Tangent\":bj.tangent, \"Adjoint\":bj.adjoint}\n";
+
+/*!
+ * Build the ThreeFunctions dict given to ADAO in EnumJacobianMode::Broyden mode. Direct is \a decorator, Tangent and Adjoint
+ * share a Jacobian kept between calls : computed by finite differences at first call, then updated by rank one Broyden corrections
+ * using the points already evaluated by Direct. Finite differences are done again only when the Jacobian predicts the last step with a
+ * relative error greater than MainModel::getBroydenTolerance.
+ * DifferentialIncrement and CenteredFiniteDifference are read from \a model now.
+ */
+static PyObjectRAII BuildBroydenFunctions(PyObject *context, PyObject *decorator, AdaoModel::MainModel *model)
 {
+  AdaoModel::DifferentialIncrement *increment(dynamic_cast<AdaoModel::DifferentialIncrement *>(model->findByPath("ObservationOperator/Parameters/DifferentialIncrement")));
+  AdaoModel::CenteredFiniteDifference *centered(dynamic_cast<AdaoModel::CenteredFiniteDifference *>(model->findByPath("ObservationOperator/Parameters/CenteredFiniteDifference")));
+  if(!increment || !centered)
+    throw AdaoExchangeLayerException("BuildBroydenFunctions : parameters of observation operator not found !");
+  PyObjectRAII func(LocateFunctionInContext(context,BROYDEN_FUNC,"BroydenAdao"));
+  PyObjectRAII args(PyObjectRAII::FromNew(PyTuple_New(4)));
+  { PyTuple_SetItem(args,0,decorator); Py_XINCREF(decorator); }
+  PyTuple_SetItem(args,1,PyFloat_FromDouble(increment->getVal()));
+  PyTuple_SetItem(args,2,PyBool_FromLong(centered->getVal()?1:0));
+  PyTuple_SetItem(args,3,PyFloat_FromDouble(model->getBroydenTolerance()));
+  PyObjectRAII ret(PyObjectRAII::FromNew(PyObject_CallObject(func,args)));
+  if(ret.isNull())
+    {
+      PyErr_Print();
+      throw AdaoExchangeLayerException("Fail to generate result of BroydenAdao function !");
+    }
+  return ret;
+}
+
+const char EXACT_JACOBIAN_FUNC[]="def ExactJacobianAdao(evaluator, transposeOfTangent):\n"
+    "    import numpy as np\n"
+    "    class ExactJacobian:\n"
+    "        def __init__(self):\n"
+    "            self._x = None\n"
+    "            self._ht = None\n"
+    "        def transposeOfJacobianAt(self, x):\n"
+    "            x = np.ascontiguousarray(x,dtype=np.float64).ravel()\n"
+    "            if self._ht is None or not np.array_equal(x,self._x):\n"
+    "                self._x, self._ht = x, np.frombuffer(transposeOfTangent(x),dtype=np.float64).reshape(x.size,-1)\n"
+    "            return self._ht\n"
+    "        def tangent(self, paires):\n"
+    "            return [self.transposeOfJacobianAt(x).T.dot(np.asarray(dx,dtype=np.float64).ravel()) for x,dx in paires]\n"
+    "        def adjoint(self, paires):\n"
+    "            return [self.transposeOfJacobianAt(x).dot(np.asarray(y,dtype=np.float64).ravel()) for x,y in paires]\n"
+    "    ej = ExactJacobian()\n"
+    "    return {\"Direct\":evaluator, \"Tangent\":ej.tangent, \"Adjoint\":ej.adjoint}\n";
+
+static const char EXACT_JACOBIAN_CAPSULE_NAME[]="AdaoExactJacobian";
+
+/*!
+ * Called by ADAO with a state x : returns the raw bytes of the transpose of the tangent at x given by the AdaoDifferentiableEvaluator of push mode.
+ * Serialized with the other calls of the operator, GIL being released during computation.
+ */
+static PyObject *exactjacobian_call(PyObject *capsule, PyObject *x)
+{
+  DataExchangedBetweenThreads *data(reinterpret_cast<DataExchangedBetweenThreads *>(PyCapsule_GetPointer(capsule,EXACT_JACOBIAN_CAPSULE_NAME)));
+  if(!data)
+    return nullptr;
+  std::unique_lock<std::mutex> lock(data->_call_mutex,std::try_to_lock);
+  if(!lock.owns_lock())
+    {
+      AutoSaveThread ast;
+      lock.lock();
+    }
+  AdaoDifferentiableEvaluator *evaluator(data->_differentiable_evaluator);
+  if(!evaluator)
+    {
+      PyErr_SetString(PyExc_RuntimeError,"exact jacobian : evaluator is not an AdaoDifferentiableEvaluator !");
+      return nullptr;
+    }
+  std::vector<double> input,ht;
+  std::string error;
+  try
+    {
+      PyToDoubles(x,input);
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      error = e.what();
+    }
+  catch(std::exception& e)
+    {
+      error = e.what();
+    }
+  std::size_t n(input.size()),m(data->_output_size);
+  if(error.empty())
+    {
+      AutoSaveThread ast;
+      try
+        {
+          std::vector<double> hx(m);
+          ht.resize(n*m);
+          evaluator->transposeOfTangent(n,input.data(),m,hx.data(),ht.data());
+        }
+      catch(AdaoExchangeLayerException& e)
+        {
+          error = e.what();
+        }
+      catch(std::exception& e)
+        {
+          error = e.what();
+        }
+      catch(...)
+        {
+          error = "exact jacobian : unknown exception in transposeOfTangent";
+        }
+    }
+  if(!error.empty())
+    {
+      PyErr_SetString(PyExc_RuntimeError,error.c_str());
+      return nullptr;
+    }
+  return PyBytes_FromStringAndSize(reinterpret_cast<const char *>(ht.data()),n*m*sizeof(double));// nullptr with python error set on failure
+}
+
+static PyMethodDef EXACT_JACOBIAN_DEF = { "AdaoTransposeOfTangent", (PyCFunction)exactjacobian_call, METH_O, "Transpose of tangent of observation operator" };
+
+/*!
+ * Build the ThreeFunctions dict given to ADAO in EnumJacobianMode::Exact mode. Direct is \a decorator, Tangent and Adjoint apply the exact
+ * tangent computed by the AdaoDifferentiableEvaluator of \a data once per point. GIL is expected to be held by caller.
+ */
+static PyObjectRAII BuildExactJacobianFunctions(PyObject *context, PyObject *decorator, DataExchangedBetweenThreads *data)
+{
+  PyObjectRAII capsule(PyObjectRAII::FromNew(PyCapsule_New(data,EXACT_JACOBIAN_CAPSULE_NAME,nullptr)));
+  PyObjectRAII transposeOfTangent(PyObjectRAII::FromNew(PyCFunction_New(&EXACT_JACOBIAN_DEF,capsule)));
+  PyObjectRAII func(LocateFunctionInContext(context,EXACT_JACOBIAN_FUNC,"ExactJacobianAdao"));
+  PyObjectRAII ret(PyObjectRAII::FromNew(PyObject_CallFunctionObjArgs(func,decorator,transposeOfTangent.operator PyObject *(),nullptr)));
+  if(ret.isNull())
+    {
+      PyErr_Print();
+      throw AdaoExchangeLayerException("Fail to generate result of ExactJacobianAdao function !");
+    }
+  return ret;
+}
+
+const char DECORATOR_FUNC[]="def DecoratorAdao(cppFunc):\n"
+    "    def evaluator( xserie ):\n"
+    "        import numpy as np\n"
+    "        yserie = [np.array(elt) for elt in cppFunc(xserie)]\n"
+    "        return yserie\n"
+    "    return evaluator\n";
+// float32 version : narrowing of the whole batch into one array and widening of the returned batch, both vectorized by numpy
+const char DECORATOR_FUNC_SINGLE_PRECISION[]="def DecoratorAdao(cppFunc):\n"
+    "    def evaluator( xserie ):\n"
+    "        import numpy as np\n"
+    "        if len(xserie)==0:\n"
+    "            return []\n"
+    "        xserie32 = np.asarray(xserie,dtype=np.float32).reshape(len(xserie),-1)\n"
+    "        yserie = np.asarray(cppFunc(xserie32),dtype=np.float64)\n"
+    "        return [elt for elt in yserie]\n"
+    "    return evaluator\n";
+
+const char TRANSPORT_FUNCS[]="def AdaoToTransport(obj, singlePrecision):\n"
+    "    import numpy as np\n"
+    "    return np.asarray(obj,dtype=np.float32 if singlePrecision else np.float64)\n"
+    "def AdaoSerieToTransport(serie, singlePrecision):\n"
+    "    import numpy as np\n"
+    "    dtype = np.float32 if singlePrecision else np.float64\n"
+    "    elts = serie[:]\n"
+    "    if len(elts)==0:\n"
+    "        return np.empty((0,0),dtype=dtype)\n"
+    "    return np.asarray(elts,dtype=dtype).reshape(len(elts),-1)\n";
+
+/*!
+ * Function \a funcName of TRANSPORT_FUNCS. Script is run once per layer, in a namespace of its own kept by releaseCase. GIL is expected to be held by caller.
+ */
+PyObjectRAII AdaoExchangeLayer::Internal::transportFunction(const char *funcName)
+{
+  if(_transport_funcs.isNull())
+    {
+      PyObjectRAII funcs(PyObjectRAII::FromNew(PyDict_New()));
+      PyDict_SetItemString(funcs,"__builtins__",PyEval_GetBuiltins());
+      LocateFunctionInContext(funcs,TRANSPORT_FUNCS,funcName);
+      _transport_funcs = funcs;
+    }
+  PyObjectRAII func(PyObjectRAII::FromDictItem(_transport_funcs,funcName));
+  if(func.isNull())
+    throw AdaoExchangeLayerException(std::string("Fail to locate ") + funcName + " function !");
+  return func;
+}
+
+/*!
+ * Python function given to ADAO, calling \a callBack (tagged with \a kind) with a list of samples. GIL is expected to be held by caller.
+ */
+PyObjectRAII AdaoExchangeLayer::Internal::buildDecorator(AdaoCallbackKeeper& callBack, AdaoOperatorKind kind)
+{
+  ReadyAdaoCallbackType();
+  callBack.assign(PyObject_GC_New(AdaoCallbackSt,&AdaoCallbackType),&_data_btw_threads,kind);
+  PyObject *callbackPyObj(callBack.getPyObject());
+  const char *decoratorScript(_single_precision?DECORATOR_FUNC_SINGLE_PRECISION:DECORATOR_FUNC);
+  PyObjectRAII decoratorGenerator(LocateFunctionInContext(_context,decoratorScript,"DecoratorAdao"));
+  PyObjectRAII args(PyObjectRAII::FromNew(PyTuple_New(1)));
+  { PyTuple_SetItem(args,0,callbackPyObj); Py_XINCREF(callbackPyObj); }
+  PyObjectRAII ret(PyObjectRAII::FromNew(PyObject_CallObject(decoratorGenerator,args)));
+  if(ret.isNull())
+    throw AdaoExchangeLayerException("Fail to generate result of DecoratorAdao function !");
+  return ret;
+}
+
+/*!
+ * Set callbacks in python leaves of \a model. \a evaluator is the one of push mode (nullptr in pull mode), needed by EnumJacobianMode::Exact.
+ */
+void AdaoExchangeLayer::Internal::setFunctionCallbackInModel(AdaoModel::MainModel *model, AdaoEvaluator *evaluator)
+{
+  if(model->getJacobianMode()==AdaoModel::EnumJacobianMode::Exact && !dynamic_cast<AdaoDifferentiableEvaluator *>(evaluator))
+    throw AdaoExchangeLayerException("setFunctionCallbackInModel : exact jacobian requires an AdaoDifferentiableEvaluator given to setEvaluatorInModel !");
   AutoGIL agil;
-  const char DECORATOR_FUNC[]="def DecoratorAdao(cppFunc):\n"
-      "    def evaluator( xserie ):\n"
-      "        import numpy as np\n"
-      "        yserie = [np.array(elt) for elt in cppFunc(xserie)]\n"
-      "        return yserie\n"
-      "    return evaluator\n";
-  this->_internal->_py_call_back.assign(PyObject_GC_New(AdaoCallbackSt,&AdaoCallbackType),
-      &this->_internal->_data_btw_threads);
-  PyObject *callbackPyObj(this->_internal->_py_call_back.getPyObject());
+  _decorator_func = buildDecorator(_py_call_back,AdaoOperatorKind::ObservationOperator);
+  _evolution_decorator_func = PyObjectRAII();
+  if(model->isEvolutionModelNeeded())
+    _evolution_decorator_func = buildDecorator(_py_evolution_call_back,AdaoOperatorKind::EvolutionModel);
   //
+  PyObjectRAII threeFuncs;
+  if(model->getJacobianMode()==AdaoModel::EnumJacobianMode::Broyden)
+    threeFuncs = BuildBroydenFunctions(_context,_decorator_func,model);
+  if(model->getJacobianMode()==AdaoModel::EnumJacobianMode::Exact)
+    threeFuncs = BuildExactJacobianFunctions(_context,_decorator_func,&_data_btw_threads);
+  Visitor1 visitor(_decorator_func,threeFuncs,_evolution_decorator_func,_context);
+  model->visitPythonLeaves(&visitor);
+}
+
+/*!
+ * Pull mode : samples requested by ADAO are given by next (or tryNext) and answered by setResult (or evaluateAndSetResult),
+ * ADAO running in its own thread launched by execute.
+ * With 4DVAR, EvolutionModel/OneFunction is set too : samples of the evolution model are given by next like the ones of the
+ * observation operator, getRequestedOperator telling which one is requested.
+ * See setEvaluatorInModel for push mode.
+ */
+void AdaoExchangeLayer::setFunctionCallbackInModel(AdaoModel::MainModel *model)
+{
+  _internal->setFunctionCallbackInModel(model,nullptr);
+  _internal->_evaluator = nullptr;
+  _internal->_evolution_evaluator = nullptr;
+}
+
+/*!
+ * Push mode : \a evaluator (not owned) computes the observation operator and is called directly, next returning false at once.
+ * It is mandatory if \a model uses AdaoModel::EnumEngine::Native.
+ * With AdaoModel::EnumEngine::Python, ADAO calls \a evaluator from the calling thread : execute runs the whole case,
+ * without hand off between threads.
+ * With AdaoModel::EnumJacobianMode::Exact, \a evaluator has to be an AdaoDifferentiableEvaluator (see AdaoForwardDiffEvaluator) : its tangent
+ * replaces finite differences.
+ */
+void AdaoExchangeLayer::setEvaluatorInModel(AdaoModel::MainModel *model, AdaoEvaluator *evaluator)
+{
+  if(!evaluator)
+    throw AdaoExchangeLayerException("setEvaluatorInModel : null evaluator ! Use setFunctionCallbackInModel(model) for pull mode.");
+  _internal->setFunctionCallbackInModel(model,evaluator);
+  _internal->_evaluator = evaluator;
+  _internal->_evolution_evaluator = nullptr;
+}
+
+/*!
+ * Push mode with 4DVAR : \a evolutionEvaluator (not owned) computes one time step of the evolution model, from states to states.
+ * Python engine only.
+ */
+void AdaoExchangeLayer::setEvaluatorInModel(AdaoModel::MainModel *model, AdaoEvaluator *evaluator, AdaoEvaluator *evolutionEvaluator)
+{
+  this->setEvaluatorInModel(model,evaluator);
+  _internal->_evolution_evaluator = evolutionEvaluator;
+}
+
+enum class CovarianceAction
+{
+    Multiply,
+    Solve,
+    SquareRoot
+};
+
+/*!
+ * Apply AdaoCovarianceOperator held by \a capsule to \a v. Result is the raw bytes of a float64 vector. GIL is released during computation.
+ */
+template<CovarianceAction ACTION>
+static PyObject *ApplyCovarianceOperator(PyObject *capsule, PyObject *v)
+{
+  AdaoCovarianceOperator *op(reinterpret_cast<AdaoCovarianceOperator *>(PyCapsule_GetPointer(capsule,AdaoCovarianceOperator::CAPSULE_NAME)));
+  if(!op)
+    return nullptr;
+  std::size_t n(op->getSize());
+  std::vector<double> input,output(n);
+  std::string error;
+  try
+    {
+      PyToDoubles(v,input);
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      error = e.what();
+    }
+  catch(std::exception& e)
+    {
+      error = e.what();
+    }
+  if(error.empty() && input.size()!=n)
+    {
+      std::ostringstream oss; oss << "covariance operator of size " << n << " applied to a vector of size " << input.size() << " !";
+      PyErr_SetString(PyExc_ValueError,oss.str().c_str());
+      return nullptr;
+    }
+  if(error.empty())
+    {
+      AutoSaveThread ast;
+      try
+        {
+          if(ACTION==CovarianceAction::Multiply)
+            op->multiply(input.data(),output.data());
+          else if(ACTION==CovarianceAction::Solve)
+            op->solve(input.data(),output.data());
+          else
+            op->multiplySquareRoot(input.data(),output.data());
+        }
+      catch(AdaoExchangeLayerException& e)
+        {
+          error = e.what();
+        }
+      catch(std::exception& e)
+        {
+          error = e.what();
+        }
+      catch(...)
+        {
+          error = "unknown exception in covariance operator";
+        }
+    }
+  if(!error.empty())
+    {
+      PyErr_SetString(PyExc_RuntimeError,error.c_str());
+      return nullptr;
+    }
+  return PyBytes_FromStringAndSize(reinterpret_cast<const char *>(output.data()),n*sizeof(double));// nullptr with python error set on failure
+}
+
+static PyObject *CovarianceOperatorDiagonal(PyObject *capsule, PyObject *)
+{
+  AdaoCovarianceOperator *op(reinterpret_cast<AdaoCovarianceOperator *>(PyCapsule_GetPointer(capsule,AdaoCovarianceOperator::CAPSULE_NAME)));
+  if(!op)
+    return nullptr;
+  std::vector<double> diag;
+  std::string error;
   {
-      PyObjectRAII res(PyObjectRAII::FromNew(PyRun_String(DECORATOR_FUNC,Py_file_input,this->_internal->_context,this->_internal->_context)));
-      PyObjectRAII decoratorGenerator( PyObjectRAII::FromBorrowed(PyDict_GetItemString(this->_internal->_context,"DecoratorAdao")) );
-      if(decoratorGenerator.isNull())
-        throw AdaoExchangeLayerException("Fail to locate DecoratorAdao function !");
-      PyObjectRAII args(PyObjectRAII::FromNew(PyTuple_New(1)));
-      { PyTuple_SetItem(args,0,callbackPyObj); Py_XINCREF(callbackPyObj); }
-      this->_internal->_decorator_func = PyObjectRAII::FromNew(PyObject_CallObject(decoratorGenerator,args));
-      if(this->_internal->_decorator_func.isNull())
-        throw AdaoExchangeLayerException("Fail to generate result of DecoratorAdao function !");
+    AutoSaveThread ast;
+    try
+      {
+        diag = op->diagonal();
+      }
+    catch(AdaoExchangeLayerException& e)
+      {
+        error = e.what();
+      }
+    catch(std::exception& e)
+      {
+        error = e.what();
+      }
+    catch(...)
+      {
+        error = "unknown exception in diagonal of covariance operator";
+      }
+  }
+  if(!error.empty())
+    {
+      PyErr_SetString(PyExc_RuntimeError,error.c_str());
+      return nullptr;
+    }
+  return PyBytes_FromStringAndSize(reinterpret_cast<const char *>(diag.data()),diag.size()*sizeof(double));
+}
+
+static PyMethodDef COVARIANCE_OPERATOR_METHODS[] = {
+  {"multiply",(PyCFunction)ApplyCovarianceOperator<CovarianceAction::Multiply>,METH_O,"B.v"},
+  {"solve",(PyCFunction)ApplyCovarianceOperator<CovarianceAction::Solve>,METH_O,"B^-1.v"},
+  {"sqrt",(PyCFunction)ApplyCovarianceOperator<CovarianceAction::SquareRoot>,METH_O,"L.v with B=L.L^T"},
+  {"diagonal",(PyCFunction)CovarianceOperatorDiagonal,METH_NOARGS,"diagonal of B"}
+};
+
+// covariance object given to ADAO as ObjectMatrix. Represents factor times B, B^-1 or L (action), applied column by column to matrices.
+// Operations needing the dense matrix (asfullmatrix, + and -) build it with a RuntimeWarning : they are never silent.
+const char COVARIANCE_OPERATOR_FUNCS[]="class AdaoCovarianceObject(object):\n"
+    "    __array_ufunc__ = None # numpy operands defer to __rmatmul__ and __rmul__\n"
+    "    def __init__(self, capsule, size, funcs, action='multiply', factor=1.):\n"
+    "        self._capsule, self._size, self._funcs, self._action, self._factor = capsule, size, funcs, action, factor\n"
+    "        self.shape = (size,size)\n"
+    "        self.size = size*size\n"
+    "    def _derived(self, action, factor):\n"
+    "        return AdaoCovarianceObject(self._capsule,self._size,self._funcs,action,factor)\n"
+    "    def _apply1(self, v):\n"
+    "        import numpy as np\n"
+    "        return self._factor*np.frombuffer(self._funcs[self._action](np.ascontiguousarray(v,dtype=np.float64).ravel()),dtype=np.float64)\n"
+    "    def _apply(self, other):\n"
+    "        import numpy as np\n"
+    "        if np.isscalar(other):\n"
+    "            return self._derived(self._action,self._factor*other)\n"
+    "        m = np.asarray(other,dtype=np.float64)\n"
+    "        if m.size==self._size:\n"
+    "            return self._apply1(m).reshape(m.shape)\n"
+    "        if m.ndim==2 and m.shape[0]==self._size:\n"
+    "            return np.column_stack([self._apply1(m[:,j]) for j in range(m.shape[1])])\n"
+    "        raise ValueError('operand of shape %s does not fit covariance of size %i'%(str(m.shape),self._size))\n"
+    "    def __matmul__(self, other):\n"
+    "        return self._apply(other)\n"
+    "    __mul__ = __matmul__\n"
+    "    def __rmatmul__(self, other):\n"
+    "        import numpy as np\n"
+    "        if np.isscalar(other):\n"
+    "            return self._derived(self._action,self._factor*other)\n"
+    "        if self._action=='sqrt':\n"
+    "            raise NotImplementedError('transpose of square root of covariance operator is not available')\n"
+    "        m = np.asarray(other,dtype=np.float64)\n"
+    "        return self._apply(m.T).T\n"
+    "    __rmul__ = __rmatmul__\n"
+    "    def __neg__(self):\n"
+    "        return self._derived(self._action,-self._factor)\n"
+    "    def getI(self):\n"
+    "        inverse = {'multiply':'solve','solve':'multiply'}\n"
+    "        if self._action not in inverse:\n"
+    "            raise NotImplementedError('inverse of square root of covariance operator is not available')\n"
+    "        return self._derived(inverse[self._action],1./self._factor)\n"
+    "    def getT(self):\n"
+    "        if self._action=='sqrt':\n"
+    "            raise NotImplementedError('transpose of square root of covariance operator is not available')\n"
+    "        return self\n"
+    "    def cholesky(self):\n"
+    "        import math\n"
+    "        if self._action!='multiply' or 'sqrt' not in self._funcs or self._factor<=0.:\n"
+    "            raise NotImplementedError('square root of covariance operator is not available')\n"
+    "        return self._derived('sqrt',math.sqrt(self._factor))\n"
+    "    def diag(self, msize=None):\n"
+    "        import numpy as np\n"
+    "        if self._action=='multiply':\n"
+    "            return self._factor*np.frombuffer(self._funcs['diagonal'](),dtype=np.float64)\n"
+    "        e, ret = np.zeros(self._size), np.empty(self._size)\n"
+    "        for i in range(self._size):\n"
+    "            e[i] = 1.\n"
+    "            ret[i] = self._apply1(e)[i]\n"
+    "            e[i] = 0.\n"
+    "        return ret\n"
+    "    def trace(self, msize=None):\n"
+    "        import numpy as np\n"
+    "        return float(np.sum(self.diag()))\n"
+    "    def _dense(self, what):\n"
+    "        import numpy as np, warnings\n"
+    "        warnings.warn('%s densifies the covariance operator of size %i : %i applications and a %ix%i matrix'%(what,self._size,self._size,self._size,self._size),RuntimeWarning,stacklevel=3)\n"
+    "        return self._apply(np.eye(self._size))\n"
+    "    def asfullmatrix(self, msize=None):\n"
+    "        return self._dense('asfullmatrix')\n"
+    "    def __add__(self, other):\n"
+    "        return self._dense('addition')+other\n"
+    "    def __radd__(self, other):\n"
+    "        return other+self._dense('addition')\n"
+    "    def __sub__(self, other):\n"
+    "        return self._dense('subtraction')-other\n"
+    "    def __rsub__(self, other):\n"
+    "        return other-self._dense('subtraction')\n";
+
+/*!
+ * Use \a op (not owned) as covariance \a errorKey (AdaoModel::BackgroundError::KEY or AdaoModel::ObservationError::KEY) of \a model.
+ * ADAO receives it as an ObjectMatrix calling \a op : Matrix, ScalarSparseMatrix and DiagonalSparseMatrix are ignored.
+ * Python and native engines. Has to be called after init and before loadTemplate.
+ */
+void AdaoExchangeLayer::setCovarianceOperatorInModel(AdaoModel::MainModel *model, const std::string& errorKey, AdaoCovarianceOperator *op)
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("setCovarianceOperatorInModel : not initialized !");
+  AdaoModel::ObjectMatrixError *leaf(dynamic_cast<AdaoModel::ObjectMatrixError *>(model->findByPath(errorKey + "/" + AdaoModel::ObjectMatrixError::KEY)));
+  if(!leaf || !op)
+    throw AdaoExchangeLayerException(std::string("setCovarianceOperatorInModel : \"") + errorKey + "\" is not a covariance of model or operator is null !");
+  AutoGIL agil;
+  PyObjectRAII capsule(PyObjectRAII::FromNew(PyCapsule_New(op,AdaoCovarianceOperator::CAPSULE_NAME,nullptr)));
+  PyObjectRAII funcs(PyObjectRAII::FromNew(PyDict_New()));
+  for(PyMethodDef& def : COVARIANCE_OPERATOR_METHODS)
+    {
+      if(std::string(def.ml_name)=="sqrt" && !op->hasSquareRoot())
+        continue;
+      PyObjectRAII func(PyObjectRAII::FromNew(PyCFunction_New(&def,capsule)));
+      PyDict_SetItemString(funcs,def.ml_name,func);
+    }
+  PyObjectRAII cls(LocateFunctionInContext(_internal->_context,COVARIANCE_OPERATOR_FUNCS,"AdaoCovarianceObject"));
+  PyObjectRAII obj(PyObjectRAII::FromNew(PyObject_CallFunction(cls,"OnO",capsule.operator PyObject *(),(Py_ssize_t)op->getSize(),funcs.operator PyObject *())));
+  if(obj.isNull())
+    {
+      PyErr_Print();
+      throw AdaoExchangeLayerException("setCovarianceOperatorInModel : fail to build covariance object !");
+    }
+  std::string varName(std::string("__cov_") + errorKey);
+  leaf->setVal(obj);
+  PyDict_SetItemString(_internal->_context,varName.c_str(),obj);
+  leaf->setVarName(varName);
+}
+
+// observer trimming the values kept by the ADAO Persistence object after each store. Spilled values are raw float64 rows.
+// Persistence has no public way to drop values : its private lists are used, and their absence (other ADAO version) is an error.
+const char STORAGE_POLICY_FUNCS[]="def AdaoPersistenceLists(var, name):\n"
+    "    values = getattr(var,'_Persistence__values',None)\n"
+    "    tags = getattr(var,'_Persistence__tags',None)\n"
+    "    if not isinstance(values,list) or not isinstance(tags,list):\n"
+    "        raise RuntimeError('storage policy of %s : stored values of ADAO Persistence (_Persistence__values and _Persistence__tags lists) not found, this ADAO version is not supported'%name)\n"
+    "    return values, tags\n"
+    "def AdaoInstallStoragePolicy(case, name, keepLast, keepEvery, spillFile):\n"
+    "    import numpy as np\n"
+    "    AdaoPersistenceLists(case.get(name),name)\n"
+    "    state = {'count':0}\n"
+    "    if spillFile:\n"
+    "        open(spillFile,'wb').close()\n"
+    "    def policy(var, info):\n"
+    "        values, tags = AdaoPersistenceLists(var,name)\n"
+    "        if len(values)==0:\n"
+    "            return\n"
+    "        idx = state['count']\n"
+    "        state['count'] += 1\n"
+    "        if spillFile:\n"
+    "            with open(spillFile,'ab') as f:\n"
+    "                np.asarray(values[-1],dtype=np.float64).ravel().tofile(f)\n"
+    "        if keepEvery>1 and idx%keepEvery!=0:\n"
+    "            del values[-1]\n"
+    "            if len(tags)>len(values):\n"
+    "                del tags[-1]\n"
+    "        if keepLast>0 and len(values)>keepLast:\n"
+    "            nb = len(values)-keepLast\n"
+    "            del values[:nb]\n"
+    "            if len(tags)>=nb:\n"
+    "                del tags[:nb]\n"
+    "    case.setObserver(Variable=name, ObjectFunction=policy, Info=name)\n"
+    "def AdaoSpilledSerie(case, name, spillFile):\n"
+    "    import numpy as np\n"
+    "    serie = case.get(name)\n"
+    "    if len(serie)==0:\n"
+    "        return np.empty((0,0))\n"
+    "    return np.memmap(spillFile,dtype=np.float64,mode='r').reshape(-1,np.asarray(serie[-1]).size)\n";
+
+const char SERIE_EXPORT_FUNCS[]="def AdaoInstallSerieExport(case, name, append):\n"
+    "    import numpy as np\n"
+    "    def export(var, info):\n"
+    "        if len(var)>0:\n"
+    "            append(np.asarray(var[-1],dtype=np.float64).ravel())\n"
+    "    case.setObserver(Variable=name, ObjectFunction=export, Info=name)\n"
+    "def AdaoExportSerie(serie, append):\n"
+    "    import numpy as np\n"
+    "    for i in range(len(serie)):\n"
+    "        append(np.asarray(serie[i],dtype=np.float64).ravel())\n";
+
+struct SerieExportSlot
+{
+  AdaoSerieExporter *_exporter;
+  std::size_t _serie_id;
+};
+
+static const char SERIE_EXPORT_SLOT_NAME[]="AdaoSerieExportSlot";
+
+static void serieexportslot_destructor(PyObject *capsule)
+{
+  delete reinterpret_cast<SerieExportSlot *>(PyCapsule_GetPointer(capsule,SERIE_EXPORT_SLOT_NAME));
+}
+
+/*!
+ * Called by python with a row of the serie. GIL is released while the row is queued : a late writer thread does not block other threads.
+ */
+static PyObject *serieexport_append(PyObject *self, PyObject *row)
+{
+  SerieExportSlot *slot(reinterpret_cast<SerieExportSlot *>(PyCapsule_GetPointer(self,SERIE_EXPORT_SLOT_NAME)));
+  if(!slot)
+    return nullptr;
+  std::string error;
+  try
+    {
+      std::vector<double> values;
+      PyToDoubles(row,values);
+      AutoSaveThread ast;
+      slot->_exporter->append(slot->_serie_id,std::move(values));
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      error = e.what();
+    }
+  catch(std::exception& e)
+    {
+      error = e.what();
+    }
+  if(!error.empty())
+    {
+      PyErr_SetString(PyExc_RuntimeError,error.c_str());
+      return nullptr;
+    }
+  Py_RETURN_NONE;
+}
+
+static PyMethodDef SERIE_EXPORT_APPEND_DEF = { "AdaoSerieExportAppend", (PyCFunction)serieexport_append, METH_O, "Append a row to an exported serie" };
+
+/*!
+ * Returns a python function appending its argument to serie \a serieId of \a exporter. GIL is expected to be held by caller.
+ */
+static PyObjectRAII NewSerieExportAppend(AdaoSerieExporter *exporter, std::size_t serieId)
+{
+  PyObjectRAII capsule(PyObjectRAII::FromNew(PyCapsule_New(new SerieExportSlot{exporter,serieId},SERIE_EXPORT_SLOT_NAME,serieexportslot_destructor)));
+  PyObjectRAII ret(PyObjectRAII::FromNew(PyCFunction_New(&SERIE_EXPORT_APPEND_DEF,capsule)));
+  if(ret.isNull())
+    throw AdaoExchangeLayerException("Fail to create function appending to an exported serie !");
+  return ret;
+}
+
+/*!
+ * Python literal of \a s (repr of the str), to put user given names and paths in scripts run by the helper process.
+ * GIL is expected to be held by caller.
+ */
+static std::string PyStringLiteral(const std::string& s)
+{
+  PyObjectRAII str(PyObjectRAII::FromNew(PyUnicode_DecodeUTF8(s.c_str(),s.size(),"strict")));
+  if(str.isNull())
+    {
+      PyErr_Clear();
+      throw AdaoExchangeLayerException(std::string("\"") + s + "\" is not a valid UTF-8 string !");
+    }
+  PyObjectRAII repr(PyObjectRAII::FromNew(PyObject_Repr(str)));
+  const char *ret(repr.isNull()?nullptr:PyUnicode_AsUTF8(repr));
+  if(!ret)
+    {
+      PyErr_Clear();
+      throw AdaoExchangeLayerException(std::string("Fail to build python literal of \"") + s + "\" !");
+    }
+  return ret;
+}
+
+/*!
+ * Split python leaves of the model between values (pickled to be sent to helper process) and callbacks
+ * (rebuilt in helper process around AdaoRemoteCallback).
+ */
+class RemoteCaseCollector : public AdaoModel::PythonLeafVisitor
+{
+public:
+  RemoteCaseCollector(PyObject *decoratorFunc, const std::string& broydenArgs):_decorator_func(decoratorFunc),_broyden_args(broydenArgs),_vars(PyObjectRAII::FromNew(PyDict_New())) { }
+  void visit(AdaoModel::MainModel *godFather, AdaoModel::PyObjKeyVal *obj) override
+  {
+    const std::string& varName(obj->getVarName());
+    if(varName.empty() || !obj->getVal())
+      return ;
+    if(godFather->findPathOf(obj)==std::string(AdaoModel::EvolutionModel::KEY) + "/OneFunction")
+      throw AdaoExchangeLayerException("loadTemplate : evolution model is not supported by out of process engine !");
+    if(obj->getKey()=="OneFunction" && obj->getVal()==_decorator_func)
+      {
+        _bindings << varName << " = DecoratorAdao(AdaoRemoteCallback)\n";
+        return ;
+      }
+    if(obj->getKey()==AdaoModel::ObjectMatrixError::KEY)
+      throw AdaoExchangeLayerException("loadTemplate : covariance operators are not supported by out of process engine !");
+    if(obj->getKey()=="ThreeFunctions")
+      {
+        _bindings << varName << " = BroydenAdao(DecoratorAdao(AdaoRemoteCallback)," << _broyden_args << ")\n";
+        return ;
+      }
+    PyDict_SetItemString(_vars,varName.c_str(),obj->getVal());
+  }
+  PyObject *getVariables() const { return _vars; }
+  std::string getBindings() const { return _bindings.str(); }
+private:
+  PyObject *_decorator_func;
+  std::string _broyden_args;
+  PyObjectRAII _vars;
+  std::ostringstream _bindings;
+};
+
+/*!
+ * Launch the helper process and load in it the case described by \a model. GIL is expected to be held by caller.
+ */
+void AdaoExchangeLayer::Internal::loadOutOfProcess(AdaoModel::MainModel *model)
+{
+  if(_store)
+    throw AdaoExchangeLayerException("loadTemplate : evaluation store is not supported by out of process engine !");
+  if(_surrogate)
+    throw AdaoExchangeLayerException("loadTemplate : surrogate is not supported by out of process engine !");
+  if(model->getJacobianMode()==AdaoModel::EnumJacobianMode::Exact)
+    throw AdaoExchangeLayerException("loadTemplate : exact jacobian is not supported by out of process engine !");
+  std::ostringstream broydenArgs;
+  if(model->getJacobianMode()==AdaoModel::EnumJacobianMode::Broyden)
+    {
+      AdaoModel::DifferentialIncrement *increment(dynamic_cast<AdaoModel::DifferentialIncrement *>(model->findByPath("ObservationOperator/Parameters/DifferentialIncrement")));
+      AdaoModel::CenteredFiniteDifference *centered(dynamic_cast<AdaoModel::CenteredFiniteDifference *>(model->findByPath("ObservationOperator/Parameters/CenteredFiniteDifference")));
+      if(!increment || !centered)
+        throw AdaoExchangeLayerException("loadTemplate : parameters of observation operator not found !");
+      broydenArgs.precision(17);
+      broydenArgs << increment->getVal() << "," << (centered->getVal()?"True":"False") << "," << model->getBroydenTolerance();
+    }
+  RemoteCaseCollector collector(_decorator_func,broydenArgs.str());
+  model->visitPythonLeaves(&collector);
+  std::string script(_single_precision?DECORATOR_FUNC_SINGLE_PRECISION:DECORATOR_FUNC);
+  script += BROYDEN_FUNC;
+  script += TRANSPORT_FUNCS;
+  script += collector.getBindings();
+  script += model->pyStr();
+  script += STORAGE_POLICY_FUNCS;
+  for(const auto& it : _storage_policies)
+    {
+      std::ostringstream oss;
+      oss << "AdaoInstallStoragePolicy(case," << PyStringLiteral(it.first) << "," << it.second.getKeepLast() << "," << it.second.getKeepEvery() << "," << PyStringLiteral(it.second.getSpillFile()) << ")\n";
+      script += oss.str();
+    }
+  std::string pickledVariables(PickleToString(collector.getVariables()));
+  _remote_engine.reset();
+  {
+    AutoSaveThread ast;// helper process is starting and importing ADAO : let other threads use python meanwhile
+    std::unique_ptr<AdaoRemoteEngine> remoteEngine(new AdaoRemoteEngine);
+    remoteEngine->load(pickledVariables,script);
+    _remote_engine = std::move(remoteEngine);
   }
-  //
-  Visitor1 visitor(this->_internal->_decorator_func,this->_internal->_context);
-  model->visitPythonLeaves(&visitor);
+}
+
+/*!
+ * GIL is expected to be held by caller.
+ */
+void AdaoExchangeLayer::Internal::installStoragePolicies()
+{
+  if(_storage_policies.empty())
+    return ;
+  PyObjectRAII func(LocateFunctionInContext(_context,STORAGE_POLICY_FUNCS,"AdaoInstallStoragePolicy"));
+  for(const auto& it : _storage_policies)
+    {
+      const AdaoStoragePolicy& policy(it.second);
+      PyObjectRAII res(PyObjectRAII::FromNew(PyObject_CallFunction(func,"OsIIs",_adao_case.operator PyObject *(),it.first.c_str(),policy.getKeepLast(),policy.getKeepEvery(),policy.getSpillFile().c_str())));
+      if(res.isNull())
+        {
+          PyErr_Print();
+          throw AdaoExchangeLayerException(std::string("loadTemplate : fail to install storage policy of ") + it.first + " !");
+        }
+    }
+}
+
+/*!
+ * Observers appending each new value of the exported variables. Installed before storage policies, which may drop values.
+ * GIL is expected to be held by caller.
+ */
+void AdaoExchangeLayer::Internal::installSerieExports()
+{
+  if(_serie_exports.empty())
+    return ;
+  _exporter.reset(new AdaoSerieExporter);
+  PyObjectRAII func(LocateFunctionInContext(_context,SERIE_EXPORT_FUNCS,"AdaoInstallSerieExport"));
+  for(const auto& it : _serie_exports)
+    {
+      PyObjectRAII append(NewSerieExportAppend(_exporter.get(),_exporter->addSerie(it.second)));
+      PyObjectRAII res(PyObjectRAII::FromNew(PyObject_CallFunction(func,"OsO",_adao_case.operator PyObject *(),it.first.c_str(),append.operator PyObject *())));
+      if(res.isNull())
+        {
+          PyErr_Print();
+          throw AdaoExchangeLayerException(std::string("loadTemplate : fail to install export of ") + it.first + " !");
+        }
+    }
+}
+
+/*!
+ * Forget evaluations of previous case and read DifferentialIncrement in \a model.
+ */
+void AdaoExchangeLayer::Internal::prepareSurrogate(AdaoModel::MainModel *model)
+{
+  _evaluator_with_surrogate.reset();
+  _data_btw_threads._surrogate = nullptr;
+  if(!_surrogate)
+    return ;
+  AdaoModel::DifferentialIncrement *increment(dynamic_cast<AdaoModel::DifferentialIncrement *>(model->findByPath("ObservationOperator/Parameters/DifferentialIncrement")));
+  if(!increment)
+    throw AdaoExchangeLayerException("loadTemplate : parameters of observation operator not found !");
+  _surrogate->reset();
+  _surrogate->setDifferentialIncrement(increment->getVal());
+  _data_btw_threads._surrogate = _surrogate.get();
+}
+
+/*!
+ * Size of the result of the observation operator (size of Observation/Vector, or of the first element of Observation/VectorSerie)
+ * and of the evolution model (size of Background/Vector). 0 when not available, the reason being kept in _output_size_diagnostic
+ * and _state_size_diagnostic when the variable is set but unreadable. GIL is expected to be held by caller.
+ */
+void AdaoExchangeLayer::Internal::readOperatorSizes(AdaoModel::MainModel *model)
+{
+  auto sizeOf([model](const std::string& path, bool firstElement, std::string& diagnostic) -> std::size_t {
+      AdaoModel::PyObjKeyVal *leaf(dynamic_cast<AdaoModel::PyObjKeyVal *>(model->findByPath(path)));
+      if(!leaf || !leaf->getVal() || leaf->getVal()==Py_None)
+        return 0;
+      PyObjectRAII obj(firstElement?PyObjectRAII::FromNew(PySequence_GetItem(leaf->getVal(),0)):PyObjectRAII::FromBorrowed(leaf->getVal()));
+      if(obj.isNull())
+        {
+          PyErr_Clear();
+          diagnostic = path + " has to be a non empty sequence of vectors !";
+          return 0;
+        }
+      std::vector<double> vals;
+      try
+        {
+          PyToDoubles(obj,vals);
+        }
+      catch(AdaoExchangeLayerException& e)
+        {// not a vector : ADAO will tell in pull mode
+          diagnostic = path + " has to be a vector (" + e.what() + ") !";
+          vals.clear();
+        }
+      PyErr_Clear();
+      return vals.size();
+    });
+  _output_size_diagnostic.clear();
+  _state_size_diagnostic.clear();
+  // all time steps are expected to have the same number of observations
+  _data_btw_threads._output_size = sizeOf(std::string("Observation/") + AdaoModel::VectorSerieObservation::KEY,true,_output_size_diagnostic);
+  if(_data_btw_threads._output_size==0 && _output_size_diagnostic.empty())
+    _data_btw_threads._output_size = sizeOf("Observation/Vector",false,_output_size_diagnostic);
+  _data_btw_threads._state_size = sizeOf("Background/Vector",false,_state_size_diagnostic);
+}
+
+/*!
+ * Push mode is used if an evaluator has been given to setEvaluatorInModel. GIL is expected to be held by caller.
+ */
+void AdaoExchangeLayer::Internal::preparePushMode(AdaoModel::MainModel *model)
+{
+  _evaluator_with_store.reset();
+  _evaluator_with_speculation.reset();
+  _data_btw_threads._evaluator = nullptr;
+  _data_btw_threads._differentiable_evaluator = nullptr;
+  _data_btw_threads._evolution_evaluator = nullptr;
+  if(_speculation && !_evaluator)
+    throw AdaoExchangeLayerException("loadTemplate : speculation requires an evaluator given to setEvaluatorInModel (push mode) !");
+  if(_speculation && model->getJacobianMode()==AdaoModel::EnumJacobianMode::Exact)
+    throw AdaoExchangeLayerException("loadTemplate : speculation evaluates finite difference points, never requested with exact jacobian !");
+  if(!_evaluator)
+    return ;
+  if(_data_btw_threads._output_size==0)
+    throw AdaoExchangeLayerException("loadTemplate : " + (_output_size_diagnostic.empty()?std::string("push mode requires Observation/Vector (or Observation/VectorSerie) to be set !"):_output_size_diagnostic));
+  if(model->isEvolutionModelNeeded())
+    {
+      if(!_evolution_evaluator)
+        throw AdaoExchangeLayerException("loadTemplate : push mode with 4DVAR requires an evaluator of the evolution model given to setEvaluatorInModel !");
+      if(_data_btw_threads._state_size==0)
+        throw AdaoExchangeLayerException("loadTemplate : " + (_state_size_diagnostic.empty()?std::string("push mode with 4DVAR requires Background/Vector to be set !"):_state_size_diagnostic));
+      _data_btw_threads._evolution_evaluator = _evolution_evaluator;
+    }
+  _data_btw_threads._evaluator = _evaluator;
+  _data_btw_threads._differentiable_evaluator = dynamic_cast<AdaoDifferentiableEvaluator *>(_evaluator);// tangent never goes through store nor surrogate
+  if(_speculation)
+    {
+      AdaoModel::DifferentialIncrement *increment(dynamic_cast<AdaoModel::DifferentialIncrement *>(model->findByPath("ObservationOperator/Parameters/DifferentialIncrement")));
+      AdaoModel::CenteredFiniteDifference *centered(dynamic_cast<AdaoModel::CenteredFiniteDifference *>(model->findByPath("ObservationOperator/Parameters/CenteredFiniteDifference")));
+      if(!increment || !centered)
+        throw AdaoExchangeLayerException("loadTemplate : parameters of observation operator not found !");
+      _speculation->reset();
+      _speculation->setFiniteDifference(increment->getVal(),centered->getVal());
+      _evaluator_with_speculation.reset(new AdaoEvaluatorWithSpeculation(_evaluator,_speculation.get()));
+      _data_btw_threads._evaluator = _evaluator_with_speculation.get();
+    }
+  if(_store)
+    {
+      _evaluator_with_store.reset(new AdaoEvaluatorWithStore(_data_btw_threads._evaluator,_store.get()));
+      _data_btw_threads._evaluator = _evaluator_with_store.get();
+    }
+  if(_surrogate)
+    {
+      _evaluator_with_surrogate.reset(new AdaoEvaluatorWithSurrogate(_data_btw_threads._evaluator,_surrogate.get()));
+      _data_btw_threads._evaluator = _evaluator_with_surrogate.get();
+    }
+}
+
+/*!
+ * Push mode : ADAO runs in the calling thread and calls the evaluator directly.
+ */
+void AdaoExchangeLayer::Internal::executeSynchronously()
+{
+  AutoGIL agil;
+  PyObjectRAII args(PyObjectRAII::FromNew(PyTuple_New(0)));
+  PyObjectRAII res(PyObjectRAII::FromNew(PyObject_CallObject(_execute_func,args)));// go to adaocallback_call
+  if(_speculation)
+    {// speculation after the last iterate is useless
+      AutoSaveThread ast;
+      _speculation->stop();
+    }
+  if(res.isNull())
+    {
+      PyErr_Print();
+      throw AdaoExchangeLayerException("execute : execution of ADAO case has failed !");
+    }
 }
 
 void AdaoExchangeLayer::loadTemplate(AdaoModel::MainModel *model)
 {
   AutoGIL agil;
+  _internal->_native_engine.reset();
+  _internal->_remote_engine.reset();
+  _internal->_posterior.reset();
+  _internal->_data_btw_threads._evaluator = nullptr;
+  _internal->_exporter.reset();
+  _internal->prepareSurrogate(model);
+  if(!_internal->_partitions.empty())
+    {
+      if(model->getEngine()!=AdaoModel::EnumEngine::Native)
+        throw AdaoExchangeLayerException("loadTemplate : partitions are solved by native engine only !");
+      if(_internal->_surrogate)
+        throw AdaoExchangeLayerException("loadTemplate : surrogate can't be shared by partitions !");
+    }
+  if(_internal->_speculation && model->getEngine()!=AdaoModel::EnumEngine::Python)
+    throw AdaoExchangeLayerException("loadTemplate : speculation is available with python engine only !");
+  _internal->readOperatorSizes(model);
+  if(!_internal->_serie_exports.empty())
+    {
+      if(model->getEngine()==AdaoModel::EnumEngine::OutOfProcess)
+        throw AdaoExchangeLayerException("loadTemplate : series are not exported by out of process engine !");
+      if(model->getEngine()==AdaoModel::EnumEngine::Native && (_internal->_serie_exports.size()!=1 || _internal->_serie_exports.begin()->first!="Analysis"))
+        throw AdaoExchangeLayerException("loadTemplate : native engine exports Analysis only !");
+    }
+  if(model->getEngine()==AdaoModel::EnumEngine::OutOfProcess)
+    {
+      _internal->loadOutOfProcess(model);
+      return ;
+    }
+  if(model->getEngine()==AdaoModel::EnumEngine::Native)
+    {
+      if(!_internal->_evaluator)
+        throw AdaoExchangeLayerException("loadTemplate : native engine requires an evaluator given to setEvaluatorInModel !");
+      _internal->_native_engine.reset(new AdaoNative::Engine(model));
+      _internal->_native_engine->setPartitions(_internal->_partitions,_internal->_max_nb_of_concurrent_partitions);
+      _internal->_native_engine->setSamplingStreaming(_internal->_sampling_chunk_size,_internal->_max_nb_of_concurrent_chunks,_internal->_sampling_result_file_name);
+      if(!_internal->_serie_exports.empty())
+        {
+          _internal->_exporter.reset(new AdaoSerieExporter);
+          _internal->_exporter->addSerie(_internal->_serie_exports.begin()->second);
+        }
+      return ;
+    }
   {
     std::string sciptPyOfModelMaker(model->pyStr());
     PyObjectRAII res(PyObjectRAII::FromNew(PyRun_String(sciptPyOfModelMaker.c_str(),Py_file_input,this->_internal->_context,this->_internal->_context)));
     PyErr_Print();
-    _internal->_adao_case = PyObjectRAII::FromNew(PyDict_GetItemString(this->_internal->_context,"case"));
+    _internal->_adao_case = PyObjectRAII::FromDictItem(this->_internal->_context,"case");
   }
   if(_internal->_adao_case.isNull())
     throw AdaoExchangeLayerException("Fail to generate ADAO case object !");
@@ -361,6 +2089,13 @@ void AdaoExchangeLayer::loadTemplate(AdaoModel::MainModel *model)
   _internal->_execute_func=PyObjectRAII::FromNew(PyObject_GetAttrString(_internal->_adao_case,"execute"));
   if(_internal->_execute_func.isNull())
     throw AdaoExchangeLayerException("Fail to locate execute function of ADAO case object !");
+  _internal->preparePushMode(model);
+  _internal->installSerieExports();
+  _internal->installStoragePolicies();
+  _internal->_stored_variables.assign(1,"Analysis");
+  AdaoModel::StoreSupplKeyVal *storeSuppl(dynamic_cast<AdaoModel::StoreSupplKeyVal *>(model->findByPath(std::string("AlgorithmParameters/Parameters/") + AdaoModel::StoreSupplKeyVal::KEY)));
+  if(storeSuppl)
+    _internal->_stored_variables.insert(_internal->_stored_variables.end(),storeSuppl->getVal().begin(),storeSuppl->getVal().end());
 }
 
 void ExecuteAsync(PyObject *pyExecuteFunction, DataExchangedBetweenThreads *data)
@@ -373,64 +2108,526 @@ void ExecuteAsync(PyObject *pyExecuteFunction, DataExchangedBetweenThreads *data
   }
   data->_finished = true;
   data->_data = nullptr;
-  sem_post(&data->_sem);
+  data->notifyCallingThread();
 }
 
 void AdaoExchangeLayer::execute()
 {
+  _internal->_posterior.reset();
+  if(_internal->_native_engine)
+    {// no python and no thread involved
+      AdaoEvaluator *evaluator(_internal->_evaluator);
+      std::unique_ptr<AdaoEvaluatorWithStore> evaluatorWithStore;
+      std::unique_ptr<AdaoEvaluatorWithSurrogate> evaluatorWithSurrogate;
+      if(_internal->_store)
+        {
+          evaluatorWithStore.reset(new AdaoEvaluatorWithStore(evaluator,_internal->_store.get()));
+          evaluator = evaluatorWithStore.get();
+        }
+      if(_internal->_surrogate)
+        {
+          evaluatorWithSurrogate.reset(new AdaoEvaluatorWithSurrogate(evaluator,_internal->_surrogate.get()));
+          evaluator = evaluatorWithSurrogate.get();
+        }
+      _internal->_native_engine->execute(evaluator);
+      if(_internal->_exporter)
+        {
+          std::vector<double> analysis(_internal->_native_engine->getAnalysis());
+          _internal->_exporter->append(0,std::move(analysis));
+          _internal->_exporter->flush();
+        }
+      return ;
+    }
+  if(_internal->_remote_engine)
+    {// ADAO runs in helper process
+      _internal->_remote_engine->execute();
+      return ;
+    }
+  if(_internal->_memory)
+    {
+      AutoGIL agil;
+      _internal->_memory->start();
+    }
+  if(_internal->_recorder)
+    _internal->_recorder->start();
+  if(_internal->_data_btw_threads._evaluator)
+    {// push mode : no thread involved
+      _internal->executeSynchronously();
+      return ;
+    }
+  if(_internal->_gil_restored)
+    {// GIL given back to calling thread at the end of previous case : needed by the ADAO thread
+      _internal->_fut = std::future< void >();// previous future holds a reference on previous execute function
+      _internal->_tstate = PyEval_SaveThread();
+      _internal->_gil_restored = false;
+    }
   _internal->_fut = std::async(std::launch::async,ExecuteAsync,_internal->_execute_func,&_internal->_data_btw_threads);
 }
 
 bool AdaoExchangeLayer::next(PyObject *& inputRequested)
 {
+  if(_internal->_native_engine || _internal->_data_btw_threads._evaluator)
+    {
+      inputRequested = nullptr;
+      return false;
+    }
+  if(_internal->_remote_engine)
+    {
+      std::string pickledSamples;
+      bool ret(_internal->_remote_engine->next(pickledSamples));
+      AutoGIL agil;
+      _internal->_remote_input = ret?PyObjectRAII::FromNew(UnpickleFromString(pickledSamples)):PyObjectRAII();
+      inputRequested = _internal->_remote_input;
+      return ret;
+    }
   sem_wait(&_internal->_data_btw_threads._sem);
-  if(_internal->_data_btw_threads._finished)
+  return _internal->consumeNotification(inputRequested);
+}
+
+/*!
+ * To be called once _sem has been acquired.
+ */
+bool AdaoExchangeLayer::Internal::consumeNotification(PyObject *& inputRequested)
+{
+  if(_data_btw_threads._finished)
     {
       inputRequested = nullptr;
       return false;
     }
-  else
+  inputRequested = (PyObject *)_data_btw_threads._data;
+  return true;
+}
+
+/*!
+ * Non blocking version of next, to be used with getEventFileDescriptor in an event loop.
+ * Returns AdaoNextStatus::Available and sets \a inputRequested if ADAO is waiting for setResult,
+ * AdaoNextStatus::Finished if ADAO has ended (getResult can be called) and AdaoNextStatus::Pending otherwise.
+ */
+AdaoNextStatus AdaoExchangeLayer::tryNext(PyObject *& inputRequested)
+{
+  inputRequested = nullptr;
+  if(_internal->_native_engine || _internal->_data_btw_threads._evaluator)
+    return AdaoNextStatus::Finished;
+  if(_internal->_remote_engine)
+    throw AdaoExchangeLayerException("tryNext : not available with out of process engine !");
+  if(_internal->_data_btw_threads._event_fd>=0)
+    {// eventfd is reset before looking at _sem : a notification posted after this reset makes it readable again
+      std::uint64_t cnt(0);
+      while(read(_internal->_data_btw_threads._event_fd,&cnt,sizeof(cnt))<0 && errno==EINTR);
+    }
+  if(sem_trywait(&_internal->_data_btw_threads._sem)!=0)
+    {
+      if(errno!=EAGAIN && errno!=EINTR)
+        throw AdaoExchangeLayerException("tryNext : sem_trywait failed !");
+      return AdaoNextStatus::Pending;
+    }
+  return _internal->consumeNotification(inputRequested)?AdaoNextStatus::Available:AdaoNextStatus::Finished;
+}
+
+/*!
+ * Returns a file descriptor (eventfd) that becomes readable when tryNext may have something to give.
+ * Once readable, tryNext has to be called until it returns AdaoNextStatus::Pending.
+ * It is owned by this and has to be requested before execute.
+ */
+int AdaoExchangeLayer::getEventFileDescriptor()
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("getEventFileDescriptor : not initialized !");
+  if(_internal->_data_btw_threads._event_fd<0)
+    {
+      if(_internal->_fut.valid())
+        throw AdaoExchangeLayerException("getEventFileDescriptor : has to be called before execute !");
+      _internal->_data_btw_threads._event_fd = eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC);
+      if(_internal->_data_btw_threads._event_fd<0)
+        throw AdaoExchangeLayerException("getEventFileDescriptor : eventfd creation failed !");
+    }
+  return _internal->_data_btw_threads._event_fd;
+}
+
+/*!
+ * Operator to be evaluated on the samples given by the last successful next (or tryNext). The result given to setResult
+ * has the size of the state for AdaoOperatorKind::EvolutionModel and the size of the observations otherwise.
+ */
+AdaoOperatorKind AdaoExchangeLayer::getRequestedOperator() const
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("getRequestedOperator : not initialized !");
+  return _internal->_data_btw_threads._requested_operator;
+}
+
+/*!
+ * Pull mode helper : \a inputRequested (given by next or tryNext) is evaluated by \a evaluator (not owned), without GIL, in the calling thread.
+ * Result is given to setResult. Output size is the one of the requested operator (see getRequestedOperator).
+ * An AdaoBatchEvaluator receives the whole batch at once, in its preferred layout.
+ *
+ * If the evaluation fails, a RuntimeError is given to setResult, so that ADAO is interrupted rather than waiting forever, then the error is thrown.
+ */
+void AdaoExchangeLayer::evaluateAndSetResult(PyObject *inputRequested, AdaoEvaluator *evaluator)
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("evaluateAndSetResult : not initialized !");
+  const DataExchangedBetweenThreads& data(_internal->_data_btw_threads);
+  std::size_t outputSize(data._requested_operator==AdaoOperatorKind::EvolutionModel?data._state_size:data._output_size);
+  PyObject *result(nullptr);
+  std::string error;
+  try
+    {
+      if(outputSize==0)
+        throw AdaoExchangeLayerException("evaluateAndSetResult : size of result is unknown (Observation/Vector and Background/Vector are expected to be set) !");
+      std::size_t nbOfSamples(0),inputSize(0);
+      std::vector<double> inputs;
+      {
+        AutoGIL agil;
+        nbOfSamples = ReadSamples(inputRequested,inputs,inputSize);
+      }
+      std::vector<double> outputs(nbOfSamples*outputSize);
+      evaluator->evaluate(nbOfSamples,inputSize,inputs.data(),outputSize,outputs.data());
+      AutoGIL agil;
+      result = WriteSamples(nbOfSamples,outputSize,outputs.data());
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      error = e.what();
+    }
+  catch(std::exception& e)
+    {
+      error = e.what();
+    }
+  catch(...)
     {
-      inputRequested = (PyObject *)_internal->_data_btw_threads._data;
-      return true;
+      error = "evaluateAndSetResult : unknown exception thrown by evaluator !";
     }
+  if(!error.empty())
+    {
+      {
+        AutoGIL agil;
+        result = PyObject_CallFunction(PyExc_RuntimeError,"s",error.c_str());
+      }
+      this->setResult(result);
+      throw AdaoExchangeLayerException(error);
+    }
+  this->setResult(result);
 }
 
 void AdaoExchangeLayer::setResult(PyObject *outputAssociated)
 {
+  if(_internal->_remote_engine)
+    {
+      std::string pickledResult;
+      {
+        AutoGIL agil;
+        pickledResult = PickleToString(outputAssociated);
+        Py_XDECREF(outputAssociated);// like in the in process case, reference is stolen
+        _internal->_remote_input = PyObjectRAII();
+      }
+      _internal->_remote_engine->setResult(pickledResult);
+      return ;
+    }
   _internal->_data_btw_threads._data = outputAssociated;
   _internal->_data_btw_threads._finished = false;
   sem_post(&_internal->_data_btw_threads._sem_result_is_here);
 }
 
+/*!
+ * Returns the ADAO Persistence object of "case.get(varName)". GIL is expected to be held by caller.
+ */
+static PyObjectRAII RetrieveVariableOfCase(PyObject *adaoCase, const std::string& varName)
+{
+  PyObjectRAII get_func_of_adao_case(PyObjectRAII::FromNew(PyObject_GetAttrString(adaoCase,"get")));
+  if(get_func_of_adao_case.isNull())
+    throw AdaoExchangeLayerException("Fail to locate \"get\" method from ADAO case !");
+  PyObjectRAII args(PyObjectRAII::FromNew(PyTuple_New(1)));
+  PyTuple_SetItem(args,0,PyUnicode_FromString(varName.c_str()));
+  PyObjectRAII ret(PyObjectRAII::FromNew(PyObject_CallObject(get_func_of_adao_case,args)));
+  if(ret.isNull())
+    {
+      PyErr_Clear();
+      throw AdaoExchangeLayerException(std::string("Fail to retrieve result of case.get(\"") + varName + std::string("\") !"));
+    }
+  return ret;
+}
+
+/*!
+ * Call \a funcName of TRANSPORT_FUNCS on \a obj. GIL is expected to be held by caller.
+ */
+PyObjectRAII AdaoExchangeLayer::Internal::toTransport(const char *funcName, PyObject *obj)
+{
+  PyObjectRAII func(transportFunction(funcName));
+  PyObjectRAII args(PyObjectRAII::FromNew(PyTuple_New(2)));
+  { PyTuple_SetItem(args,0,obj); Py_XINCREF(obj); }
+  PyTuple_SetItem(args,1,PyBool_FromLong(_single_precision?1:0));
+  PyObjectRAII ret(PyObjectRAII::FromNew(PyObject_CallObject(func,args)));
+  if(ret.isNull())
+    {
+      PyErr_Print();
+      throw AdaoExchangeLayerException(std::string("Fail to convert data using ") + funcName + " !");
+    }
+  return ret;
+}
+
 PyObject *AdaoExchangeLayer::getResult()
 {
-  _internal->_fut.wait();
-  if(_internal->_tstate)
-    PyEval_RestoreThread(_internal->_tstate);
+  _internal->waitForEndOfExecution();
   AutoGIL gil;
+  if(_internal->_native_engine)
+    {
+      const std::vector<double>& analysis(_internal->_native_engine->getAnalysis());
+      PyObjectRAII lst(PyObjectRAII::FromNew(PyList_New(analysis.size())));
+      for(std::size_t i=0;i<analysis.size();++i)
+        PyList_SetItem(lst,i,PyFloat_FromDouble(analysis[i]));
+      PyObjectRAII ret(_internal->toTransport("AdaoToTransport",lst));
+      return ret.retn();
+    }
+  if(_internal->_remote_engine)
+    {
+      std::string expr(_internal->_single_precision?"AdaoToTransport(case.get(\"Analysis\")[-1],True)":"case.get(\"Analysis\")[-1]");
+      std::string pickledResult;
+      {
+        AutoSaveThread ast;
+        pickledResult = _internal->_remote_engine->eval(expr);
+      }
+      return UnpickleFromString(pickledResult);
+    }
   // now retrieve case.get("Analysis")[-1]
-  PyObjectRAII get_func_of_adao_case(PyObjectRAII::FromNew(PyObject_GetAttrString(_internal->_adao_case,"get")));
-  if(get_func_of_adao_case.isNull())
-    throw AdaoExchangeLayerException("Fail to locate \"get\" method from ADAO case !");
-  PyObjectRAII all_intermediate_results;
-  {// retrieve return data from case.get("Analysis")
-    PyObjectRAII args(PyObjectRAII::FromNew(PyTuple_New(1)));
-    PyTuple_SetItem(args,0,PyUnicode_FromString("Analysis"));
-    all_intermediate_results=PyObjectRAII::FromNew(PyObject_CallObject(get_func_of_adao_case,args));
-    if(all_intermediate_results.isNull())
-      throw AdaoExchangeLayerException("Fail to retrieve result of case.get(\"Analysis\") !");
-  }
+  PyObjectRAII all_intermediate_results(RetrieveVariableOfCase(_internal->_adao_case,"Analysis"));
   PyObjectRAII optimum;
   {
     PyObjectRAII param(PyObjectRAII::FromNew(PyLong_FromLong(-1)));
     optimum=PyObjectRAII::FromNew(PyObject_GetItem(all_intermediate_results,param));
     if(optimum.isNull())
-      throw AdaoExchangeLayerException("Fail to retrieve result of last element of case.get(\"Analysis\") !");
+      {// typically no analysis because ADAO has been interrupted
+        PyErr_Clear();
+        throw AdaoExchangeLayerException("Fail to retrieve result of last element of case.get(\"Analysis\") !");
+      }
   }
   /*PyObjectRAII code(PyObjectRAII::FromNew(Py_CompileString("case.get(\"Analysis\")[-1]","retrieve result",Py_file_input)));
   if(code.isNull())
     throw AdaoExchangeLayerException("Fail to compile code to retrieve result after ADAO computation !");
     PyObjectRAII res(PyObjectRAII::FromNew(PyEval_EvalCode(code,_internal->_context,_internal->_context)));*/
+  if(_internal->_single_precision)
+    optimum = _internal->toTransport("AdaoToTransport",optimum);
   return optimum.retn();
 }
+
+const AdaoNative::PosteriorCovariance& AdaoExchangeLayer::Internal::posteriorCovariance()
+{
+  if(!_native_engine)
+    throw AdaoExchangeLayerException("Posterior covariance is computed by native engine only !");
+  if(!_posterior)
+    {
+      AdaoEvaluator *evaluator(_evaluator);
+      std::unique_ptr<AdaoEvaluatorWithStore> evaluatorWithStore;
+      if(_store)
+        {
+          evaluatorWithStore.reset(new AdaoEvaluatorWithStore(evaluator,_store.get()));
+          evaluator = evaluatorWithStore.get();
+        }
+      _posterior.reset(new AdaoNative::PosteriorCovariance(_native_engine->posteriorCovariance(evaluator)));
+    }
+  return *_posterior;
+}
+
+/*!
+ * Variances of analysis (diagonal of posterior covariance), without building the n x n posterior covariance that ADAO
+ * would store for APosterioriCovariance. Native engine only, after execute.
+ */
+std::vector<double> AdaoExchangeLayer::getPosteriorVariances()
+{
+  return _internal->posteriorCovariance().diagonal();
+}
+
+/*!
+ * Column \a i (equal to row \a i) of posterior covariance : covariances of the i-th state component with all the others.
+ */
+std::vector<double> AdaoExchangeLayer::getPosteriorCovarianceColumn(std::size_t i)
+{
+  return _internal->posteriorCovariance().column(i);
+}
+
+/*!
+ * Posterior covariance as the prior one reduced by a rank \a rank term (see AdaoLowRankCovariance), O(n.rank) in memory.
+ */
+AdaoLowRankCovariance AdaoExchangeLayer::getPosteriorCovarianceLowRank(std::size_t rank)
+{
+  return _internal->posteriorCovariance().lowRank(rank);
+}
+
+/*!
+ * Returns all the values stored by ADAO for \a varName (for example one of StoreSupplementaryCalculations) as a 2D numpy array
+ * with one row per stored step. Array is float32 if single precision transport is activated, float64 otherwise.
+ */
+PyObject *AdaoExchangeLayer::getSerie(const std::string& varName)
+{
+  if(_internal->_native_engine)
+    throw AdaoExchangeLayerException("getSerie : no serie stored by native engine !");
+  if(_internal->_remote_engine)
+    {
+      std::string serie;
+      {
+        AutoGIL gil;
+        serie = "case.get(" + PyStringLiteral(varName) + ")";
+        auto policy(_internal->_storage_policies.find(varName));
+        if(policy!=_internal->_storage_policies.end() && policy->second.isSpilled())
+          serie = "AdaoSpilledSerie(case," + PyStringLiteral(varName) + "," + PyStringLiteral(policy->second.getSpillFile()) + ")";
+      }
+      std::string pickledSerie(_internal->_remote_engine->eval("AdaoSerieToTransport(" + serie + "," + (_internal->_single_precision?"True":"False") + ")"));
+      AutoGIL gil;
+      return UnpickleFromString(pickledSerie);
+    }
+  _internal->waitForEndOfExecution();
+  AutoGIL gil;
+  auto policy(_internal->_storage_policies.find(varName));
+  if(policy!=_internal->_storage_policies.end() && policy->second.isSpilled())
+    {// whole history is on disk
+      PyObjectRAII func(LocateFunctionInContext(_internal->_context,STORAGE_POLICY_FUNCS,"AdaoSpilledSerie"));
+      PyObjectRAII serie(PyObjectRAII::FromNew(PyObject_CallFunction(func,"Oss",_internal->_adao_case.operator PyObject *(),varName.c_str(),policy->second.getSpillFile().c_str())));
+      if(serie.isNull())
+        {
+          PyErr_Print();
+          throw AdaoExchangeLayerException(std::string("getSerie : fail to read spilled values of ") + varName + " !");
+        }
+      PyObjectRAII ret(_internal->toTransport("AdaoSerieToTransport",serie));
+      return ret.retn();
+    }
+  PyObjectRAII serie(RetrieveVariableOfCase(_internal->_adao_case,varName));
+  PyObjectRAII ret(_internal->toTransport("AdaoSerieToTransport",serie));
+  return ret.retn();
+}
+
+/*!
+ * Writes all the values stored by ADAO for \a varName in the 2D npy file \a npyFileName, one value at a time : contrary to getSerie
+ * the whole serie is never gathered in memory. Python engine (or Analysis with native engine), after execute.
+ */
+void AdaoExchangeLayer::exportSerie(const std::string& varName, const std::string& npyFileName)
+{
+  if(_internal->_remote_engine)
+    throw AdaoExchangeLayerException("exportSerie : not available with out of process engine !");
+  _internal->waitForEndOfExecution();
+  AdaoSerieExporter exporter;
+  std::size_t serieId(exporter.addSerie(npyFileName));
+  if(_internal->_native_engine)
+    {
+      if(varName!="Analysis")
+        throw AdaoExchangeLayerException("exportSerie : native engine stores Analysis only !");
+      std::vector<double> analysis(_internal->_native_engine->getAnalysis());
+      exporter.append(serieId,std::move(analysis));
+      exporter.flush();
+      return ;
+    }
+  AutoGIL gil;
+  PyObjectRAII serie;
+  auto policy(_internal->_storage_policies.find(varName));
+  if(policy!=_internal->_storage_policies.end() && policy->second.isSpilled())
+    {// whole history is on disk
+      PyObjectRAII func(LocateFunctionInContext(_internal->_context,STORAGE_POLICY_FUNCS,"AdaoSpilledSerie"));
+      serie = PyObjectRAII::FromNew(PyObject_CallFunction(func,"Oss",_internal->_adao_case.operator PyObject *(),varName.c_str(),policy->second.getSpillFile().c_str()));
+    }
+  else
+    serie = RetrieveVariableOfCase(_internal->_adao_case,varName);
+  if(serie.isNull())
+    {
+      PyErr_Print();
+      throw AdaoExchangeLayerException(std::string("exportSerie : fail to read spilled values of ") + varName + " !");
+    }
+  PyObjectRAII func(LocateFunctionInContext(_internal->_context,SERIE_EXPORT_FUNCS,"AdaoExportSerie"));
+  PyObjectRAII append(NewSerieExportAppend(&exporter,serieId));
+  PyObjectRAII res(PyObjectRAII::FromNew(PyObject_CallFunctionObjArgs(func,serie.operator PyObject *(),append.operator PyObject *(),nullptr)));
+  if(res.isNull())
+    {
+      PyErr_Print();
+      throw AdaoExchangeLayerException(std::string("exportSerie : fail to export ") + varName + " !");
+    }
+  AutoSaveThread ast;
+  exporter.flush();
+}
+
+const char STORED_BYTES_FUNC[]="def AdaoStoredBytes(case, name):\n"
+    "    import numpy as np\n"
+    "    try:\n"
+    "        serie = case.get(name)\n"
+    "    except Exception:\n"
+    "        return 0\n"
+    "    return int(sum([np.asarray(elt).nbytes for elt in serie[:]]))\n";
+
+/*!
+ * Returns the number of bytes held by each variable stored by ADAO in case ("Analysis" and StoreSupplementaryCalculations).
+ * Can be called between next and setResult (ADAO thread is then waiting) or after getResult. Python engine only.
+ */
+std::vector< std::pair<std::string,std::size_t> > AdaoExchangeLayer::getStoredVariablesSizes()
+{
+  if(_internal->_native_engine || _internal->_remote_engine || _internal->_adao_case.isNull())
+    throw AdaoExchangeLayerException("getStoredVariablesSizes : available for python engine only, after loadTemplate !");
+  AutoGIL gil;
+  PyObjectRAII func(LocateFunctionInContext(_internal->_context,STORED_BYTES_FUNC,"AdaoStoredBytes"));
+  std::vector< std::pair<std::string,std::size_t> > ret;
+  for(const auto& varName : _internal->_stored_variables)
+    {
+      PyObjectRAII res(PyObjectRAII::FromNew(PyObject_CallFunction(func,"Os",_internal->_adao_case.operator PyObject *(),varName.c_str())));
+      if(res.isNull())
+        {
+          PyErr_Print();
+          throw AdaoExchangeLayerException(std::string("getStoredVariablesSizes : fail to compute size of ") + varName + " !");
+        }
+      ret.push_back(std::make_pair(varName,(std::size_t)PyLong_AsSize_t(res)));
+    }
+  return ret;
+}
+
+/*!
+ * Drop all references to objects of the last case. GIL is expected to be held by caller.
+ */
+void AdaoExchangeLayer::Internal::releaseCase()
+{
+  _fut = std::future< void >();
+  _native_engine.reset();
+  _remote_engine.reset();
+  _posterior.reset();
+  _exporter.reset();
+  _evaluator_with_store.reset();
+  _evaluator_with_surrogate.reset();
+  _evaluator_with_speculation.reset();
+  _evaluator = nullptr;
+  _evolution_evaluator = nullptr;
+  _data_btw_threads._evaluator = nullptr;
+  _data_btw_threads._differentiable_evaluator = nullptr;
+  _data_btw_threads._evolution_evaluator = nullptr;
+  _data_btw_threads._data = nullptr;
+  _stored_variables.clear();
+  _remote_input = PyObjectRAII();
+  _adao_case = PyObjectRAII();
+  _execute_func = PyObjectRAII();
+  _generate_case_func = PyObjectRAII();
+  _decorator_func = PyObjectRAII();
+  _evolution_decorator_func = PyObjectRAII();
+  _py_call_back.reset();
+  _py_evolution_call_back.reset();
+  if(_memory)// samples of the last case are kept
+    _memory->stop();
+  // names set by this layer (__0, functions of the scripts, case...) and by the visitors of the caller
+  PyDict_Clear(_context);
+  PyDict_SetItemString(_context,"__builtins__",PyEval_GetBuiltins());
+  // ADAO objects reference each other (case, observers, operators)
+  PyGC_Collect();
+}
+
+/*!
+ * Teardown of the last case, for long lived processes running many cases with the same layer : ADAO case, callbacks, engines,
+ * results and everything set in getPythonContext (also by the visitors of the caller) are released, and the context is back to its state after init.
+ * Interpreter and settings of the layer (evaluation store, surrogate, storage policies, exports, partitions...) are kept for the next case,
+ * which starts again with setFunctionCallbackInModel. Last case has to be finished : getResult has returned, or next has returned false.
+ */
+void AdaoExchangeLayer::releaseCase()
+{
+  if(!_internal)
+    throw AdaoExchangeLayerException("releaseCase : not initialized !");
+  if(_internal->_fut.valid() && _internal->_fut.wait_for(std::chrono::seconds(0))!=std::future_status::ready)
+    throw AdaoExchangeLayerException("releaseCase : case is still running !");
+  _internal->waitForEndOfExecution();
+  {
+    AutoGIL gil;
+    _internal->releaseCase();
+  }
+#ifdef __GLIBC__
+  malloc_trim(0);// freed heap is given back to the system : RSS does not keep the peak of previous cases
+#endif
+}
@@ -23,14 +23,41 @@
 #include "Python.h"
 
 #include <string>
+#include <vector>
+#include <utility>
 
 class AdaoCallbackSt;
+class AdaoEvaluator;
+class AdaoMemoryAccounting;
+class AdaoStoragePolicy;
+class AdaoSurrogate;
+class AdaoSpeculation;
+class AdaoCovarianceOperator;
+class AdaoPartition;
+class AdaoSamplingResult;
+struct AdaoLowRankCovariance;
 
 namespace AdaoModel
 {
   class MainModel;
 }
 
+enum class AdaoNextStatus
+{
+    Pending,
+    Available,
+    Finished
+};
+
+/*!
+ * Operator ADAO asks to evaluate. EvolutionModel is requested by 4DVAR only.
+ */
+enum class AdaoOperatorKind
+{
+    ObservationOperator,
+    EvolutionModel
+};
+
 class AdaoExchangeLayer
 {
   class Internal;
@@ -40,12 +67,43 @@ public:
   PyObject *getPythonContext() const;
   std::string printContext() const;
   void init();
+  void setSinglePrecisionTransport(bool val);
+  bool isSinglePrecisionTransport() const;
+  void setEvaluationStore(const std::string& fileName, const std::string& modelVersionTag);
+  void setSurrogate(double relativeTolerance);
+  const AdaoSurrogate& getSurrogate() const;
+  void setSpeculation(std::size_t chunkSize);
+  const AdaoSpeculation& getSpeculation() const;
+  void setMemoryAccounting(bool val);
+  void setExchangeRecording(const std::string& fileName);
+  void setStoragePolicy(const std::string& varName, const AdaoStoragePolicy& policy);
+  void setSerieExport(const std::string& varName, const std::string& npyFileName);
+  void addPartition(const AdaoPartition& partition);
+  void clearPartitions();
+  void setMaximumNumberOfConcurrentPartitions(std::size_t nb);
+  void setSamplingStreaming(std::size_t chunkSize, std::size_t maxNbOfConcurrentChunks, const std::string& resultFileName = std::string());
+  const AdaoSamplingResult& getSamplingResult() const;
+  const AdaoMemoryAccounting& getMemoryAccounting() const;
   void setFunctionCallbackInModel(AdaoModel::MainModel *model);
+  void setEvaluatorInModel(AdaoModel::MainModel *model, AdaoEvaluator *evaluator);
+  void setEvaluatorInModel(AdaoModel::MainModel *model, AdaoEvaluator *evaluator, AdaoEvaluator *evolutionEvaluator);
+  void setCovarianceOperatorInModel(AdaoModel::MainModel *model, const std::string& errorKey, AdaoCovarianceOperator *op);
   void loadTemplate(AdaoModel::MainModel *model);
   void execute();
   bool next(PyObject *& inputRequested);
+  AdaoNextStatus tryNext(PyObject *& inputRequested);
+  int getEventFileDescriptor();
+  AdaoOperatorKind getRequestedOperator() const;
   void setResult(PyObject *outputAssociated);
+  void evaluateAndSetResult(PyObject *inputRequested, AdaoEvaluator *evaluator);
   PyObject *getResult();
+  std::vector<double> getPosteriorVariances();
+  std::vector<double> getPosteriorCovarianceColumn(std::size_t i);
+  AdaoLowRankCovariance getPosteriorCovarianceLowRank(std::size_t rank);
+  PyObject *getSerie(const std::string& varName);
+  void exportSerie(const std::string& varName, const std::string& npyFileName);
+  std::vector< std::pair<std::string,std::size_t> > getStoredVariablesSizes();
+  void releaseCase();
 private:
   void initPythonIfNeeded();
 private:
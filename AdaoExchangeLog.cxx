@@ -0,0 +1,241 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+
+#include "AdaoExchangeLog.hxx"
+#include "AdaoExchangeLayerException.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+  const char MAGIC[8]={'A','D','A','O','L','O','G','1'};
+
+  struct RecordHeader
+  {
+    //! size of the whole record, repeated after the payload
+    std::uint64_t _record_size;
+    std::uint32_t _kind;
+    std::uint32_t _reserved;
+    std::uint64_t _nb_of_samples;
+    std::uint64_t _input_size;
+    std::uint64_t _output_size;
+    double _adao_seconds;
+    double _evaluation_seconds;
+  };
+
+  void WriteAll(int fd, const char *data, std::size_t len)
+  {
+    while(len>0)
+      {
+        ssize_t nb(write(fd,data,len));
+        if(nb<=0)
+          throw AdaoExchangeLayerException("AdaoExchangeRecorder : write failed on log file !");
+        data+=nb; len-=nb;
+      }
+  }
+
+  double SecondsBetween(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b)
+  {
+    return std::chrono::duration<double>(b-a).count();
+  }
+}
+
+AdaoExchangeRecorder::AdaoExchangeRecorder(const std::string& fileName):_file_name(fileName)
+{
+  _fd = open(fileName.c_str(),O_WRONLY | O_CREAT | O_TRUNC | O_APPEND,0644);
+  if(_fd<0)
+    {
+      std::ostringstream oss; oss << "AdaoExchangeRecorder : impossible to open \"" << fileName << "\" !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+  WriteAll(_fd,MAGIC,sizeof(MAGIC));
+  start();
+}
+
+AdaoExchangeRecorder::~AdaoExchangeRecorder()
+{
+  if(_fd>=0)
+    close(_fd);
+}
+
+void AdaoExchangeRecorder::start()
+{
+  _last_answer = std::chrono::steady_clock::now();
+}
+
+/*!
+ * \a evaluationSeconds is the time spent to answer the batch. Time spent by ADAO is the one elapsed before, since previous answer.
+ */
+void AdaoExchangeRecorder::record(AdaoOperatorKind kind, std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, const double *outputs, double evaluationSeconds)
+{
+  auto now(std::chrono::steady_clock::now());
+  std::size_t inputBytes(nbOfSamples*inputSize*sizeof(double)),outputBytes(nbOfSamples*outputSize*sizeof(double));
+  RecordHeader rh;
+  rh._record_size = sizeof(RecordHeader)+inputBytes+outputBytes+sizeof(std::uint64_t);
+  rh._kind = (std::uint32_t)kind;
+  rh._reserved = 0;
+  rh._nb_of_samples = nbOfSamples; rh._input_size = inputSize; rh._output_size = outputSize;
+  rh._adao_seconds = std::max(SecondsBetween(_last_answer,now)-evaluationSeconds,0.);
+  rh._evaluation_seconds = evaluationSeconds;
+  _buffer.resize(rh._record_size);
+  char *pt(_buffer.data());
+  std::memcpy(pt,&rh,sizeof(RecordHeader)); pt+=sizeof(RecordHeader);
+  std::memcpy(pt,inputs,inputBytes); pt+=inputBytes;
+  std::memcpy(pt,outputs,outputBytes); pt+=outputBytes;
+  std::memcpy(pt,&rh._record_size,sizeof(std::uint64_t));
+  WriteAll(_fd,_buffer.data(),_buffer.size());
+  _nb_of_records++;
+  _last_answer = now;
+}
+
+AdaoExchangeLog::AdaoExchangeLog(const std::string& fileName)
+{
+  read(fileName,nullptr);
+}
+
+/*!
+ * Only records of operator \a kind are kept : payloads of the others are skipped without being read.
+ */
+AdaoExchangeLog::AdaoExchangeLog(const std::string& fileName, AdaoOperatorKind kind)
+{
+  read(fileName,&kind);
+}
+
+/*!
+ * Records are read one by one straight into their AdaoExchangeRecord : memory used is the one of the records kept.
+ * Reading stops at the first record whose header is inconsistent (sizes overflowing, record going beyond end of file) or
+ * whose trailer does not match : truncated tail of an interrupted run.
+ */
+void AdaoExchangeLog::read(const std::string& fileName, const AdaoOperatorKind *kind)
+{
+  std::ifstream ifs(fileName,std::ios::binary);
+  if(!ifs)
+    {
+      std::ostringstream oss; oss << "AdaoExchangeLog : impossible to open \"" << fileName << "\" !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+  ifs.seekg(0,std::ios::end);
+  std::uint64_t fileSize(ifs.tellg());
+  ifs.seekg(0,std::ios::beg);
+  char magic[sizeof(MAGIC)];
+  if(!ifs.read(magic,sizeof(MAGIC)) || std::memcmp(magic,MAGIC,sizeof(MAGIC))!=0)
+    {
+      std::ostringstream oss; oss << "AdaoExchangeLog : \"" << fileName << "\" is not an exchange log !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+  const std::uint64_t maxValue(std::numeric_limits<std::uint64_t>::max());
+  std::uint64_t pos(sizeof(MAGIC));
+  RecordHeader rh;
+  while(ifs.read(reinterpret_cast<char *>(&rh),sizeof(RecordHeader)))
+    {
+      if(rh._input_size>maxValue-rh._output_size)
+        break;
+      std::uint64_t sampleSize(rh._input_size+rh._output_size);
+      if(sampleSize!=0 && rh._nb_of_samples>(maxValue-sizeof(RecordHeader)-sizeof(std::uint64_t))/sizeof(double)/sampleSize)
+        break;
+      std::uint64_t payload(rh._nb_of_samples*sampleSize*sizeof(double));
+      if(rh._record_size!=sizeof(RecordHeader)+payload+sizeof(std::uint64_t) || rh._record_size>fileSize-pos)
+        break;// truncated tail
+      std::uint64_t trailer(0);
+      if(kind && (AdaoOperatorKind)rh._kind!=*kind)
+        {
+          if(!ifs.seekg(payload,std::ios::cur) || !ifs.read(reinterpret_cast<char *>(&trailer),sizeof(std::uint64_t)) || trailer!=rh._record_size)
+            break;
+          pos += rh._record_size;
+          continue;
+        }
+      AdaoExchangeRecord rec;
+      rec._kind = (AdaoOperatorKind)rh._kind;
+      rec._nb_of_samples = rh._nb_of_samples; rec._input_size = rh._input_size; rec._output_size = rh._output_size;
+      rec._adao_seconds = rh._adao_seconds; rec._evaluation_seconds = rh._evaluation_seconds;
+      rec._inputs.resize(rec._nb_of_samples*rec._input_size);
+      rec._outputs.resize(rec._nb_of_samples*rec._output_size);
+      if(!ifs.read(reinterpret_cast<char *>(rec._inputs.data()),rec._inputs.size()*sizeof(double)) ||
+         !ifs.read(reinterpret_cast<char *>(rec._outputs.data()),rec._outputs.size()*sizeof(double)) ||
+         !ifs.read(reinterpret_cast<char *>(&trailer),sizeof(std::uint64_t)) || trailer!=rh._record_size)
+        break;
+      _records.push_back(std::move(rec));
+      pos += rh._record_size;
+    }
+}
+
+double AdaoExchangeLog::getAdaoSeconds() const
+{
+  double ret(0.);
+  for(const auto& rec : _records)
+    ret += rec._adao_seconds;
+  return ret;
+}
+
+double AdaoExchangeLog::getEvaluationSeconds() const
+{
+  double ret(0.);
+  for(const auto& rec : _records)
+    ret += rec._evaluation_seconds;
+  return ret;
+}
+
+AdaoReplayEvaluator::AdaoReplayEvaluator(const std::string& fileName, AdaoOperatorKind kind):_records(AdaoExchangeLog(fileName,kind).takeRecords())
+{
+}
+
+void AdaoReplayEvaluator::evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs)
+{
+  auto now(std::chrono::steady_clock::now());
+  if(_pos>0)
+    _adao_seconds += SecondsBetween(_last_answer,now);
+  std::ostringstream oss; oss << "AdaoReplayEvaluator : run departs from the recorded sequence at batch #" << _pos << " : ";
+  if(_pos>=_records.size())
+    {
+      oss << "log has only " << _records.size() << " batches !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+  const AdaoExchangeRecord& rec(_records[_pos]);
+  if(rec._nb_of_samples!=nbOfSamples || rec._input_size!=inputSize || rec._output_size!=outputSize)
+    {
+      oss << nbOfSamples << " samples of size " << inputSize << " -> " << outputSize << " requested whereas ";
+      oss << rec._nb_of_samples << " samples of size " << rec._input_size << " -> " << rec._output_size << " are recorded !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+  for(std::size_t i=0;i<rec._inputs.size();++i)
+    {
+      double ref(rec._inputs[i]);
+      bool isSame(_relative_tolerance==0.?std::memcmp(&ref,inputs+i,sizeof(double))==0:std::abs(inputs[i]-ref)<=_relative_tolerance*std::abs(ref));
+      if(!isSame)
+        {
+          oss.precision(17);
+          oss << "component #" << i%inputSize << " of sample #" << i/inputSize << " is " << inputs[i] << " whereas " << ref << " is recorded !";
+          throw AdaoExchangeLayerException(oss.str());
+        }
+    }
+  std::copy(rec._outputs.begin(),rec._outputs.end(),outputs);
+  _pos++;
+  _last_answer = std::chrono::steady_clock::now();
+}
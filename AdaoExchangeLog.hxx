@@ -0,0 +1,111 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+
+#pragma once
+
+#include "AdaoEvaluator.hxx"
+#include "AdaoExchangeLayer.hxx"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+
+/*!
+ * One batch exchanged between ADAO and the operator : samples requested, results given back and timings.
+ */
+struct AdaoExchangeRecord
+{
+  AdaoOperatorKind _kind = AdaoOperatorKind::ObservationOperator;
+  std::size_t _nb_of_samples = 0;
+  std::size_t _input_size = 0;
+  std::size_t _output_size = 0;
+  //! time spent by ADAO since the previous batch has been answered (or since start of the recording)
+  double _adao_seconds = 0.;
+  //! time spent to answer this batch
+  double _evaluation_seconds = 0.;
+  std::vector<double> _inputs;
+  std::vector<double> _outputs;
+};
+
+/*!
+ * Append-only binary log of the batches exchanged with the operators. Each record is written with a single write call and ends
+ * with a copy of its size : a record partially written by an interrupted run is ignored by AdaoExchangeLog.
+ */
+class AdaoExchangeRecorder
+{
+public:
+  AdaoExchangeRecorder(const std::string& fileName);
+  ~AdaoExchangeRecorder();
+  const std::string& getFileName() const { return _file_name; }
+  void start();
+  void record(AdaoOperatorKind kind, std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, const double *outputs, double evaluationSeconds);
+  std::size_t getNumberOfRecords() const { return _nb_of_records; }
+private:
+  std::string _file_name;
+  int _fd = -1;
+  std::size_t _nb_of_records = 0;
+  std::chrono::steady_clock::time_point _last_answer;
+  std::vector<char> _buffer;
+};
+
+/*!
+ * Records of a log written by AdaoExchangeRecorder, in the order of the run.
+ */
+class AdaoExchangeLog
+{
+public:
+  AdaoExchangeLog(const std::string& fileName);
+  AdaoExchangeLog(const std::string& fileName, AdaoOperatorKind kind);
+  const std::vector<AdaoExchangeRecord>& getRecords() const { return _records; }
+  //! records are moved out of this
+  std::vector<AdaoExchangeRecord> takeRecords() { return std::move(_records); }
+  std::size_t getNumberOfRecords() const { return _records.size(); }
+  double getAdaoSeconds() const;
+  double getEvaluationSeconds() const;
+private:
+  void read(const std::string& fileName, const AdaoOperatorKind *kind);
+private:
+  std::vector<AdaoExchangeRecord> _records;
+};
+
+/*!
+ * Evaluator answering from a log the batches of operator \a kind, in the recorded order, without calling the simulator.
+ * Samples requested have to be the recorded ones, bit for bit (or up to the relative tolerance given by setTolerance) :
+ * otherwise the run departs from the recorded sequence and evaluate throws.
+ */
+class AdaoReplayEvaluator : public AdaoEvaluator
+{
+public:
+  AdaoReplayEvaluator(const std::string& fileName, AdaoOperatorKind kind = AdaoOperatorKind::ObservationOperator);
+  void setTolerance(double relativeTolerance) { _relative_tolerance = relativeTolerance; }
+  void evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs) override;
+  std::size_t getNumberOfReplayedBatches() const { return _pos; }
+  bool isExhausted() const { return _pos==_records.size(); }
+  //! time spent by ADAO between the replayed batches
+  double getAdaoSeconds() const { return _adao_seconds; }
+private:
+  std::vector<AdaoExchangeRecord> _records;
+  std::size_t _pos = 0;
+  double _relative_tolerance = 0.;
+  double _adao_seconds = 0.;
+  std::chrono::steady_clock::time_point _last_answer;
+};
@@ -0,0 +1,338 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#include "AdaoExternalEvaluator.hxx"
+
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+
+#include <csignal>
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+class AdaoExternalEvaluator::Run
+{
+public:
+  std::size_t _sample_id = 0;
+  unsigned int _nb_of_attempts = 0;
+  std::string _directory;
+  pid_t _pid = -1;
+  std::chrono::steady_clock::time_point _deadline;
+};
+
+static int RemoveEntry(const char *path, const struct stat *, int, struct FTW *)
+{
+  return ::remove(path);
+}
+
+static void RemoveDirectory(const std::string& dirName)
+{
+  if(!dirName.empty())
+    nftw(dirName.c_str(),RemoveEntry,16,FTW_DEPTH|FTW_PHYS);
+}
+
+static std::string ReadFile(const std::string& fileName)
+{
+  std::ifstream ifs(fileName,std::ios::binary);
+  if(!ifs)
+    throw AdaoExchangeLayerException(std::string("AdaoExternalEvaluator : fail to read \"") + fileName + "\" !");
+  std::ostringstream oss; oss << ifs.rdbuf();
+  return oss.str();
+}
+
+static void WriteFile(const std::string& fileName, const std::string& content)
+{
+  std::ofstream ofs(fileName,std::ios::binary);
+  ofs << content;
+  if(!ofs)
+    throw AdaoExchangeLayerException(std::string("AdaoExternalEvaluator : fail to write \"") + fileName + "\" !");
+}
+
+/*!
+ * Path of \a exe as execvp would find it when run in \a runDirectory : \a exe itself if it contains a '/', else the first
+ * executable file named \a exe in PATH (relative entries of PATH being relative to \a runDirectory). Searching PATH
+ * allocates : it is done before fork.
+ */
+static std::string ResolveExecutable(const std::string& exe, const std::string& runDirectory)
+{
+  if(exe.find('/')!=std::string::npos)
+    return exe;
+  const char *env(std::getenv("PATH"));
+  std::string path(env?env:"/bin:/usr/bin");
+  std::size_t pos(0);
+  while(true)
+    {
+      std::size_t end(path.find(':',pos));
+      std::string dir(path.substr(pos,end==std::string::npos?std::string::npos:end-pos));
+      std::string candidate((dir.empty()?std::string("."):dir) + "/" + exe);
+      std::string fromHere(candidate[0]=='/'?candidate:runDirectory + "/" + candidate);
+      struct stat st;
+      if(stat(fromHere.c_str(),&st)==0 && S_ISREG(st.st_mode) && access(fromHere.c_str(),X_OK)==0)
+        return candidate;
+      if(end==std::string::npos)
+        break;
+      pos = end+1;
+    }
+  throw AdaoExchangeLayerException(std::string("AdaoExternalEvaluator : executable \"") + exe + "\" not found in PATH !");
+}
+
+AdaoExternalEvaluator::AdaoExternalEvaluator(const std::vector<std::string>& command):_command(command)
+{
+  if(_command.empty())
+    throw AdaoExchangeLayerException("AdaoExternalEvaluator : command is empty !");
+  struct stat st;
+  _run_directory_root = (stat("/dev/shm",&st)==0 && S_ISDIR(st.st_mode) && access("/dev/shm",W_OK)==0)?"/dev/shm":"/tmp";
+}
+
+void AdaoExternalEvaluator::addInputTemplate(const std::string& templateFileName, const std::string& fileNameInRunDirectory)
+{
+  addInputTemplateFromString(ReadFile(templateFileName),fileNameInRunDirectory);
+}
+
+void AdaoExternalEvaluator::addInputTemplateFromString(const std::string& templateContent, const std::string& fileNameInRunDirectory)
+{
+  _templates.push_back(std::make_pair(templateContent,fileNameInRunDirectory));
+}
+
+void AdaoExternalEvaluator::setMaximumNumberOfConcurrentRuns(unsigned int val)
+{
+  if(val==0)
+    throw AdaoExchangeLayerException("AdaoExternalEvaluator::setMaximumNumberOfConcurrentRuns : value is expected to be > 0 !");
+  _max_concurrent_runs = val;
+}
+
+/*!
+ * Replace ${x<i>} by component i of \a input (17 significant digits) and ${sample} by \a sampleId.
+ */
+std::string AdaoExternalEvaluator::Substitute(const std::string& text, std::size_t sampleId, std::size_t inputSize, const double *input)
+{
+  std::ostringstream oss;
+  oss.precision(17);
+  std::size_t pos(0);
+  while(true)
+    {
+      std::size_t start(text.find("${",pos));
+      if(start==std::string::npos)
+        {
+          oss << text.substr(pos);
+          break;
+        }
+      std::size_t end(text.find('}',start));
+      if(end==std::string::npos)
+        throw AdaoExchangeLayerException("AdaoExternalEvaluator : unterminated ${ in template !");
+      oss << text.substr(pos,start-pos);
+      std::string name(text.substr(start+2,end-start-2));
+      if(name=="sample")
+        oss << sampleId;
+      else if(name.size()>1 && name[0]=='x' && name.find_first_not_of("0123456789",1)==std::string::npos)
+        {
+          // more than 9 digits : out of range of samples, and possibly of std::stoul
+          std::size_t id(name.size()>10?inputSize:std::stoul(name.substr(1)));
+          if(id>=inputSize)
+            {
+              std::ostringstream oss2; oss2 << "AdaoExternalEvaluator : template refers to ${" << name << "} whereas samples have " << inputSize << " components !";
+              throw AdaoExchangeLayerException(oss2.str());
+            }
+          oss << input[id];
+        }
+      else
+        throw AdaoExchangeLayerException(std::string("AdaoExternalEvaluator : unknown placeholder ${") + name + "} in template !");
+      pos = end+1;
+    }
+  return oss.str();
+}
+
+std::vector<double> AdaoExternalEvaluator::ParseNumbers(const std::string& content)
+{
+  std::vector<double> ret;
+  const char *pt(content.c_str());
+  while(true)
+    {
+      char *endPt(nullptr);
+      double val(std::strtod(pt,&endPt));
+      if(endPt==pt)
+        break;
+      ret.push_back(val);
+      pt = endPt;
+    }
+  while(*pt!='\0' && std::isspace((unsigned char)*pt))
+    ++pt;
+  if(*pt!='\0')
+    throw AdaoExchangeLayerException("AdaoExternalEvaluator : output contains something else than numbers !");
+  return ret;
+}
+
+/*!
+ * Create a fresh run directory, fill templates and start command in it.
+ */
+void AdaoExternalEvaluator::launch(Run& run, std::size_t inputSize, const double *inputs)
+{
+  const double *input(inputs+run._sample_id*inputSize);
+  RemoveDirectory(run._directory);
+  std::string pattern(_run_directory_root + "/adao_run_XXXXXX");
+  if(!mkdtemp(&pattern[0]))
+    throw AdaoExchangeLayerException(std::string("AdaoExternalEvaluator : fail to create run directory in \"") + _run_directory_root + "\" : " + std::strerror(errno) + " !");
+  run._directory = pattern;
+  for(const auto& it : _templates)
+    WriteFile(run._directory + "/" + it.second,Substitute(it.first,run._sample_id,inputSize,input));
+  // everything needed by child is prepared before fork : only async-signal-safe calls in child
+  std::vector<std::string> args;
+  for(const auto& arg : _command)
+    args.push_back(Substitute(arg,run._sample_id,inputSize,input));
+  std::vector<char *> argv;
+  args[0] = ResolveExecutable(args[0],run._directory);
+  for(auto& arg : args)
+    argv.push_back(&arg[0]);
+  argv.push_back(nullptr);
+  std::string outName(run._directory + "/stdout.txt"),errName(run._directory + "/stderr.txt");
+  ++run._nb_of_attempts;
+  run._pid = fork();
+  if(run._pid<0)
+    throw AdaoExchangeLayerException("AdaoExternalEvaluator : fork failed !");
+  if(run._pid==0)
+    {
+      setpgid(0,0);// own process group : killed with its children on timeout
+      int out(open(outName.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644)),err(open(errName.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644));
+      if(out<0 || err<0 || chdir(run._directory.c_str())!=0)
+        _exit(126);
+      dup2(out,STDOUT_FILENO); dup2(err,STDERR_FILENO);
+      close(out); close(err);
+      execv(argv[0],argv.data());
+      _exit(127);
+    }
+  setpgid(run._pid,run._pid);
+  if(_timeout>0.)
+    run._deadline = std::chrono::steady_clock::now()+std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(_timeout));
+}
+
+/*!
+ * An AdaoExchangeLayerException is thrown as soon as a sample fails after all retries. Runs still in progress are then killed.
+ */
+void AdaoExternalEvaluator::evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs)
+{
+  std::vector<Run> running;
+  std::size_t nextSample(0);
+  try
+    {
+      while(nextSample<nbOfSamples || !running.empty())
+        {
+          while(nextSample<nbOfSamples && running.size()<_max_concurrent_runs)
+            {
+              running.emplace_back();
+              running.back()._sample_id = nextSample++;
+              launch(running.back(),inputSize,inputs);
+            }
+          bool somethingHappened(false);
+          for(auto it=running.begin();it!=running.end();)
+            {
+              Run& run(*it);
+              int status(0);
+              std::string failure;
+              pid_t ret(waitpid(run._pid,&status,WNOHANG));
+              if(ret==0)
+                {
+                  if(_timeout<=0. || std::chrono::steady_clock::now()<run._deadline)
+                    { ++it; continue; }
+                  kill(-run._pid,SIGKILL);
+                  waitpid(run._pid,&status,0);
+                  std::ostringstream oss; oss << "timeout of " << _timeout << " s reached";
+                  failure = oss.str();
+                }
+              else if(ret<0 || !WIFEXITED(status) || WEXITSTATUS(status)!=0)
+                {
+                  std::ostringstream oss;
+                  if(ret>0 && WIFEXITED(status))
+                    oss << "exit status " << WEXITSTATUS(status);
+                  else
+                    oss << "abnormal termination";
+                  failure = oss.str();
+                }
+              else
+                {
+                  try
+                    {
+                      std::string content(ReadFile(run._directory + "/" + _output_file));
+                      std::vector<double> res(_output_parser?_output_parser(content):ParseNumbers(content));
+                      if(res.size()!=outputSize)
+                        {
+                          std::ostringstream oss; oss << "output contains " << res.size() << " values whereas " << outputSize << " are expected";
+                          failure = oss.str();
+                        }
+                      else
+                        std::copy(res.begin(),res.end(),outputs+run._sample_id*outputSize);
+                    }
+                  catch(AdaoExchangeLayerException& e)
+                    {
+                      failure = e.what();
+                    }
+                  catch(std::exception& e)
+                    {// user given output parser
+                      failure = e.what();
+                    }
+                  catch(...)
+                    {
+                      failure = "unknown exception while parsing output";
+                    }
+                }
+              run._pid = -1;
+              somethingHappened = true;
+              if(failure.empty())
+                {
+                  RemoveDirectory(run._directory);
+                  it = running.erase(it);
+                  continue;
+                }
+              if(run._nb_of_attempts>_max_retries)
+                {
+                  std::ostringstream oss; oss << "AdaoExternalEvaluator : run of sample #" << run._sample_id << " in \"" << run._directory << "\" has failed " << run._nb_of_attempts << " time(s), last failure : " << failure << " !";
+                  if(_keep_failed_run_directories)
+                    run._directory.clear();// kept for post mortem
+                  throw AdaoExchangeLayerException(oss.str());
+                }
+              launch(run,inputSize,inputs);
+              ++it;
+            }
+          if(!somethingHappened)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+  catch(...)
+    {// runs are never left behind, whatever the failure (std::bad_alloc, fork...)
+      for(auto& run : running)
+        {
+          if(run._pid>0)
+            {
+              kill(-run._pid,SIGKILL);
+              waitpid(run._pid,nullptr,0);
+            }
+          RemoveDirectory(run._directory);
+        }
+      throw;
+    }
+}
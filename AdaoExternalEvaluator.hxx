@@ -0,0 +1,72 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include "AdaoEvaluator.hxx"
+
+#include <string>
+#include <vector>
+#include <functional>
+
+/*!
+ * Evaluator running an external executable once per sample, up to getMaximumNumberOfConcurrentRuns at the same time.
+ *
+ * Each run has its own directory created under getRunDirectoryRoot (/dev/shm by default, i.e. tmpfs) in which :
+ * - input templates are written after substitution of ${x0}, ${x1}... by the components of the sample and of ${sample} by its id in the batch,
+ * - command is launched (same substitutions in its arguments), stdout and stderr going to stdout.txt and stderr.txt,
+ * - output file is parsed : by default whitespace separated numbers, one per component of the result.
+ * A run killed by timeout, ending with a non zero status or giving an unparsable output (exception of the output parser included) is retried. Run directories are removed once
+ * parsed, except by default those of runs failing after all retries.
+ */
+class AdaoExternalEvaluator : public AdaoEvaluator
+{
+public:
+  AdaoExternalEvaluator(const std::vector<std::string>& command);
+  void addInputTemplate(const std::string& templateFileName, const std::string& fileNameInRunDirectory);
+  void addInputTemplateFromString(const std::string& templateContent, const std::string& fileNameInRunDirectory);
+  void setOutputFile(const std::string& fileNameInRunDirectory) { _output_file = fileNameInRunDirectory; }
+  void setOutputParser(std::function< std::vector<double>(const std::string&) > parser) { _output_parser = parser; }
+  void setMaximumNumberOfConcurrentRuns(unsigned int val);
+  unsigned int getMaximumNumberOfConcurrentRuns() const { return _max_concurrent_runs; }
+  void setTimeout(double seconds) { _timeout = seconds; }
+  void setMaximumNumberOfRetries(unsigned int val) { _max_retries = val; }
+  void setRunDirectoryRoot(const std::string& dirName) { _run_directory_root = dirName; }
+  const std::string& getRunDirectoryRoot() const { return _run_directory_root; }
+  void setKeepFailedRunDirectories(bool val) { _keep_failed_run_directories = val; }
+  void evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs) override;
+  static std::string Substitute(const std::string& text, std::size_t sampleId, std::size_t inputSize, const double *input);
+  static std::vector<double> ParseNumbers(const std::string& content);
+private:
+  class Run;
+  void launch(Run& run, std::size_t inputSize, const double *inputs);
+private:
+  std::vector<std::string> _command;
+  //! pairs of template content and file name in run directory
+  std::vector< std::pair<std::string,std::string> > _templates;
+  std::string _output_file = "output.txt";
+  std::function< std::vector<double>(const std::string&) > _output_parser;
+  unsigned int _max_concurrent_runs = 1;
+  //! in seconds, no timeout if <= 0
+  double _timeout = 0.;
+  unsigned int _max_retries = 0;
+  std::string _run_directory_root;
+  bool _keep_failed_run_directories = true;
+};
@@ -0,0 +1,192 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#include "AdaoMemoryAccounting.hxx"
+#include "AdaoExchangeLayerException.hxx"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <unistd.h>
+
+/*!
+ * GIL is expected to be held by caller.
+ */
+AdaoMemoryAccounting::~AdaoMemoryAccounting()
+{
+  stop();
+}
+
+/*!
+ * Start tracemalloc if not already tracing. GIL is expected to be held by caller.
+ */
+void AdaoMemoryAccounting::start()
+{
+  _samples.clear();
+  _input_high_water_mark = 0;
+  _output_high_water_mark = 0;
+  PyObjectRAII tracemalloc(PyObjectRAII::FromNew(PyImport_ImportModule("tracemalloc")));
+  if(tracemalloc.isNull())
+    {
+      PyErr_Print();
+      throw AdaoExchangeLayerException("AdaoMemoryAccounting : fail to import tracemalloc !");
+    }
+  PyObjectRAII isTracing(PyObjectRAII::FromNew(PyObject_CallMethod(tracemalloc,"is_tracing",nullptr)));
+  if(isTracing.isNull() || !PyObject_IsTrue(isTracing))
+    {
+      PyObjectRAII res(PyObjectRAII::FromNew(PyObject_CallMethod(tracemalloc,"start",nullptr)));
+      if(res.isNull())
+        {
+          PyErr_Print();
+          throw AdaoExchangeLayerException("AdaoMemoryAccounting : fail to start tracemalloc !");
+        }
+      _tracemalloc_started = true;
+    }
+  _get_traced_memory = PyObjectRAII::FromNew(PyObject_GetAttrString(tracemalloc,"get_traced_memory"));
+}
+
+/*!
+ * Stop tracemalloc if it has been started by start : tracing slows down every python allocation of the process,
+ * and a tracing started by someone else is left untouched. Samples are kept. GIL is expected to be held by caller.
+ */
+void AdaoMemoryAccounting::stop()
+{
+  _get_traced_memory = PyObjectRAII();
+  if(!_tracemalloc_started)
+    return ;
+  _tracemalloc_started = false;
+  PyObjectRAII tracemalloc(PyObjectRAII::FromNew(PyImport_ImportModule("tracemalloc")));
+  PyObjectRAII res;
+  if(!tracemalloc.isNull())
+    res = PyObjectRAII::FromNew(PyObject_CallMethod(tracemalloc,"stop",nullptr));
+  if(res.isNull())
+    PyErr_Clear();
+}
+
+/*!
+ * GIL is expected to be held by caller.
+ */
+void AdaoMemoryAccounting::sample(PyObject *inputs, PyObject *outputs)
+{
+  AdaoMemorySample s;
+  s._batch_id = _samples.size();
+  s._nb_of_samples = inputs?std::max<Py_ssize_t>(PyObject_Length(inputs),0):0;
+  if(inputs && s._nb_of_samples==0)
+    PyErr_Clear();
+  s._rss = CurrentRSS();
+  if(!_get_traced_memory.isNull())
+    {
+      PyObjectRAII res(PyObjectRAII::FromNew(PyObject_CallObject(_get_traced_memory,nullptr)));
+      if(!res.isNull() && PyTuple_Check(res.operator PyObject *()) && PyTuple_Size(res)==2)
+        {
+          s._python_current = PyLong_AsSize_t(PyTuple_GetItem(res,0));
+          s._python_peak = PyLong_AsSize_t(PyTuple_GetItem(res,1));
+        }
+      PyErr_Clear();
+    }
+  s._input_bytes = SizeInBytesOf(inputs);
+  s._output_bytes = SizeInBytesOf(outputs);
+  _input_high_water_mark = std::max(_input_high_water_mark,s._input_bytes);
+  _output_high_water_mark = std::max(_output_high_water_mark,s._output_bytes);
+  _samples.push_back(s);
+}
+
+std::size_t AdaoMemoryAccounting::getPeakRSS() const
+{
+  std::size_t ret(0);
+  for(const auto& s : _samples)
+    ret = std::max(ret,s._rss);
+  return ret;
+}
+
+std::size_t AdaoMemoryAccounting::getPythonPeak() const
+{
+  std::size_t ret(0);
+  for(const auto& s : _samples)
+    ret = std::max(ret,s._python_peak);
+  return ret;
+}
+
+std::string AdaoMemoryAccounting::toCSV() const
+{
+  std::ostringstream oss;
+  oss << "batch,samples,rss,python_current,python_peak,input_bytes,output_bytes" << std::endl;
+  for(const auto& s : _samples)
+    oss << s._batch_id << "," << s._nb_of_samples << "," << s._rss << "," << s._python_current << "," << s._python_peak << "," << s._input_bytes << "," << s._output_bytes << std::endl;
+  return oss.str();
+}
+
+void AdaoMemoryAccounting::exportCSV(const std::string& fileName) const
+{
+  std::ofstream ofs(fileName);
+  if(!ofs)
+    throw AdaoExchangeLayerException(std::string("AdaoMemoryAccounting::exportCSV : impossible to open \"") + fileName + "\" !");
+  ofs << toCSV();
+}
+
+/*!
+ * Resident set size in bytes read in /proc/self/statm. Returns 0 if not available.
+ */
+std::size_t AdaoMemoryAccounting::CurrentRSS()
+{
+  std::ifstream ifs("/proc/self/statm");
+  std::size_t sz(0),resident(0);
+  if(!(ifs >> sz >> resident))
+    return 0;
+  return resident*(std::size_t)sysconf(_SC_PAGESIZE);
+}
+
+/*!
+ * Bytes of data held by \a obj : buffer size for numpy arrays, sum over elements for sequences, 8 for numbers.
+ * GIL is expected to be held by caller.
+ */
+std::size_t AdaoMemoryAccounting::SizeInBytesOf(PyObject *obj)
+{
+  if(!obj)
+    return 0;
+  if(PyFloat_Check(obj) || PyLong_Check(obj))
+    return sizeof(double);
+  if(PyObject_CheckBuffer(obj))
+    {
+      Py_buffer view;
+      if(PyObject_GetBuffer(obj,&view,PyBUF_SIMPLE)==0)
+        {
+          std::size_t ret(view.len);
+          PyBuffer_Release(&view);
+          return ret;
+        }
+      PyErr_Clear();
+      // non contiguous numpy array
+      PyObjectRAII nbytes(PyObjectRAII::FromNew(PyObject_GetAttrString(obj,"nbytes")));
+      if(!nbytes.isNull() && PyLong_Check(nbytes.operator PyObject *()))
+        return PyLong_AsSize_t(nbytes);
+      PyErr_Clear();
+    }
+  if(PyList_Check(obj) || PyTuple_Check(obj))
+    {
+      std::size_t ret(0);
+      Py_ssize_t len(PySequence_Fast_GET_SIZE(obj));
+      for(Py_ssize_t i=0;i<len;++i)
+        ret += SizeInBytesOf(PySequence_Fast_GET_ITEM(obj,i));
+      return ret;
+    }
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include "Python.h"
+#include "PyObjectRAII.hxx"
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/*!
+ * Memory usage sampled each time ADAO calls the observation operator (one sample per batch).
+ */
+struct AdaoMemorySample
+{
+  std::size_t _batch_id = 0;
+  std::size_t _nb_of_samples = 0;
+  //! resident set size of the process
+  std::size_t _rss = 0;
+  //! python heap traced by tracemalloc
+  std::size_t _python_current = 0;
+  std::size_t _python_peak = 0;
+  //! bytes of the batch given by ADAO and of the result given back
+  std::size_t _input_bytes = 0;
+  std::size_t _output_bytes = 0;
+};
+
+/*!
+ * Opt-in memory accounting of AdaoExchangeLayer. Samples are taken in the ADAO thread with GIL held, at the cost of
+ * a read of /proc/self/statm and a call to tracemalloc.get_traced_memory.
+ */
+class AdaoMemoryAccounting
+{
+public:
+  ~AdaoMemoryAccounting();
+  void start();
+  void stop();
+  void sample(PyObject *inputs, PyObject *outputs);
+  const std::vector<AdaoMemorySample>& getSamples() const { return _samples; }
+  std::size_t getPeakRSS() const;
+  std::size_t getPythonPeak() const;
+  std::size_t getInputHighWaterMark() const { return _input_high_water_mark; }
+  std::size_t getOutputHighWaterMark() const { return _output_high_water_mark; }
+  std::string toCSV() const;
+  void exportCSV(const std::string& fileName) const;
+  static std::size_t CurrentRSS();
+  static std::size_t SizeInBytesOf(PyObject *obj);
+private:
+  PyObjectRAII _get_traced_memory;
+  //! tracemalloc has been started by start (and not by someone else) : stopped by stop
+  bool _tracemalloc_started = false;
+  std::vector<AdaoMemorySample> _samples;
+  std::size_t _input_high_water_mark = 0;
+  std::size_t _output_high_water_mark = 0;
+};
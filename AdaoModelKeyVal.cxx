@@ -35,12 +35,26 @@ const char StoreSupplKeyVal::KEY[]="StoreSupplementaryCalculations";
 
 const char *StoreSupplKeyVal::DFTL[]={"CostFunctionJAtCurrentOptimum","CostFunctionJoAtCurrentOptimum","CurrentOptimum","SimulatedObservationAtCurrentOptimum","SimulatedObservationAtOptimum"};
 
+// 4DVAR does not compute simulated observations
+const char *StoreSupplKeyVal::DFTL_FOUR_D_VAR[]={"CostFunctionJAtCurrentOptimum","CostFunctionJoAtCurrentOptimum","CurrentOptimum"};
+
+// sampling tasks store one value per sample
+const char *StoreSupplKeyVal::DFTL_SAMPLING_TEST[]={"CostFunctionJ","CostFunctionJb","CostFunctionJo"};
+
+const char *StoreSupplKeyVal::DFTL_ENSEMBLE_OF_SIMULATION_GENERATION[]={"EnsembleOfSimulations"};
+
 const char EnumAlgoKeyVal::KEY[]="Algorithm";
 
 const char ParametersOfAlgorithmParameters::KEY[]="Parameters";
 
 const char Bounds::KEY[]="Bounds";
 
+const char SampleAsnUplet::KEY[]="SampleAsnUplet";
+
+const char SampleAsExplicitHyperCube::KEY[]="SampleAsExplicitHyperCube";
+
+const char SampleAsMinMaxStepHyperCube::KEY[]="SampleAsMinMaxStepHyperCube";
+
 const char MaximumNumberOfSteps::KEY[]="MaximumNumberOfSteps";
 
 const char VectorBackground::KEY[]="Vector";
@@ -53,8 +67,12 @@ const char ScalarSparseMatrixError::KEY[]="ScalarSparseMatrix";
 
 const char DiagonalSparseMatrixError::KEY[]="DiagonalSparseMatrix";
 
+const char ObjectMatrixError::KEY[]="ObjectMatrix";
+
 const char OneFunction::KEY[]="OneFunction";
 
+const char ThreeFunctions::KEY[]="ThreeFunctions";
+
 const char DifferentialIncrement::KEY[]="DifferentialIncrement";
 
 const char ObservationOperatorParameters::KEY[]="Parameters";
@@ -63,6 +81,8 @@ const char CenteredFiniteDifference::KEY[]="CenteredFiniteDifference";
 
 const char InputFunctionAsMulti::KEY[]="InputFunctionAsMulti";
 
+const char VectorSerieObservation::KEY[]="VectorSerie";
+
 const char VariableKV::KEY[]="Variable";
 
 const char TemplateKV::KEY[]="Template";
@@ -83,6 +103,8 @@ const char Observation::KEY[]="Observation";
 
 const double ObservationError::BACKGROUND_SCALAR_SPARSE_DFT = 1.;
 
+const char EvolutionModel::KEY[]="EvolutionModel";
+
 const char ObserverEntry::KEY[]="Observer";
 
 std::string TopEntry::getParamForSet(const GenericKeyVal& entry) const
@@ -154,6 +176,11 @@ StoreSupplKeyVal::StoreSupplKeyVal():ListStringsKeyVal(KEY)
   _val.insert(_val.end(),DFTL,DFTL+sizeof(DFTL)/sizeof(char *));
 }
 
+StoreSupplKeyVal::StoreSupplKeyVal(const std::vector< std::string >& val):ListStringsKeyVal(KEY)
+{
+  _val = val;
+}
+
 std::shared_ptr<DictKeyVal> EnumAlgoKeyVal::generateDftParameters() const
 {
   switch(_enum)
@@ -168,6 +195,18 @@ std::shared_ptr<DictKeyVal> EnumAlgoKeyVal::generateDftParameters() const
       {
         return templateForBlue();
       }
+    case EnumAlgo::FourDVar:
+      {
+        return templateForFourDVar();
+      }
+    case EnumAlgo::SamplingTest:
+      {
+        return templateForSampling(std::vector< std::string >(StoreSupplKeyVal::DFTL_SAMPLING_TEST,StoreSupplKeyVal::DFTL_SAMPLING_TEST+sizeof(StoreSupplKeyVal::DFTL_SAMPLING_TEST)/sizeof(char *)));
+      }
+    case EnumAlgo::EnsembleOfSimulationGenerationTask:
+      {
+        return templateForSampling(std::vector< std::string >(StoreSupplKeyVal::DFTL_ENSEMBLE_OF_SIMULATION_GENERATION,StoreSupplKeyVal::DFTL_ENSEMBLE_OF_SIMULATION_GENERATION+sizeof(StoreSupplKeyVal::DFTL_ENSEMBLE_OF_SIMULATION_GENERATION)/sizeof(char *)));
+      }
     default:
       throw AdaoExchangeLayerException("EnumAlgoKeyVal::generateDftParameters : Unrecognized Algo !");
     }
@@ -185,6 +224,12 @@ std::string EnumAlgoKeyVal::getRepresentation() const
       return "LinearLeastSquares";
     case EnumAlgo::Blue:
       return "Blue";
+    case EnumAlgo::FourDVar:
+      return "4DVAR";
+    case EnumAlgo::SamplingTest:
+      return "SamplingTest";
+    case EnumAlgo::EnsembleOfSimulationGenerationTask:
+      return "EnsembleOfSimulationGenerationTask";
     default:
       throw AdaoExchangeLayerException("EnumAlgoKeyVal::getRepresentation : Unrecognized Algo !");
     }
@@ -219,6 +264,38 @@ std::shared_ptr<DictKeyVal> EnumAlgoKeyVal::templateForOthers() const
   return ret;
 }
 
+std::shared_ptr<DictKeyVal> EnumAlgoKeyVal::templateForFourDVar() const
+{
+  std::shared_ptr<DictKeyVal> ret(std::make_shared<ParametersOfAlgorithmParameters>());
+  std::shared_ptr<Bounds> v0(std::make_shared<Bounds>());
+  std::shared_ptr<MaximumNumberOfSteps> v1(std::make_shared<MaximumNumberOfSteps>());
+  std::shared_ptr<CostDecrementTolerance> v2(std::make_shared<CostDecrementTolerance>());
+  std::vector< std::string > storeSuppl(StoreSupplKeyVal::DFTL_FOUR_D_VAR,StoreSupplKeyVal::DFTL_FOUR_D_VAR+sizeof(StoreSupplKeyVal::DFTL_FOUR_D_VAR)/sizeof(char *));
+  std::shared_ptr<StoreSupplKeyVal> v3(std::make_shared<StoreSupplKeyVal>(storeSuppl));
+  ret->pushBack(std::static_pointer_cast<GenericKeyVal>(v0));
+  ret->pushBack(std::static_pointer_cast<GenericKeyVal>(v1));
+  ret->pushBack(std::static_pointer_cast<GenericKeyVal>(v2));
+  ret->pushBack(std::static_pointer_cast<GenericKeyVal>(v3));
+  return ret;
+}
+
+/*!
+ * Only the sampling key set (one of SampleAsnUplet, SampleAsExplicitHyperCube and SampleAsMinMaxStepHyperCube) is emitted.
+ */
+std::shared_ptr<DictKeyVal> EnumAlgoKeyVal::templateForSampling(const std::vector< std::string >& storeSuppl) const
+{
+  std::shared_ptr<DictKeyVal> ret(std::make_shared<ParametersOfAlgorithmParameters>());
+  std::shared_ptr<SampleAsnUplet> v0(std::make_shared<SampleAsnUplet>());
+  std::shared_ptr<SampleAsExplicitHyperCube> v1(std::make_shared<SampleAsExplicitHyperCube>());
+  std::shared_ptr<SampleAsMinMaxStepHyperCube> v2(std::make_shared<SampleAsMinMaxStepHyperCube>());
+  std::shared_ptr<StoreSupplKeyVal> v3(std::make_shared<StoreSupplKeyVal>(storeSuppl));
+  ret->pushBack(std::static_pointer_cast<GenericKeyVal>(v0));
+  ret->pushBack(std::static_pointer_cast<GenericKeyVal>(v1));
+  ret->pushBack(std::static_pointer_cast<GenericKeyVal>(v2));
+  ret->pushBack(std::static_pointer_cast<GenericKeyVal>(v3));
+  return ret;
+}
+
 std::string DictKeyVal::pyStr() const
 {
   std::vector<std::string> vect;
@@ -302,6 +379,26 @@ AlgorithmParameters::AlgorithmParameters():DictKeyVal(KEY)
   _pairs.push_back(std::static_pointer_cast<GenericKeyVal,DictKeyVal>(v1));
 }
 
+EnumAlgo AlgorithmParameters::getAlgo() const
+{
+  EnumAlgoKeyVal *algo(dynamic_cast<EnumAlgoKeyVal *>(_pairs[0].get()));
+  if(!algo)
+    throw AdaoExchangeLayerException("AlgorithmParameters::getAlgo : algorithm not found !");
+  return algo->getVal();
+}
+
+/*!
+ * Contrary to a direct change of the EnumAlgoKeyVal, Parameters are replaced by the default ones of \a algo.
+ */
+void AlgorithmParameters::setAlgo(EnumAlgo algo)
+{
+  EnumAlgoKeyVal *algoKV(dynamic_cast<EnumAlgoKeyVal *>(_pairs[0].get()));
+  if(!algoKV)
+    throw AdaoExchangeLayerException("AlgorithmParameters::setAlgo : algorithm not found !");
+  algoKV->setVal(algo);
+  _pairs[1] = std::static_pointer_cast<GenericKeyVal,DictKeyVal>(algoKV->generateDftParameters());
+}
+
 Background::Background():DictKeyVal(KEY)
 {
   std::shared_ptr<VectorBackground> v0(std::make_shared<VectorBackground>());
@@ -319,6 +416,22 @@ GenericError::GenericError(const std::string& key, double dftValForScalarSparseM
   _pairs.push_back(std::static_pointer_cast<GenericKeyVal,MatrixBackgroundError>(v0));
   _pairs.push_back(std::static_pointer_cast<GenericKeyVal,ScalarSparseMatrixError>(v1));
   _pairs.push_back(std::static_pointer_cast<GenericKeyVal,DiagonalSparseMatrixError>(v2));
+  std::shared_ptr<ObjectMatrixError> v3(std::make_shared<ObjectMatrixError>());
+  _pairs.push_back(std::static_pointer_cast<GenericKeyVal,ObjectMatrixError>(v3));
+}
+
+/*!
+ * ADAO gives precedence to ScalarSparseMatrix, always emitted : ObjectMatrix, when set, is emitted alone.
+ */
+std::string GenericError::pyStr() const
+{
+  for(const auto& elt : _pairs)
+    {
+      ObjectMatrixError *obj(dynamic_cast<ObjectMatrixError *>(elt.get()));
+      if(obj && !obj->pyStr().empty())
+        return std::string("{ ") + obj->pyStrKeyVal() + " }";
+    }
+  return DictKeyVal::pyStr();
 }
 
 Observation::Observation():DictKeyVal(KEY)
@@ -328,6 +441,43 @@ Observation::Observation():DictKeyVal(KEY)
   v1->setVal(false);
   _pairs.push_back(std::static_pointer_cast<GenericKeyVal,VectorBackground>(v0));
   _pairs.push_back(std::static_pointer_cast<GenericKeyVal,StoreBackground>(v1));
+  std::shared_ptr<VectorSerieObservation> v2(std::make_shared<VectorSerieObservation>());
+  _pairs.push_back(std::static_pointer_cast<GenericKeyVal,VectorSerieObservation>(v2));
+}
+
+/*!
+ * ADAO accepts only one of Vector and VectorSerie : VectorSerie, when set, replaces Vector.
+ */
+std::string Observation::pyStr() const
+{
+  bool serieIsSet(false);
+  for(const auto& elt : _pairs)
+    {
+      VectorSerieObservation *obj(dynamic_cast<VectorSerieObservation *>(elt.get()));
+      if(obj && !obj->pyStr().empty())
+        serieIsSet = true;
+    }
+  if(!serieIsSet)
+    return DictKeyVal::pyStr();
+  std::vector<std::string> vect;
+  for(const auto& elt : _pairs)
+    {
+      if(dynamic_cast<VectorBackground *>(elt.get()))
+        continue;
+      std::string cont(elt->pyStrKeyVal());
+      if( ! cont.empty() )
+        vect.push_back(cont);
+    }
+  std::ostringstream oss;
+  oss << "{ ";
+  for(std::size_t i=0;i<vect.size();++i)
+    {
+      oss << vect[i];
+      if(i!=vect.size()-1)
+        oss << ", ";
+    }
+  oss << " }";
+  return oss.str();
 }
 
 ObservationOperator::ObservationOperator():DictKeyVal(KEY)
@@ -336,10 +486,22 @@ ObservationOperator::ObservationOperator():DictKeyVal(KEY)
   std::shared_ptr<MatrixBackgroundError> v1(std::make_shared<MatrixBackgroundError>());
   std::shared_ptr<ObservationOperatorParameters> v2(std::make_shared<ObservationOperatorParameters>());
   std::shared_ptr<InputFunctionAsMulti> v3(std::make_shared<InputFunctionAsMulti>());
+  std::shared_ptr<ThreeFunctions> v4(std::make_shared<ThreeFunctions>());
   _pairs.push_back(std::static_pointer_cast<GenericKeyVal,OneFunction>(v0));
   _pairs.push_back(std::static_pointer_cast<GenericKeyVal,MatrixBackgroundError>(v1));
   _pairs.push_back(std::static_pointer_cast<GenericKeyVal,ObservationOperatorParameters>(v2));
   _pairs.push_back(std::static_pointer_cast<GenericKeyVal,InputFunctionAsMulti>(v3));
+  _pairs.push_back(std::static_pointer_cast<GenericKeyVal,ThreeFunctions>(v4));
+}
+
+EvolutionModel::EvolutionModel():DictKeyVal(KEY)
+{
+  std::shared_ptr<OneFunction> v0(std::make_shared<OneFunction>());
+  std::shared_ptr<ObservationOperatorParameters> v1(std::make_shared<ObservationOperatorParameters>());
+  std::shared_ptr<InputFunctionAsMulti> v2(std::make_shared<InputFunctionAsMulti>());
+  _pairs.push_back(std::static_pointer_cast<GenericKeyVal,OneFunction>(v0));
+  _pairs.push_back(std::static_pointer_cast<GenericKeyVal,ObservationOperatorParameters>(v1));
+  _pairs.push_back(std::static_pointer_cast<GenericKeyVal,InputFunctionAsMulti>(v2));
 }
 
 ObserverEntry::ObserverEntry():DictKeyVal(KEY)
@@ -360,6 +522,7 @@ MainModel::MainModel():_algo(std::make_shared<AlgorithmParameters>()),
     _obs(std::make_shared<Observation>()),
     _obs_err(std::make_shared<ObservationError>()),
     _observ_op(std::make_shared<ObservationOperator>()),
+    _evol_model(std::make_shared<EvolutionModel>()),
     _observ_entry(std::make_shared<ObserverEntry>())
 {
 }
@@ -375,6 +538,8 @@ std::string MainModel::pyStr() const
   oss << _obs->getParamForSet(*_obs) << std::endl;
   oss << _obs_err->getParamForSet(*_obs_err) << std::endl;
   oss << _observ_op->getParamForSet(*_observ_op) << std::endl;
+  if(isEvolutionModelNeeded())
+    oss << _evol_model->getParamForSet(*_evol_model) << std::endl;
   oss << _observ_entry->getParamForSet(*_observ_entry) << std::endl;
   return oss.str();
 }
@@ -388,6 +553,7 @@ std::vector< std::shared_ptr<GenericKeyVal> > MainModel::toVect() const
         std::static_pointer_cast<GenericKeyVal,Observation>(_obs),
         std::static_pointer_cast<GenericKeyVal,ObservationError>(_obs_err),
         std::static_pointer_cast<GenericKeyVal,ObservationOperator>(_observ_op),
+        std::static_pointer_cast<GenericKeyVal,EvolutionModel>(_evol_model),
         std::static_pointer_cast<GenericKeyVal,ObserverEntry>(_observ_entry)
   };
 }
@@ -439,6 +605,54 @@ std::string MainModel::findPathOf(GenericKeyVal *elt)
   return vis.getPath();
 }
 
+class MyFindByPathVisitor : public RecursiveVisitor
+{
+public:
+  MyFindByPathVisitor(const std::string& path):_path_to_find(path) { }
+  void visit(GenericKeyVal *elt) override
+      {
+      if(_found) return ;
+      if(currentPath(elt->getKey())==_path_to_find)
+        _found = elt;
+      }
+  void enterSubDir(DictKeyVal *subdir) override
+      {
+      if(_found) return ;
+      if(currentPath(subdir->getKey())==_path_to_find)
+        _found = subdir;
+      _path.push_back(subdir->getKey());
+      }
+  void exitSubDir(DictKeyVal *subdir) override
+      {
+      if(_found) return ;
+      _path.pop_back();
+      }
+  GenericKeyVal *getFound() const { return _found; }
+private:
+  std::string currentPath(const std::string& key) const
+  {
+    std::ostringstream oss;
+    for(auto elt : _path)
+      oss << elt << "/";
+    oss << key;
+    return oss.str();
+  }
+private:
+  std::string _path_to_find;
+  std::vector<std::string> _path;
+  GenericKeyVal *_found = nullptr;
+};
+
+/*!
+ * Reverse of findPathOf. Returns nullptr if no element is at \a path (for example "Background/Vector").
+ */
+GenericKeyVal *MainModel::findByPath(const std::string& path)
+{
+  MyFindByPathVisitor vis(path);
+  this->visitAll(&vis);
+  return vis.getFound();
+}
+
 void MainModel::visitPythonLeaves(PythonLeafVisitor *visitor)
 {
   std::vector< std::shared_ptr<GenericKeyVal> > sons(toVect());
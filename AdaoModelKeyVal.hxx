@@ -46,7 +46,24 @@ namespace AdaoModel
       ThreeDVar,
       Blue,
       NonLinearLeastSquares,
-      LinearLeastSquares
+      LinearLeastSquares,
+      FourDVar,
+      SamplingTest,
+      EnsembleOfSimulationGenerationTask
+  };
+
+  enum class EnumEngine
+  {
+      Python,
+      Native,
+      OutOfProcess
+  };
+
+  enum class EnumJacobianMode
+  {
+      FiniteDifferences,
+      Broyden,
+      Exact
   };
 
   class GenericKeyVal;
@@ -167,6 +184,7 @@ namespace AdaoModel
   public:
     Type getType() const override { return Type::ListStrings; }
     std::string pyStr() const override;
+    const std::vector< std::string >& getVal() const { return _val; }
   protected:
     std::vector< std::string > _val;
   };
@@ -175,8 +193,12 @@ namespace AdaoModel
   {
   public:
     StoreSupplKeyVal();
+    StoreSupplKeyVal(const std::vector< std::string >& val);
   public:
     static const char *DFTL[];
+    static const char *DFTL_FOUR_D_VAR[];
+    static const char *DFTL_SAMPLING_TEST[];
+    static const char *DFTL_ENSEMBLE_OF_SIMULATION_GENERATION[];
     static const char KEY[];
   };
 
@@ -195,6 +217,8 @@ namespace AdaoModel
   private:
     std::shared_ptr<DictKeyVal> templateForBlue() const;
     std::shared_ptr<DictKeyVal> templateForOthers() const;
+    std::shared_ptr<DictKeyVal> templateForFourDVar() const;
+    std::shared_ptr<DictKeyVal> templateForSampling(const std::vector< std::string >& storeSuppl) const;
   private:
     static const char KEY[];
     EnumAlgo _enum;
@@ -231,6 +255,7 @@ namespace AdaoModel
     PyObject *getVal() const { return _val; }
     std::string pyStr() const;
     void setVarName(const std::string& vn) { _var_name = vn; }
+    const std::string& getVarName() const { return _var_name; }
     void visitPython(MainModel *godFather, PythonLeafVisitor *visitor) override;
   private:
     PyObjectRAII _val;
@@ -305,6 +330,18 @@ namespace AdaoModel
     static const char KEY[];
   };
 
+  /*!
+   * Covariance given as an operator object, see AdaoExchangeLayer::setCovarianceOperatorInModel.
+   * When set, it is the only entry of GenericError emitted by pyStr.
+   */
+  class ObjectMatrixError : public PyObjKeyVal
+  {
+  public:
+    ObjectMatrixError():PyObjKeyVal(KEY) { }
+  public:
+    static const char KEY[];
+  };
+
   class OneFunction : public PyObjKeyVal
   {
   public:
@@ -313,6 +350,14 @@ namespace AdaoModel
     static const char KEY[];
   };
 
+  class ThreeFunctions : public PyObjKeyVal
+  {
+  public:
+    ThreeFunctions():PyObjKeyVal(KEY) { }
+  public:
+    static const char KEY[];
+  };
+
   class DifferentialIncrement : public DoubleKeyVal
   {
   public:
@@ -321,6 +366,50 @@ namespace AdaoModel
     static const char KEY[];
   };
 
+  /*!
+   * Time series of observations (one vector per time step), used by 4DVAR. When set, it is emitted instead of Vector.
+   */
+  class VectorSerieObservation : public PyObjKeyVal
+  {
+  public:
+    VectorSerieObservation():PyObjKeyVal(KEY) { }
+  public:
+    static const char KEY[];
+  };
+
+  /*!
+   * Samples of a sampling task given one by one (list of states).
+   */
+  class SampleAsnUplet : public PyObjKeyVal
+  {
+  public:
+    SampleAsnUplet():PyObjKeyVal(KEY) { }
+  public:
+    static const char KEY[];
+  };
+
+  /*!
+   * Samples of a sampling task as the cartesian product of the values given for each state component (list of lists).
+   */
+  class SampleAsExplicitHyperCube : public PyObjKeyVal
+  {
+  public:
+    SampleAsExplicitHyperCube():PyObjKeyVal(KEY) { }
+  public:
+    static const char KEY[];
+  };
+
+  /*!
+   * Same as SampleAsExplicitHyperCube, values of each state component being given by a [min,max,step] triplet.
+   */
+  class SampleAsMinMaxStepHyperCube : public PyObjKeyVal
+  {
+  public:
+    SampleAsMinMaxStepHyperCube():PyObjKeyVal(KEY) { }
+  public:
+    static const char KEY[];
+  };
+
   class ObservationOperatorParameters : public DictKeyVal
   {
   public:
@@ -368,6 +457,8 @@ namespace AdaoModel
   {
   public:
     AlgorithmParameters();
+    EnumAlgo getAlgo() const;
+    void setAlgo(EnumAlgo algo);
   public:
     static const char KEY[];
   };
@@ -382,6 +473,8 @@ namespace AdaoModel
 
   class GenericError : public DictKeyVal, public TopEntry
   {
+  public:
+    std::string pyStr() const override;
   protected:
     GenericError(const std::string& key, double dftValForScalarSparseMatrix);
   };
@@ -416,6 +509,18 @@ namespace AdaoModel
   {
   public:
     Observation();
+    std::string pyStr() const override;
+  public:
+    static const char KEY[];
+  };
+
+  /*!
+   * Model of one time step, used by 4DVAR only. Called by ADAO like ObservationOperator, with a list of states.
+   */
+  class EvolutionModel : public DictKeyVal, public TopEntry
+  {
+  public:
+    EvolutionModel();
   public:
     static const char KEY[];
   };
@@ -451,17 +556,33 @@ namespace AdaoModel
   public:
     MainModel();
     std::string findPathOf(GenericKeyVal *elt);
+    GenericKeyVal *findByPath(const std::string& path);
     std::string pyStr() const;
     std::vector< std::shared_ptr<GenericKeyVal> > toVect() const;
     void visitPythonLeaves(PythonLeafVisitor *visitor);
     void visitAll(RecursiveVisitor *visitor);
+    void setAlgorithm(EnumAlgo algo) { _algo->setAlgo(algo); }
+    EnumAlgo getAlgorithm() const { return _algo->getAlgo(); }
+    bool isEvolutionModelNeeded() const { return getAlgorithm()==EnumAlgo::FourDVar; }
+    bool isSamplingTask() const { return IsSamplingTask(getAlgorithm()); }
+    static bool IsSamplingTask(EnumAlgo algo) { return algo==EnumAlgo::SamplingTest || algo==EnumAlgo::EnsembleOfSimulationGenerationTask; }
+    void setEngine(EnumEngine engine) { _engine = engine; }
+    EnumEngine getEngine() const { return _engine; }
+    void setJacobianMode(EnumJacobianMode mode) { _jacobian_mode = mode; }
+    EnumJacobianMode getJacobianMode() const { return _jacobian_mode; }
+    void setBroydenTolerance(double tol) { _broyden_tolerance = tol; }
+    double getBroydenTolerance() const { return _broyden_tolerance; }
   private:
+    EnumEngine _engine = EnumEngine::Python;
+    EnumJacobianMode _jacobian_mode = EnumJacobianMode::FiniteDifferences;
+    double _broyden_tolerance = 0.1;
     std::shared_ptr<AlgorithmParameters> _algo;
     std::shared_ptr<Background> _bg;
     std::shared_ptr<BackgroundError> _bg_err;
     std::shared_ptr<Observation> _obs;
     std::shared_ptr<ObservationError> _obs_err;
     std::shared_ptr<ObservationOperator> _observ_op;
+    std::shared_ptr<EvolutionModel> _evol_model;
     std::shared_ptr<ObserverEntry> _observ_entry;
   };
 }
@@ -0,0 +1,281 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#include "AdaoMpiEvaluator.hxx"
+
+#include <sstream>
+#include <string>
+
+enum AdaoMpiTag
+{
+  TAG_SAMPLE = 4401,
+  TAG_RESULT,
+  TAG_ERROR,
+  TAG_STOP
+};
+
+//! header broadcast by a leader to its worker before each evaluation : {command, inputSize, outputSize}
+enum AdaoMpiCommand
+{
+  COMMAND_EVALUATE,
+  COMMAND_STOP
+};
+
+static void CheckMpi(int ret, const char *what)
+{
+  if(ret!=MPI_SUCCESS)
+    {
+      char msg[MPI_MAX_ERROR_STRING]; int len(0);
+      MPI_Error_string(ret,msg,&len);
+      throw AdaoExchangeLayerException(std::string("AdaoMpiEvaluator : ") + what + " has failed : " + std::string(msg,len) + " !");
+    }
+}
+
+AdaoMpiEvaluator::AdaoMpiEvaluator(MPI_Comm comm, int ranksPerWorker):_ranks_per_worker(ranksPerWorker)
+{
+  int size(0);
+  CheckMpi(MPI_Comm_dup(comm,&_comm),"MPI_Comm_dup");
+  MPI_Comm_rank(_comm,&_rank);
+  MPI_Comm_size(_comm,&size);
+  if(ranksPerWorker<1 || size<2 || (size-1)%ranksPerWorker!=0)
+    {
+      MPI_Comm_free(&_comm);
+      std::ostringstream oss; oss << "AdaoMpiEvaluator : " << size << " ranks can't be split into master and workers of " << ranksPerWorker << " ranks !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+  for(int i=1;i<size;i+=ranksPerWorker)
+    _leaders.push_back(i);
+  int color(_rank==0?MPI_UNDEFINED:(_rank-1)/ranksPerWorker);
+  CheckMpi(MPI_Comm_split(_comm,color,_rank,&_worker_comm),"MPI_Comm_split");
+}
+
+AdaoMpiEvaluator::~AdaoMpiEvaluator()
+{
+  int finalized(0);
+  MPI_Finalized(&finalized);
+  if(finalized)
+    return ;
+  if(isMaster() && !_stopped)
+    stopWorkers();
+  if(_worker_comm!=MPI_COMM_NULL)
+    MPI_Comm_free(&_worker_comm);
+  MPI_Comm_free(&_comm);
+}
+
+/*!
+ * Master only. Samples are sent one by one, each worker having at most one sample in progress.
+ * If evaluator of a worker throws, remaining samples are still computed and an AdaoExchangeLayerException is thrown at the end.
+ */
+void AdaoMpiEvaluator::evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs)
+{
+  if(!isMaster())
+    throw AdaoExchangeLayerException("AdaoMpiEvaluator::evaluate : to be called by rank 0 only, other ranks have to call serve !");
+  if(_stopped)
+    throw AdaoExchangeLayerException("AdaoMpiEvaluator::evaluate : workers have been stopped !");
+  // sample is sent as {sample id, outputSize, inputs...}
+  std::vector< std::vector<double> > sendBuffers(_leaders.size());
+  std::vector<MPI_Request> sendRequests(_leaders.size(),MPI_REQUEST_NULL);
+  std::vector<std::size_t> inProgress(_leaders.size());
+  std::size_t nextSample(0),nbOfResults(0);
+  std::string error;
+  auto sendNextSample=[&](std::size_t workerId)
+    {
+      MPI_Wait(&sendRequests[workerId],MPI_STATUS_IGNORE);
+      std::vector<double>& buf(sendBuffers[workerId]);
+      buf.resize(2+inputSize);
+      buf[0] = (double)nextSample; buf[1] = (double)outputSize;
+      std::copy(inputs+nextSample*inputSize,inputs+(nextSample+1)*inputSize,buf.begin()+2);
+      CheckMpi(MPI_Isend(buf.data(),(int)buf.size(),MPI_DOUBLE,_leaders[workerId],TAG_SAMPLE,_comm,&sendRequests[workerId]),"MPI_Isend");
+      inProgress[workerId] = nextSample++;
+    };
+  for(std::size_t i=0;i<_leaders.size() && nextSample<nbOfSamples;++i)
+    sendNextSample(i);
+  while(nbOfResults<nbOfSamples)
+    {
+      MPI_Status status;
+      CheckMpi(MPI_Probe(MPI_ANY_SOURCE,MPI_ANY_TAG,_comm,&status),"MPI_Probe");
+      std::size_t workerId((status.MPI_SOURCE-1)/_ranks_per_worker);
+      std::size_t sampleId(inProgress[workerId]);
+      if(status.MPI_TAG==TAG_RESULT)
+        CheckMpi(MPI_Recv(outputs+sampleId*outputSize,(int)outputSize,MPI_DOUBLE,status.MPI_SOURCE,TAG_RESULT,_comm,MPI_STATUS_IGNORE),"MPI_Recv");
+      else
+        {
+          int len(0);
+          MPI_Get_count(&status,MPI_CHAR,&len);
+          std::string msg(len,'\0');
+          CheckMpi(MPI_Recv(&msg[0],len,MPI_CHAR,status.MPI_SOURCE,TAG_ERROR,_comm,MPI_STATUS_IGNORE),"MPI_Recv");
+          if(error.empty())
+            {
+              std::ostringstream oss; oss << "AdaoMpiEvaluator : evaluation of sample #" << sampleId << " on rank " << status.MPI_SOURCE << " has failed : " << msg;
+              error = oss.str();
+            }
+        }
+      ++nbOfResults;
+      if(nextSample<nbOfSamples)
+        sendNextSample(workerId);
+    }
+  MPI_Waitall((int)sendRequests.size(),sendRequests.data(),MPI_STATUSES_IGNORE);
+  if(!error.empty())
+    throw AdaoExchangeLayerException(error);
+}
+
+/*!
+ * Master only. Make serve return on all workers. Called by destructor if needed.
+ */
+void AdaoMpiEvaluator::stopWorkers()
+{
+  if(!isMaster() || _stopped)
+    return ;
+  for(int leader : _leaders)
+    MPI_Send(nullptr,0,MPI_DOUBLE,leader,TAG_STOP,_comm);
+  _stopped = true;
+}
+
+/*!
+ * Worker ranks only. Evaluate samples sent by master with \a evaluator until master calls stopWorkers.
+ */
+void AdaoMpiEvaluator::serve(AdaoEvaluator *evaluator)
+{
+  if(isMaster())
+    throw AdaoExchangeLayerException("AdaoMpiEvaluator::serve : to be called by worker ranks only !");
+  int rankInWorker(0);
+  MPI_Comm_rank(_worker_comm,&rankInWorker);
+  if(rankInWorker==0)
+    serveAsLeader(evaluator);
+  else
+    serveAsFollower(evaluator);
+}
+
+void AdaoMpiEvaluator::serveAsLeader(AdaoEvaluator *evaluator)
+{
+  std::vector<double> buf,output;
+  while(true)
+    {
+      MPI_Status status;
+      CheckMpi(MPI_Probe(0,MPI_ANY_TAG,_comm,&status),"MPI_Probe");
+      if(status.MPI_TAG==TAG_STOP)
+        {
+          MPI_Recv(nullptr,0,MPI_DOUBLE,0,TAG_STOP,_comm,MPI_STATUS_IGNORE);
+          unsigned long long header[3]={COMMAND_STOP,0,0};
+          MPI_Bcast(header,3,MPI_UNSIGNED_LONG_LONG,0,_worker_comm);
+          return ;
+        }
+      int len(0);
+      MPI_Get_count(&status,MPI_DOUBLE,&len);
+      buf.resize(len);
+      CheckMpi(MPI_Recv(buf.data(),len,MPI_DOUBLE,0,TAG_SAMPLE,_comm,MPI_STATUS_IGNORE),"MPI_Recv");
+      std::size_t inputSize(len-2),outputSize((std::size_t)buf[1]);
+      unsigned long long header[3]={COMMAND_EVALUATE,inputSize,outputSize};
+      MPI_Bcast(header,3,MPI_UNSIGNED_LONG_LONG,0,_worker_comm);
+      MPI_Bcast(buf.data()+2,(int)inputSize,MPI_DOUBLE,0,_worker_comm);
+      output.resize(outputSize);
+      std::string error;
+      try
+        {
+          evaluator->evaluate(1,inputSize,buf.data()+2,outputSize,output.data());
+        }
+      catch(AdaoExchangeLayerException& e)
+        {
+          error = e.what();
+        }
+      catch(std::exception& e)
+        {
+          error = e.what();
+        }
+      catch(...)
+        {
+          error = "unknown exception";
+        }
+      error = gatherWorkerErrors(error);
+      if(error.empty())
+        MPI_Send(output.data(),(int)outputSize,MPI_DOUBLE,0,TAG_RESULT,_comm);
+      else
+        MPI_Send(error.data(),(int)error.size(),MPI_CHAR,0,TAG_ERROR,_comm);
+    }
+}
+
+void AdaoMpiEvaluator::serveAsFollower(AdaoEvaluator *evaluator)
+{
+  std::vector<double> input,output;
+  while(true)
+    {
+      unsigned long long header[3];
+      MPI_Bcast(header,3,MPI_UNSIGNED_LONG_LONG,0,_worker_comm);
+      if(header[0]==COMMAND_STOP)
+        return ;
+      input.resize(header[1]); output.resize(header[2]);
+      MPI_Bcast(input.data(),(int)input.size(),MPI_DOUBLE,0,_worker_comm);
+      std::string error;
+      try
+        {// only the result of the leader is sent to master
+          evaluator->evaluate(1,input.size(),input.data(),output.size(),output.data());
+        }
+      catch(AdaoExchangeLayerException& e)
+        {
+          error = e.what();
+        }
+      catch(std::exception& e)
+        {
+          error = e.what();
+        }
+      catch(...)
+        {
+          error = "unknown exception";
+        }
+      gatherWorkerErrors(error);
+    }
+}
+
+/*!
+ * Collective over the ranks of a worker after each evaluation. Returns on the leader the errors of all the ranks of the worker,
+ * empty if none has failed, so that a failure of a follower reaches master too. Returns an empty string on followers.
+ */
+std::string AdaoMpiEvaluator::gatherWorkerErrors(const std::string& error)
+{
+  int rankInWorker(0),size(0);
+  MPI_Comm_rank(_worker_comm,&rankInWorker);
+  MPI_Comm_size(_worker_comm,&size);
+  int len((int)error.size());
+  std::vector<int> lens(size),displs(size);
+  CheckMpi(MPI_Gather(&len,1,MPI_INT,lens.data(),1,MPI_INT,0,_worker_comm),"MPI_Gather");
+  std::string all;
+  if(rankInWorker==0)
+    {
+      int total(0);
+      for(int i=0;i<size;++i)
+        {
+          displs[i] = total;
+          total += lens[i];
+        }
+      all.resize(total);
+    }
+  CheckMpi(MPI_Gatherv(error.data(),len,MPI_CHAR,&all[0],lens.data(),displs.data(),MPI_CHAR,0,_worker_comm),"MPI_Gatherv");
+  if(rankInWorker!=0)
+    return std::string();
+  std::ostringstream oss;
+  for(int i=0;i<size;++i)
+    if(lens[i]>0)
+      {
+        if(oss.tellp()>0)
+          oss << " ; ";
+        oss << "rank " << _rank+i << " : " << all.substr(displs[i],lens[i]);
+      }
+  return oss.str();
+}
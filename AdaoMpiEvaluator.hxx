@@ -0,0 +1,66 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include "AdaoEvaluator.hxx"
+
+#include <mpi.h>
+
+#include <string>
+#include <vector>
+
+/*!
+ * Evaluator spreading samples over the ranks of a communicator. Rank 0 (master) calls evaluate, typically as the evaluator of
+ * push mode (see AdaoExchangeLayer::setEvaluatorInModel) or of the native engine. Other ranks are grouped by \a ranksPerWorker
+ * into workers calling serve.
+ *
+ * Balancing is dynamic : each worker receives a new sample as soon as it sends back the result of the previous one.
+ * Results are received directly in the output buffer given to evaluate.
+ * All ranks of a worker call the evaluator given to serve with the same sample. Its MPI code has to use getWorkerCommunicator.
+ * An exception thrown on any rank of a worker is reported to master, which throws it from evaluate.
+ *
+ * Constructor is collective over \a comm.
+ */
+class AdaoMpiEvaluator : public AdaoEvaluator
+{
+public:
+  AdaoMpiEvaluator(MPI_Comm comm, int ranksPerWorker = 1);
+  ~AdaoMpiEvaluator();
+  bool isMaster() const { return _rank==0; }
+  int getNumberOfWorkers() const { return (int)_leaders.size(); }
+  MPI_Comm getWorkerCommunicator() const { return _worker_comm; }
+  void evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs) override;
+  void stopWorkers();
+  void serve(AdaoEvaluator *evaluator);
+private:
+  void serveAsLeader(AdaoEvaluator *evaluator);
+  void serveAsFollower(AdaoEvaluator *evaluator);
+  std::string gatherWorkerErrors(const std::string& error);
+private:
+  MPI_Comm _comm = MPI_COMM_NULL;
+  //! ranks of one worker, MPI_COMM_NULL on master
+  MPI_Comm _worker_comm = MPI_COMM_NULL;
+  int _rank = 0;
+  int _ranks_per_worker = 1;
+  //! rank in _comm of rank 0 of each worker
+  std::vector<int> _leaders;
+  bool _stopped = false;
+};
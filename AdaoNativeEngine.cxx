@@ -0,0 +1,748 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#include "AdaoNativeEngine.hxx"
+#include "AdaoEvaluator.hxx"
+#include "AdaoExchangeLayerException.hxx"
+#include "PyObjectRAII.hxx"
+#include "AdaoPyConversion.hxx"
+#include "AdaoCovarianceOperator.hxx"
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <cmath>
+#include <sstream>
+#include <algorithm>
+
+using namespace AdaoNative;
+
+template<class T>
+static T *FindLeaf(AdaoModel::MainModel *model, const std::string& path)
+{
+  return dynamic_cast<T *>(model->findByPath(path));
+}
+
+template<class T>
+static T *GetLeaf(AdaoModel::MainModel *model, const std::string& path)
+{
+  T *ret(FindLeaf<T>(model,path));
+  if(!ret)
+    throw AdaoExchangeLayerException(std::string("Native engine : no leaf of expected type at ") + path + " !");
+  return ret;
+}
+
+static bool IsSet(PyObject *obj)
+{
+  return obj && obj!=Py_None;
+}
+
+static std::vector<double> ReadVector(AdaoModel::MainModel *model, const std::string& path)
+{
+  PyObject *obj(GetLeaf<AdaoModel::PyObjKeyVal>(model,path)->getVal());
+  if(!IsSet(obj))
+    throw AdaoExchangeLayerException(std::string("Native engine : ") + path + " is not set !");
+  std::vector<double> ret;
+  PyToDoubles(obj,ret);
+  return ret;
+}
+
+/*!
+ * ScalarSparseMatrix is always emitted by MainModel::pyStr and ADAO gives it precedence over DiagonalSparseMatrix and Matrix.
+ * ObjectMatrix, emitted alone when set, is the AdaoCovarianceOperator given to AdaoExchangeLayer::setCovarianceOperatorInModel.
+ */
+static Covariance ReadCovariance(AdaoModel::MainModel *model, const std::string& errorKey)
+{
+  AdaoModel::ObjectMatrixError *object(FindLeaf<AdaoModel::ObjectMatrixError>(model,errorKey + "/" + AdaoModel::ObjectMatrixError::KEY));
+  if(object && !object->getVarName().empty() && IsSet(object->getVal()))
+    {
+      PyObjectRAII capsule(PyObjectRAII::FromNew(PyObject_GetAttrString(object->getVal(),"_capsule")));
+      void *op(capsule.isNull()?nullptr:PyCapsule_GetPointer(capsule,AdaoCovarianceOperator::CAPSULE_NAME));
+      if(!op)
+        {
+          PyErr_Clear();
+          throw AdaoExchangeLayerException(std::string("Native engine : ") + errorKey + "/ObjectMatrix is not an AdaoCovarianceOperator !");
+        }
+      return Covariance::FromOperator(reinterpret_cast<AdaoCovarianceOperator *>(op));
+    }
+  return Covariance::FromScalar(GetLeaf<AdaoModel::ScalarSparseMatrixError>(model,errorKey + "/" + AdaoModel::ScalarSparseMatrixError::KEY)->getVal());
+}
+
+/*!
+ * Bounds are a sequence of (min,max) pairs, None meaning no bound. No Bounds given means no bound at all.
+ */
+static void ReadBounds(AdaoModel::MainModel *model, std::size_t n, std::vector<double>& lower, std::vector<double>& upper)
+{
+  lower.assign(n,-std::numeric_limits<double>::infinity());
+  upper.assign(n,std::numeric_limits<double>::infinity());
+  AdaoModel::Bounds *bounds(FindLeaf<AdaoModel::Bounds>(model,std::string("AlgorithmParameters/Parameters/") + AdaoModel::Bounds::KEY));
+  if(!bounds || !IsSet(bounds->getVal()))
+    return ;
+  PyObjectRAII pairs(PyObjectRAII::FromNew(PySequence_Fast(bounds->getVal(),"Bounds is not a sequence")));
+  if(pairs.isNull() || PySequence_Fast_GET_SIZE(pairs.operator PyObject *())!=(Py_ssize_t)n)
+    {
+      PyErr_Clear();
+      throw AdaoExchangeLayerException("Native engine : Bounds has to be a sequence of pairs with size of state !");
+    }
+  for(std::size_t i=0;i<n;++i)
+    {
+      PyObjectRAII pair(PyObjectRAII::FromNew(PySequence_Fast(PySequence_Fast_GET_ITEM(pairs.operator PyObject *(),i),"Bound is not a pair")));
+      if(pair.isNull() || PySequence_Fast_GET_SIZE(pair.operator PyObject *())!=2)
+        {
+          PyErr_Clear();
+          throw AdaoExchangeLayerException("Native engine : each element of Bounds has to be a pair !");
+        }
+      PyObject *lo(PySequence_Fast_GET_ITEM(pair.operator PyObject *(),0)),*up(PySequence_Fast_GET_ITEM(pair.operator PyObject *(),1));
+      std::vector<double> tmp;
+      if(IsSet(lo))
+        { PyToDoubles(lo,tmp); lower[i] = tmp.back(); }
+      if(IsSet(up))
+        { PyToDoubles(up,tmp); upper[i] = tmp.back(); }
+    }
+}
+
+Problem Problem::FromModel(AdaoModel::MainModel *model)
+{
+  Problem ret;
+  ret._algo = GetLeaf<AdaoModel::EnumAlgoKeyVal>(model,"AlgorithmParameters/Algorithm")->getVal();
+  if(!Engine::IsAlgoSupported(ret._algo))
+    throw AdaoExchangeLayerException("Native engine : algorithm not supported !");
+  bool isSampling(AdaoModel::MainModel::IsSamplingTask(ret._algo));
+  if(!isSampling || ret._algo==AdaoModel::EnumAlgo::SamplingTest)
+    ret._xb = ReadVector(model,"Background/Vector");
+  ret._y = ReadVector(model,"Observation/Vector");// also gives the size of simulations of EnsembleOfSimulationGenerationTask
+  ret._b = ReadCovariance(model,AdaoModel::BackgroundError::KEY);
+  ret._r = ReadCovariance(model,AdaoModel::ObservationError::KEY);
+  ret._differential_increment = GetLeaf<AdaoModel::DifferentialIncrement>(model,"ObservationOperator/Parameters/DifferentialIncrement")->getVal();
+  ret._centered_finite_difference = GetLeaf<AdaoModel::CenteredFiniteDifference>(model,"ObservationOperator/Parameters/CenteredFiniteDifference")->getVal();
+  ReadBounds(model,ret._xb.size(),ret._lower_bounds,ret._upper_bounds);
+  ret._jacobian_mode = model->getJacobianMode();
+  ret._broyden_tolerance = model->getBroydenTolerance();
+  AdaoModel::MaximumNumberOfSteps *maxSteps(FindLeaf<AdaoModel::MaximumNumberOfSteps>(model,std::string("AlgorithmParameters/Parameters/") + AdaoModel::MaximumNumberOfSteps::KEY));
+  if(maxSteps)
+    ret._maximum_number_of_steps = maxSteps->getVal();
+  AdaoModel::CostDecrementTolerance *costTol(FindLeaf<AdaoModel::CostDecrementTolerance>(model,std::string("AlgorithmParameters/Parameters/") + AdaoModel::CostDecrementTolerance::KEY));
+  if(costTol)
+    ret._cost_decrement_tolerance = costTol->getVal();
+  if(isSampling)
+    ret._sampling_design = std::make_shared<AdaoSamplingDesign>(AdaoSamplingDesign::FromModel(model));
+  return ret;
+}
+
+/*!
+ * Sub-case made of state components \a stateIds and observations \a observationIds, other parameters being unchanged.
+ */
+Problem Problem::restrict(const std::vector<std::size_t>& stateIds, const std::vector<std::size_t>& observationIds) const
+{
+  Problem ret(*this);
+  ret._xb.resize(stateIds.size());
+  ret._lower_bounds.resize(stateIds.size());
+  ret._upper_bounds.resize(stateIds.size());
+  for(std::size_t i=0;i<stateIds.size();++i)
+    {
+      ret._xb[i] = _xb[stateIds[i]];
+      ret._lower_bounds[i] = _lower_bounds[stateIds[i]];
+      ret._upper_bounds[i] = _upper_bounds[stateIds[i]];
+    }
+  ret._y.resize(observationIds.size());
+  for(std::size_t i=0;i<observationIds.size();++i)
+    ret._y[i] = _y[observationIds[i]];
+  ret._b = _b.restrict(stateIds);
+  ret._r = _r.restrict(observationIds);
+  return ret;
+}
+
+Engine::Engine(AdaoModel::MainModel *model):Engine(Problem::FromModel(model))
+{
+}
+
+Engine::Engine(const Problem& pb):_pb(pb)
+{
+  if(!IsAlgoSupported(_pb._algo))
+    throw AdaoExchangeLayerException("Native engine : algorithm not supported !");
+}
+
+/*!
+ * Each state component has to be in exactly one partition (halo excepted). An observation can be used by several partitions.
+ */
+void Engine::setPartitions(const std::vector<AdaoPartition>& partitions, std::size_t maxNbOfConcurrentPartitions)
+{
+  std::size_t n(_pb.getStateSize()),m(_pb.getObservationSize());
+  std::vector<std::size_t> nbOfOwners(n,0);
+  for(const auto& partition : partitions)
+    {
+      std::vector<std::size_t> ids(partition.getExtendedStateIds());
+      if(std::any_of(ids.begin(),ids.end(),[n](std::size_t id) { return id>=n; }))
+        throw AdaoExchangeLayerException("Native engine : partition refers to a state component out of range !");
+      if(std::any_of(partition.getObservationIds().begin(),partition.getObservationIds().end(),[m](std::size_t id) { return id>=m; }))
+        throw AdaoExchangeLayerException("Native engine : partition refers to an observation out of range !");
+      std::sort(ids.begin(),ids.end());
+      if(std::adjacent_find(ids.begin(),ids.end())!=ids.end())
+        throw AdaoExchangeLayerException("Native engine : state component given twice in a partition (or in its halo) !");
+      for(auto id : partition.getStateIds())
+        nbOfOwners[id]++;
+    }
+  auto it(std::find_if(nbOfOwners.begin(),nbOfOwners.end(),[](std::size_t nb) { return nb!=1; }));
+  if(!partitions.empty() && it!=nbOfOwners.end())
+    {
+      std::ostringstream oss; oss << "Native engine : state component #" << std::distance(nbOfOwners.begin(),it) << " belongs to " << *it << " partitions whereas exactly one is expected !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+  if(!partitions.empty() && _pb._sampling_design)
+    throw AdaoExchangeLayerException("Native engine : partitions are not available for sampling tasks !");
+  _partitions = partitions;
+  _max_nb_of_concurrent_partitions = maxNbOfConcurrentPartitions;
+}
+
+/*!
+ * Sampling tasks : samples are generated and given to the evaluator \a chunkSize at a time (0 meaning all at once), up to
+ * \a maxNbOfConcurrentChunks chunks being evaluated at the same time (0 meaning number of cores, more than 1 requires an evaluator
+ * callable from several threads). Outputs are written in place in the AdaoSamplingResult, memory mapped on \a resultFileName if not empty.
+ */
+void Engine::setSamplingStreaming(std::size_t chunkSize, std::size_t maxNbOfConcurrentChunks, const std::string& resultFileName)
+{
+  _sampling_chunk_size = chunkSize;
+  _max_nb_of_concurrent_chunks = maxNbOfConcurrentChunks;
+  _sampling_result_file_name = resultFileName;
+}
+
+const AdaoSamplingResult& Engine::getSamplingResult() const
+{
+  if(!_sampling_result)
+    throw AdaoExchangeLayerException("Native engine : no sampling result (not a sampling task or not executed) !");
+  return *_sampling_result;
+}
+
+bool Engine::IsAlgoSupported(AdaoModel::EnumAlgo algo)
+{
+  return algo==AdaoModel::EnumAlgo::Blue || algo==AdaoModel::EnumAlgo::LinearLeastSquares || algo==AdaoModel::EnumAlgo::ThreeDVar || AdaoModel::MainModel::IsSamplingTask(algo);
+}
+
+void Engine::execute(AdaoEvaluator *evaluator)
+{
+  if(!_partitions.empty())
+    {
+      executePartitioned(evaluator);
+      return ;
+    }
+  switch(_pb._algo)
+    {
+    case AdaoModel::EnumAlgo::Blue:
+      executeBlue(evaluator);
+      break;
+    case AdaoModel::EnumAlgo::LinearLeastSquares:
+      executeLinearLeastSquares(evaluator);
+      break;
+    case AdaoModel::EnumAlgo::ThreeDVar:
+      executeThreeDVar(evaluator);
+      break;
+    case AdaoModel::EnumAlgo::SamplingTest:
+    case AdaoModel::EnumAlgo::EnsembleOfSimulationGenerationTask:
+      executeSampling(evaluator);
+      break;
+    default:
+      throw AdaoExchangeLayerException("Native engine : algorithm not supported !");
+    }
+}
+
+/*!
+ * Transpose of tangent matrix at \a x by finite differences, using same increments than ADAO FDApproximation.
+ * All perturbed points are evaluated in a single batch. If \a hxIsKnown is false, \a x itself is part of the batch and its image is returned in \a hx.
+ * Each row of returned matrix is a column of the tangent matrix.
+ * With EnumJacobianMode::Exact, the tangent is given by \a evaluator itself (AdaoDifferentiableEvaluator).
+ */
+DenseMatrix Engine::transposeOfTangentMatrix(AdaoEvaluator *evaluator, const std::vector<double>& x, std::vector<double>& hx, bool hxIsKnown) const
+{
+  std::size_t n(x.size()),m(_pb.getObservationSize());
+  if(_pb._jacobian_mode==AdaoModel::EnumJacobianMode::Exact)
+    {
+      AdaoDifferentiableEvaluator *differentiable(dynamic_cast<AdaoDifferentiableEvaluator *>(evaluator));
+      if(!differentiable)
+        throw AdaoExchangeLayerException("Native engine : exact jacobian requires an AdaoDifferentiableEvaluator, without evaluation store, surrogate nor partitions !");
+      DenseMatrix ret(n,m);
+      std::vector<double> hxExact(m);
+      differentiable->transposeOfTangent(n,x.data(),m,hxExact.data(),ret.data());
+      if(!hxIsKnown)
+        hx = hxExact;
+      return ret;
+    }
+  std::vector<double> dx(FiniteDifferenceIncrements(x,_pb._differential_increment));
+  bool centered(_pb._centered_finite_difference);
+  // logical sample #0 is x, then x+dx[i] (and x-dx[i] if centered). first is the first logical sample really evaluated
+  std::size_t first(hxIsKnown?1:0);
+  std::size_t nbOfSamples((centered?2*n+1:n+1)-first);
+  std::vector<double> inputs(nbOfSamples*n),outputs(nbOfSamples*m);
+  for(std::size_t s=0;s<nbOfSamples;++s)
+    std::copy(x.begin(),x.end(),inputs.begin()+s*n);
+  for(std::size_t i=0;i<n;++i)
+    {
+      if(centered)
+        {
+          inputs[(2*i+1-first)*n+i] += dx[i];
+          inputs[(2*i+2-first)*n+i] -= dx[i];
+        }
+      else
+        inputs[(i+1-first)*n+i] += dx[i];
+    }
+  evaluator->evaluate(nbOfSamples,n,inputs.data(),m,outputs.data());
+  if(!hxIsKnown)
+    hx.assign(outputs.begin(),outputs.begin()+m);
+  DenseMatrix ret(n,m);
+  for(std::size_t i=0;i<n;++i)
+    {
+      const double *plus(outputs.data()+((centered?2*i+1:i+1)-first)*m);
+      const double *minus(centered?outputs.data()+(2*i+2-first)*m:hx.data());
+      double inv(1./(centered?2.*dx[i]:dx[i]));
+      double *row(ret.getRow(i));
+      for(std::size_t k=0;k<m;++k)
+        row[k] = (plus[k]-minus[k])*inv;
+    }
+  return ret;
+}
+
+/*!
+ * Same formulation than ADAO Blue : the smallest of the two linear systems (size of observation or size of state) is solved.
+ */
+void Engine::executeBlue(AdaoEvaluator *evaluator)
+{
+  std::size_t n(_pb.getStateSize()),m(_pb.getObservationSize());
+  std::vector<double> hxb;
+  DenseMatrix ht(transposeOfTangentMatrix(evaluator,_pb._xb,hxb,false));
+  DenseMatrix h(ht.transpose());
+  std::vector<double> innovation(m);
+  for(std::size_t k=0;k<m;++k)
+    innovation[k] = _pb._y[k]-hxb[k];
+  _analysis = _pb._xb;
+  if(m<=n)
+    {// Xa = Xb + B.Ht.(R + H.B.Ht)^-1.d
+      DenseMatrix bht(ht);
+      _pb._b.multiplyRows(bht);
+      DenseMatrix a;
+      MatMul(h,bht,a);
+      _pb._r.addTo(a);
+      CholeskyFactorize(a);
+      CholeskySolve(a,innovation.data());
+      std::vector<double> incr(n);
+      MatVec(bht,innovation.data(),incr.data());
+      Axpy(n,1.,incr.data(),_analysis.data());
+    }
+  else
+    {// Xa = Xb + (B^-1 + Ht.R^-1.H)^-1.Ht.R^-1.d
+      DenseMatrix rih(h);
+      _pb._r.solveRows(rih);
+      DenseMatrix a;
+      TransMatMul(h,rih,a);
+      _pb._b.addInverseTo(a);
+      _pb._r.solve(m,innovation.data());
+      std::vector<double> incr(n);
+      MatVec(ht,innovation.data(),incr.data());
+      CholeskyFactorize(a);
+      CholeskySolve(a,incr.data());
+      Axpy(n,1.,incr.data(),_analysis.data());
+    }
+}
+
+/*!
+ * Xa = (Ht.R^-1.H)^-1.Ht.R^-1.Y with H linearized at background like ADAO.
+ */
+void Engine::executeLinearLeastSquares(AdaoEvaluator *evaluator)
+{
+  std::size_t n(_pb.getStateSize()),m(_pb.getObservationSize());
+  std::vector<double> hxb;
+  DenseMatrix ht(transposeOfTangentMatrix(evaluator,_pb._xb,hxb,false));
+  DenseMatrix h(ht.transpose());
+  DenseMatrix rih(h);
+  _pb._r.solveRows(rih);
+  DenseMatrix a;
+  TransMatMul(h,rih,a);
+  std::vector<double> riy(_pb._y);
+  _pb._r.solve(m,riy.data());
+  _analysis.resize(n);
+  MatVec(ht,riy.data(),_analysis.data());
+  CholeskyFactorize(a);
+  CholeskySolve(a,_analysis.data());
+}
+
+std::vector<double> Engine::directOperator(AdaoEvaluator *evaluator, const std::vector<double>& x) const
+{
+  std::vector<double> ret(_pb.getObservationSize());
+  evaluator->evaluate(1,x.size(),x.data(),ret.size(),ret.data());
+  return ret;
+}
+
+/*!
+ * J(x) = 1/2.(x-Xb)t.B^-1.(x-Xb) + 1/2.(Y-H(x))t.R^-1.(Y-H(x))
+ */
+double Engine::costFunction(const std::vector<double>& x, const std::vector<double>& hx) const
+{
+  double jb(0.),jo(0.);
+  costFunctionTerms(x.data(),hx.data(),jb,jo);
+  return jb+jo;
+}
+
+/*!
+ * Background and observation terms of cost function at \a x (size of state) knowing \a hx = H(x) (size of observation).
+ */
+void Engine::costFunctionTerms(const double *x, const double *hx, double& jb, double& jo) const
+{
+  std::size_t n(_pb.getStateSize()),m(_pb.getObservationSize());
+  std::vector<double> dxb(n),dy(m);
+  for(std::size_t i=0;i<n;++i)
+    dxb[i] = x[i]-_pb._xb[i];
+  for(std::size_t k=0;k<m;++k)
+    dy[k] = _pb._y[k]-hx[k];
+  std::vector<double> bidxb(dxb),ridy(dy);
+  _pb._b.solve(n,bidxb.data());
+  _pb._r.solve(m,ridy.data());
+  jb = 0.5*Dot(n,dxb.data(),bidxb.data());
+  jo = 0.5*Dot(m,dy.data(),ridy.data());
+}
+
+/*!
+ * Tangent at \a x (transposed) knowing \a hx = H(x).
+ * With EnumJacobianMode::Broyden, the previous tangent is corrected by the rank one Broyden update built from the step between previous point and \a x,
+ * so that no evaluation is needed. Finite differences are used at first call, or when the previous tangent predicts the step with
+ * a relative error greater than the Broyden tolerance.
+ */
+const DenseMatrix& Engine::transposeOfTangentMatrixReusingPrevious(AdaoEvaluator *evaluator, const std::vector<double>& x, const std::vector<double>& hx)
+{
+  std::size_t n(x.size()),m(hx.size());
+  bool isFD(_pb._jacobian_mode!=AdaoModel::EnumJacobianMode::Broyden || _last_ht.getNumberOfRows()==0);
+  if(!isFD)
+    {
+      std::vector<double> dx(n),residual(m),jdx(m);
+      for(std::size_t i=0;i<n;++i)
+        dx[i] = x[i]-_last_x[i];
+      double dxdx(Dot(n,dx.data(),dx.data()));
+      if(dxdx==0.)
+        return _last_ht;
+      TransMatVec(_last_ht,dx.data(),jdx.data());
+      double normDy(0.),normResidual(0.);
+      for(std::size_t k=0;k<m;++k)
+        {
+          double dy(hx[k]-_last_hx[k]);
+          residual[k] = dy-jdx[k];
+          normDy += dy*dy;
+          normResidual += residual[k]*residual[k];
+        }
+      if(std::sqrt(normResidual)>_pb._broyden_tolerance*std::max(std::sqrt(normDy),std::numeric_limits<double>::min()))
+        isFD = true;
+      else
+        {// H += residual.dxt/(dxt.dx) applied on transposed matrix
+          for(std::size_t i=0;i<n;++i)
+            Axpy(m,dx[i]/dxdx,residual.data(),_last_ht.getRow(i));
+        }
+    }
+  if(isFD)
+    {
+      std::vector<double> hxCpy(hx);
+      _last_ht = transposeOfTangentMatrix(evaluator,x,hxCpy,true);
+    }
+  _last_x = x;
+  _last_hx = hx;
+  return _last_ht;
+}
+
+/*!
+ * grad J(x) = B^-1.(x-Xb) - Ht.R^-1.(Y-H(x)) with \a hx = H(x) already known.
+ */
+std::vector<double> Engine::gradientOfCostFunction(AdaoEvaluator *evaluator, const std::vector<double>& x, const std::vector<double>& hx)
+{
+  std::size_t n(x.size()),m(hx.size());
+  const DenseMatrix& ht(transposeOfTangentMatrixReusingPrevious(evaluator,x,hx));
+  std::vector<double> ridy(m);
+  for(std::size_t k=0;k<m;++k)
+    ridy[k] = _pb._y[k]-hx[k];
+  _pb._r.solve(m,ridy.data());
+  std::vector<double> ret(n),gjo(n);
+  for(std::size_t i=0;i<n;++i)
+    ret[i] = x[i]-_pb._xb[i];
+  _pb._b.solve(n,ret.data());
+  MatVec(ht,ridy.data(),gjo.data());
+  Axpy(n,-1.,gjo.data(),ret.data());
+  return ret;
+}
+
+void Engine::projectOnBounds(std::vector<double>& x) const
+{
+  for(std::size_t i=0;i<x.size();++i)
+    x[i] = std::min(std::max(x[i],_pb._lower_bounds[i]),_pb._upper_bounds[i]);
+}
+
+/*!
+ * Minimization of 3DVAR cost function by a bound constrained limited memory BFGS, close to the L-BFGS-B used by ADAO through scipy :
+ * - search direction given by two-loop recursion restricted to variables not blocked on a bound,
+ * - backtracking along the projected path with Armijo condition,
+ * - stop when relative decrement of cost is lower than CostDecrementTolerance (same scaling than scipy factr), or after MaximumNumberOfSteps.
+ */
+void Engine::executeThreeDVar(AdaoEvaluator *evaluator)
+{
+  constexpr std::size_t MEMORY = 10;
+  constexpr unsigned int MAX_LINE_SEARCH = 30;
+  constexpr double ARMIJO = 1.e-4;
+  const double tol(_pb._cost_decrement_tolerance*1.e14*std::numeric_limits<double>::epsilon());
+  std::size_t n(_pb.getStateSize());
+  std::vector<double> x(_pb._xb);
+  projectOnBounds(x);
+  std::vector<double> hx(directOperator(evaluator,x));
+  double f(costFunction(x,hx));
+  std::vector<double> g(gradientOfCostFunction(evaluator,x,hx));
+  std::deque< std::vector<double> > ss,ys;
+  std::deque<double> rhos;
+  for(unsigned int step=0;step<_pb._maximum_number_of_steps;++step)
+    {
+      // variables blocked on a bound by gradient are frozen
+      std::vector<bool> isFree(n);
+      for(std::size_t i=0;i<n;++i)
+        isFree[i] = !( (x[i]<=_pb._lower_bounds[i] && g[i]>0.) || (x[i]>=_pb._upper_bounds[i] && g[i]<0.) );
+      std::vector<double> d(n);
+      for(std::size_t i=0;i<n;++i)
+        d[i] = isFree[i]?g[i]:0.;
+      if(std::all_of(d.begin(),d.end(),[](double v) { return v==0.; }))
+        break;
+      {// two-loop recursion
+        std::size_t nbPairs(ss.size());
+        std::vector<double> alphas(nbPairs);
+        for(std::size_t p=nbPairs;p>0;--p)
+          {
+            alphas[p-1] = rhos[p-1]*Dot(n,ss[p-1].data(),d.data());
+            Axpy(n,-alphas[p-1],ys[p-1].data(),d.data());
+          }
+        double gamma(nbPairs>0?1./(rhos.back()*Dot(n,ys.back().data(),ys.back().data())):1./std::sqrt(Dot(n,d.data(),d.data())));
+        for(auto& v : d)
+          v *= gamma;
+        for(std::size_t p=0;p<nbPairs;++p)
+          {
+            double beta(rhos[p]*Dot(n,ys[p].data(),d.data()));
+            Axpy(n,alphas[p]-beta,ss[p].data(),d.data());
+          }
+        for(std::size_t i=0;i<n;++i)
+          d[i] = isFree[i]?-d[i]:0.;
+      }
+      if(Dot(n,d.data(),g.data())>=0.)
+        {// not a descent direction : restart from steepest descent
+          ss.clear(); ys.clear(); rhos.clear();
+          for(std::size_t i=0;i<n;++i)
+            d[i] = isFree[i]?-g[i]:0.;
+        }
+      // backtracking along projected path
+      double alpha(1.),fNew(f);
+      std::vector<double> xNew(n),hxNew;
+      bool found(false);
+      for(unsigned int ls=0;ls<MAX_LINE_SEARCH && !found;++ls,alpha*=0.5)
+        {
+          for(std::size_t i=0;i<n;++i)
+            xNew[i] = x[i]+alpha*d[i];
+          projectOnBounds(xNew);
+          std::vector<double> s(n);
+          for(std::size_t i=0;i<n;++i)
+            s[i] = xNew[i]-x[i];
+          hxNew = directOperator(evaluator,xNew);
+          fNew = costFunction(xNew,hxNew);
+          found = fNew<=f+ARMIJO*Dot(n,g.data(),s.data());
+        }
+      if(!found)
+        break;
+      std::vector<double> gNew(gradientOfCostFunction(evaluator,xNew,hxNew));
+      std::vector<double> s(n),y(n);
+      for(std::size_t i=0;i<n;++i)
+        {
+          s[i] = xNew[i]-x[i];
+          y[i] = gNew[i]-g[i];
+        }
+      double sy(Dot(n,s.data(),y.data()));
+      if(sy>std::numeric_limits<double>::epsilon()*Dot(n,y.data(),y.data()))
+        {
+          ss.push_back(s); ys.push_back(y); rhos.push_back(1./sy);
+          if(ss.size()>MEMORY)
+            { ss.pop_front(); ys.pop_front(); rhos.pop_front(); }
+        }
+      double decrement((f-fNew)/std::max(std::max(std::abs(f),std::abs(fNew)),1.));
+      x = xNew; hx = hxNew; f = fNew; g = gNew;
+      if(decrement<=tol)
+        break;
+    }
+  _analysis = x;
+}
+
+/*!
+ * Posterior covariance linearized at analysis. Tangent used by the last gradient is reused when it has been computed by finite differences (or exactly)
+ * at analysis (usual end of 3DVAR), otherwise it is computed (n+1 evaluations).
+ */
+PosteriorCovariance Engine::posteriorCovariance(AdaoEvaluator *evaluator) const
+{
+  if(!_partitions.empty())
+    throw AdaoExchangeLayerException("Native engine : posterior covariance is not available with partitions !");
+  if(_pb._sampling_design)
+    throw AdaoExchangeLayerException("Native engine : posterior covariance is not available for sampling tasks !");
+  if(_analysis.empty())
+    throw AdaoExchangeLayerException("Native engine : posterior covariance requested before execution !");
+  if(_pb._jacobian_mode!=AdaoModel::EnumJacobianMode::Broyden && _last_ht.getNumberOfRows()!=0 && _last_x==_analysis)
+    return PosteriorCovariance(_pb,_last_ht);
+  std::vector<double> hx;
+  return PosteriorCovariance(_pb,transposeOfTangentMatrix(evaluator,_analysis,hx,false));
+}
+
+/*!
+ * Observation operator of a partition deduced from the global one : local state is completed by background, global observation is restricted.
+ * Calls to global evaluator are serialized as it is not expected to be thread safe.
+ */
+class SlicedEvaluator : public AdaoEvaluator
+{
+public:
+  SlicedEvaluator(AdaoEvaluator *global, std::mutex& globalMutex, const std::vector<double>& xb, std::size_t globalOutputSize, const AdaoPartition& partition):
+    _global(global),_global_mutex(globalMutex),_xb(xb),_global_output_size(globalOutputSize),_state_ids(partition.getExtendedStateIds()),_observation_ids(partition.getObservationIds()) { }
+  void evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs) override
+  {
+    std::size_t n(_xb.size());
+    std::vector<double> globalInputs(nbOfSamples*n),globalOutputs(nbOfSamples*_global_output_size);
+    for(std::size_t s=0;s<nbOfSamples;++s)
+      {
+        std::copy(_xb.begin(),_xb.end(),globalInputs.begin()+s*n);
+        for(std::size_t i=0;i<inputSize;++i)
+          globalInputs[s*n+_state_ids[i]] = inputs[s*inputSize+i];
+      }
+    {
+      std::lock_guard<std::mutex> lock(_global_mutex);
+      _global->evaluate(nbOfSamples,n,globalInputs.data(),_global_output_size,globalOutputs.data());
+    }
+    for(std::size_t s=0;s<nbOfSamples;++s)
+      for(std::size_t k=0;k<outputSize;++k)
+        outputs[s*outputSize+k] = globalOutputs[s*_global_output_size+_observation_ids[k]];
+  }
+private:
+  AdaoEvaluator *_global;
+  std::mutex& _global_mutex;
+  const std::vector<double>& _xb;
+  std::size_t _global_output_size;
+  std::vector<std::size_t> _state_ids;
+  std::vector<std::size_t> _observation_ids;
+};
+
+/*!
+ * Partitions are distributed among threads. Each one solves its sub-case with a new engine and writes the values of its own state components.
+ * First error met is thrown once all threads are over.
+ */
+void Engine::executePartitioned(AdaoEvaluator *evaluator)
+{
+  _analysis = _pb._xb;
+  std::mutex globalMutex;
+  std::atomic<std::size_t> nextPartition(0);
+  std::vector<std::exception_ptr> errors(_partitions.size());
+  auto work = [this,evaluator,&globalMutex,&nextPartition,&errors]()
+    {
+      for(std::size_t p=nextPartition++;p<_partitions.size();p=nextPartition++)
+        {
+          try
+            {
+              const AdaoPartition& partition(_partitions[p]);
+              Engine subEngine(_pb.restrict(partition.getExtendedStateIds(),partition.getObservationIds()));
+              SlicedEvaluator sliced(evaluator,globalMutex,_pb._xb,_pb.getObservationSize(),partition);
+              subEngine.execute(partition.getEvaluator()?partition.getEvaluator():&sliced);
+              const std::vector<double>& subAnalysis(subEngine.getAnalysis());
+              for(std::size_t i=0;i<partition.getStateIds().size();++i)
+                _analysis[partition.getStateIds()[i]] = subAnalysis[i];
+            }
+          catch(...)
+            {
+              errors[p] = std::current_exception();
+            }
+        }
+    };
+  std::size_t nbOfThreads(_max_nb_of_concurrent_partitions==0?std::thread::hardware_concurrency():_max_nb_of_concurrent_partitions);
+  nbOfThreads = std::max<std::size_t>(1,std::min(nbOfThreads,_partitions.size()));
+  std::vector<std::thread> threads;
+  for(std::size_t t=1;t<nbOfThreads;++t)
+    threads.emplace_back(work);
+  work();
+  for(auto& thread : threads)
+    thread.join();
+  for(const auto& error : errors)
+    if(error)
+      std::rethrow_exception(error);
+}
+
+/*!
+ * Chunks are distributed among threads. Each thread generates the samples of its chunk in its own buffer and the evaluator writes
+ * the outputs directly in the result : memory used does not depend on the number of samples beyond the result itself.
+ * SamplingTest also computes the cost function at each sample, and its analysis is the sample with the lowest one.
+ * First error met stops the distribution of chunks and is thrown once all threads are over.
+ */
+void Engine::executeSampling(AdaoEvaluator *evaluator)
+{
+  const AdaoSamplingDesign& design(*_pb._sampling_design);
+  std::size_t nbOfSamples(design.getNumberOfSamples()),n(design.getSampleSize()),m(_pb.getObservationSize());
+  bool withCostFunctions(_pb._algo==AdaoModel::EnumAlgo::SamplingTest);
+  if(withCostFunctions && n!=_pb.getStateSize())
+    throw AdaoExchangeLayerException("Native engine : samples of SamplingTest are expected to have the size of Background !");
+  _analysis.clear();
+  _sampling_result.reset();
+  _sampling_result.reset(new AdaoSamplingResult(nbOfSamples,m,_sampling_result_file_name,withCostFunctions));
+  std::size_t chunkSize(_sampling_chunk_size==0?nbOfSamples:_sampling_chunk_size);
+  std::size_t nbOfChunks(chunkSize==0?0:(nbOfSamples+chunkSize-1)/chunkSize);
+  std::atomic<std::size_t> nextChunk(0);
+  std::mutex errorMutex;
+  std::exception_ptr error;
+  auto work = [this,evaluator,&design,nbOfSamples,n,m,chunkSize,nbOfChunks,withCostFunctions,&nextChunk,&errorMutex,&error]()
+    {
+      std::vector<double> inputs(chunkSize*n);
+      for(std::size_t c=nextChunk++;c<nbOfChunks;c=nextChunk++)
+        {
+          try
+            {
+              std::size_t first(c*chunkSize),nb(std::min(chunkSize,nbOfSamples-first));
+              design.fillSamples(first,nb,inputs.data());
+              evaluator->evaluate(nb,n,inputs.data(),m,_sampling_result->getOutputs(first));
+              for(std::size_t i=0;withCostFunctions && i<nb;++i)
+                {
+                  double jb(0.),jo(0.);
+                  costFunctionTerms(inputs.data()+i*n,_sampling_result->getOutputs(first+i),jb,jo);
+                  _sampling_result->setCostFunction(first+i,jb,jo);
+                }
+            }
+          catch(...)
+            {
+              std::lock_guard<std::mutex> lock(errorMutex);
+              if(!error)
+                error = std::current_exception();
+              nextChunk = nbOfChunks;
+            }
+        }
+    };
+  std::size_t nbOfThreads(_max_nb_of_concurrent_chunks==0?std::thread::hardware_concurrency():_max_nb_of_concurrent_chunks);
+  nbOfThreads = std::max<std::size_t>(1,std::min(nbOfThreads,nbOfChunks));
+  std::vector<std::thread> threads;
+  for(std::size_t t=1;t<nbOfThreads;++t)
+    threads.emplace_back(work);
+  work();
+  for(auto& thread : threads)
+    thread.join();
+  if(error)
+    std::rethrow_exception(error);
+  if(withCostFunctions && nbOfSamples>0)
+    {
+      const std::vector<double>& j(_sampling_result->getCostFunctionJ());
+      _analysis.resize(n);
+      design.fillSamples(std::distance(j.begin(),std::min_element(j.begin(),j.end())),1,_analysis.data());
+    }
+}
@@ -0,0 +1,111 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include "AdaoModelKeyVal.hxx"
+#include "AdaoNativeLinearAlgebra.hxx"
+#include "AdaoPartition.hxx"
+#include "AdaoPosteriorCovariance.hxx"
+#include "AdaoSampling.hxx"
+
+#include <vector>
+#include <memory>
+
+class AdaoEvaluator;
+
+namespace AdaoNative
+{
+  /*!
+   * Content of a MainModel needed by native engines. Read once (GIL held) when case is loaded.
+   */
+  class Problem
+  {
+  public:
+    static Problem FromModel(AdaoModel::MainModel *model);
+    Problem restrict(const std::vector<std::size_t>& stateIds, const std::vector<std::size_t>& observationIds) const;
+    std::size_t getStateSize() const { return _xb.size(); }
+    std::size_t getObservationSize() const { return _y.size(); }
+  public:
+    AdaoModel::EnumAlgo _algo = AdaoModel::EnumAlgo::ThreeDVar;
+    std::vector<double> _xb;
+    std::vector<double> _y;
+    Covariance _b;
+    Covariance _r;
+    double _differential_increment = 0.;
+    bool _centered_finite_difference = false;
+    std::vector<double> _lower_bounds;
+    std::vector<double> _upper_bounds;
+    unsigned int _maximum_number_of_steps = 0;
+    double _cost_decrement_tolerance = 0.;
+    AdaoModel::EnumJacobianMode _jacobian_mode = AdaoModel::EnumJacobianMode::FiniteDifferences;
+    double _broyden_tolerance = 0.;
+    //! sampling tasks only
+    std::shared_ptr<AdaoSamplingDesign> _sampling_design;
+  };
+
+  /*!
+   * Solve the case described by a MainModel in C++, calling the observation operator through an AdaoEvaluator.
+   * Result is the same than the "Analysis" computed by ADAO.
+   * With partitions, each partition is solved as an independent sub-case, up to \a maxNbOfConcurrentPartitions at the same time.
+   * Sampling tasks stream their samples to the evaluator chunk by chunk (see setSamplingStreaming).
+   */
+  class Engine
+  {
+  public:
+    Engine(AdaoModel::MainModel *model);
+    Engine(const Problem& pb);
+    static bool IsAlgoSupported(AdaoModel::EnumAlgo algo);
+    void setPartitions(const std::vector<AdaoPartition>& partitions, std::size_t maxNbOfConcurrentPartitions);
+    void setSamplingStreaming(std::size_t chunkSize, std::size_t maxNbOfConcurrentChunks, const std::string& resultFileName);
+    void execute(AdaoEvaluator *evaluator);
+    const std::vector<double>& getAnalysis() const { return _analysis; }
+    const AdaoSamplingResult& getSamplingResult() const;
+    PosteriorCovariance posteriorCovariance(AdaoEvaluator *evaluator) const;
+  private:
+    void executeBlue(AdaoEvaluator *evaluator);
+    void executeLinearLeastSquares(AdaoEvaluator *evaluator);
+    void executeThreeDVar(AdaoEvaluator *evaluator);
+    void executePartitioned(AdaoEvaluator *evaluator);
+    void executeSampling(AdaoEvaluator *evaluator);
+    DenseMatrix transposeOfTangentMatrix(AdaoEvaluator *evaluator, const std::vector<double>& x, std::vector<double>& hx, bool hxIsKnown) const;
+    std::vector<double> directOperator(AdaoEvaluator *evaluator, const std::vector<double>& x) const;
+    double costFunction(const std::vector<double>& x, const std::vector<double>& hx) const;
+    void costFunctionTerms(const double *x, const double *hx, double& jb, double& jo) const;
+    const DenseMatrix& transposeOfTangentMatrixReusingPrevious(AdaoEvaluator *evaluator, const std::vector<double>& x, const std::vector<double>& hx);
+    std::vector<double> gradientOfCostFunction(AdaoEvaluator *evaluator, const std::vector<double>& x, const std::vector<double>& hx);
+    void projectOnBounds(std::vector<double>& x) const;
+  private:
+    Problem _pb;
+    std::vector<double> _analysis;
+    std::vector<AdaoPartition> _partitions;
+    //! 0 means number of cores
+    std::size_t _max_nb_of_concurrent_partitions = 0;
+    std::size_t _sampling_chunk_size = 1024;
+    //! 1 : chunks are given one after the other to the evaluator, which parallelizes each of them
+    std::size_t _max_nb_of_concurrent_chunks = 1;
+    std::string _sampling_result_file_name;
+    std::unique_ptr<AdaoSamplingResult> _sampling_result;
+    //! last tangent computed (transposed), and point where it has been computed
+    DenseMatrix _last_ht;
+    std::vector<double> _last_x;
+    std::vector<double> _last_hx;
+  };
+}
@@ -0,0 +1,607 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#include "AdaoNativeLinearAlgebra.hxx"
+#include "AdaoCovarianceOperator.hxx"
+#include "AdaoExchangeLayerException.hxx"
+
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+
+using namespace AdaoNative;
+
+// 64x64 blocks of double fit in L1/L2 caches
+constexpr std::size_t BLOCK_SIZE = 64;
+
+DenseMatrix DenseMatrix::transpose() const
+{
+  DenseMatrix ret(_nb_cols,_nb_rows);
+  for(std::size_t ii=0;ii<_nb_rows;ii+=BLOCK_SIZE)
+    for(std::size_t jj=0;jj<_nb_cols;jj+=BLOCK_SIZE)
+      {
+        std::size_t iEnd(std::min(ii+BLOCK_SIZE,_nb_rows)),jEnd(std::min(jj+BLOCK_SIZE,_nb_cols));
+        for(std::size_t i=ii;i<iEnd;++i)
+          for(std::size_t j=jj;j<jEnd;++j)
+            ret(j,i) = (*this)(i,j);
+      }
+  return ret;
+}
+
+/*!
+ * 4 independent accumulators to let the compiler vectorize the reduction without reassociation.
+ */
+double AdaoNative::Dot(std::size_t n, const double *AEL_RESTRICT x, const double *AEL_RESTRICT y)
+{
+  double s0(0.),s1(0.),s2(0.),s3(0.);
+  std::size_t i(0);
+  for(;i+4<=n;i+=4)
+    {
+      s0 += x[i]*y[i];
+      s1 += x[i+1]*y[i+1];
+      s2 += x[i+2]*y[i+2];
+      s3 += x[i+3]*y[i+3];
+    }
+  for(;i<n;++i)
+    s0 += x[i]*y[i];
+  return (s0+s1)+(s2+s3);
+}
+
+void AdaoNative::Axpy(std::size_t n, double alpha, const double *AEL_RESTRICT x, double *AEL_RESTRICT y)
+{
+  for(std::size_t i=0;i<n;++i)
+    y[i] += alpha*x[i];
+}
+
+/*!
+ * Sum of \a x in the same order than numpy (pairwise summation with 8 accumulators on blocks of at most 128 values),
+ * so that results are bitwise equal to the ones of numpy.
+ */
+static double PairwiseSum(std::size_t n, const double *x)
+{
+  if(n<8)
+    {
+      double res(0.);
+      for(std::size_t i=0;i<n;++i)
+        res += x[i];
+      return res;
+    }
+  if(n<=128)
+    {
+      double r[8];
+      std::copy(x,x+8,r);
+      std::size_t i(8);
+      for(;i<n-n%8;i+=8)
+        for(std::size_t j=0;j<8;++j)
+          r[j] += x[i+j];
+      double res(((r[0]+r[1])+(r[2]+r[3]))+((r[4]+r[5])+(r[6]+r[7])));
+      for(;i<n;++i)
+        res += x[i];
+      return res;
+    }
+  std::size_t n2(n/2);
+  n2 -= n2%8;
+  return PairwiseSum(n2,x)+PairwiseSum(n-n2,x+n2);
+}
+
+/*!
+ * Same value than numpy mean.
+ */
+double AdaoNative::Mean(std::size_t n, const double *x)
+{
+  return PairwiseSum(n,x)/(double)n;
+}
+
+/*!
+ * Increments used by ADAO FDApproximation around \a x : dx = increment.x, null components of dx being replaced by their mean
+ * (or by increment if mean is null). A null \a increment is replaced by 0.01 as ADAO does.
+ */
+std::vector<double> AdaoNative::FiniteDifferenceIncrements(const std::vector<double>& x, double increment)
+{
+  if(std::abs(increment)<=1.e-15)
+    increment = 0.01;
+  std::size_t n(x.size());
+  std::vector<double> dx(n);
+  for(std::size_t i=0;i<n;++i)
+    dx[i] = increment*x[i];
+  if(std::any_of(dx.begin(),dx.end(),[](double v) { return v==0.; }))
+    {
+      double mean(Mean(n,dx.data()));
+      std::replace(dx.begin(),dx.end(),0.,mean==0.?increment:mean);
+    }
+  return dx;
+}
+
+/*!
+ * c = a * b
+ */
+void AdaoNative::MatMul(const DenseMatrix& a, const DenseMatrix& b, DenseMatrix& c)
+{
+  std::size_t m(a.getNumberOfRows()),p(a.getNumberOfCols()),n(b.getNumberOfCols());
+  if(b.getNumberOfRows()!=p)
+    throw AdaoExchangeLayerException("MatMul : mismatch of sizes !");
+  c = DenseMatrix(m,n);
+  for(std::size_t ii=0;ii<m;ii+=BLOCK_SIZE)
+    for(std::size_t kk=0;kk<p;kk+=BLOCK_SIZE)
+      for(std::size_t jj=0;jj<n;jj+=BLOCK_SIZE)
+        {
+          std::size_t iEnd(std::min(ii+BLOCK_SIZE,m)),kEnd(std::min(kk+BLOCK_SIZE,p)),len(std::min(jj+BLOCK_SIZE,n)-jj);
+          for(std::size_t i=ii;i<iEnd;++i)
+            {
+              double *crow(c.getRow(i)+jj);
+              const double *arow(a.getRow(i));
+              for(std::size_t k=kk;k<kEnd;++k)
+                Axpy(len,arow[k],b.getRow(k)+jj,crow);
+            }
+        }
+}
+
+/*!
+ * c = transpose(a) * b
+ */
+void AdaoNative::TransMatMul(const DenseMatrix& a, const DenseMatrix& b, DenseMatrix& c)
+{
+  std::size_t p(a.getNumberOfRows()),m(a.getNumberOfCols()),n(b.getNumberOfCols());
+  if(b.getNumberOfRows()!=p)
+    throw AdaoExchangeLayerException("TransMatMul : mismatch of sizes !");
+  c = DenseMatrix(m,n);
+  for(std::size_t kk=0;kk<p;kk+=BLOCK_SIZE)
+    for(std::size_t ii=0;ii<m;ii+=BLOCK_SIZE)
+      for(std::size_t jj=0;jj<n;jj+=BLOCK_SIZE)
+        {
+          std::size_t kEnd(std::min(kk+BLOCK_SIZE,p)),iEnd(std::min(ii+BLOCK_SIZE,m)),len(std::min(jj+BLOCK_SIZE,n)-jj);
+          for(std::size_t k=kk;k<kEnd;++k)
+            {
+              const double *arow(a.getRow(k));
+              const double *brow(b.getRow(k)+jj);
+              for(std::size_t i=ii;i<iEnd;++i)
+                Axpy(len,arow[i],brow,c.getRow(i)+jj);
+            }
+        }
+}
+
+/*!
+ * y = a * x
+ */
+void AdaoNative::MatVec(const DenseMatrix& a, const double *x, double *y)
+{
+  std::size_t m(a.getNumberOfRows()),n(a.getNumberOfCols());
+  for(std::size_t i=0;i<m;++i)
+    y[i] = Dot(n,a.getRow(i),x);
+}
+
+/*!
+ * y = transpose(a) * x
+ */
+void AdaoNative::TransMatVec(const DenseMatrix& a, const double *x, double *y)
+{
+  std::size_t m(a.getNumberOfRows()),n(a.getNumberOfCols());
+  std::fill(y,y+n,0.);
+  for(std::size_t i=0;i<m;++i)
+    Axpy(n,x[i],a.getRow(i),y);
+}
+
+/*!
+ * In place Cholesky factorization a = L * transpose(L). Lower part of \a a is replaced by L, upper part is zeroed.
+ */
+void AdaoNative::CholeskyFactorize(DenseMatrix& a)
+{
+  std::size_t n(a.getNumberOfRows());
+  if(a.getNumberOfCols()!=n)
+    throw AdaoExchangeLayerException("CholeskyFactorize : matrix is not square !");
+  for(std::size_t i=0;i<n;++i)
+    {
+      double *li(a.getRow(i));
+      for(std::size_t j=0;j<=i;++j)
+        {
+          const double *lj(a.getRow(j));
+          double s(li[j]-Dot(j,li,lj));
+          if(i==j)
+            {
+              if(s<=0.)
+                {
+                  std::ostringstream oss; oss << "CholeskyFactorize : matrix is not positive definite (pivot #" << i << ") !";
+                  throw AdaoExchangeLayerException(oss.str());
+                }
+              li[i] = std::sqrt(s);
+            }
+          else
+            li[j] = s/lj[j];
+        }
+      std::fill(li+i+1,li+n,0.);
+    }
+}
+
+/*!
+ * Solve L * transpose(L) * x = b in place. \a l is the output of CholeskyFactorize.
+ */
+void AdaoNative::CholeskySolve(const DenseMatrix& l, double *b)
+{
+  std::size_t n(l.getNumberOfRows());
+  for(std::size_t i=0;i<n;++i)
+    b[i] = (b[i]-Dot(i,l.getRow(i),b))/l(i,i);
+  for(std::size_t i=n;i>0;--i)
+    {
+      std::size_t ii(i-1);
+      double s(b[ii]);
+      for(std::size_t k=i;k<n;++k)
+        s -= l(k,ii)*b[k];
+      b[ii] = s/l(ii,ii);
+    }
+}
+
+/*!
+ * Solve L * transpose(L) * X = B in place where B has several columns. Rows of B are updated as a whole.
+ */
+static void CholeskySolveRows(const DenseMatrix& l, DenseMatrix& b)
+{
+  std::size_t n(l.getNumberOfRows()),nbCols(b.getNumberOfCols());
+  for(std::size_t i=0;i<n;++i)
+    {
+      double *bi(b.getRow(i));
+      const double *li(l.getRow(i));
+      for(std::size_t k=0;k<i;++k)
+        Axpy(nbCols,-li[k],b.getRow(k),bi);
+      double inv(1./li[i]);
+      for(std::size_t j=0;j<nbCols;++j)
+        bi[j] *= inv;
+    }
+  for(std::size_t i=n;i>0;--i)
+    {
+      std::size_t ii(i-1);
+      double *bi(b.getRow(ii));
+      for(std::size_t k=i;k<n;++k)
+        Axpy(nbCols,-l(k,ii),b.getRow(k),bi);
+      double inv(1./l(ii,ii));
+      for(std::size_t j=0;j<nbCols;++j)
+        bi[j] *= inv;
+    }
+}
+
+/*!
+ * Columns of \a m are replaced by the result of \a op (multiply or solve) applied to them.
+ */
+static void ApplyToColumns(const AdaoCovarianceOperator *op, bool solve, DenseMatrix& m)
+{
+  std::size_t n(m.getNumberOfRows()),nbCols(m.getNumberOfCols());
+  std::vector<double> col(n),res(n);
+  for(std::size_t j=0;j<nbCols;++j)
+    {
+      for(std::size_t i=0;i<n;++i)
+        col[i] = m(i,j);
+      if(solve)
+        op->solve(col.data(),res.data());
+      else
+        op->multiply(col.data(),res.data());
+      for(std::size_t i=0;i<n;++i)
+        m(i,j) = res[i];
+    }
+}
+
+/*!
+ * a += op or a += inverse(op), one column at a time.
+ */
+static void AddColumns(const AdaoCovarianceOperator *op, bool solve, DenseMatrix& a)
+{
+  std::size_t n(a.getNumberOfRows());
+  std::vector<double> e(n,0.),res(n);
+  for(std::size_t j=0;j<n;++j)
+    {
+      e[j] = 1.;
+      if(solve)
+        op->solve(e.data(),res.data());
+      else
+        op->multiply(e.data(),res.data());
+      e[j] = 0.;
+      for(std::size_t i=0;i<n;++i)
+        a(i,j) += res[i];
+    }
+}
+
+Covariance Covariance::FromScalar(double val)
+{
+  Covariance ret;
+  ret._kind = Kind::Scalar;
+  ret._scalar = std::abs(val);
+  return ret;
+}
+
+Covariance Covariance::FromDiagonal(const std::vector<double>& diag)
+{
+  Covariance ret;
+  ret._kind = Kind::Diagonal;
+  ret._diag = diag;
+  return ret;
+}
+
+Covariance Covariance::FromFull(const DenseMatrix& mat)
+{
+  Covariance ret;
+  ret._kind = Kind::Full;
+  ret._full = std::make_shared<DenseMatrix>(mat);
+  ret._cholesky = std::make_shared<DenseMatrix>(mat);
+  CholeskyFactorize(*ret._cholesky);
+  return ret;
+}
+
+Covariance Covariance::FromOperator(const AdaoCovarianceOperator *op)
+{
+  Covariance ret;
+  ret._kind = Kind::Operator;
+  ret._operator = op;
+  return ret;
+}
+
+/*!
+ * Covariance of the components \a ids only. Not available for an operator whose inverse is not the restriction of its inverse.
+ */
+Covariance Covariance::restrict(const std::vector<std::size_t>& ids) const
+{
+  switch(_kind)
+    {
+    case Kind::Scalar:
+      return *this;
+    case Kind::Diagonal:
+      {
+        if(std::any_of(ids.begin(),ids.end(),[this](std::size_t id) { return id>=_diag.size(); }))
+          throw AdaoExchangeLayerException("Covariance : restriction to ids out of range !");
+        std::vector<double> diag(ids.size());
+        for(std::size_t i=0;i<ids.size();++i)
+          diag[i] = _diag[ids[i]];
+        return FromDiagonal(diag);
+      }
+    case Kind::Full:
+      {
+        if(std::any_of(ids.begin(),ids.end(),[this](std::size_t id) { return id>=_full->getNumberOfRows(); }))
+          throw AdaoExchangeLayerException("Covariance : restriction to ids out of range !");
+        DenseMatrix mat(ids.size(),ids.size());
+        for(std::size_t i=0;i<ids.size();++i)
+          for(std::size_t j=0;j<ids.size();++j)
+            mat(i,j) = (*_full)(ids[i],ids[j]);
+        return FromFull(mat);
+      }
+    default:
+      throw AdaoExchangeLayerException("Covariance : restriction of a covariance operator is not supported !");
+    }
+}
+
+void Covariance::checkSize(std::size_t n) const
+{
+  std::size_t expected(0);
+  switch(_kind)
+    {
+    case Kind::Scalar:
+      return ;
+    case Kind::Diagonal:
+      expected = _diag.size();
+      break;
+    case Kind::Full:
+      expected = _full->getNumberOfRows();
+      break;
+    case Kind::Operator:
+      expected = _operator->getSize();
+      break;
+    }
+  if(expected!=n)
+    {
+      std::ostringstream oss; oss << "Covariance : size is " << expected << " whereas " << n << " is expected !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+}
+
+/*!
+ * v = C * v
+ */
+void Covariance::multiply(std::size_t n, double *v) const
+{
+  checkSize(n);
+  switch(_kind)
+    {
+    case Kind::Scalar:
+      for(std::size_t i=0;i<n;++i)
+        v[i] *= _scalar;
+      break;
+    case Kind::Diagonal:
+      for(std::size_t i=0;i<n;++i)
+        v[i] *= _diag[i];
+      break;
+    case Kind::Full:
+      {
+        std::vector<double> tmp(v,v+n);
+        MatVec(*_full,tmp.data(),v);
+        break;
+      }
+    case Kind::Operator:
+      {
+        std::vector<double> tmp(v,v+n);
+        _operator->multiply(tmp.data(),v);
+        break;
+      }
+    }
+}
+
+std::vector<double> Covariance::diagonal(std::size_t n) const
+{
+  checkSize(n);
+  switch(_kind)
+    {
+    case Kind::Scalar:
+      return std::vector<double>(n,_scalar);
+    case Kind::Diagonal:
+      return _diag;
+    case Kind::Full:
+      {
+        std::vector<double> ret(n);
+        for(std::size_t i=0;i<n;++i)
+          ret[i] = (*_full)(i,i);
+        return ret;
+      }
+    default:
+      return _operator->diagonal();
+    }
+}
+
+/*!
+ * v = inverse(C) * v
+ */
+void Covariance::solve(std::size_t n, double *v) const
+{
+  checkSize(n);
+  switch(_kind)
+    {
+    case Kind::Scalar:
+      for(std::size_t i=0;i<n;++i)
+        v[i] /= _scalar;
+      break;
+    case Kind::Diagonal:
+      for(std::size_t i=0;i<n;++i)
+        v[i] /= _diag[i];
+      break;
+    case Kind::Full:
+      CholeskySolve(*_cholesky,v);
+      break;
+    case Kind::Operator:
+      {
+        std::vector<double> tmp(v,v+n);
+        _operator->solve(tmp.data(),v);
+        break;
+      }
+    }
+}
+
+/*!
+ * m = C * m
+ */
+void Covariance::multiplyRows(DenseMatrix& m) const
+{
+  std::size_t n(m.getNumberOfRows()),nbCols(m.getNumberOfCols());
+  checkSize(n);
+  switch(_kind)
+    {
+    case Kind::Scalar:
+    case Kind::Diagonal:
+      for(std::size_t i=0;i<n;++i)
+        {
+          double coef(_kind==Kind::Scalar?_scalar:_diag[i]);
+          double *row(m.getRow(i));
+          for(std::size_t j=0;j<nbCols;++j)
+            row[j] *= coef;
+        }
+      break;
+    case Kind::Full:
+      {
+        DenseMatrix tmp;
+        MatMul(*_full,m,tmp);
+        m = tmp;
+        break;
+      }
+    case Kind::Operator:
+      ApplyToColumns(_operator,false,m);
+      break;
+    }
+}
+
+/*!
+ * m = inverse(C) * m
+ */
+void Covariance::solveRows(DenseMatrix& m) const
+{
+  std::size_t n(m.getNumberOfRows()),nbCols(m.getNumberOfCols());
+  checkSize(n);
+  switch(_kind)
+    {
+    case Kind::Scalar:
+    case Kind::Diagonal:
+      for(std::size_t i=0;i<n;++i)
+        {
+          double coef(1./(_kind==Kind::Scalar?_scalar:_diag[i]));
+          double *row(m.getRow(i));
+          for(std::size_t j=0;j<nbCols;++j)
+            row[j] *= coef;
+        }
+      break;
+    case Kind::Full:
+      CholeskySolveRows(*_cholesky,m);
+      break;
+    case Kind::Operator:
+      ApplyToColumns(_operator,true,m);
+      break;
+    }
+}
+
+/*!
+ * a += C
+ */
+void Covariance::addTo(DenseMatrix& a) const
+{
+  std::size_t n(a.getNumberOfRows());
+  checkSize(n);
+  switch(_kind)
+    {
+    case Kind::Scalar:
+      for(std::size_t i=0;i<n;++i)
+        a(i,i) += _scalar;
+      break;
+    case Kind::Diagonal:
+      for(std::size_t i=0;i<n;++i)
+        a(i,i) += _diag[i];
+      break;
+    case Kind::Full:
+      for(std::size_t i=0;i<n;++i)
+        Axpy(n,1.,_full->getRow(i),a.getRow(i));
+      break;
+    case Kind::Operator:
+      AddColumns(_operator,false,a);
+      break;
+    }
+}
+
+/*!
+ * a += inverse(C)
+ */
+void Covariance::addInverseTo(DenseMatrix& a) const
+{
+  std::size_t n(a.getNumberOfRows());
+  checkSize(n);
+  switch(_kind)
+    {
+    case Kind::Scalar:
+      for(std::size_t i=0;i<n;++i)
+        a(i,i) += 1./_scalar;
+      break;
+    case Kind::Diagonal:
+      for(std::size_t i=0;i<n;++i)
+        a(i,i) += 1./_diag[i];
+      break;
+    case Kind::Full:
+      {
+        DenseMatrix inv(n,n);
+        for(std::size_t i=0;i<n;++i)
+          inv(i,i) = 1.;
+        CholeskySolveRows(*_cholesky,inv);
+        for(std::size_t i=0;i<n;++i)
+          Axpy(n,1.,inv.getRow(i),a.getRow(i));
+        break;
+      }
+    case Kind::Operator:
+      AddColumns(_operator,true,a);
+      break;
+    }
+}
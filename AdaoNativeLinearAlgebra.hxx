@@ -0,0 +1,110 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+class AdaoCovarianceOperator;
+
+#ifdef _MSC_VER
+#define AEL_RESTRICT __restrict
+#else
+#define AEL_RESTRICT __restrict__
+#endif
+
+namespace AdaoNative
+{
+  /*!
+   * Dense row major matrix.
+   */
+  class DenseMatrix
+  {
+  public:
+    DenseMatrix() { }
+    DenseMatrix(std::size_t nbRows, std::size_t nbCols):_nb_rows(nbRows),_nb_cols(nbCols),_data(nbRows*nbCols,0.) { }
+    std::size_t getNumberOfRows() const { return _nb_rows; }
+    std::size_t getNumberOfCols() const { return _nb_cols; }
+    double *getRow(std::size_t i) { return _data.data()+i*_nb_cols; }
+    const double *getRow(std::size_t i) const { return _data.data()+i*_nb_cols; }
+    double& operator()(std::size_t i, std::size_t j) { return _data[i*_nb_cols+j]; }
+    double operator()(std::size_t i, std::size_t j) const { return _data[i*_nb_cols+j]; }
+    double *data() { return _data.data(); }
+    const double *data() const { return _data.data(); }
+    DenseMatrix transpose() const;
+  private:
+    std::size_t _nb_rows = 0;
+    std::size_t _nb_cols = 0;
+    std::vector<double> _data;
+  };
+
+  // Kernels are blocked to keep operands in cache. Inner loops run on contiguous rows to be vectorized by the compiler.
+  double Dot(std::size_t n, const double *AEL_RESTRICT x, const double *AEL_RESTRICT y);
+  void Axpy(std::size_t n, double alpha, const double *AEL_RESTRICT x, double *AEL_RESTRICT y);
+  void MatMul(const DenseMatrix& a, const DenseMatrix& b, DenseMatrix& c);
+  void TransMatMul(const DenseMatrix& a, const DenseMatrix& b, DenseMatrix& c);
+  void MatVec(const DenseMatrix& a, const double *x, double *y);
+  void TransMatVec(const DenseMatrix& a, const double *x, double *y);
+  void CholeskyFactorize(DenseMatrix& a);
+  void CholeskySolve(const DenseMatrix& l, double *b);
+  double Mean(std::size_t n, const double *x);
+  std::vector<double> FiniteDifferenceIncrements(const std::vector<double>& x, double increment);
+
+  /*!
+   * Error covariance matrix as described by GenericError : ScalarSparseMatrix, DiagonalSparseMatrix, Matrix or ObjectMatrix
+   * (AdaoCovarianceOperator, not owned, applied column by column).
+   */
+  class Covariance
+  {
+  public:
+    enum class Kind
+    {
+        Scalar,
+        Diagonal,
+        Full,
+        Operator
+    };
+  public:
+    static Covariance FromScalar(double val);
+    static Covariance FromDiagonal(const std::vector<double>& diag);
+    static Covariance FromFull(const DenseMatrix& mat);
+    static Covariance FromOperator(const AdaoCovarianceOperator *op);
+    Kind getKind() const { return _kind; }
+    Covariance restrict(const std::vector<std::size_t>& ids) const;
+    void multiply(std::size_t n, double *v) const;
+    void solve(std::size_t n, double *v) const;
+    std::vector<double> diagonal(std::size_t n) const;
+    void multiplyRows(DenseMatrix& m) const;
+    void solveRows(DenseMatrix& m) const;
+    void addTo(DenseMatrix& a) const;
+    void addInverseTo(DenseMatrix& a) const;
+  private:
+    void checkSize(std::size_t n) const;
+  private:
+    Kind _kind = Kind::Scalar;
+    double _scalar = 1.;
+    std::vector<double> _diag;
+    std::shared_ptr<DenseMatrix> _full;
+    std::shared_ptr<DenseMatrix> _cholesky;
+    const AdaoCovarianceOperator *_operator = nullptr;
+  };
+}
@@ -0,0 +1,91 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include "AdaoExchangeLayerException.hxx"
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+class AdaoEvaluator;
+
+/*!
+ * Part of a case solved as an independent sub-case by the native engine (see AdaoExchangeLayer::addPartition).
+ * Sub-case state is made of \a stateIds followed by halo ids, its observation of \a observationIds.
+ * Halo components are estimated by the sub-case but only values of \a stateIds are kept in global analysis.
+ * Sub-case observation operator is, if given, \a evaluator working on these local vectors (ordered as getExtendedStateIds
+ * and getObservationIds). Otherwise it is the global evaluator, components out of the sub-case being taken in background.
+ */
+class AdaoPartition
+{
+public:
+  AdaoPartition(const std::vector<std::size_t>& stateIds, const std::vector<std::size_t>& observationIds):_state_ids(stateIds),_observation_ids(observationIds)
+  {
+    if(_state_ids.empty())
+      throw AdaoExchangeLayerException("AdaoPartition : no state component given !");
+  }
+  void setHalo(const std::vector<std::size_t>& haloStateIds) { _halo_state_ids = haloStateIds; }
+  void setEvaluator(AdaoEvaluator *evaluator) { _evaluator = evaluator; }
+  const std::vector<std::size_t>& getStateIds() const { return _state_ids; }
+  const std::vector<std::size_t>& getHaloStateIds() const { return _halo_state_ids; }
+  const std::vector<std::size_t>& getObservationIds() const { return _observation_ids; }
+  std::vector<std::size_t> getExtendedStateIds() const
+  {
+    std::vector<std::size_t> ret(_state_ids);
+    ret.insert(ret.end(),_halo_state_ids.begin(),_halo_state_ids.end());
+    return ret;
+  }
+  AdaoEvaluator *getEvaluator() const { return _evaluator; }
+  /*!
+   * Splits state in \a nbOfPartitions contiguous blocks of same size, observations being assumed to be spread along state the same way.
+   * Halo of a block is made of the \a haloWidth state components on each side. A partition uses the observations located on its block and its halo.
+   */
+  static std::vector<AdaoPartition> Blocks(std::size_t stateSize, std::size_t observationSize, std::size_t nbOfPartitions, std::size_t haloWidth = 0)
+  {
+    if(nbOfPartitions==0 || nbOfPartitions>stateSize)
+      throw AdaoExchangeLayerException("AdaoPartition::Blocks : number of partitions has to be in [1,size of state] !");
+    std::vector<AdaoPartition> ret;
+    for(std::size_t p=0;p<nbOfPartitions;++p)
+      {
+        std::size_t stateBg(p*stateSize/nbOfPartitions),stateEnd((p+1)*stateSize/nbOfPartitions);
+        std::size_t haloBg(stateBg-std::min(stateBg,haloWidth)),haloEnd(std::min(stateSize,stateEnd+haloWidth));
+        std::size_t obsBg(haloBg*observationSize/stateSize),obsEnd(haloEnd*observationSize/stateSize);
+        std::vector<std::size_t> stateIds(stateEnd-stateBg),obsIds(obsEnd-obsBg),halo;
+        for(std::size_t i=0;i<stateIds.size();++i)
+          stateIds[i] = stateBg+i;
+        for(std::size_t i=0;i<obsIds.size();++i)
+          obsIds[i] = obsBg+i;
+        for(std::size_t i=haloBg;i<stateBg;++i)
+          halo.push_back(i);
+        for(std::size_t i=stateEnd;i<haloEnd;++i)
+          halo.push_back(i);
+        ret.emplace_back(stateIds,obsIds);
+        ret.back().setHalo(halo);
+      }
+    return ret;
+  }
+private:
+  std::vector<std::size_t> _state_ids;
+  std::vector<std::size_t> _halo_state_ids;
+  std::vector<std::size_t> _observation_ids;
+  AdaoEvaluator *_evaluator = nullptr;
+};
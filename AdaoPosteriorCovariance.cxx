@@ -0,0 +1,247 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#include "AdaoPosteriorCovariance.hxx"
+#include "AdaoNativeEngine.hxx"
+#include "AdaoExchangeLayerException.hxx"
+
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+using namespace AdaoNative;
+
+const std::size_t PosteriorCovariance::OVERSAMPLING = 10;
+
+const unsigned int PosteriorCovariance::NB_OF_POWER_ITERATIONS = 2;
+
+/*!
+ * Modified Gram-Schmidt applied twice on rows of \a q. Rows dependent on previous ones are zeroed.
+ */
+static void Orthonormalize(DenseMatrix& q)
+{
+  std::size_t l(q.getNumberOfRows()),n(q.getNumberOfCols());
+  for(std::size_t i=0;i<l;++i)
+    {
+      double *qi(q.getRow(i));
+      double initialNorm(std::sqrt(Dot(n,qi,qi)));
+      for(int pass=0;pass<2;++pass)
+        for(std::size_t j=0;j<i;++j)
+          Axpy(n,-Dot(n,qi,q.getRow(j)),q.getRow(j),qi);
+      double norm(std::sqrt(Dot(n,qi,qi)));
+      if(norm<=1.e3*std::numeric_limits<double>::epsilon()*initialNorm)
+        std::fill(qi,qi+n,0.);
+      else
+        for(std::size_t k=0;k<n;++k)
+          qi[k] /= norm;
+    }
+}
+
+/*!
+ * Eigen decomposition of symmetric \a a by cyclic Jacobi rotations. \a a is overwritten : its diagonal holds the eigenvalues.
+ * Column j of returned matrix is the eigenvector of the j-th eigenvalue.
+ */
+static DenseMatrix JacobiEigen(DenseMatrix& a)
+{
+  constexpr unsigned int MAX_NB_OF_SWEEPS = 100;
+  std::size_t l(a.getNumberOfRows());
+  DenseMatrix v(l,l);
+  for(std::size_t i=0;i<l;++i)
+    v(i,i) = 1.;
+  double norm(std::sqrt(Dot(l*l,a.data(),a.data())));
+  for(unsigned int sweep=0;sweep<MAX_NB_OF_SWEEPS;++sweep)
+    {
+      double off(0.);
+      for(std::size_t p=0;p<l;++p)
+        for(std::size_t q=p+1;q<l;++q)
+          off += a(p,q)*a(p,q);
+      if(std::sqrt(off)<=std::numeric_limits<double>::epsilon()*norm)
+        break;
+      for(std::size_t p=0;p<l;++p)
+        for(std::size_t q=p+1;q<l;++q)
+          {
+            if(a(p,q)==0.)
+              continue;
+            double theta((a(q,q)-a(p,p))/(2.*a(p,q)));
+            double t((theta>=0.?1.:-1.)/(std::abs(theta)+std::sqrt(theta*theta+1.)));
+            double c(1./std::sqrt(t*t+1.)),s(t*c);
+            for(std::size_t k=0;k<l;++k)
+              {
+                double akp(a(k,p)),akq(a(k,q));
+                a(k,p) = c*akp-s*akq;
+                a(k,q) = s*akp+c*akq;
+              }
+            for(std::size_t k=0;k<l;++k)
+              {
+                double apk(a(p,k)),aqk(a(q,k));
+                a(p,k) = c*apk-s*aqk;
+                a(q,k) = s*apk+c*aqk;
+                double vkp(v(k,p)),vkq(v(k,q));
+                v(k,p) = c*vkp-s*vkq;
+                v(k,q) = s*vkp+c*vkq;
+              }
+          }
+    }
+  return v;
+}
+
+/*!
+ * \a ht is the transposed tangent at analysis (n x m).
+ */
+PosteriorCovariance::PosteriorCovariance(const Problem& pb, const DenseMatrix& ht):_size(ht.getNumberOfRows()),_b(pb._b),_in_observation_space(ht.getNumberOfCols()<=ht.getNumberOfRows())
+{
+  DenseMatrix h(ht.transpose());
+  if(_in_observation_space)
+    {
+      _g = ht;
+      _b.multiplyRows(_g);
+      MatMul(h,_g,_l);
+      pb._r.addTo(_l);
+    }
+  else
+    {
+      DenseMatrix rih(h);
+      pb._r.solveRows(rih);
+      TransMatMul(h,rih,_l);
+      _b.addInverseTo(_l);
+    }
+  CholeskyFactorize(_l);
+}
+
+/*!
+ * v = (B - A).v
+ */
+void PosteriorCovariance::multiplyReduction(double *v) const
+{
+  if(_in_observation_space)
+    {
+      std::vector<double> t(_l.getNumberOfRows());
+      TransMatVec(_g,v,t.data());
+      CholeskySolve(_l,t.data());
+      MatVec(_g,t.data(),v);
+    }
+  else
+    {
+      std::vector<double> av(v,v+_size);
+      CholeskySolve(_l,av.data());
+      _b.multiply(_size,v);
+      Axpy(_size,-1.,av.data(),v);
+    }
+}
+
+/*!
+ * v = A.v
+ */
+void PosteriorCovariance::multiply(double *v) const
+{
+  if(_in_observation_space)
+    {
+      std::vector<double> reduction(v,v+_size);
+      multiplyReduction(reduction.data());
+      _b.multiply(_size,v);
+      Axpy(_size,-1.,reduction.data(),v);
+    }
+  else
+    CholeskySolve(_l,v);
+}
+
+/*!
+ * A(i,i) = B(i,i) - |L^-1.G(i,:)|^2 or |L^-1.e_i|^2 : one triangular solve per component, nothing of size n^2.
+ */
+std::vector<double> PosteriorCovariance::diagonal() const
+{
+  std::size_t nl(_l.getNumberOfRows());
+  std::vector<double> ret(_in_observation_space?_b.diagonal(_size):std::vector<double>(_size,0.)),w(nl);
+  for(std::size_t i=0;i<_size;++i)
+    {
+      // forward substitution starting at first non zero component of right hand side
+      std::size_t first(_in_observation_space?0:i);
+      std::fill(w.begin(),w.end(),0.);
+      if(_in_observation_space)
+        std::copy(_g.getRow(i),_g.getRow(i)+nl,w.begin());
+      else
+        w[i] = 1.;
+      for(std::size_t k=first;k<nl;++k)
+        w[k] = (w[k]-Dot(k-first,_l.getRow(k)+first,w.data()+first))/_l(k,k);
+      double sq(Dot(nl-first,w.data()+first,w.data()+first));
+      ret[i] += _in_observation_space?-sq:sq;
+    }
+  return ret;
+}
+
+/*!
+ * Column (and row) \a j of A.
+ */
+std::vector<double> PosteriorCovariance::column(std::size_t j) const
+{
+  if(j>=_size)
+    throw AdaoExchangeLayerException("PosteriorCovariance::column : id out of range !");
+  std::vector<double> ret(_size,0.);
+  ret[j] = 1.;
+  multiply(ret.data());
+  return ret;
+}
+
+/*!
+ * Randomized eigen decomposition of B - A (symmetric positive, rank <= m) : range of B - A captured by products with
+ * rank + OVERSAMPLING random vectors, refined by NB_OF_POWER_ITERATIONS, then Rayleigh-Ritz on this basis.
+ * Memory is O(n.rank). Random generator is seeded so that result is reproducible.
+ */
+AdaoLowRankCovariance PosteriorCovariance::lowRank(std::size_t rank) const
+{
+  if(rank==0 || rank>_size)
+    throw AdaoExchangeLayerException("PosteriorCovariance::lowRank : rank has to be in [1,size of state] !");
+  std::size_t l(std::min(_size,rank+OVERSAMPLING));
+  DenseMatrix q(l,_size);
+  std::mt19937 generator(0);
+  std::normal_distribution<double> normal;
+  std::generate(q.data(),q.data()+l*_size,[&generator,&normal]() { return normal(generator); });
+  for(unsigned int it=0;it<=NB_OF_POWER_ITERATIONS;++it)
+    {
+      if(it>0)
+        Orthonormalize(q);
+      for(std::size_t i=0;i<l;++i)
+        multiplyReduction(q.getRow(i));
+    }
+  Orthonormalize(q);
+  DenseMatrix cq(q),t(l,l);
+  for(std::size_t i=0;i<l;++i)
+    multiplyReduction(cq.getRow(i));
+  for(std::size_t i=0;i<l;++i)
+    for(std::size_t j=0;j<=i;++j)
+      t(i,j) = t(j,i) = 0.5*(Dot(_size,q.getRow(i),cq.getRow(j))+Dot(_size,q.getRow(j),cq.getRow(i)));
+  DenseMatrix z(JacobiEigen(t));
+  std::vector<std::size_t> order(l);
+  std::iota(order.begin(),order.end(),0);
+  std::sort(order.begin(),order.end(),[&t](std::size_t a, std::size_t b) { return t(a,a)>t(b,b); });
+  AdaoLowRankCovariance ret;
+  ret._size = _size;
+  ret._values.resize(rank);
+  ret._vectors.assign(rank*_size,0.);
+  for(std::size_t j=0;j<rank;++j)
+    {
+      ret._values[j] = std::max(t(order[j],order[j]),0.);
+      for(std::size_t i=0;i<l;++i)
+        Axpy(_size,z(i,order[j]),q.getRow(i),ret._vectors.data()+j*_size);
+    }
+  return ret;
+}
@@ -0,0 +1,71 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include "AdaoNativeLinearAlgebra.hxx"
+
+#include <vector>
+#include <cstddef>
+
+/*!
+ * Rank k approximation of a posterior covariance A given as a reduction of the prior covariance B :
+ * A ~ B - sum_j _values[j].v_j.v_j^T where v_j is the j-th row of \a _vectors (k x n, row major). Values are decreasing.
+ */
+struct AdaoLowRankCovariance
+{
+  std::size_t _size = 0;
+  std::vector<double> _values;
+  std::vector<double> _vectors;
+};
+
+namespace AdaoNative
+{
+  class Problem;
+
+  /*!
+   * Posterior covariance A = (B^-1 + Ht.R^-1.H)^-1 of a problem linearized at analysis. Nothing of size n^2 is built when there
+   * are less observations than state components : A = B - G.(R + H.G)^-1.Gt with G = B.Ht, only the m x m matrix is factorized.
+   * Otherwise the n x n hessian is factorized, as done by BLUE.
+   */
+  class PosteriorCovariance
+  {
+  public:
+    PosteriorCovariance(const Problem& pb, const DenseMatrix& ht);
+    std::size_t getSize() const { return _size; }
+    void multiply(double *v) const;
+    std::vector<double> diagonal() const;
+    std::vector<double> column(std::size_t j) const;
+    AdaoLowRankCovariance lowRank(std::size_t rank) const;
+  private:
+    void multiplyReduction(double *v) const;
+  public:
+    static const std::size_t OVERSAMPLING;
+    static const unsigned int NB_OF_POWER_ITERATIONS;
+  private:
+    std::size_t _size = 0;
+    Covariance _b;
+    bool _in_observation_space = true;
+    //! B.Ht (n x m) in observation space only
+    DenseMatrix _g;
+    //! Cholesky factor of R + H.B.Ht or of B^-1 + Ht.R^-1.H
+    DenseMatrix _l;
+  };
+}
@@ -0,0 +1,139 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#include "AdaoPyConversion.hxx"
+#include "AdaoExchangeLayerException.hxx"
+#include "PyObjectRAII.hxx"
+
+#include <cstring>
+
+static bool IsFormat(const char *format, const char *expected)
+{
+  if(!format)
+    return false;
+  if(format[0]=='<' || format[0]=='=' || format[0]=='@')
+    format++;
+  return std::strcmp(format,expected)==0;
+}
+
+/*!
+ * Flatten \a obj (float, list, tuple, numpy array or matrix...) and append it to \a ret.
+ * Contiguous float64 and float32 numpy arrays are read directly through buffer protocol.
+ */
+void PyToDoubles(PyObject *obj, std::vector<double>& ret)
+{
+  if(PyFloat_Check(obj) || PyLong_Check(obj))
+    {
+      ret.push_back(PyFloat_AsDouble(obj));
+      return ;
+    }
+  if(PyObject_CheckBuffer(obj))
+    {
+      Py_buffer view;
+      if(PyObject_GetBuffer(obj,&view,PyBUF_C_CONTIGUOUS | PyBUF_FORMAT)==0)
+        {
+          bool isDouble(IsFormat(view.format,"d")),isFloat(IsFormat(view.format,"f"));
+          if(isDouble)
+            {
+              const double *pt(reinterpret_cast<const double *>(view.buf));
+              ret.insert(ret.end(),pt,pt+view.len/sizeof(double));
+            }
+          if(isFloat)
+            {
+              const float *pt(reinterpret_cast<const float *>(view.buf));
+              ret.insert(ret.end(),pt,pt+view.len/sizeof(float));
+            }
+          PyBuffer_Release(&view);
+          if(isDouble || isFloat)
+            return ;
+        }
+      else
+        PyErr_Clear();
+    }
+  PyObjectRAII fast(PyObjectRAII::FromNew(PySequence_Fast(obj,"not a sequence")));
+  if(fast.isNull())
+    {// numpy scalars
+      PyErr_Clear();
+      PyObjectRAII asFloat(PyObjectRAII::FromNew(PyNumber_Float(obj)));
+      if(asFloat.isNull())
+        {
+          PyErr_Clear();
+          throw AdaoExchangeLayerException("PyToDoubles : object is neither a sequence nor a number !");
+        }
+      ret.push_back(PyFloat_AsDouble(asFloat));
+      return ;
+    }
+  Py_ssize_t len(PySequence_Fast_GET_SIZE(fast.operator PyObject *()));
+  for(Py_ssize_t i=0;i<len;++i)
+    PyToDoubles(PySequence_Fast_GET_ITEM(fast.operator PyObject *(),i),ret);
+}
+
+/*!
+ * Returns a new reference on a python list of floats.
+ */
+PyObject *DoublesToPyList(const double *vals, std::size_t nbOfVals)
+{
+  PyObject *ret(PyList_New(nbOfVals));
+  for(std::size_t i=0;i<nbOfVals;++i)
+    PyList_SetItem(ret,i,PyFloat_FromDouble(vals[i]));
+  return ret;
+}
+
+static PyObjectRAII PickleFunction(const char *funcName)
+{
+  PyObjectRAII pickleModule(PyObjectRAII::FromNew(PyImport_ImportModule("pickle")));
+  if(pickleModule.isNull())
+    {
+      PyErr_Print();
+      throw AdaoExchangeLayerException("Fail to import pickle module !");
+    }
+  return PyObjectRAII::FromNew(PyObject_GetAttrString(pickleModule,funcName));
+}
+
+/*!
+ * Serialize \a obj with pickle (highest protocol, numpy arrays are dumped as raw buffers).
+ */
+std::string PickleToString(PyObject *obj)
+{
+  PyObjectRAII dumps(PickleFunction("dumps"));
+  PyObjectRAII res(PyObjectRAII::FromNew(PyObject_CallFunction(dumps,"Oi",obj,-1)));
+  if(res.isNull() || !PyBytes_Check(res.operator PyObject *()))
+    {
+      PyErr_Print();
+      throw AdaoExchangeLayerException("PickleToString : fail to pickle object !");
+    }
+  return std::string(PyBytes_AsString(res),PyBytes_Size(res));
+}
+
+/*!
+ * Returns a new reference.
+ */
+PyObject *UnpickleFromString(const std::string& data)
+{
+  PyObjectRAII loads(PickleFunction("loads"));
+  PyObjectRAII bytes(PyObjectRAII::FromNew(PyBytes_FromStringAndSize(data.data(),data.size())));
+  PyObjectRAII ret(PyObjectRAII::FromNew(PyObject_CallFunctionObjArgs(loads,bytes.operator PyObject *(),nullptr)));
+  if(ret.isNull())
+    {
+      PyErr_Print();
+      throw AdaoExchangeLayerException("UnpickleFromString : fail to unpickle object !");
+    }
+  return ret.retn();
+}
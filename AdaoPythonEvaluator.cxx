@@ -0,0 +1,72 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+
+#include "AdaoPythonEvaluator.hxx"
+#include "AdaoPyConversion.hxx"
+
+#include <sstream>
+
+/*!
+ * GIL is expected to be held by caller.
+ */
+AdaoPythonEvaluator::AdaoPythonEvaluator(PyObject *callable):_callable(PyObjectRAII::FromBorrowed(callable))
+{
+  if(!PyCallable_Check(callable))
+    throw AdaoExchangeLayerException("AdaoPythonEvaluator : object is not callable !");
+}
+
+AdaoPythonEvaluator::~AdaoPythonEvaluator()
+{
+  AutoGIL agil;
+  _callable = PyObjectRAII();
+}
+
+void AdaoPythonEvaluator::evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs)
+{
+  AutoGIL agil;
+  PyObjectRAII samples(PyObjectRAII::FromNew(PyList_New(nbOfSamples)));
+  for(std::size_t i=0;i<nbOfSamples;++i)
+    PyList_SetItem(samples,i,DoublesToPyList(inputs+i*inputSize,inputSize));
+  PyObjectRAII results(PyObjectRAII::FromNew(PyObject_CallFunctionObjArgs(_callable,samples.operator PyObject *(),nullptr)));
+  if(results.isNull())
+    {
+      PyErr_Print();
+      throw AdaoExchangeLayerException("AdaoPythonEvaluator : call of python evaluator has failed !");
+    }
+  PyObjectRAII fastResults(PyObjectRAII::FromNew(PySequence_Fast(results,"result is not a sequence")));
+  if(fastResults.isNull() || PySequence_Fast_GET_SIZE(fastResults.operator PyObject *())!=(Py_ssize_t)nbOfSamples)
+    {
+      PyErr_Clear();
+      throw AdaoExchangeLayerException("AdaoPythonEvaluator : python evaluator is expected to return a sequence with one element per sample !");
+    }
+  std::vector<double> result;
+  for(std::size_t i=0;i<nbOfSamples;++i)
+    {
+      result.clear();
+      PyToDoubles(PySequence_Fast_GET_ITEM(fastResults.operator PyObject *(),i),result);
+      if(result.size()!=outputSize)
+        {
+          std::ostringstream oss; oss << "AdaoPythonEvaluator : python evaluator returned " << result.size() << " values whereas " << outputSize << " are expected !";
+          throw AdaoExchangeLayerException(oss.str());
+        }
+      std::copy(result.begin(),result.end(),outputs+i*outputSize);
+    }
+}
@@ -0,0 +1,41 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+
+#pragma once
+
+#include "AdaoEvaluator.hxx"
+#include "PyObjectRAII.hxx"
+
+/*!
+ * Evaluator calling a python callable with the list of samples (lists of floats). It returns one sequence of floats per sample.
+ * Thread state is attached during the call only : with free-threaded python builds (Py_GIL_DISABLED), concurrent calls
+ * (partitions, speculation, several layers) run in parallel, they are serialized by the GIL otherwise.
+ * Can be used by native engine and by python engine in push mode.
+ */
+class AdaoPythonEvaluator : public AdaoEvaluator
+{
+public:
+  AdaoPythonEvaluator(PyObject *callable);
+  ~AdaoPythonEvaluator();
+  void evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs) override;
+private:
+  PyObjectRAII _callable;
+};
@@ -0,0 +1,214 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#include "AdaoRemoteEngine.hxx"
+#include "AdaoExchangeLayerException.hxx"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <cstdlib>
+
+#include <csignal>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+std::string AdaoRemoteEngine::HelperExecutable()
+{
+  const char *env(std::getenv("ADAO_ENGINE_PROCESS"));
+  if(env && env[0]!='\0')
+    return std::string(env);
+  return std::string("AdaoEngineProcess");
+}
+
+/*!
+ * Path of \a exe as execvp would find it : \a exe itself if it contains a '/', else the first executable file named \a exe
+ * in PATH. Searching PATH allocates : it is done before fork.
+ */
+static std::string ResolveExecutable(const std::string& exe)
+{
+  if(exe.find('/')!=std::string::npos)
+    return exe;
+  const char *env(std::getenv("PATH"));
+  std::string path(env?env:"/bin:/usr/bin");
+  std::size_t pos(0);
+  while(true)
+    {
+      std::size_t end(path.find(':',pos));
+      std::string dir(path.substr(pos,end==std::string::npos?std::string::npos:end-pos));
+      std::string candidate((dir.empty()?std::string("."):dir) + "/" + exe);
+      struct stat st;
+      if(stat(candidate.c_str(),&st)==0 && S_ISREG(st.st_mode) && access(candidate.c_str(),X_OK)==0)
+        return candidate;
+      if(end==std::string::npos)
+        break;
+      pos = end+1;
+    }
+  throw AdaoExchangeLayerException(std::string("AdaoRemoteEngine : executable \"") + exe + "\" not found in PATH !");
+}
+
+/*!
+ * The helper is killed when the thread creating this (not the process) ends : see PR_SET_PDEATHSIG in prctl(2).
+ * This has to be created by a long lived thread, typically the one driving the case.
+ */
+AdaoRemoteEngine::AdaoRemoteEngine(std::size_t capacity)
+{
+  static std::atomic<unsigned int> CNT(0);
+  std::ostringstream oss; oss << "/adaoexchange_" << getpid() << "_" << CNT++;
+  _channel.reset(new AdaoShmChannel(AdaoShmChannel::Create(oss.str(),capacity)));
+  // everything needed by child is prepared before fork : only async-signal-safe calls in child
+  std::string exe(ResolveExecutable(HelperExecutable()));
+  std::string channelName(_channel->getName());
+  char *argv[] = { &exe[0], &channelName[0], nullptr };
+  pid_t parent(getpid());
+  _pid = fork();
+  if(_pid<0)
+    throw AdaoExchangeLayerException("AdaoRemoteEngine : fork failed !");
+  if(_pid==0)
+    {
+#ifdef __linux__
+      prctl(PR_SET_PDEATHSIG,SIGKILL);
+      if(getppid()!=parent)// parent ended before prctl : death signal would never come
+        _exit(127);
+#endif
+      execv(argv[0],argv);
+      _exit(127);
+    }
+  _channel->setPeerChecker([this]() { this->checkHelper(); });
+  std::string payload;
+  if(_channel->recv(payload)!=AdaoShmMessage::Ready)
+    throw AdaoExchangeLayerException("AdaoRemoteEngine : unexpected first message from helper !");
+  _channel->unlink();
+}
+
+/*!
+ * Helper is asked to quit. It is killed if it does not within one second or if it is still executing a case.
+ */
+AdaoRemoteEngine::~AdaoRemoteEngine()
+{
+  if(_pid<=0)
+    return ;
+  if(!_executing)
+    {
+      try
+        {
+          _channel->send(AdaoShmMessage::Quit,std::string());
+          for(int i=0;i<100;++i)
+            {
+              if(waitpid(_pid,nullptr,WNOHANG)==_pid)
+                return ;
+              std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+      catch(AdaoExchangeLayerException& e)
+        { }
+    }
+  kill(_pid,SIGKILL);
+  waitpid(_pid,nullptr,0);
+}
+
+void AdaoRemoteEngine::checkHelper()
+{
+  if(_pid<=0)
+    throw AdaoExchangeLayerException("AdaoRemoteEngine : no helper process !");
+  int status(0);
+  if(waitpid(_pid,&status,WNOHANG)==_pid)
+    {
+      _pid = -1;
+      _executing = false;
+      std::ostringstream oss; oss << "AdaoRemoteEngine : helper process \"" << HelperExecutable() << "\" has ended unexpectedly";
+      if(WIFEXITED(status))
+        oss << " (exit code " << WEXITSTATUS(status) << ")";
+      oss << " !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+}
+
+std::string AdaoRemoteEngine::request(AdaoShmMessage kind, const std::string& payload, const char *where)
+{
+  if(_executing)
+    throw AdaoExchangeLayerException(std::string(where) + " : ADAO case is still executing !");
+  _channel->send(kind,payload);
+  std::string ret;
+  AdaoShmMessage answer(_channel->recv(ret));
+  if(answer==AdaoShmMessage::Error)
+    throw AdaoExchangeLayerException(std::string(where) + " : " + ret);
+  if(answer!=AdaoShmMessage::Data)
+    throw AdaoExchangeLayerException(std::string(where) + " : unexpected answer from helper process !");
+  return ret;
+}
+
+/*!
+ * \a pickledVariables is a pickled dict put in the context of helper, before running \a script in it.
+ */
+void AdaoRemoteEngine::load(const std::string& pickledVariables, const std::string& script)
+{
+  request(AdaoShmMessage::Variables,pickledVariables,"AdaoRemoteEngine::load");
+  request(AdaoShmMessage::Setup,script,"AdaoRemoteEngine::load");
+}
+
+void AdaoRemoteEngine::execute()
+{
+  if(_executing)
+    throw AdaoExchangeLayerException("AdaoRemoteEngine::execute : ADAO case is already executing !");
+  _channel->send(AdaoShmMessage::Execute,std::string());
+  _executing = true;
+}
+
+bool AdaoRemoteEngine::next(std::string& pickledSamples)
+{
+  if(!_executing)
+    return false;
+  AdaoShmMessage kind(_channel->recv(pickledSamples));
+  switch(kind)
+    {
+    case AdaoShmMessage::Samples:
+      return true;
+    case AdaoShmMessage::Finished:
+      _executing = false;
+      return false;
+    case AdaoShmMessage::Error:
+      _executing = false;
+      throw AdaoExchangeLayerException(std::string("AdaoRemoteEngine::next : ") + pickledSamples);
+    default:
+      _executing = false;
+      throw AdaoExchangeLayerException("AdaoRemoteEngine::next : unexpected message from helper process !");
+    }
+}
+
+void AdaoRemoteEngine::setResult(const std::string& pickledResult)
+{
+  if(!_executing)
+    throw AdaoExchangeLayerException("AdaoRemoteEngine::setResult : no execution in progress !");
+  _channel->send(AdaoShmMessage::Result,pickledResult);
+}
+
+/*!
+ * Returns the pickled value of python \a expression evaluated in the context of helper.
+ */
+std::string AdaoRemoteEngine::eval(const std::string& expression)
+{
+  return request(AdaoShmMessage::Eval,expression,"AdaoRemoteEngine::eval");
+}
@@ -0,0 +1,56 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include "AdaoShmChannel.hxx"
+
+#include <string>
+#include <memory>
+
+#include <sys/types.h>
+
+/*!
+ * Host side of the out of process engine. Launches the AdaoEngineProcess helper (found using ADAO_ENGINE_PROCESS
+ * environment variable, or in PATH) and drives the ADAO case it holds through an AdaoShmChannel.
+ * Payloads are pickled python objects : no python is involved here.
+ * The helper is killed when the thread that created the engine ends : it has to be created by a long lived thread.
+ */
+class AdaoRemoteEngine
+{
+public:
+  AdaoRemoteEngine(std::size_t capacity = DFT_CAPACITY);
+  ~AdaoRemoteEngine();
+  void load(const std::string& pickledVariables, const std::string& script);
+  void execute();
+  bool next(std::string& pickledSamples);
+  void setResult(const std::string& pickledResult);
+  std::string eval(const std::string& expression);
+  static std::string HelperExecutable();
+public:
+  static const std::size_t DFT_CAPACITY = 4*1024*1024;
+private:
+  void checkHelper();
+  std::string request(AdaoShmMessage kind, const std::string& payload, const char *where);
+private:
+  pid_t _pid = -1;
+  std::unique_ptr<AdaoShmChannel> _channel;
+  bool _executing = false;
+};
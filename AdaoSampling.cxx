@@ -0,0 +1,217 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+
+#include "AdaoSampling.hxx"
+#include "AdaoModelKeyVal.hxx"
+#include "AdaoExchangeLayerException.hxx"
+#include "AdaoPyConversion.hxx"
+#include "PyObjectRAII.hxx"
+
+#include <algorithm>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static std::vector< std::vector<double> > ReadListOfVectors(PyObject *obj, const std::string& key)
+{
+  PyObjectRAII fast(PyObjectRAII::FromNew(PySequence_Fast(obj,"not a sequence")));
+  if(fast.isNull())
+    {
+      PyErr_Clear();
+      throw AdaoExchangeLayerException(std::string("AdaoSamplingDesign : ") + key + " is expected to be a sequence of sequences !");
+    }
+  std::size_t nb(PySequence_Fast_GET_SIZE(fast.operator PyObject *()));
+  std::vector< std::vector<double> > ret(nb);
+  for(std::size_t i=0;i<nb;++i)
+    PyToDoubles(PySequence_Fast_GET_ITEM(fast.operator PyObject *(),i),ret[i]);
+  return ret;
+}
+
+AdaoSamplingDesign AdaoSamplingDesign::FromnUplet(const std::vector< std::vector<double> >& samples)
+{
+  AdaoSamplingDesign ret;
+  ret._nb_of_samples = samples.size();
+  ret._sample_size = samples.empty()?0:samples[0].size();
+  ret._samples.reserve(ret._nb_of_samples*ret._sample_size);
+  for(const auto& sample : samples)
+    {
+      if(sample.size()!=ret._sample_size)
+        throw AdaoExchangeLayerException("AdaoSamplingDesign::FromnUplet : samples are expected to have the same size !");
+      ret._samples.insert(ret._samples.end(),sample.begin(),sample.end());
+    }
+  return ret;
+}
+
+AdaoSamplingDesign AdaoSamplingDesign::FromExplicitHyperCube(const std::vector< std::vector<double> >& valuesOfComponents)
+{
+  AdaoSamplingDesign ret;
+  ret._sample_size = valuesOfComponents.size();
+  ret._nb_of_samples = valuesOfComponents.empty()?0:1;
+  for(const auto& values : valuesOfComponents)
+    ret._nb_of_samples *= values.size();
+  ret._values_of_components = valuesOfComponents;
+  return ret;
+}
+
+/*!
+ * Values of a component are numpy.linspace(min,max,1+int((max-min)/step)), as ADAO does. They are computed as numpy does
+ * (i*delta+min, delta=(max-min)/(nb-1), last one being max) so that samples are bitwise the ones of ADAO.
+ */
+AdaoSamplingDesign AdaoSamplingDesign::FromMinMaxStepHyperCube(const std::vector< std::array<double,3> >& minMaxSteps)
+{
+  std::vector< std::vector<double> > valuesOfComponents;
+  for(const auto& minMaxStep : minMaxSteps)
+    {
+      if(minMaxStep[2]<=0. || minMaxStep[1]<minMaxStep[0])
+        throw AdaoExchangeLayerException("AdaoSamplingDesign::FromMinMaxStepHyperCube : [min,max,step] expected with min <= max and step > 0 !");
+      std::size_t nb(1+(std::size_t)((minMaxStep[1]-minMaxStep[0])/minMaxStep[2]));
+      std::vector<double> values(nb,minMaxStep[0]);
+      if(nb>1)
+        {
+          double delta((minMaxStep[1]-minMaxStep[0])/(double)(nb-1));
+          for(std::size_t i=1;i<nb-1;++i)
+            values[i] = (double)i*delta+minMaxStep[0];
+          values[nb-1] = minMaxStep[1];
+        }
+      valuesOfComponents.push_back(values);
+    }
+  return FromExplicitHyperCube(valuesOfComponents);
+}
+
+/*!
+ * Reads the sampling keys of AlgorithmParameters/Parameters, exactly one being expected to be set. GIL is expected to be held by caller.
+ */
+AdaoSamplingDesign AdaoSamplingDesign::FromModel(AdaoModel::MainModel *model)
+{
+  const std::string path(std::string(AdaoModel::AlgorithmParameters::KEY) + "/" + AdaoModel::ParametersOfAlgorithmParameters::KEY + "/");
+  std::vector<AdaoSamplingDesign> designs;
+  for(const char *key : {AdaoModel::SampleAsnUplet::KEY,AdaoModel::SampleAsExplicitHyperCube::KEY,AdaoModel::SampleAsMinMaxStepHyperCube::KEY})
+    {
+      AdaoModel::PyObjKeyVal *leaf(dynamic_cast<AdaoModel::PyObjKeyVal *>(model->findByPath(path + key)));
+      if(!leaf || leaf->getVarName().empty() || !leaf->getVal() || leaf->getVal()==Py_None)
+        continue;
+      std::vector< std::vector<double> > lists(ReadListOfVectors(leaf->getVal(),key));
+      if(std::string(key)==AdaoModel::SampleAsnUplet::KEY)
+        designs.push_back(FromnUplet(lists));
+      else if(std::string(key)==AdaoModel::SampleAsExplicitHyperCube::KEY)
+        designs.push_back(FromExplicitHyperCube(lists));
+      else
+        {
+          std::vector< std::array<double,3> > minMaxSteps;
+          for(const auto& elt : lists)
+            {
+              if(elt.size()!=3)
+                throw AdaoExchangeLayerException("AdaoSamplingDesign : SampleAsMinMaxStepHyperCube is expected to be a sequence of [min,max,step] !");
+              minMaxSteps.push_back({elt[0],elt[1],elt[2]});
+            }
+          designs.push_back(FromMinMaxStepHyperCube(minMaxSteps));
+        }
+    }
+  if(designs.size()!=1)
+    throw AdaoExchangeLayerException("AdaoSamplingDesign : exactly one of SampleAsnUplet, SampleAsExplicitHyperCube and SampleAsMinMaxStepHyperCube has to be set !");
+  return designs[0];
+}
+
+/*!
+ * Writes samples [\a firstSample, \a firstSample + \a nbOfSamples) row by row in \a samples.
+ */
+void AdaoSamplingDesign::fillSamples(std::size_t firstSample, std::size_t nbOfSamples, double *samples) const
+{
+  if(firstSample+nbOfSamples>_nb_of_samples)
+    throw AdaoExchangeLayerException("AdaoSamplingDesign::fillSamples : sample out of range !");
+  if(_values_of_components.empty())
+    {
+      std::copy(_samples.begin()+firstSample*_sample_size,_samples.begin()+(firstSample+nbOfSamples)*_sample_size,samples);
+      return ;
+    }
+  std::vector<std::size_t> ids(_sample_size);// position of firstSample in the hypercube, then incremented like an odometer
+  std::size_t remainder(firstSample);
+  for(std::size_t j=_sample_size;j>0;--j)
+    {
+      ids[j-1] = remainder%_values_of_components[j-1].size();
+      remainder /= _values_of_components[j-1].size();
+    }
+  for(std::size_t i=0;i<nbOfSamples;++i)
+    {
+      for(std::size_t j=0;j<_sample_size;++j)
+        samples[i*_sample_size+j] = _values_of_components[j][ids[j]];
+      for(std::size_t j=_sample_size;j>0 && ++ids[j-1]==_values_of_components[j-1].size();--j)
+        ids[j-1] = 0;
+    }
+}
+
+AdaoSamplingResult::AdaoSamplingResult(std::size_t nbOfSamples, std::size_t outputSize, const std::string& fileName, bool withCostFunctions):_nb_of_samples(nbOfSamples),_output_size(outputSize),_file_name(fileName)
+{
+  std::size_t nbOfValues(nbOfSamples*outputSize);
+  if(fileName.empty())
+    {
+      _in_memory.resize(nbOfValues);
+      _data = _in_memory.data();
+    }
+  else
+    {
+      _fd = open(fileName.c_str(),O_RDWR | O_CREAT | O_TRUNC,0644);
+      if(_fd<0)
+        {
+          std::ostringstream oss; oss << "AdaoSamplingResult : impossible to open \"" << fileName << "\" !";
+          throw AdaoExchangeLayerException(oss.str());
+        }
+      _map_size = nbOfValues*sizeof(double);
+      if(_map_size>0)
+        {
+          void *map(MAP_FAILED);
+          if(ftruncate(_fd,_map_size)==0)
+            map = mmap(nullptr,_map_size,PROT_READ | PROT_WRITE,MAP_SHARED,_fd,0);
+          if(map==MAP_FAILED)
+            {
+              close(_fd);
+              std::ostringstream oss; oss << "AdaoSamplingResult : impossible to map " << _map_size << " bytes of \"" << fileName << "\" !";
+              throw AdaoExchangeLayerException(oss.str());
+            }
+          _data = reinterpret_cast<double *>(map);
+        }
+    }
+  if(withCostFunctions)
+    {
+      _j.resize(nbOfSamples);
+      _jb.resize(nbOfSamples);
+      _jo.resize(nbOfSamples);
+    }
+}
+
+AdaoSamplingResult::~AdaoSamplingResult()
+{
+  if(_fd>=0)
+    {
+      if(_data)
+        munmap(_data,_map_size);
+      close(_fd);
+    }
+}
+
+void AdaoSamplingResult::setCostFunction(std::size_t sampleId, double jb, double jo)
+{
+  _j[sampleId] = jb+jo;
+  _jb[sampleId] = jb;
+  _jo[sampleId] = jo;
+}
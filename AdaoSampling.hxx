@@ -0,0 +1,88 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace AdaoModel
+{
+  class MainModel;
+}
+
+/*!
+ * Samples of a sampling task, generated on demand chunk by chunk : an hypercube is never expanded in memory.
+ * Samples of an hypercube are ordered as itertools.product of the values of each component (last component varying fastest).
+ */
+class AdaoSamplingDesign
+{
+public:
+  static AdaoSamplingDesign FromnUplet(const std::vector< std::vector<double> >& samples);
+  static AdaoSamplingDesign FromExplicitHyperCube(const std::vector< std::vector<double> >& valuesOfComponents);
+  static AdaoSamplingDesign FromMinMaxStepHyperCube(const std::vector< std::array<double,3> >& minMaxSteps);
+  static AdaoSamplingDesign FromModel(AdaoModel::MainModel *model);
+  std::size_t getNumberOfSamples() const { return _nb_of_samples; }
+  std::size_t getSampleSize() const { return _sample_size; }
+  void fillSamples(std::size_t firstSample, std::size_t nbOfSamples, double *samples) const;
+private:
+  std::size_t _nb_of_samples = 0;
+  std::size_t _sample_size = 0;
+  //! nUplet : samples row by row. Empty for an hypercube
+  std::vector<double> _samples;
+  std::vector< std::vector<double> > _values_of_components;
+};
+
+/*!
+ * Preallocated outputs of a sampling task, one row of getOutputSize() values per sample, either in memory or in a memory mapped file
+ * (raw float64 row major, without header) whose pages are written back by the system when memory is short.
+ * SamplingTest also gives the cost function (and its two terms) at each sample.
+ */
+class AdaoSamplingResult
+{
+public:
+  AdaoSamplingResult(std::size_t nbOfSamples, std::size_t outputSize, const std::string& fileName, bool withCostFunctions);
+  ~AdaoSamplingResult();
+  AdaoSamplingResult(const AdaoSamplingResult&) = delete;
+  AdaoSamplingResult& operator=(const AdaoSamplingResult&) = delete;
+  std::size_t getNumberOfSamples() const { return _nb_of_samples; }
+  std::size_t getOutputSize() const { return _output_size; }
+  const std::string& getFileName() const { return _file_name; }
+  const double *getOutputs(std::size_t sampleId) const { return _data+sampleId*_output_size; }
+  double *getOutputs(std::size_t sampleId) { return _data+sampleId*_output_size; }
+  const std::vector<double>& getCostFunctionJ() const { return _j; }
+  const std::vector<double>& getCostFunctionJb() const { return _jb; }
+  const std::vector<double>& getCostFunctionJo() const { return _jo; }
+  void setCostFunction(std::size_t sampleId, double jb, double jo);
+private:
+  std::size_t _nb_of_samples = 0;
+  std::size_t _output_size = 0;
+  std::string _file_name;
+  std::vector<double> _in_memory;
+  int _fd = -1;
+  std::size_t _map_size = 0;
+  double *_data = nullptr;
+  std::vector<double> _j;
+  std::vector<double> _jb;
+  std::vector<double> _jo;
+};
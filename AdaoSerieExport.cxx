@@ -0,0 +1,193 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+
+#include "AdaoSerieExport.hxx"
+#include "AdaoExchangeLayerException.hxx"
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+  //! magic, version, header length and dictionary padded with spaces : 64 bytes aligned, room for 20 digits counts
+  constexpr std::size_t NPY_HEADER_SIZE = 128;
+
+  void WriteAll(int fd, const char *data, std::size_t len, std::size_t offset)
+  {
+    while(len>0)
+      {
+        ssize_t nb(pwrite(fd,data,len,offset));
+        if(nb<=0)
+          throw AdaoExchangeLayerException("AdaoNpyAppender : write failed on npy file !");
+        data+=nb; len-=nb; offset+=nb;
+      }
+  }
+}
+
+AdaoNpyAppender::AdaoNpyAppender(const std::string& fileName):_file_name(fileName)
+{
+  _fd = open(fileName.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0644);
+  if(_fd<0)
+    {
+      std::ostringstream oss; oss << "AdaoNpyAppender : impossible to open \"" << fileName << "\" !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+  writeHeader();
+}
+
+AdaoNpyAppender::~AdaoNpyAppender()
+{
+  if(_fd>=0)
+    close(_fd);
+}
+
+void AdaoNpyAppender::writeHeader()
+{
+  std::ostringstream oss;
+  oss << "{'descr': '<f8', 'fortran_order': False, 'shape': (" << _nb_of_rows << ", " << _row_size << "), }";
+  std::string dict(oss.str());
+  std::string header("\x93NUMPY\x01\x00",8);
+  std::uint16_t headerLen(NPY_HEADER_SIZE-10);
+  header += (char)(headerLen & 0xFF);
+  header += (char)(headerLen >> 8);
+  header += dict;
+  header.resize(NPY_HEADER_SIZE-1,' ');
+  header += '\n';
+  WriteAll(_fd,header.data(),header.size(),0);
+}
+
+/*!
+ * All rows have the size of the first one.
+ */
+void AdaoNpyAppender::append(std::size_t rowSize, const double *row)
+{
+  if(_nb_of_rows==0)
+    _row_size = rowSize;
+  if(rowSize!=_row_size)
+    {
+      std::ostringstream oss; oss << "AdaoNpyAppender : row of size " << rowSize << " appended to \"" << _file_name << "\" whose rows have size " << _row_size << " !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+  WriteAll(_fd,reinterpret_cast<const char *>(row),rowSize*sizeof(double),NPY_HEADER_SIZE+_nb_of_rows*_row_size*sizeof(double));
+  _nb_of_rows++;
+  writeHeader();
+}
+
+AdaoSerieExporter::AdaoSerieExporter(std::size_t maxNbOfPendingRows):_max_nb_of_pending_rows(std::max<std::size_t>(1,maxNbOfPendingRows))
+{
+  _writer = std::thread(&AdaoSerieExporter::run,this);
+}
+
+AdaoSerieExporter::~AdaoSerieExporter()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _cond.notify_all();
+  _writer.join();
+}
+
+/*!
+ * Creates (or truncates) \a fileName. Returns the id of the serie, to be given to append.
+ */
+std::size_t AdaoSerieExporter::addSerie(const std::string& fileName)
+{
+  std::unique_ptr<AdaoNpyAppender> appender(new AdaoNpyAppender(fileName));
+  std::lock_guard<std::mutex> lock(_mutex);
+  _appenders.push_back(std::move(appender));
+  return _appenders.size()-1;
+}
+
+void AdaoSerieExporter::append(std::size_t serieId, std::vector<double>&& row)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  if(serieId>=_appenders.size())
+    throw AdaoExchangeLayerException("AdaoSerieExporter::append : unknown serie !");
+  _cond.wait(lock,[this] { return _pending.size()<_max_nb_of_pending_rows || _error; });
+  throwIfFailed();
+  _pending.emplace_back(serieId,std::move(row));
+  _cond.notify_all();
+}
+
+/*!
+ * Waits for all rows appended to be written.
+ */
+void AdaoSerieExporter::flush()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  _cond.wait(lock,[this] { return (_pending.empty() && _nb_of_rows_being_written==0) || _error; });
+  throwIfFailed();
+}
+
+std::size_t AdaoSerieExporter::getNumberOfRows(std::size_t serieId)
+{
+  flush();
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _appenders.at(serieId)->getNumberOfRows();
+}
+
+/*!
+ * To be called with _mutex held.
+ */
+void AdaoSerieExporter::throwIfFailed()
+{
+  if(_error)
+    std::rethrow_exception(_error);
+}
+
+/*!
+ * Writer thread : rows are written outside of the lock, appenders being only touched by this thread once created.
+ */
+void AdaoSerieExporter::run()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  for(;;)
+    {
+      _cond.wait(lock,[this] { return !_pending.empty() || _stop; });
+      if(_pending.empty())
+        return ;
+      std::pair< std::size_t,std::vector<double> > row(std::move(_pending.front()));
+      _pending.pop_front();
+      _nb_of_rows_being_written = 1;
+      AdaoNpyAppender *appender(_appenders[row.first].get());
+      _cond.notify_all();
+      lock.unlock();
+      std::exception_ptr error;
+      try
+        {
+          appender->append(row.second.size(),row.second.data());
+        }
+      catch(...)
+        {
+          error = std::current_exception();
+        }
+      lock.lock();
+      _nb_of_rows_being_written = 0;
+      if(error && !_error)
+        _error = error;
+      _cond.notify_all();
+    }
+}
@@ -0,0 +1,86 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <exception>
+#include <condition_variable>
+#include <cstddef>
+
+/*!
+ * .npy file (format 1.0, little endian float64, C order) of shape (number of rows, row size), growing by appending rows.
+ * The header is sized once for any row count and rewritten in place after each append : numpy.load reads the rows appended so far.
+ */
+class AdaoNpyAppender
+{
+public:
+  AdaoNpyAppender(const std::string& fileName);
+  ~AdaoNpyAppender();
+  AdaoNpyAppender(const AdaoNpyAppender&) = delete;
+  AdaoNpyAppender& operator=(const AdaoNpyAppender&) = delete;
+  const std::string& getFileName() const { return _file_name; }
+  void append(std::size_t rowSize, const double *row);
+  std::size_t getNumberOfRows() const { return _nb_of_rows; }
+  std::size_t getRowSize() const { return _row_size; }
+private:
+  void writeHeader();
+private:
+  std::string _file_name;
+  int _fd = -1;
+  std::size_t _nb_of_rows = 0;
+  std::size_t _row_size = 0;
+};
+
+/*!
+ * Series written to AdaoNpyAppender by a background thread, so that I/O overlaps with computation. At most \a maxNbOfPendingRows rows
+ * wait to be written (append blocks beyond) : memory used does not depend on the length of the series.
+ * First write error is thrown by the next append or flush.
+ */
+class AdaoSerieExporter
+{
+public:
+  AdaoSerieExporter(std::size_t maxNbOfPendingRows = 64);
+  ~AdaoSerieExporter();
+  std::size_t addSerie(const std::string& fileName);
+  void append(std::size_t serieId, std::vector<double>&& row);
+  void flush();
+  std::size_t getNumberOfRows(std::size_t serieId);
+private:
+  void run();
+  void throwIfFailed();
+private:
+  std::size_t _max_nb_of_pending_rows;
+  std::vector< std::unique_ptr<AdaoNpyAppender> > _appenders;
+  std::deque< std::pair< std::size_t,std::vector<double> > > _pending;
+  //! number of rows taken by the writer thread but not written yet
+  std::size_t _nb_of_rows_being_written = 0;
+  bool _stop = false;
+  std::exception_ptr _error;
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  std::thread _writer;
+};
@@ -0,0 +1,227 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#include "AdaoShmChannel.hxx"
+#include "AdaoExchangeLayerException.hxx"
+
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <new>
+#include <sstream>
+#include <algorithm>
+
+#include <semaphore.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct AdaoShmMailbox
+{
+  sem_t _full;
+  sem_t _empty;
+  std::uint32_t _kind;
+  std::uint64_t _total_size;
+  std::uint64_t _chunk_size;
+};
+
+struct AdaoShmSegment
+{
+  AdaoShmMailbox _to_helper;
+  AdaoShmMailbox _to_host;
+  std::uint64_t _capacity;
+};
+
+namespace
+{
+  char *PayloadOf(AdaoShmSegment *seg, bool toHelper)
+  {
+    char *base(reinterpret_cast<char *>(seg)+sizeof(AdaoShmSegment));
+    return toHelper?base:base+seg->_capacity;
+  }
+
+  //! to helper if creator is sending or helper is receiving
+  AdaoShmMailbox *MailboxOf(AdaoShmSegment *seg, bool toHelper)
+  {
+    return toHelper?&seg->_to_helper:&seg->_to_host;
+  }
+}
+
+AdaoShmChannel::AdaoShmChannel(const std::string& name, bool isCreator, void *map, std::size_t mapSize):_name(name),_is_creator(isCreator),_is_linked(isCreator),_map(map),_map_size(mapSize)
+{
+}
+
+AdaoShmChannel::AdaoShmChannel(AdaoShmChannel&& other):_name(other._name),_is_creator(other._is_creator),_is_linked(other._is_linked),_map(other._map),_map_size(other._map_size),_check_peer(other._check_peer)
+{
+  other._map = nullptr;
+  other._is_linked = false;
+}
+
+/*!
+ * Creates segment \a name (see shm_open) with two mailboxes of \a capacity bytes.
+ */
+AdaoShmChannel AdaoShmChannel::Create(const std::string& name, std::size_t capacity)
+{
+  if(capacity==0)
+    throw AdaoExchangeLayerException("AdaoShmChannel::Create : capacity must be > 0 !");
+  int fd(shm_open(name.c_str(),O_RDWR | O_CREAT | O_EXCL,0600));
+  if(fd<0)
+    {
+      std::ostringstream oss; oss << "AdaoShmChannel::Create : shm_open of \"" << name << "\" failed (" << std::strerror(errno) << ") !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+  std::size_t sz(sizeof(AdaoShmSegment)+2*capacity);
+  if(ftruncate(fd,sz)!=0)
+    {
+      close(fd); shm_unlink(name.c_str());
+      throw AdaoExchangeLayerException("AdaoShmChannel::Create : ftruncate failed !");
+    }
+  void *map(mmap(nullptr,sz,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0));
+  close(fd);
+  if(map==MAP_FAILED)
+    {
+      shm_unlink(name.c_str());
+      throw AdaoExchangeLayerException("AdaoShmChannel::Create : mmap failed !");
+    }
+  AdaoShmSegment *seg(new(map) AdaoShmSegment);
+  seg->_capacity = capacity;
+  for(AdaoShmMailbox *mb : {&seg->_to_helper,&seg->_to_host})
+    {
+      if(sem_init(&mb->_full,1,0)!=0 || sem_init(&mb->_empty,1,1)!=0)
+        throw AdaoExchangeLayerException("AdaoShmChannel::Create : process shared semaphore initialization failed !");
+      mb->_kind = 0; mb->_total_size = 0; mb->_chunk_size = 0;
+    }
+  return AdaoShmChannel(name,true,map,sz);
+}
+
+AdaoShmChannel AdaoShmChannel::Open(const std::string& name)
+{
+  int fd(shm_open(name.c_str(),O_RDWR,0600));
+  if(fd<0)
+    {
+      std::ostringstream oss; oss << "AdaoShmChannel::Open : shm_open of \"" << name << "\" failed (" << std::strerror(errno) << ") !";
+      throw AdaoExchangeLayerException(oss.str());
+    }
+  struct stat st;
+  if(fstat(fd,&st)!=0 || (std::size_t)st.st_size<sizeof(AdaoShmSegment))
+    {
+      close(fd);
+      throw AdaoExchangeLayerException("AdaoShmChannel::Open : segment is too small !");
+    }
+  void *map(mmap(nullptr,st.st_size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0));
+  close(fd);
+  if(map==MAP_FAILED)
+    throw AdaoExchangeLayerException("AdaoShmChannel::Open : mmap failed !");
+  return AdaoShmChannel(name,false,map,st.st_size);
+}
+
+AdaoShmChannel::~AdaoShmChannel()
+{
+  if(!_map)
+    return ;
+  if(_is_creator)
+    {
+      AdaoShmSegment *seg(reinterpret_cast<AdaoShmSegment *>(_map));
+      for(AdaoShmMailbox *mb : {&seg->_to_helper,&seg->_to_host})
+        { sem_destroy(&mb->_full); sem_destroy(&mb->_empty); }
+    }
+  munmap(_map,_map_size);
+  unlink();
+}
+
+/*!
+ * Remove the name of the segment. Can be done as soon as peer has opened it.
+ */
+void AdaoShmChannel::unlink()
+{
+  if(_is_linked)
+    shm_unlink(_name.c_str());
+  _is_linked = false;
+}
+
+void AdaoShmChannel::waitOn(void *semPt)
+{
+  sem_t *sem(reinterpret_cast<sem_t *>(semPt));
+  if(!_check_peer)
+    {
+      while(sem_wait(sem)!=0)
+        if(errno!=EINTR)
+          throw AdaoExchangeLayerException("AdaoShmChannel : sem_wait failed !");
+      return ;
+    }
+  while(true)
+    {
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME,&ts);
+      ts.tv_nsec += 100000000;
+      if(ts.tv_nsec>=1000000000)
+        { ts.tv_sec++; ts.tv_nsec-=1000000000; }
+      if(sem_timedwait(sem,&ts)==0)
+        return ;
+      if(errno!=ETIMEDOUT && errno!=EINTR)
+        throw AdaoExchangeLayerException("AdaoShmChannel : sem_timedwait failed !");
+      _check_peer();
+    }
+}
+
+void AdaoShmChannel::send(AdaoShmMessage kind, const std::string& payload)
+{
+  AdaoShmSegment *seg(reinterpret_cast<AdaoShmSegment *>(_map));
+  bool toHelper(_is_creator);
+  AdaoShmMailbox *mb(MailboxOf(seg,toHelper));
+  char *dest(PayloadOf(seg,toHelper));
+  std::size_t pos(0);
+  do
+    {
+      std::size_t chunk(std::min<std::size_t>(seg->_capacity,payload.size()-pos));
+      waitOn(&mb->_empty);
+      mb->_kind = (std::uint32_t)kind;
+      mb->_total_size = payload.size();
+      mb->_chunk_size = chunk;
+      std::memcpy(dest,payload.data()+pos,chunk);
+      pos += chunk;
+      sem_post(&mb->_full);
+    }
+  while(pos<payload.size());
+}
+
+AdaoShmMessage AdaoShmChannel::recv(std::string& payload)
+{
+  AdaoShmSegment *seg(reinterpret_cast<AdaoShmSegment *>(_map));
+  bool toHelper(!_is_creator);
+  AdaoShmMailbox *mb(MailboxOf(seg,toHelper));
+  const char *src(PayloadOf(seg,toHelper));
+  payload.clear();
+  AdaoShmMessage ret;
+  std::size_t total(0);
+  do
+    {
+      waitOn(&mb->_full);
+      ret = (AdaoShmMessage)mb->_kind;
+      total = mb->_total_size;
+      if(payload.empty())
+        payload.reserve(total);
+      payload.append(src,mb->_chunk_size);
+      sem_post(&mb->_empty);
+    }
+  while(payload.size()<total);
+  return ret;
+}
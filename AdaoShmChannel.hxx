@@ -0,0 +1,75 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include <string>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+/*!
+ * Messages exchanged between AdaoExchangeLayer and the AdaoEngineProcess helper.
+ */
+enum class AdaoShmMessage : std::uint32_t
+{
+    Ready,
+    Variables,
+    Setup,
+    Execute,
+    Samples,
+    Result,
+    Finished,
+    Eval,
+    Data,
+    Error,
+    Quit
+};
+
+struct AdaoShmSegment;
+
+/*!
+ * Half duplex channel between two processes through a POSIX shared memory segment holding one mailbox per direction.
+ * Messages larger than the capacity of a mailbox are transferred by chunks.
+ */
+class AdaoShmChannel
+{
+public:
+  static AdaoShmChannel Create(const std::string& name, std::size_t capacity);
+  static AdaoShmChannel Open(const std::string& name);
+  AdaoShmChannel(AdaoShmChannel&& other);
+  ~AdaoShmChannel();
+  const std::string& getName() const { return _name; }
+  void unlink();
+  void send(AdaoShmMessage kind, const std::string& payload);
+  AdaoShmMessage recv(std::string& payload);
+  //! \a checkPeer is called periodically while waiting and is expected to throw if peer is dead
+  void setPeerChecker(std::function<void()> checkPeer) { _check_peer = checkPeer; }
+private:
+  AdaoShmChannel(const std::string& name, bool isCreator, void *map, std::size_t mapSize);
+  void waitOn(void *sem);
+private:
+  std::string _name;
+  bool _is_creator = false;
+  bool _is_linked = false;
+  void *_map = nullptr;
+  std::size_t _map_size = 0;
+  std::function<void()> _check_peer;
+};
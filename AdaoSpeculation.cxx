@@ -0,0 +1,123 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#include "AdaoSpeculation.hxx"
+#include "AdaoNativeLinearAlgebra.hxx"
+
+#include <algorithm>
+
+std::string AdaoSpeculation::KeyOf(std::size_t inputSize, const double *input)
+{
+  return std::string(reinterpret_cast<const char *>(input),inputSize*sizeof(double));
+}
+
+void AdaoSpeculation::reset()
+{
+  stop();
+  _cache.clear();
+  _nb_of_speculative_evaluations = 0;
+  _nb_of_hits = 0;
+}
+
+void AdaoSpeculation::stop()
+{
+  if(!_thread.joinable())
+    return ;
+  _stop_requested = true;
+  _thread.join();
+}
+
+/*!
+ * Points of ADAO FDApproximation around \a x, stored row by row : x+dx[i].e_i (then x-dx[i].e_i if centered)
+ * with dx given by AdaoNative::FiniteDifferenceIncrements.
+ */
+std::vector<double> AdaoSpeculation::finiteDifferencePoints(const std::vector<double>& x) const
+{
+  std::size_t n(x.size());
+  std::vector<double> dx(AdaoNative::FiniteDifferenceIncrements(x,_differential_increment));
+  std::size_t nbOfPoints(_centered?2*n:n);
+  std::vector<double> ret(nbOfPoints*n);
+  for(std::size_t p=0;p<nbOfPoints;++p)
+    {
+      std::size_t i(p%n);
+      std::copy(x.begin(),x.end(),ret.begin()+p*n);
+      ret[p*n+i] = p<n?x[i]+dx[i]:x[i]-dx[i];
+    }
+  return ret;
+}
+
+/*!
+ * Launch the evaluation of the finite difference points around \a x not already known. Previous speculation is forgotten.
+ */
+void AdaoSpeculation::start(AdaoEvaluator *evaluator, const std::vector<double>& x, std::size_t outputSize)
+{
+  std::size_t n(x.size());
+  std::vector<double> points(finiteDifferencePoints(x));
+  _cache.clear();
+  _stop_requested = false;
+  _thread = std::thread([this,evaluator,n,outputSize,points]()
+    {
+      std::size_t nbOfPoints(points.size()/n),chunk(_chunk_size==0?nbOfPoints:_chunk_size);
+      std::vector<double> outputs;
+      try
+        {
+          for(std::size_t bg=0;bg<nbOfPoints && !_stop_requested;bg+=chunk)
+            {
+              std::size_t nb(std::min(chunk,nbOfPoints-bg));
+              outputs.resize(nb*outputSize);
+              evaluator->evaluate(nb,n,points.data()+bg*n,outputSize,outputs.data());
+              _nb_of_speculative_evaluations += nb;
+              for(std::size_t p=0;p<nb;++p)
+                _cache[KeyOf(n,points.data()+(bg+p)*n)].assign(outputs.begin()+p*outputSize,outputs.begin()+(p+1)*outputSize);
+            }
+        }
+      catch(...)
+        {// speculation is only an opportunity : true request will evaluate again
+        }
+    });
+}
+
+void AdaoSpeculation::evaluate(AdaoEvaluator *evaluator, std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs)
+{
+  stop();
+  std::vector<std::size_t> misses;
+  for(std::size_t i=0;i<nbOfSamples;++i)
+    {
+      auto it(_cache.find(KeyOf(inputSize,inputs+i*inputSize)));
+      if(it!=_cache.end() && it->second.size()==outputSize)
+        {
+          std::copy(it->second.begin(),it->second.end(),outputs+i*outputSize);
+          _nb_of_hits++;
+        }
+      else
+        misses.push_back(i);
+    }
+  if(!misses.empty())
+    {
+      std::vector<double> subInputs(misses.size()*inputSize),subOutputs(misses.size()*outputSize);
+      for(std::size_t i=0;i<misses.size();++i)
+        std::copy(inputs+misses[i]*inputSize,inputs+(misses[i]+1)*inputSize,subInputs.begin()+i*inputSize);
+      evaluator->evaluate(misses.size(),inputSize,subInputs.data(),outputSize,subOutputs.data());
+      for(std::size_t i=0;i<misses.size();++i)
+        std::copy(subOutputs.begin()+i*outputSize,subOutputs.begin()+(i+1)*outputSize,outputs+misses[i]*outputSize);
+    }
+  if(nbOfSamples==1)
+    start(evaluator,std::vector<double>(inputs,inputs+inputSize),outputSize);
+}
@@ -0,0 +1,82 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include "AdaoEvaluator.hxx"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+
+/*!
+ * Speculative evaluation of the samples ADAO is likely to request next, run while ADAO (python) computes its update.
+ * A request of a single sample is the evaluation of a new iterate by the cost function : the gradient asked just after needs
+ * the finite difference points around it, built as ADAO FDApproximation does (same increments, bitwise identical). They are
+ * evaluated in the background, \a chunkSize at a time (0 meaning all at once), and kept in a cache.
+ *
+ * Each request first stops the speculation (waiting for the chunk in flight, evaluator is never called concurrently),
+ * then answers the cached samples and evaluates the others. A speculation failure is silently dropped.
+ */
+class AdaoSpeculation
+{
+public:
+  AdaoSpeculation(std::size_t chunkSize):_chunk_size(chunkSize) { }
+  ~AdaoSpeculation() { stop(); }
+  std::size_t getChunkSize() const { return _chunk_size; }
+  void setFiniteDifference(double increment, bool centered) { _differential_increment = increment; _centered = centered; }
+  void reset();
+  void stop();
+  void evaluate(AdaoEvaluator *evaluator, std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs);
+  std::size_t getNumberOfSpeculativeEvaluations() const { return _nb_of_speculative_evaluations; }
+  std::size_t getNumberOfHits() const { return _nb_of_hits; }
+private:
+  void start(AdaoEvaluator *evaluator, const std::vector<double>& x, std::size_t outputSize);
+  std::vector<double> finiteDifferencePoints(const std::vector<double>& x) const;
+  static std::string KeyOf(std::size_t inputSize, const double *input);
+private:
+  std::size_t _chunk_size = 0;
+  double _differential_increment = 0.01;
+  bool _centered = false;
+  std::thread _thread;
+  std::atomic<bool> _stop_requested{false};
+  //! results of the last speculation. Written by speculation thread, read after stop only
+  std::unordered_map< std::string, std::vector<double> > _cache;
+  std::atomic<std::size_t> _nb_of_speculative_evaluations{0};
+  std::size_t _nb_of_hits = 0;
+};
+
+/*!
+ * Evaluator speculating with \a speculation around the iterates it evaluates with \a evaluator (not owned).
+ */
+class AdaoEvaluatorWithSpeculation : public AdaoEvaluator
+{
+public:
+  AdaoEvaluatorWithSpeculation(AdaoEvaluator *evaluator, AdaoSpeculation *speculation):_evaluator(evaluator),_speculation(speculation) { }
+  void evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs) override
+  {
+    _speculation->evaluate(_evaluator,nbOfSamples,inputSize,inputs,outputSize,outputs);
+  }
+private:
+  AdaoEvaluator *_evaluator = nullptr;
+  AdaoSpeculation *_speculation = nullptr;
+};
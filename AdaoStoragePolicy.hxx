@@ -0,0 +1,51 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include "AdaoExchangeLayerException.hxx"
+
+#include <string>
+
+/*!
+ * How ADAO keeps in memory the successive values of a stored variable (StoreSupplementaryCalculations).
+ * - KeepLast : only the last \a n values are kept,
+ * - KeepEvery : only one value every \a k iterations is kept,
+ * - SpillToFile : every value is appended to \a fileName (raw float64) and the last \a n are kept in memory.
+ *   AdaoExchangeLayer::getSerie then reads the whole history from the file (memory mapped).
+ */
+class AdaoStoragePolicy
+{
+public:
+  static AdaoStoragePolicy KeepLast(unsigned int n) { check(n); AdaoStoragePolicy ret; ret._keep_last=n; return ret; }
+  static AdaoStoragePolicy KeepEvery(unsigned int k) { check(k); AdaoStoragePolicy ret; ret._keep_every=k; return ret; }
+  static AdaoStoragePolicy SpillToFile(const std::string& fileName, unsigned int n = 1) { check(n); AdaoStoragePolicy ret; ret._keep_last=n; ret._spill_file=fileName; return ret; }
+  unsigned int getKeepLast() const { return _keep_last; }
+  unsigned int getKeepEvery() const { return _keep_every; }
+  const std::string& getSpillFile() const { return _spill_file; }
+  bool isSpilled() const { return !_spill_file.empty(); }
+private:
+  static void check(unsigned int val) { if(val==0) throw AdaoExchangeLayerException("AdaoStoragePolicy : value has to be > 0 !"); }
+private:
+  //! 0 means no limit
+  unsigned int _keep_last = 0;
+  unsigned int _keep_every = 1;
+  std::string _spill_file;
+};
@@ -0,0 +1,216 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#include "AdaoSurrogate.hxx"
+
+#include <cmath>
+#include <algorithm>
+
+static double Norm(std::size_t n, const double *x)
+{
+  return std::sqrt(AdaoNative::Dot(n,x,x));
+}
+
+static double Distance(std::size_t n, const double *x, const double *y)
+{
+  double ret(0.);
+  for(std::size_t i=0;i<n;++i)
+    ret += (x[i]-y[i])*(x[i]-y[i]);
+  return std::sqrt(ret);
+}
+
+static double PerturbationRadius(double increment, const std::vector<double>& center)
+{
+  return 2.*increment*std::max(Norm(center.size(),center.data()),1.);
+}
+
+AdaoSurrogate::AdaoSurrogate(double relativeTolerance):_relative_tolerance(relativeTolerance)
+{
+  if(relativeTolerance<=0.)
+    throw AdaoExchangeLayerException("AdaoSurrogate : relative tolerance is expected to be > 0 !");
+}
+
+/*!
+ * Forget all evaluations learnt so far. To be called between two cases.
+ */
+void AdaoSurrogate::reset()
+{
+  _center_x.clear();
+  _center_y.clear();
+  _jacobian = AdaoNative::DenseMatrix();
+  _nb_of_corrections = 0;
+  _curvature = -1.;
+}
+
+double AdaoSurrogate::radius() const
+{
+  return PerturbationRadius(_differential_increment,_center_x);
+}
+
+double AdaoSurrogate::distanceToCenter(std::size_t inputSize, const double *input) const
+{
+  return Distance(inputSize,input,_center_x.data());
+}
+
+/*!
+ * Fill \a output and return true if the model is confident about \a input. \a output is left untouched otherwise.
+ */
+bool AdaoSurrogate::predict(std::size_t inputSize, const double *input, std::size_t outputSize, double *output)
+{
+  if(_center_x.size()!=inputSize || _center_y.size()!=outputSize)
+    return false;
+  double dist(distanceToCenter(inputSize,input));
+  if(dist==0.)
+    {
+      std::copy(_center_y.begin(),_center_y.end(),output);
+      ++_nb_of_predictions;
+      return true;
+    }
+  if(_nb_of_corrections<inputSize || _curvature<0. || dist>radius())
+    return false;
+  if(_curvature*dist*dist>_relative_tolerance*Norm(outputSize,_center_y.data()))
+    {
+      ++_nb_of_refusals;
+      return false;
+    }
+  std::vector<double> dx(inputSize);
+  for(std::size_t i=0;i<inputSize;++i)
+    dx[i] = input[i]-_center_x[i];
+  AdaoNative::MatVec(_jacobian,dx.data(),output);
+  for(std::size_t i=0;i<outputSize;++i)
+    output[i] += _center_y[i];
+  ++_nb_of_predictions;
+  return true;
+}
+
+/*!
+ * Correct the model with the true evaluation \a output of \a input.
+ */
+void AdaoSurrogate::learn(std::size_t inputSize, const double *input, std::size_t outputSize, const double *output)
+{
+  if(_center_x.size()!=inputSize || _center_y.size()!=outputSize)
+    {
+      reset();
+      _center_x.assign(input,input+inputSize);
+      _center_y.assign(output,output+outputSize);
+      _jacobian = AdaoNative::DenseMatrix(outputSize,inputSize);
+      return ;
+    }
+  std::vector<double> dx(inputSize),r(outputSize);
+  for(std::size_t i=0;i<inputSize;++i)
+    dx[i] = input[i]-_center_x[i];
+  double dist2(AdaoNative::Dot(inputSize,dx.data(),dx.data()));
+  if(dist2==0.)
+    return ;
+  AdaoNative::MatVec(_jacobian,dx.data(),r.data());
+  for(std::size_t i=0;i<outputSize;++i)
+    r[i] = output[i]-_center_y[i]-r[i];
+  if(_nb_of_corrections>=inputSize)
+    {// residual of a trained model is the second order term
+      double curvature(Norm(outputSize,r.data())/dist2);
+      _curvature = _curvature<0.?curvature:std::max(curvature,0.5*_curvature);
+    }
+  for(std::size_t i=0;i<outputSize;++i)
+    AdaoNative::Axpy(inputSize,r[i]/dist2,dx.data(),_jacobian.getRow(i));
+  ++_nb_of_corrections;
+  if(std::sqrt(dist2)>radius())
+    {
+      _center_x.assign(input,input+inputSize);
+      _center_y.assign(output,output+outputSize);
+    }
+}
+
+/*!
+ * Fill \a outputs with one result per sample of \a inputs. Samples the model is not confident about are given to \a trueEvaluation
+ * (which fills \a outputs at the requested ids) in at most two calls : samples far from the center (new iterate of the algorithm)
+ * first, then those that remain unpredictable once the model has learnt the first ones.
+ * Return false if \a trueEvaluation failed.
+ */
+bool AdaoSurrogate::evaluate(const std::vector< std::vector<double> >& inputs, std::vector< std::vector<double> >& outputs,
+                             const std::function<bool(const std::vector<std::size_t>&, std::vector< std::vector<double> >&)>& trueEvaluation)
+{
+  std::size_t nbOfSamples(inputs.size());
+  outputs.resize(nbOfSamples);
+  std::vector<std::size_t> misses;
+  for(std::size_t i=0;i<nbOfSamples;++i)
+    {
+      outputs[i].resize(_center_y.size());
+      if(!predict(inputs[i].size(),inputs[i].data(),outputs[i].size(),outputs[i].data()))
+        misses.push_back(i);
+    }
+  std::vector<std::size_t> anchors,others;
+  for(auto id : misses)
+    {
+      const std::vector<double>& x(inputs[id]);
+      bool isNear(_center_x.size()==x.size() && distanceToCenter(x.size(),x.data())<=radius());
+      for(auto it=anchors.begin();it!=anchors.end() && !isNear;++it)
+        isNear = inputs[*it].size()==x.size() && Distance(x.size(),x.data(),inputs[*it].data())<=PerturbationRadius(_differential_increment,inputs[*it]);
+      (isNear?others:anchors).push_back(id);
+    }
+  if(anchors.empty() || others.empty())
+    {
+      anchors = misses;
+      others.clear();
+    }
+  for(int round=0;round<2;++round)
+    {
+      std::vector<std::size_t> toEvaluate;
+      if(round==0)
+        toEvaluate = anchors;
+      else
+        for(auto id : others)
+          {
+            outputs[id].resize(_center_y.size());
+            if(!predict(inputs[id].size(),inputs[id].data(),outputs[id].size(),outputs[id].data()))
+              toEvaluate.push_back(id);
+          }
+      if(toEvaluate.empty())
+        continue;
+      if(!trueEvaluation(toEvaluate,outputs))
+        return false;
+      _nb_of_true_evaluations += toEvaluate.size();
+      for(auto id : toEvaluate)
+        learn(inputs[id].size(),inputs[id].data(),outputs[id].size(),outputs[id].data());
+    }
+  return true;
+}
+
+void AdaoEvaluatorWithSurrogate::evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs)
+{
+  std::vector< std::vector<double> > ins(nbOfSamples),outs;
+  for(std::size_t i=0;i<nbOfSamples;++i)
+    ins[i].assign(inputs+i*inputSize,inputs+(i+1)*inputSize);
+  _surrogate->evaluate(ins,outs,[this,&ins,inputSize,outputSize](const std::vector<std::size_t>& ids, std::vector< std::vector<double> >& res)
+                       {
+                         std::vector<double> subInputs(ids.size()*inputSize),subOutputs(ids.size()*outputSize);
+                         for(std::size_t i=0;i<ids.size();++i)
+                           std::copy(ins[ids[i]].begin(),ins[ids[i]].end(),subInputs.begin()+i*inputSize);
+                         _evaluator->evaluate(ids.size(),inputSize,subInputs.data(),outputSize,subOutputs.data());
+                         for(std::size_t i=0;i<ids.size();++i)
+                           res[ids[i]].assign(subOutputs.begin()+i*outputSize,subOutputs.begin()+(i+1)*outputSize);
+                         return true;
+                       });
+  for(std::size_t i=0;i<nbOfSamples;++i)
+    {
+      if(outs[i].size()!=outputSize)
+        throw AdaoExchangeLayerException("AdaoEvaluatorWithSurrogate : unexpected size of output !");
+      std::copy(outs[i].begin(),outs[i].end(),outputs+i*outputSize);
+    }
+}
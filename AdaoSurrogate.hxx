@@ -0,0 +1,84 @@
+// Copyright (C) 2019 EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+// Author: Anthony Geay, anthony.geay@edf.fr, EDF R&D
+
+#pragma once
+
+#include "AdaoEvaluator.hxx"
+#include "AdaoNativeLinearAlgebra.hxx"
+
+#include <vector>
+#include <functional>
+
+/*!
+ * Local linear model of the observation operator H used to answer the finite difference points instead of the true evaluator.
+ * Model is H(x) ~ H(c) + J.(x-c) where c is the last true evaluation far from the previous one. J is built by rank one (Broyden)
+ * corrections with each true evaluation : starting from 0, the finite difference points of the first iteration give exactly the
+ * finite difference Jacobian.
+ *
+ * The residual of each correction gives an estimate K of the curvature of H. A point x is answered by the model only when
+ * its estimated error K.|x-c|^2 is lower than relativeTolerance.|H(c)|, and only when |x-c| is lower than the perturbation radius
+ * (2.DifferentialIncrement.max(|c|,1)). Other points are given to the true evaluator.
+ */
+class AdaoSurrogate
+{
+public:
+  AdaoSurrogate(double relativeTolerance);
+  double getRelativeTolerance() const { return _relative_tolerance; }
+  void setDifferentialIncrement(double increment) { _differential_increment = increment; }
+  void reset();
+  bool predict(std::size_t inputSize, const double *input, std::size_t outputSize, double *output);
+  void learn(std::size_t inputSize, const double *input, std::size_t outputSize, const double *output);
+  bool evaluate(const std::vector< std::vector<double> >& inputs, std::vector< std::vector<double> >& outputs,
+                const std::function<bool(const std::vector<std::size_t>&, std::vector< std::vector<double> >&)>& trueEvaluation);
+  std::size_t getNumberOfPredictions() const { return _nb_of_predictions; }
+  std::size_t getNumberOfTrueEvaluations() const { return _nb_of_true_evaluations; }
+  std::size_t getNumberOfRefusals() const { return _nb_of_refusals; }
+private:
+  double radius() const;
+  double distanceToCenter(std::size_t inputSize, const double *input) const;
+private:
+  double _relative_tolerance = 0.;
+  double _differential_increment = 0.01;
+  std::vector<double> _center_x;
+  std::vector<double> _center_y;
+  //! row i is the gradient of output i
+  AdaoNative::DenseMatrix _jacobian;
+  //! number of corrections applied to _jacobian. Model is usable when it reaches the input size
+  std::size_t _nb_of_corrections = 0;
+  //! negative as long as not measured
+  double _curvature = -1.;
+  std::size_t _nb_of_predictions = 0;
+  std::size_t _nb_of_true_evaluations = 0;
+  //! predictions of a trained model refused because of the estimated error (curvature), the point going to the true evaluator
+  std::size_t _nb_of_refusals = 0;
+};
+
+/*!
+ * Evaluator answering with \a surrogate the samples it is confident about and calling \a evaluator (not owned) for the others.
+ */
+class AdaoEvaluatorWithSurrogate : public AdaoEvaluator
+{
+public:
+  AdaoEvaluatorWithSurrogate(AdaoEvaluator *evaluator, AdaoSurrogate *surrogate):_evaluator(evaluator),_surrogate(surrogate) { }
+  void evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs) override;
+private:
+  AdaoEvaluator *_evaluator = nullptr;
+  AdaoSurrogate *_surrogate = nullptr;
+};
@@ -22,16 +22,21 @@
 
 #include "Python.h"
 
+/*!
+ * Owns one strong reference. Reference counts are atomic in free-threaded python builds, but like any python call, copies and
+ * destruction have to be done by a thread with an attached thread state (AutoGIL).
+ */
 class PyObjectRAII
 {
 public:
   static PyObjectRAII FromBorrowed(PyObject *obj) { IncRef(obj); return PyObjectRAII(obj); }
   static PyObjectRAII FromNew(PyObject *obj) { return PyObjectRAII(obj); }
+  static PyObjectRAII FromDictItem(PyObject *dict, const char *key);
   PyObjectRAII():_obj(nullptr) { }
   PyObjectRAII(PyObjectRAII&& other):_obj(other._obj) { other._obj=nullptr; }
   PyObjectRAII(const PyObjectRAII& other):_obj(other._obj) { incRef(); }
-  PyObjectRAII& operator=(PyObjectRAII&& other) { unRef(); _obj=other._obj; other._obj=nullptr; }
-  PyObjectRAII& operator=(const PyObjectRAII& other) { if(_obj==other._obj) return *this; unRef(); _obj=other._obj; incRef(); return *this; }
+  PyObjectRAII& operator=(PyObjectRAII&& other) { if(this==&other) return *this; PyObject *old(_obj); _obj=other._obj; other._obj=nullptr; Py_XDECREF(old); return *this; }
+  PyObjectRAII& operator=(const PyObjectRAII& other) { if(_obj==other._obj) return *this; PyObject *old(_obj); _obj=other._obj; incRef(); Py_XDECREF(old); return *this; }
   ~PyObjectRAII() { unRef(); }
   PyObject *retn() { incRef(); return _obj; }
   operator PyObject *() const { return _obj; }
@@ -45,6 +50,22 @@ private:
   PyObject *_obj;
 };
 
+/*!
+ * Strong reference to \a dict[\a key], nullptr if missing. A borrowed reference from PyDict_GetItemString may be released
+ * by another thread modifying \a dict when there is no GIL.
+ */
+inline PyObjectRAII PyObjectRAII::FromDictItem(PyObject *dict, const char *key)
+{
+#if PY_VERSION_HEX >= 0x030D0000
+  PyObject *ret(nullptr);
+  if(PyDict_GetItemStringRef(dict,key,&ret)<0)
+    PyErr_Clear();
+  return FromNew(ret);
+#else
+  return FromBorrowed(PyDict_GetItemString(dict,key));
+#endif
+}
+
 class AutoGIL
 {
 public:
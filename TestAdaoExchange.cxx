@@ -22,6 +22,21 @@
 
 #include "AdaoExchangeLayer.hxx"
 #include "AdaoExchangeLayerException.hxx"
+#include "AdaoEvaluator.hxx"
+#include "AdaoDual.hxx"
+#include "AdaoNativeLinearAlgebra.hxx"
+#include "AdaoCovarianceOperator.hxx"
+#include "AdaoPartition.hxx"
+#include "AdaoPosteriorCovariance.hxx"
+#include "AdaoSpeculation.hxx"
+#include "AdaoSurrogate.hxx"
+#include "AdaoExternalEvaluator.hxx"
+#include "AdaoPythonEvaluator.hxx"
+#include "AdaoExchangeLog.hxx"
+#include "AdaoSampling.hxx"
+#include "AdaoSerieExport.hxx"
+#include "AdaoMemoryAccounting.hxx"
+#include "AdaoStoragePolicy.hxx"
 #include "AdaoModelKeyVal.hxx"
 #include "PyObjectRAII.hxx"
 
@@ -29,9 +44,24 @@
 
 #include <vector>
 #include <iterator>
+#include <memory>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <stdexcept>
+
+#include <poll.h>
 
 #include "TestAdaoHelper.cxx"
 
+#ifdef AEL_WITH_MPI
+#include "AdaoMpiEvaluator.hxx"
+
+//! shared by rank 0 running tests and worker ranks, nullptr if not launched by mpirun with at least 2 ranks
+static AdaoMpiEvaluator *MpiEvaluator = nullptr;
+#endif
+
 // Functor a remplacer par un appel a un evaluateur parallele
 class NonParallelFunctor
 {
@@ -117,6 +147,57 @@ void AdaoExchangeTest::cleanUp()
 
 using namespace AdaoModel;
 
+/* Analysis given by getResult once the case run by \a adao is finished */
+static std::vector<double> AnalysisOf(AdaoExchangeLayer& adao)
+{
+  PyObject *res(adao.getResult());
+  AutoGIL agil;
+  PyObjectRAII optimum(PyObjectRAII::FromNew(res));
+  PyObjectRAII optimum_4_py2cpp(NumpyToListWaitingForPy2CppManagement(optimum));
+  std::vector<double> vect;
+  {
+    py2cpp::PyPtr obj(optimum_4_py2cpp.retn());
+    py2cpp::fromPyPtr(obj,vect);
+  }
+  return vect;
+}
+
+/*
+ * Run the case of \a mm, its python leaves being set by \a visitor, and return its analysis. Callback has already been set in \a mm.
+ * Samples given by next (pull mode) are answered by \a answer, none being expected if \a answer is empty.
+ */
+static std::vector<double> RunCase(AdaoExchangeLayer& adao, MainModel& mm, PythonLeafVisitor& visitor, std::function< PyObject *(PyObject *) > answer = nullptr)
+{
+  {
+    AutoGIL agil;
+    mm.visitPythonLeaves(&visitor);
+  }
+  adao.loadTemplate(&mm);
+  adao.execute();
+  PyObject *listOfElts( nullptr );
+  while( adao.next(listOfElts) )
+    {
+      CPPUNIT_ASSERT(answer);
+      adao.setResult(answer(listOfElts));
+    }
+  return AnalysisOf(adao);
+}
+
+/* Same than above, samples given by next being answered by \a evaluator through evaluateAndSetResult */
+static std::vector<double> RunCase(AdaoExchangeLayer& adao, MainModel& mm, PythonLeafVisitor& visitor, AdaoEvaluator *evaluator)
+{
+  {
+    AutoGIL agil;
+    mm.visitPythonLeaves(&visitor);
+  }
+  adao.loadTemplate(&mm);
+  adao.execute();
+  PyObject *listOfElts( nullptr );
+  while( adao.next(listOfElts) )
+    adao.evaluateAndSetResult(listOfElts,evaluator);
+  return AnalysisOf(adao);
+}
+
 void AdaoExchangeTest::test3DVar()
 {
   NonParallelFunctor functor(funcBase);
@@ -149,7 +230,7 @@ void AdaoExchangeTest::test3DVar()
   PyObjectRAII optimum_4_py2cpp(NumpyToListWaitingForPy2CppManagement(optimum));
   std::vector<double> vect;
   {
-    py2cpp::PyPtr obj(optimum_4_py2cpp);
+    py2cpp::PyPtr obj(optimum_4_py2cpp.retn());
     py2cpp::fromPyPtr(obj,vect);
   }
   CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
@@ -207,7 +288,7 @@ void AdaoExchangeTest::testBlue()
     PyObjectRAII optimum_4_py2cpp(NumpyToListWaitingForPy2CppManagement(optimum));
     std::vector<double> vect;
     {
-      py2cpp::PyPtr obj(optimum_4_py2cpp);
+      py2cpp::PyPtr obj(optimum_4_py2cpp.retn());
       py2cpp::fromPyPtr(obj,vect);
     }
     CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
@@ -264,7 +345,7 @@ void AdaoExchangeTest::testNonLinearLeastSquares()
   PyObjectRAII optimum_4_py2cpp(NumpyToListWaitingForPy2CppManagement(optimum));
   std::vector<double> vect;
   {
-    py2cpp::PyPtr obj(optimum_4_py2cpp);
+    py2cpp::PyPtr obj(optimum_4_py2cpp.retn());
     py2cpp::fromPyPtr(obj,vect);
   }
   CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
@@ -305,13 +386,1384 @@ void AdaoExchangeTest::testCasCrue()
   PyObjectRAII optimum_4_py2cpp(NumpyToListWaitingForPy2CppManagement(optimum));
   std::vector<double> vect;
   {
-    py2cpp::PyPtr obj(optimum_4_py2cpp);
+    py2cpp::PyPtr obj(optimum_4_py2cpp.retn());
     py2cpp::fromPyPtr(obj,vect);
   }
   CPPUNIT_ASSERT_EQUAL(1,(int)vect.size());
   CPPUNIT_ASSERT_DOUBLES_EQUAL(25.,vect[0],1e-3);
 }
 
+void AdaoExchangeTest::test3DVarSinglePrecision()
+{
+  NonParallelFunctor functor(funcBase);
+  MainModel mm;
+  AdaoExchangeLayer adao;
+  adao.init();
+  adao.setSinglePrecisionTransport(true);
+  // For bounds, Background/Vector, Observation/Vector
+  adao.setFunctionCallbackInModel(&mm);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  std::vector<double> vect(RunCase(adao,mm,visitorPythonObj,functor));
+  CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(2.,vect[0],1e-3);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(3.,vect[1],1e-3);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(4.,vect[2],1e-3);
+  // one row per iteration for stored series
+  PyObjectRAII serie(PyObjectRAII::FromNew(adao.getSerie("CurrentOptimum")));
+  PyObjectRAII serie_4_py2cpp(NumpyToListWaitingForPy2CppManagement(serie));
+  std::vector< std::vector<double> > vect2;
+  {
+    py2cpp::PyPtr obj(serie_4_py2cpp.retn());
+    py2cpp::fromPyPtr(obj,vect2);
+  }
+  CPPUNIT_ASSERT(!vect2.empty());
+  CPPUNIT_ASSERT_EQUAL(3,(int)vect2.back().size());
+}
+
+void AdaoExchangeTest::testBlueNative()
+{
+  class TestBlueVisitor : public RecursiveVisitor
+  {
+  public:
+    void visit(GenericKeyVal *obj)
+    {
+      EnumAlgoKeyVal *objc(dynamic_cast<EnumAlgoKeyVal *>(obj));
+      if(objc)
+        objc->setVal(EnumAlgo::Blue);
+    }
+    void enterSubDir(DictKeyVal *subdir) { }
+    void exitSubDir(DictKeyVal *subdir) { }
+  };
+
+  AdaoFunctionEvaluator evaluator(funcBase);
+  MainModel mm;
+  mm.setEngine(EnumEngine::Native);
+  //
+  TestBlueVisitor vis;
+  mm.visitAll(&vis);
+  //
+  AdaoExchangeLayer adao;
+  adao.init();
+  // For bounds, Background/Vector, Observation/Vector
+  adao.setEvaluatorInModel(&mm,&evaluator);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  std::vector<double> vect(RunCase(adao,mm,visitorPythonObj));// nothing given by next
+  CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(2.,vect[0],1e-7);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(3.,vect[1],1e-7);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(4.,vect[2],1e-7);
+}
+
+/* Analysis of default 3DVAR case, computed either by python ADAO or by native engine */
+template<class VISITOR>
+std::vector<double> Compute3DVarAnalysis(EnumEngine engine, std::function< std::vector<double>(const std::vector<double>&) > func)
+{
+  NonParallelFunctor functor(func);
+  AdaoFunctionEvaluator evaluator(func);
+  MainModel mm;
+  mm.setEngine(engine);
+  AdaoExchangeLayer adao;
+  adao.init();
+  if(engine==EnumEngine::Native)
+    adao.setEvaluatorInModel(&mm,&evaluator);
+  else
+    adao.setFunctionCallbackInModel(&mm);
+  VISITOR visitorPythonObj(adao.getPythonContext());
+  return RunCase(adao,mm,visitorPythonObj,functor);
+}
+
+void AdaoExchangeTest::test3DVarNativeParity()
+{
+  std::vector<double> vectPy(Compute3DVarAnalysis<Visitor2>(EnumEngine::Python,funcBase));
+  std::vector<double> vectNative(Compute3DVarAnalysis<Visitor2>(EnumEngine::Native,funcBase));
+  CPPUNIT_ASSERT_EQUAL(3,(int)vectNative.size());
+  CPPUNIT_ASSERT_EQUAL(vectPy.size(),vectNative.size());
+  for(std::size_t i=0;i<vectPy.size();++i)
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(vectPy[i],vectNative[i],1e-5);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(2.,vectNative[0],1e-5);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(3.,vectNative[1],1e-5);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(4.,vectNative[2],1e-5);
+}
+
+void AdaoExchangeTest::testCasCrueNativeParity()
+{
+  std::vector<double> vectPy(Compute3DVarAnalysis<VisitorCruePython>(EnumEngine::Python,funcCrue));
+  std::vector<double> vectNative(Compute3DVarAnalysis<VisitorCruePython>(EnumEngine::Native,funcCrue));
+  CPPUNIT_ASSERT_EQUAL(1,(int)vectNative.size());
+  CPPUNIT_ASSERT_EQUAL(vectPy.size(),vectNative.size());
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(vectPy[0],vectNative[0],2e-3);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(25.,vectNative[0],1e-3);
+}
+
+/* Increments of finite differences are the ones of ADAO FDApproximation computed by numpy, also with null state components */
+void AdaoExchangeTest::testFiniteDifferenceIncrements()
+{
+  const char SCRIPT[]="import numpy as np\n"
+      "def increments(x, increment):\n"
+      "    increment = increment if abs(increment) > 1.e-15 else 0.01\n"
+      "    dx = increment * np.ravel(x)\n"
+      "    if (dx == 0.).any():\n"
+      "        moyenne = dx.mean()\n"
+      "        dx = np.where(dx == 0., increment if moyenne == 0. else moyenne, dx)\n"
+      "    return dx.tolist()\n";
+  AdaoExchangeLayer adao;
+  adao.init();
+  AutoGIL agil;
+  PyObject *context(adao.getPythonContext());
+  PyObjectRAII res(PyObjectRAII::FromNew(PyRun_String(SCRIPT,Py_file_input,context,context)));
+  CPPUNIT_ASSERT(!res.isNull());
+  PyObjectRAII func(PyObjectRAII::FromDictItem(context,"increments"));
+  // more than 128 components : numpy sums them pairwise, by blocks
+  std::vector< std::vector<double> > states{ {0.,1.,2.}, {0.,0.,0.}, std::vector<double>(137) };
+  for(std::size_t i=0;i<137;++i)
+    states[2][i] = i%5==0?0.:1./(1.+i*i);
+  for(const auto& x : states)
+    for(double increment : {1e-4,0.})
+      {
+        py2cpp::PyPtr xPy(py2cpp::toPyPtr(x));
+        PyObjectRAII dxPy(PyObjectRAII::FromNew(PyObject_CallFunction(func,"Od",xPy.get(),increment)));
+        CPPUNIT_ASSERT(!dxPy.isNull());
+        std::vector<double> ref;
+        {
+          py2cpp::PyPtr obj(dxPy.retn());
+          py2cpp::fromPyPtr(obj,ref);
+        }
+        std::vector<double> dx(AdaoNative::FiniteDifferenceIncrements(x,increment));
+        CPPUNIT_ASSERT_EQUAL(ref.size(),dx.size());
+        for(std::size_t i=0;i<dx.size();++i)
+          CPPUNIT_ASSERT_EQUAL(ref[i],dx[i]);
+      }
+}
+
+/* Run default 3DVAR case and returns the number of evaluations of funcBase */
+static std::size_t Run3DVarCountingEvaluations(EnumJacobianMode mode, std::vector<double>& vect, const std::string& storeFileName = std::string(), double surrogateTolerance = 0.)
+{
+  std::size_t nbOfEvals(0);
+  NonParallelFunctor functor([&nbOfEvals](const std::vector<double>& vec) { nbOfEvals++; return funcBase(vec); });
+  MainModel mm;
+  mm.setJacobianMode(mode);
+  AdaoExchangeLayer adao;
+  adao.init();
+  if(!storeFileName.empty())
+    adao.setEvaluationStore(storeFileName,"funcBase");
+  if(surrogateTolerance>0.)
+    adao.setSurrogate(surrogateTolerance);
+  adao.setFunctionCallbackInModel(&mm);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  vect = RunCase(adao,mm,visitorPythonObj,functor);
+  return nbOfEvals;
+}
+
+void AdaoExchangeTest::test3DVarBroyden()
+{
+  std::vector<double> vectFD,vectBroyden;
+  std::size_t nbOfEvalsFD(Run3DVarCountingEvaluations(EnumJacobianMode::FiniteDifferences,vectFD));
+  std::size_t nbOfEvalsBroyden(Run3DVarCountingEvaluations(EnumJacobianMode::Broyden,vectBroyden));
+  CPPUNIT_ASSERT_EQUAL(3,(int)vectBroyden.size());
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(2.,vectBroyden[0],1e-5);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(3.,vectBroyden[1],1e-5);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(4.,vectBroyden[2],1e-5);
+  // same analysis than with a Jacobian computed by finite differences at each iteration
+  CPPUNIT_ASSERT_EQUAL(vectFD.size(),vectBroyden.size());
+  for(std::size_t i=0;i<vectFD.size();++i)
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(vectFD[i],vectBroyden[i],1e-6);
+  // funcBase is linear : Jacobian computed once is exact and never recomputed
+  CPPUNIT_ASSERT(nbOfEvalsBroyden<nbOfEvalsFD);
+}
+
+void AdaoExchangeTest::testEvaluationStore()
+{
+  const char STORE_FILE[]="testEvaluationStore.bin";
+  std::remove(STORE_FILE);
+  std::vector<double> vectFirst,vectSecond;
+  std::size_t nbOfEvalsFirst(Run3DVarCountingEvaluations(EnumJacobianMode::FiniteDifferences,vectFirst,STORE_FILE));
+  std::size_t nbOfEvalsSecond(Run3DVarCountingEvaluations(EnumJacobianMode::FiniteDifferences,vectSecond,STORE_FILE));
+  std::remove(STORE_FILE);
+  CPPUNIT_ASSERT(nbOfEvalsFirst>0);
+  // same case run again : everything is answered by the store
+  CPPUNIT_ASSERT_EQUAL(0,(int)nbOfEvalsSecond);
+  CPPUNIT_ASSERT_EQUAL(3,(int)vectSecond.size());
+  for(int i=0;i<3;++i)
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(vectFirst[i],vectSecond[i],1e-12);
+  // result missing one sample given to setResult : ADAO is interrupted by a python error
+  {
+    NonParallelFunctor functor(funcBase);
+    MainModel mm;
+    AdaoExchangeLayer adao;
+    adao.init();
+    adao.setEvaluationStore(STORE_FILE,"funcBase");
+    adao.setFunctionCallbackInModel(&mm);
+    Visitor2 visitorPythonObj(adao.getPythonContext());
+    {
+      AutoGIL agil;
+      mm.visitPythonLeaves(&visitorPythonObj);
+    }
+    adao.loadTemplate(&mm);
+    adao.execute();
+    PyObject *listOfElts( nullptr );
+    std::size_t nbOfBatches(0);
+    while( adao.next(listOfElts) )
+      {
+        nbOfBatches++;
+        PyObject *result(functor(listOfElts));
+        {
+          AutoGIL agil;
+          PySequence_DelItem(result,PySequence_Size(result)-1);
+        }
+        adao.setResult(result);
+      }
+    CPPUNIT_ASSERT_EQUAL(1,(int)nbOfBatches);
+    bool hasThrown(false);
+    try
+      {
+        PyObjectRAII optimum(PyObjectRAII::FromNew(adao.getResult()));
+      }
+    catch(AdaoExchangeLayerException& e)
+      {
+        hasThrown = true;
+      }
+    CPPUNIT_ASSERT(hasThrown);
+  }
+  std::remove(STORE_FILE);
+}
+
+void AdaoExchangeTest::testSurrogate()
+{
+  std::vector<double> vectFD,vectSurrogate;
+  std::size_t nbOfEvalsFD(Run3DVarCountingEvaluations(EnumJacobianMode::FiniteDifferences,vectFD));
+  std::size_t nbOfEvalsSurrogate(Run3DVarCountingEvaluations(EnumJacobianMode::FiniteDifferences,vectSurrogate,std::string(),1e-6));
+  CPPUNIT_ASSERT_EQUAL(3,(int)vectSurrogate.size());
+  for(int i=0;i<3;++i)
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(vectFD[i],vectSurrogate[i],1e-5);
+  // funcBase is linear : after first iteration finite difference points are answered by the surrogate
+  CPPUNIT_ASSERT(nbOfEvalsSurrogate<nbOfEvalsFD);
+  // funcCrue is not : points whose estimated error is too large fall back to the true evaluator
+  std::size_t nbOfCrueEvals(0);
+  AdaoFunctionEvaluator crue([&nbOfCrueEvals](const std::vector<double>& vec) { nbOfCrueEvals++; return funcCrue(vec); });
+  MainModel mm;
+  AdaoExchangeLayer adao;
+  adao.init();
+  adao.setSurrogate(1e-8);
+  adao.setEvaluatorInModel(&mm,&crue);
+  VisitorCruePython visitorPythonObj(adao.getPythonContext());
+  std::vector<double> vectCrue(RunCase(adao,mm,visitorPythonObj));
+  const AdaoSurrogate& surrogate(adao.getSurrogate());
+  std::vector<double> vectCrueFD(Compute3DVarAnalysis<VisitorCruePython>(EnumEngine::Python,funcCrue));
+  CPPUNIT_ASSERT_EQUAL(1,(int)vectCrue.size());
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(vectCrueFD[0],vectCrue[0],1e-3);
+  CPPUNIT_ASSERT_EQUAL(nbOfCrueEvals,surrogate.getNumberOfTrueEvaluations());
+  CPPUNIT_ASSERT(surrogate.getNumberOfPredictions()>0);
+  CPPUNIT_ASSERT(surrogate.getNumberOfRefusals()>0);
+}
+
+/* AdaoEngineProcess is expected to be in PATH or given by ADAO_ENGINE_PROCESS */
+void AdaoExchangeTest::test3DVarOutOfProcess()
+{
+  std::vector<double> vectPy(Compute3DVarAnalysis<Visitor2>(EnumEngine::Python,funcBase));
+  std::vector<double> vectRemote(Compute3DVarAnalysis<Visitor2>(EnumEngine::OutOfProcess,funcBase));
+  CPPUNIT_ASSERT_EQUAL(3,(int)vectRemote.size());
+  // same ADAO computation, only the process differs
+  for(std::size_t i=0;i<vectPy.size();++i)
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(vectPy[i],vectRemote[i],1e-12);
+}
+
+void AdaoExchangeTest::test3DVarPushMode()
+{
+  std::size_t nbOfEvals(0);
+  AdaoFunctionEvaluator evaluator([&nbOfEvals](const std::vector<double>& vec) { nbOfEvals++; return funcBase(vec); });
+  MainModel mm;
+  AdaoExchangeLayer adao;
+  adao.init();
+  adao.setEvaluatorInModel(&mm,&evaluator);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  std::vector<double> vect(RunCase(adao,mm,visitorPythonObj));// whole case is computed by execute, nothing given by next
+  CPPUNIT_ASSERT(nbOfEvals>0);
+  std::vector<double> vectPull(Compute3DVarAnalysis<Visitor2>(EnumEngine::Python,funcBase));
+  CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
+  for(std::size_t i=0;i<vect.size();++i)
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(vectPull[i],vect[i],1e-12);
+}
+
+void AdaoExchangeTest::test3DVarEventLoop()
+{
+  NonParallelFunctor functor(funcBase);
+  MainModel mm;
+  AdaoExchangeLayer adao;
+  adao.init();
+  adao.setFunctionCallbackInModel(&mm);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  {
+    AutoGIL agil;
+    mm.visitPythonLeaves(&visitorPythonObj);
+  }
+  adao.loadTemplate(&mm);
+  int fd(adao.getEventFileDescriptor());
+  adao.execute();
+  bool finished(false);
+  while(!finished)
+    {
+      struct pollfd pfd = { fd, POLLIN, 0 };
+      CPPUNIT_ASSERT_EQUAL(1,poll(&pfd,1,-1));
+      PyObject *listOfElts( nullptr );
+      AdaoNextStatus status;
+      while( (status=adao.tryNext(listOfElts))!=AdaoNextStatus::Pending )
+        {
+          if(status==AdaoNextStatus::Finished)
+            { finished=true; break; }
+          adao.setResult(functor(listOfElts));
+        }
+    }
+  std::vector<double> vect(AnalysisOf(adao));
+  CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(2.,vect[0],1e-5);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(3.,vect[1],1e-5);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(4.,vect[2],1e-5);
+}
+
+/* tracemalloc.is_tracing() */
+static bool IsTracingPythonMemory()
+{
+  AutoGIL agil;
+  PyObjectRAII tracemalloc(PyObjectRAII::FromNew(PyImport_ImportModule("tracemalloc")));
+  PyObjectRAII res(PyObjectRAII::FromNew(PyObject_CallMethod(tracemalloc,"is_tracing",nullptr)));
+  return PyObject_IsTrue(res)==1;
+}
+
+void AdaoExchangeTest::testMemoryAccounting()
+{
+  NonParallelFunctor functor(funcBase);
+  MainModel mm;
+  AdaoExchangeLayer adao;
+  adao.init();
+  adao.setMemoryAccounting(true);
+  adao.setFunctionCallbackInModel(&mm);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  std::size_t nbOfBatches(0);
+  RunCase(adao,mm,visitorPythonObj,[&nbOfBatches,&functor](PyObject *listOfElts) { nbOfBatches++; return functor(listOfElts); });
+  const AdaoMemoryAccounting& memory(adao.getMemoryAccounting());
+  CPPUNIT_ASSERT_EQUAL(nbOfBatches,memory.getSamples().size());
+  CPPUNIT_ASSERT(memory.getPeakRSS()>0);
+  CPPUNIT_ASSERT(memory.getPythonPeak()>0);
+  // samples of size 3 and results of size 4, in double precision
+  CPPUNIT_ASSERT_EQUAL(memory.getSamples()[0]._nb_of_samples*3*sizeof(double),memory.getSamples()[0]._input_bytes);
+  CPPUNIT_ASSERT_EQUAL(memory.getSamples()[0]._nb_of_samples*4*sizeof(double),memory.getSamples()[0]._output_bytes);
+  std::vector< std::pair<std::string,std::size_t> > sizes(adao.getStoredVariablesSizes());
+  CPPUNIT_ASSERT_EQUAL(std::string("Analysis"),sizes[0].first);
+  CPPUNIT_ASSERT(sizes[0].second>=3*sizeof(double));
+  // tracing started by the layer is stopped with the case, samples are kept
+  CPPUNIT_ASSERT(IsTracingPythonMemory());
+  adao.releaseCase();
+  CPPUNIT_ASSERT(!IsTracingPythonMemory());
+  CPPUNIT_ASSERT_EQUAL(nbOfBatches,memory.getSamples().size());
+}
+
+/* Run default 3DVAR case and returns the serie of CurrentOptimum. Analysis is put in \a analysis if not null */
+static std::vector< std::vector<double> > Run3DVarCurrentOptimum(const AdaoStoragePolicy *policy, std::vector<double> *analysis = nullptr)
+{
+  NonParallelFunctor functor(funcBase);
+  MainModel mm;
+  AdaoExchangeLayer adao;
+  adao.init();
+  if(policy)
+    adao.setStoragePolicy("CurrentOptimum",*policy);
+  adao.setFunctionCallbackInModel(&mm);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  std::vector<double> vect(RunCase(adao,mm,visitorPythonObj,functor));
+  if(analysis)
+    *analysis = vect;
+  PyObjectRAII serie(PyObjectRAII::FromNew(adao.getSerie("CurrentOptimum")));
+  PyObjectRAII serie_4_py2cpp(NumpyToListWaitingForPy2CppManagement(serie));
+  std::vector< std::vector<double> > ret;
+  {
+    py2cpp::PyPtr obj(serie_4_py2cpp.retn());
+    py2cpp::fromPyPtr(obj,ret);
+  }
+  return ret;
+}
+
+void AdaoExchangeTest::testStoragePolicy()
+{
+  const char SPILL_FILE[]="testStoragePolicy.bin";
+  std::vector<double> refAnalysis;
+  std::vector< std::vector<double> > ref(Run3DVarCurrentOptimum(nullptr,&refAnalysis));
+  // series read back by ADAO algorithms can't be bounded, the other ones don't change the analysis
+  {
+    NonParallelFunctor functor(funcBase);
+    MainModel mm;
+    AdaoExchangeLayer adao;
+    adao.init();
+    for(const char *varName : {"CurrentState","SimulatedObservationAtCurrentState","CostFunctionJ","CostFunctionJo","Analysis"})
+      {
+        bool hasThrown(false);
+        try
+          {
+            adao.setStoragePolicy(varName,AdaoStoragePolicy::KeepLast(1));
+          }
+        catch(AdaoExchangeLayerException& e)
+          {
+            hasThrown = true;
+          }
+        CPPUNIT_ASSERT(hasThrown);
+      }
+    adao.setStoragePolicy("CostFunctionJAtCurrentOptimum",AdaoStoragePolicy::KeepLast(1));
+    adao.setStoragePolicy("SimulatedObservationAtCurrentOptimum",AdaoStoragePolicy::KeepEvery(2));
+    adao.setFunctionCallbackInModel(&mm);
+    Visitor2 visitorPythonObj(adao.getPythonContext());
+    std::vector<double> vect(RunCase(adao,mm,visitorPythonObj,functor));
+    CPPUNIT_ASSERT_EQUAL(refAnalysis.size(),vect.size());
+    for(std::size_t j=0;j<refAnalysis.size();++j)
+      CPPUNIT_ASSERT_EQUAL(refAnalysis[j],vect[j]);
+  }
+  AdaoStoragePolicy spill(AdaoStoragePolicy::SpillToFile(SPILL_FILE,1));
+  std::vector< std::vector<double> > spilled(Run3DVarCurrentOptimum(&spill));
+  std::remove(SPILL_FILE);
+  // only the last value was kept in memory by ADAO, but the whole history is read back from file
+  CPPUNIT_ASSERT(ref.size()>1);
+  CPPUNIT_ASSERT_EQUAL(ref.size(),spilled.size());
+  for(std::size_t i=0;i<ref.size();++i)
+    for(std::size_t j=0;j<ref[i].size();++j)
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(ref[i][j],spilled[i][j],1e-12);
+  AdaoStoragePolicy last(AdaoStoragePolicy::KeepLast(1));
+  std::vector<double> lastAnalysis;
+  std::vector< std::vector<double> > lastOnly(Run3DVarCurrentOptimum(&last,&lastAnalysis));
+  CPPUNIT_ASSERT_EQUAL(1,(int)lastOnly.size());
+  // CurrentOptimum is not read back by ADAO : bounding it leaves the analysis unchanged
+  CPPUNIT_ASSERT_EQUAL(refAnalysis.size(),lastAnalysis.size());
+  for(std::size_t j=0;j<refAnalysis.size();++j)
+    CPPUNIT_ASSERT_EQUAL(refAnalysis[j],lastAnalysis[j]);
+  for(std::size_t j=0;j<ref.back().size();++j)
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(ref.back()[j],lastOnly[0][j],1e-12);
+}
+
+/* funcBase computed by awk, 4 runs at a time */
+void AdaoExchangeTest::testExternalEvaluator()
+{
+  AdaoExternalEvaluator evaluator({"sh","-c","awk '{printf \"%.17g %.17g %.17g %.17g\\n\", $1, 2*$2, 3*$3, $1+2*$2+3*$3}' input.txt > output.txt"});
+  evaluator.addInputTemplateFromString("${x0} ${x1} ${x2}\n","input.txt");
+  evaluator.setMaximumNumberOfConcurrentRuns(4);
+  MainModel mm;
+  AdaoExchangeLayer adao;
+  adao.init();
+  adao.setEvaluatorInModel(&mm,&evaluator);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  std::vector<double> vect(RunCase(adao,mm,visitorPythonObj));
+  std::vector<double> vectPull(Compute3DVarAnalysis<Visitor2>(EnumEngine::Python,funcBase));
+  CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
+  for(std::size_t i=0;i<vect.size();++i)
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(vectPull[i],vect[i],1e-12);
+  // run never ending : killed at timeout, retried once, then reported
+  AdaoExternalEvaluator sleeper({"sleep","60"});
+  sleeper.setTimeout(0.2);
+  sleeper.setMaximumNumberOfRetries(1);
+  sleeper.setKeepFailedRunDirectories(false);
+  std::vector<double> input{1.,2.,3.},output(4);
+  bool hasThrown(false);
+  try
+    {
+      sleeper.evaluate(1,3,input.data(),4,output.data());
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      hasThrown = std::string(e.what()).find("2 time(s)")!=std::string::npos;
+    }
+  CPPUNIT_ASSERT(hasThrown);
+  // exception of the output parser is a failure of the run
+  AdaoExternalEvaluator badParser({"sh","-c","echo 1 > output.txt"});
+  badParser.setOutputParser([](const std::string& content) -> std::vector<double> { throw std::runtime_error("unexpected output format"); });
+  badParser.setMaximumNumberOfRetries(0);
+  badParser.setKeepFailedRunDirectories(false);
+  hasThrown = false;
+  try
+    {
+      badParser.evaluate(1,3,input.data(),4,output.data());
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      hasThrown = std::string(e.what()).find("unexpected output format")!=std::string::npos;
+    }
+  CPPUNIT_ASSERT(hasThrown);
+  // executable is searched in PATH before fork
+  AdaoExternalEvaluator missing({"adao_no_such_executable"});
+  hasThrown = false;
+  try
+    {
+      missing.evaluate(1,3,input.data(),4,output.data());
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      hasThrown = std::string(e.what()).find("not found in PATH")!=std::string::npos;
+    }
+  CPPUNIT_ASSERT(hasThrown);
+  // placeholder index too large for std::stoul
+  hasThrown = false;
+  try
+    {
+      AdaoExternalEvaluator::Substitute("${x123456789012345678901234567890}",0,3,input.data());
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      hasThrown = std::string(e.what()).find("whereas samples have 3 components")!=std::string::npos;
+    }
+  CPPUNIT_ASSERT(hasThrown);
+}
+
+/* BackgroundError given as a matrix-free operator equal to the default scalar one, with native and python engines. No solve given : conjugate gradient is used */
+void AdaoExchangeTest::testCovarianceOperator()
+{
+  const double scal(AdaoModel::BackgroundError::BACKGROUND_SCALAR_SPARSE_DFT);
+  AdaoFunctionCovarianceOperator op(3,[scal](const double *v, double *res) { for(std::size_t i=0;i<3;++i) res[i] = scal*v[i]; });
+  AdaoFunctionEvaluator evaluator(funcBase);
+  MainModel mm;
+  mm.setEngine(EnumEngine::Native);
+  AdaoExchangeLayer adao;
+  adao.init();
+  adao.setEvaluatorInModel(&mm,&evaluator);
+  adao.setCovarianceOperatorInModel(&mm,"BackgroundError",&op);
+  CPPUNIT_ASSERT(mm.pyStr().find("ObjectMatrix")!=std::string::npos);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  std::vector<double> vect(RunCase(adao,mm,visitorPythonObj));
+  std::vector<double> vectScalar(Compute3DVarAnalysis<Visitor2>(EnumEngine::Native,funcBase));
+  CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
+  for(std::size_t i=0;i<vect.size();++i)
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(vectScalar[i],vect[i],1e-6);
+  // same operator used by ADAO algorithm itself with python engine
+  MainModel mmPy;
+  AdaoExchangeLayer adaoPy;
+  adaoPy.init();
+  adaoPy.setEvaluatorInModel(&mmPy,&evaluator);
+  adaoPy.setCovarianceOperatorInModel(&mmPy,"BackgroundError",&op);
+  Visitor2 visitorPy(adaoPy.getPythonContext());
+  std::vector<double> vectPy(RunCase(adaoPy,mmPy,visitorPy));
+  std::vector<double> vectScalarPy(Compute3DVarAnalysis<Visitor2>(EnumEngine::Python,funcBase));
+  CPPUNIT_ASSERT_EQUAL(3,(int)vectPy.size());
+  for(std::size_t i=0;i<vectPy.size();++i)
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(vectScalarPy[i],vectPy[i],1e-6);
+  bool hasThrown(false);
+  try
+    {
+      adao.setCovarianceOperatorInModel(&mm,"Observation",&op);
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      hasThrown = true;
+    }
+  CPPUNIT_ASSERT(hasThrown);
+  // non symmetric operator : conjugate gradient does not converge in 2 iterations, which is reported
+  AdaoFunctionCovarianceOperator nonSymmetric(2,[](const double *v, double *res) { res[0] = v[0]+v[1]; res[1] = v[1]; });
+  std::vector<double> v{1.,1.},sol(2);
+  hasThrown = false;
+  try
+    {
+      nonSymmetric.solve(v.data(),sol.data());
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      hasThrown = std::string(e.what()).find("has not converged")!=std::string::npos;
+    }
+  CPPUNIT_ASSERT(hasThrown);
+}
+
+/* Default 3DVAR case solved as 3 sub-cases, 2 at a time. Last one needs the first two components (halo) to use the 4th observation */
+void AdaoExchangeTest::testPartitions()
+{
+  AdaoFunctionEvaluator evaluator(funcBase);
+  MainModel mm;
+  mm.setEngine(EnumEngine::Native);
+  AdaoExchangeLayer adao;
+  adao.init();
+  adao.setEvaluatorInModel(&mm,&evaluator);
+  AdaoPartition last({2},{2,3});
+  last.setHalo({0,1});
+  adao.addPartition(AdaoPartition({0},{0}));
+  adao.addPartition(AdaoPartition({1},{1}));
+  adao.addPartition(last);
+  adao.setMaximumNumberOfConcurrentPartitions(2);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  std::vector<double> vect(RunCase(adao,mm,visitorPythonObj));
+  CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(2.,vect[0],1e-5);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(3.,vect[1],1e-5);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(4.,vect[2],1e-5);
+  // state component #2 in no partition
+  adao.clearPartitions();
+  adao.addPartition(AdaoPartition({0,1},{0,1}));
+  bool hasThrown(false);
+  try
+    {
+      adao.loadTemplate(&mm);
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      hasThrown = true;
+    }
+  CPPUNIT_ASSERT(hasThrown);
+}
+
+/* funcBase is linear, so posterior covariance of default 3DVAR case is inverse of B^-1 + Ht.H, B^-1 being negligible */
+void AdaoExchangeTest::testPosteriorCovariance()
+{
+  const double htH[3][3]={ {2.,2.,3.}, {2.,8.,6.}, {3.,6.,18.} };
+  AdaoFunctionEvaluator evaluator(funcBase);
+  MainModel mm;
+  mm.setEngine(EnumEngine::Native);
+  AdaoExchangeLayer adao;
+  adao.init();
+  adao.setEvaluatorInModel(&mm,&evaluator);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  RunCase(adao,mm,visitorPythonObj);
+  std::vector<double> variances(adao.getPosteriorVariances());
+  CPPUNIT_ASSERT_EQUAL(3,(int)variances.size());
+  for(std::size_t j=0;j<3;++j)
+    {
+      std::vector<double> col(adao.getPosteriorCovarianceColumn(j));
+      CPPUNIT_ASSERT_EQUAL(3,(int)col.size());
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(col[j],variances[j],1e-6);
+      for(std::size_t i=0;i<3;++i)
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(i==j?1.:0.,htH[i][0]*col[0]+htH[i][1]*col[1]+htH[i][2]*col[2],1e-4);
+    }
+  AdaoLowRankCovariance lowRank(adao.getPosteriorCovarianceLowRank(2));
+  CPPUNIT_ASSERT_EQUAL(3,(int)lowRank._size);
+  CPPUNIT_ASSERT_EQUAL(2,(int)lowRank._values.size());
+  CPPUNIT_ASSERT_EQUAL(6,(int)lowRank._vectors.size());
+  CPPUNIT_ASSERT(lowRank._values[0]>=lowRank._values[1]);
+  // B - A = B.Ht.(R + H.B.Ht)^-1.H.B : largest eigenvalue is B minus smallest eigenvalue of A
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(1.,lowRank._values[0]/BackgroundError::BACKGROUND_SCALAR_SPARSE_DFT,1e-6);
+}
+
+/* Finite difference points asked by the gradient after each evaluation of the cost function are computed in advance */
+void AdaoExchangeTest::test3DVarSpeculation()
+{
+  AdaoFunctionEvaluator evaluator(funcBase);
+  MainModel mm;
+  AdaoExchangeLayer adao;
+  adao.init();
+  adao.setSpeculation(2);
+  adao.setEvaluatorInModel(&mm,&evaluator);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  std::vector<double> vect(RunCase(adao,mm,visitorPythonObj));
+  std::vector<double> vectPull(Compute3DVarAnalysis<Visitor2>(EnumEngine::Python,funcBase));
+  CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
+  for(std::size_t i=0;i<vect.size();++i)
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(vectPull[i],vect[i],1e-12);
+  const AdaoSpeculation& speculation(adao.getSpeculation());
+  CPPUNIT_ASSERT(speculation.getNumberOfHits()>0);
+  CPPUNIT_ASSERT(speculation.getNumberOfHits()<=speculation.getNumberOfSpeculativeEvaluations());
+}
+
+/* Persistence model : the 3 observations of the time window are the ones of test3DVar, analysis is the same */
+/* Visitor2 completed by the serie \a serie set to the leaf of key \a key, under the python name \a varName */
+class VisitorWithSerie : public Visitor2
+{
+public:
+  VisitorWithSerie(PyObject *context, const std::string& key, const std::vector< std::vector<double> >& serie, const std::string& varName):Visitor2(context),_context(context),_key(key),_serie(serie),_var_name(varName) { }
+  void visit(AdaoModel::MainModel *godFather, AdaoModel::PyObjKeyVal *obj) override
+  {
+    if(obj->getKey()!=_key)
+      {
+        Visitor2::visit(godFather,obj);
+        return ;
+      }
+    py2cpp::PyPtr seriePy(py2cpp::toPyPtr(_serie));
+    obj->setVal(seriePy.get());
+    PyDict_SetItemString(_context,_var_name.c_str(),seriePy.get());
+    obj->setVarName(_var_name);
+  }
+private:
+  PyObject *_context;
+  std::string _key;
+  std::vector< std::vector<double> > _serie;
+  std::string _var_name;
+};
+
+void AdaoExchangeTest::test4DVar()
+{
+  NonParallelFunctor observationFunctor(funcBase);
+  NonParallelFunctor evolutionFunctor([](const std::vector<double>& vec) { return vec; });
+  MainModel mm;
+  mm.setAlgorithm(EnumAlgo::FourDVar);
+  AdaoExchangeLayer adao;
+  adao.init();
+  adao.setFunctionCallbackInModel(&mm);
+  VisitorWithSerie visitorPythonObj(adao.getPythonContext(),VectorSerieObservation::KEY,std::vector< std::vector<double> >(3,{2., 6., 12., 20.}),"serieOf4DVar");
+  std::size_t nbOfEvolutionRequests(0),nbOfObservationRequests(0);
+  std::vector<double> vect(RunCase(adao,mm,visitorPythonObj,[&](PyObject *listOfElts)
+                                   {
+                                     if(adao.getRequestedOperator()==AdaoOperatorKind::EvolutionModel)
+                                       {
+                                         nbOfEvolutionRequests++;
+                                         return evolutionFunctor(listOfElts);
+                                       }
+                                     nbOfObservationRequests++;
+                                     return observationFunctor(listOfElts);
+                                   }));
+  std::string script(mm.pyStr());
+  CPPUNIT_ASSERT(script.find("case.set('EvolutionModel'")!=std::string::npos);
+  CPPUNIT_ASSERT(script.find("\"VectorSerie\" : serieOf4DVar")!=std::string::npos);
+  CPPUNIT_ASSERT(nbOfEvolutionRequests>0);
+  CPPUNIT_ASSERT(nbOfObservationRequests>0);
+  CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(2.,vect[0],1e-5);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(3.,vect[1],1e-5);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(4.,vect[2],1e-5);
+}
+
+/* Two native cases run by two threads, each one calling a python evaluator (in parallel with free-threaded python) */
+void AdaoExchangeTest::testPythonEvaluator()
+{
+  const char SCRIPT[]="import numpy as np\n"
+      "def funcBase(xserie):\n"
+      "    return [np.array([x[0],2.*x[1],3.*x[2],x[0]+2.*x[1]+3.*x[2]]) for x in xserie]\n";
+  std::vector<double> vectRef(Compute3DVarAnalysis<Visitor2>(EnumEngine::Native,funcBase));
+  PyObjectRAII func;
+  {
+    AutoGIL agil;
+    PyObjectRAII context(PyObjectRAII::FromNew(PyDict_New()));
+    PyDict_SetItemString(context,"__builtins__",PyEval_GetBuiltins());
+    PyObjectRAII res(PyObjectRAII::FromNew(PyRun_String(SCRIPT,Py_file_input,context,context)));
+    CPPUNIT_ASSERT(!res.isNull());
+    func = PyObjectRAII::FromDictItem(context,"funcBase");
+    CPPUNIT_ASSERT(!func.isNull());
+  }
+  constexpr std::size_t NB_OF_CASES(2);
+  std::vector< std::vector<double> > vects(NB_OF_CASES);
+  std::vector<std::thread> threads;
+  for(std::size_t i=0;i<NB_OF_CASES;++i)
+    threads.emplace_back([&vects,&func,i]()
+                         {
+                           std::unique_ptr<AdaoPythonEvaluator> evaluator;
+                           {
+                             AutoGIL agil;
+                             evaluator.reset(new AdaoPythonEvaluator(func));
+                           }
+                           MainModel mm;
+                           mm.setEngine(EnumEngine::Native);
+                           AdaoExchangeLayer adao;
+                           adao.init();
+                           adao.setEvaluatorInModel(&mm,evaluator.get());
+                           std::unique_ptr<Visitor2> visitorPythonObj;
+                           {
+                             AutoGIL agil;
+                             visitorPythonObj.reset(new Visitor2(adao.getPythonContext()));
+                           }
+                           vects[i] = RunCase(adao,mm,*visitorPythonObj);
+                         });
+  {// GIL given back by layer of Compute3DVarAnalysis : released while waiting, threads need it
+    AutoSaveThread ast;
+    for(auto& thread : threads)
+      thread.join();
+  }
+  for(const auto& vect : vects)
+    {
+      CPPUNIT_ASSERT_EQUAL(vectRef.size(),vect.size());
+      for(std::size_t i=0;i<vect.size();++i)
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(vectRef[i],vect[i],1e-10);
+    }
+  AutoGIL agil;
+  func = PyObjectRAII();
+}
+
+/* funcBase vectorized across samples : each component of the batch is contiguous */
+class VectorizedFuncBase : public AdaoBatchEvaluator
+{
+public:
+  AdaoBatchLayout getPreferredLayout() const override { return AdaoBatchLayout::ComponentMajor; }
+  void evaluateBatch(const AdaoConstSampleMatrix& inputs, const AdaoSampleMatrix& outputs) override
+  {
+    std::size_t nbOfSamples(inputs.getNumberOfSamples());
+    CPPUNIT_ASSERT_EQUAL((std::size_t)1,inputs.getSampleStride());
+    CPPUNIT_ASSERT_EQUAL((std::size_t)1,outputs.getSampleStride());
+    const double *x0(&inputs(0,0)),*x1(&inputs(0,1)),*x2(&inputs(0,2));
+    double *y0(&outputs(0,0)),*y1(&outputs(0,1)),*y2(&outputs(0,2)),*y3(&outputs(0,3));
+    for(std::size_t i=0;i<nbOfSamples;++i)
+      {
+        y0[i] = x0[i];
+        y1[i] = 2.*x1[i];
+        y2[i] = 3.*x2[i];
+        y3[i] = x0[i]+2.*x1[i]+3.*x2[i];
+      }
+    _max_nb_of_samples = std::max(_max_nb_of_samples,nbOfSamples);
+  }
+  std::size_t getMaxNumberOfSamples() const { return _max_nb_of_samples; }
+private:
+  std::size_t _max_nb_of_samples = 0;
+};
+
+void AdaoExchangeTest::testBatchEvaluator()
+{
+  std::vector<double> vectRef(Compute3DVarAnalysis<Visitor2>(EnumEngine::Python,funcBase));
+  VectorizedFuncBase vectorized;
+  AdaoPerSampleEvaluator perSample([](std::size_t inputSize, const double *x, std::size_t outputSize, double *y)
+                                   {
+                                     y[0] = x[0]; y[1] = 2.*x[1]; y[2] = 3.*x[2]; y[3] = x[0]+2.*x[1]+3.*x[2];
+                                   });
+  for(AdaoEvaluator *evaluator : std::vector<AdaoEvaluator *>{&vectorized,&perSample})
+    {
+      MainModel mm;
+      AdaoExchangeLayer adao;
+      adao.init();
+      adao.setFunctionCallbackInModel(&mm);
+      Visitor2 visitorPythonObj(adao.getPythonContext());
+      std::vector<double> vect(RunCase(adao,mm,visitorPythonObj,evaluator));
+      CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
+      for(std::size_t i=0;i<vect.size();++i)
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(vectRef[i],vect[i],1e-12);
+    }
+  CPPUNIT_ASSERT(vectorized.getMaxNumberOfSamples()>1);// finite difference points come as one batch
+  // failing evaluator : ADAO is interrupted by the error rather than waiting for a result forever
+  AdaoPerSampleEvaluator failing([](std::size_t inputSize, const double *x, std::size_t outputSize, double *y) { throw std::runtime_error("evaluation failed"); });
+  {
+    MainModel mm;
+    AdaoExchangeLayer adao;
+    adao.init();
+    adao.setFunctionCallbackInModel(&mm);
+    Visitor2 visitorPythonObj(adao.getPythonContext());
+    {
+      AutoGIL agil;
+      mm.visitPythonLeaves(&visitorPythonObj);
+    }
+    adao.loadTemplate(&mm);
+    adao.execute();
+    PyObject *listOfElts( nullptr );
+    bool hasThrown(false);
+    while( adao.next(listOfElts) )
+      {
+        try
+          {
+            adao.evaluateAndSetResult(listOfElts,&failing);
+          }
+        catch(AdaoExchangeLayerException& e)
+          {
+            hasThrown = std::string(e.what()).find("evaluation failed")!=std::string::npos;
+          }
+      }
+    CPPUNIT_ASSERT(hasThrown);
+    hasThrown = false;
+    try
+      {
+        PyObjectRAII optimum(PyObjectRAII::FromNew(adao.getResult()));
+      }
+    catch(AdaoExchangeLayerException& e)
+      {
+        hasThrown = true;
+      }
+    CPPUNIT_ASSERT(hasThrown);
+  }
+  // push mode reports why the size of the result is unknown
+  {
+    MainModel mm;
+    mm.setAlgorithm(EnumAlgo::FourDVar);
+    AdaoExchangeLayer adao;
+    adao.init();
+    adao.setEvaluatorInModel(&mm,&perSample,&perSample);
+    VisitorWithSerie visitorPythonObj(adao.getPythonContext(),VectorSerieObservation::KEY,{},"emptySerie");
+    {
+      AutoGIL agil;
+      mm.visitPythonLeaves(&visitorPythonObj);
+    }
+    bool hasThrown(false);
+    try
+      {
+        adao.loadTemplate(&mm);
+      }
+    catch(AdaoExchangeLayerException& e)
+      {
+        hasThrown = std::string(e.what()).find("Observation/VectorSerie has to be a non empty sequence of vectors")!=std::string::npos;
+      }
+    CPPUNIT_ASSERT(hasThrown);
+  }
+}
+
+/* Default 3DVAR case in pull mode answered by funcBase (recorded in \a logFile if not empty), or in push mode by \a evaluator */
+static std::vector<double> Run3DVarRecordingOrReplaying(const std::string& logFile, AdaoEvaluator *evaluator)
+{
+  AdaoFunctionEvaluator simulator(funcBase);
+  MainModel mm;
+  AdaoExchangeLayer adao;
+  adao.init();
+  if(!logFile.empty())
+    adao.setExchangeRecording(logFile);
+  if(evaluator)
+    adao.setEvaluatorInModel(&mm,evaluator);
+  else
+    adao.setFunctionCallbackInModel(&mm);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  return RunCase(adao,mm,visitorPythonObj,&simulator);
+}
+
+void AdaoExchangeTest::testExchangeRecordAndReplay()
+{
+  const char LOG_FILE[]="testExchangeRecordAndReplay.bin";
+  std::vector<double> vectRecorded(Run3DVarRecordingOrReplaying(LOG_FILE,nullptr));
+  AdaoExchangeLog log(LOG_FILE);
+  CPPUNIT_ASSERT(log.getNumberOfRecords()>0);
+  for(const auto& rec : log.getRecords())
+    {
+      CPPUNIT_ASSERT(rec._kind==AdaoOperatorKind::ObservationOperator);
+      CPPUNIT_ASSERT_EQUAL((std::size_t)3,rec._input_size);
+      CPPUNIT_ASSERT_EQUAL((std::size_t)4,rec._output_size);
+      std::vector<double> expected(funcBase(std::vector<double>(rec._inputs.begin(),rec._inputs.begin()+3)));
+      for(std::size_t i=0;i<4;++i)
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[i],rec._outputs[i],1e-12);
+    }
+  // same run answered by the log only
+  AdaoReplayEvaluator replay(LOG_FILE);
+  std::vector<double> vectReplayed(Run3DVarRecordingOrReplaying(std::string(),&replay));
+  CPPUNIT_ASSERT(replay.isExhausted());
+  CPPUNIT_ASSERT_EQUAL(log.getNumberOfRecords(),replay.getNumberOfReplayedBatches());
+  CPPUNIT_ASSERT_EQUAL(3,(int)vectReplayed.size());
+  for(std::size_t i=0;i<vectReplayed.size();++i)
+    CPPUNIT_ASSERT_EQUAL(vectRecorded[i],vectReplayed[i]);
+  // a run asking something else departs from the log
+  AdaoReplayEvaluator departing(LOG_FILE);
+  std::remove(LOG_FILE);
+  const AdaoExchangeRecord& first(log.getRecords()[0]);
+  std::vector<double> input(first._inputs),output(first._nb_of_samples*4);
+  input[1] += 1e-3;
+  bool hasThrown(false);
+  try
+    {
+      departing.evaluate(first._nb_of_samples,3,input.data(),4,output.data());
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      hasThrown = std::string(e.what()).find("departs from the recorded sequence at batch #0")!=std::string::npos;
+    }
+  CPPUNIT_ASSERT(hasThrown);
+  // an answer that cannot be recorded interrupts ADAO
+  {
+    MainModel mm;
+    AdaoExchangeLayer adao;
+    adao.init();
+    adao.setExchangeRecording(LOG_FILE);
+    adao.setFunctionCallbackInModel(&mm);
+    Visitor2 visitorPythonObj(adao.getPythonContext());
+    hasThrown = false;
+    try
+      {
+        RunCase(adao,mm,visitorPythonObj,[](PyObject *) -> PyObject * { AutoGIL agil; return PyList_New(0); });
+      }
+    catch(AdaoExchangeLayerException& e)
+      {
+        hasThrown = true;
+      }
+    CPPUNIT_ASSERT(hasThrown);
+  }
+  // header whose payload size overflows to 0 (2^61 samples of size 4) : rejected as a corrupted tail, nothing is allocated
+  {
+    std::ofstream ofs(LOG_FILE,std::ios::binary);
+    ofs.write("ADAOLOG1",8);
+    std::uint64_t header[7]={ 64, 0, std::uint64_t(1)<<61, 4, 0, 0, 0 };// record size, kind, samples, input and output sizes, timings
+    ofs.write(reinterpret_cast<const char *>(header),sizeof(header));
+    ofs.write(reinterpret_cast<const char *>(header),sizeof(std::uint64_t));
+  }
+  AdaoExchangeLog corrupted(LOG_FILE);
+  CPPUNIT_ASSERT_EQUAL((std::size_t)0,corrupted.getNumberOfRecords());
+  std::remove(LOG_FILE);
+}
+
+void AdaoExchangeTest::testSamplingStreaming()
+{
+  const char RESULT_FILE[]="testSamplingStreaming.bin";
+  std::atomic<std::size_t> maxChunkSize(0);
+  AdaoPerSampleEvaluator evaluator([](std::size_t inputSize, const double *x, std::size_t outputSize, double *y)
+                                   {
+                                     std::vector<double> res(funcBase(std::vector<double>(x,x+inputSize)));
+                                     std::copy(res.begin(),res.end(),y);
+                                   });
+  class ChunkSpy : public AdaoEvaluator
+  {
+  public:
+    ChunkSpy(AdaoEvaluator *evaluator, std::atomic<std::size_t>& maxChunkSize):_evaluator(evaluator),_max_chunk_size(maxChunkSize) { }
+    void evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs) override
+    {
+      for(std::size_t prev(_max_chunk_size);prev<nbOfSamples && !_max_chunk_size.compare_exchange_weak(prev,nbOfSamples););
+      _evaluator->evaluate(nbOfSamples,inputSize,inputs,outputSize,outputs);
+    }
+  private:
+    AdaoEvaluator *_evaluator;
+    std::atomic<std::size_t>& _max_chunk_size;
+  } spy(&evaluator,maxChunkSize);
+  // 5 x 3 x 5 = 75 samples, 7 at a time, 3 chunks evaluated concurrently, outputs memory mapped
+  {
+    MainModel mm;
+    mm.setEngine(EnumEngine::Native);
+    mm.setAlgorithm(EnumAlgo::EnsembleOfSimulationGenerationTask);
+    AdaoExchangeLayer adao;
+    adao.init();
+    adao.setSamplingStreaming(7,3,RESULT_FILE);
+    adao.setEvaluatorInModel(&mm,&spy);
+    VisitorWithSerie visitorPythonObj(adao.getPythonContext(),SampleAsMinMaxStepHyperCube::KEY,{ {0.,1.,0.25}, {0.,2.,1.}, {-1.,1.,0.5} },"___samples");
+    RunCase(adao,mm,visitorPythonObj);
+    const AdaoSamplingResult& result(adao.getSamplingResult());
+    CPPUNIT_ASSERT_EQUAL((std::size_t)75,result.getNumberOfSamples());
+    CPPUNIT_ASSERT_EQUAL((std::size_t)4,result.getOutputSize());
+    CPPUNIT_ASSERT_EQUAL((std::size_t)7,maxChunkSize.load());
+    AdaoSamplingDesign design(AdaoSamplingDesign::FromMinMaxStepHyperCube({ {0.,1.,0.25}, {0.,2.,1.}, {-1.,1.,0.5} }));
+    std::vector<double> sample(3);
+    design.fillSamples(1,1,sample.data());// last component varies fastest
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-0.5,sample[2],1e-15);
+    // values of a component are bitwise the ones of numpy.linspace used by ADAO
+    AdaoSamplingDesign design1D(AdaoSamplingDesign::FromMinMaxStepHyperCube({ {-1.3,2.9,0.3} }));
+    std::vector<double> ref;
+    {
+      AutoGIL agil;
+      PyObjectRAII numpyModule(PyObjectRAII::FromNew(PyImport_ImportModule("numpy")));
+      PyObjectRAII linspace(PyObjectRAII::FromNew(PyObject_CallMethod(numpyModule,"linspace","ddi",-1.3,2.9,(int)design1D.getNumberOfSamples())));
+      CPPUNIT_ASSERT(!linspace.isNull());
+      PyObjectRAII lst(PyObjectRAII::FromNew(PyObject_CallMethod(linspace,"tolist",nullptr)));
+      py2cpp::PyPtr obj(lst.retn());
+      py2cpp::fromPyPtr(obj,ref);
+    }
+    CPPUNIT_ASSERT_EQUAL((std::size_t)15,ref.size());
+    for(std::size_t i=0;i<ref.size();++i)
+      {
+        double val(0.);
+        design1D.fillSamples(i,1,&val);
+        CPPUNIT_ASSERT_EQUAL(ref[i],val);
+      }
+    for(std::size_t i=0;i<75;++i)
+      {
+        design.fillSamples(i,1,sample.data());
+        std::vector<double> expected(funcBase(sample));
+        for(std::size_t k=0;k<4;++k)
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[k],result.getOutputs(i)[k],1e-12);
+      }
+  }
+  std::remove(RESULT_FILE);
+  // SamplingTest : analysis is the sample minimizing the cost function
+  MainModel mm;
+  mm.setEngine(EnumEngine::Native);
+  mm.setAlgorithm(EnumAlgo::SamplingTest);
+  AdaoExchangeLayer adao;
+  adao.init();
+  adao.setSamplingStreaming(2,1);
+  adao.setEvaluatorInModel(&mm,&evaluator);
+  VisitorWithSerie visitorPythonObj(adao.getPythonContext(),SampleAsnUplet::KEY,{ {5.,7.,9.}, {2.1,3.,4.}, {2.,3.,4.}, {0.,0.,0.} },"___samples");
+  std::vector<double> vect(RunCase(adao,mm,visitorPythonObj));
+  const std::vector<double>& j(adao.getSamplingResult().getCostFunctionJ());
+  CPPUNIT_ASSERT_EQUAL(4,(int)j.size());
+  CPPUNIT_ASSERT(j[2]<j[1] && j[2]<j[0] && j[2]<j[3]);
+  CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(2.,vect[0],1e-15);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(3.,vect[1],1e-15);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(4.,vect[2],1e-15);
+}
+
+/*!
+ * Rows of a 2D float64 npy file, read without numpy.
+ */
+static std::vector< std::vector<double> > ReadNpyRows(const std::string& fileName, std::size_t rowSize)
+{
+  std::ifstream ifs(fileName,std::ios::binary);
+  char preamble[10];
+  ifs.read(preamble,10);
+  std::size_t headerLen((unsigned char)preamble[8] | ((unsigned char)preamble[9] << 8));
+  ifs.seekg(10+headerLen);
+  std::vector< std::vector<double> > ret;
+  std::vector<double> row(rowSize);
+  while(ifs.read(reinterpret_cast<char *>(row.data()),rowSize*sizeof(double)))
+    ret.push_back(row);
+  return ret;
+}
+
+/* CurrentOptimum written while ADAO runs, and after the run, is the serie stored by ADAO */
+void AdaoExchangeTest::testSerieExport()
+{
+  const char STREAMED_FILE[]="testSerieExportStreamed.npy";
+  const char ANALYSIS_FILE[]="testSerieExportAnalysis.npy";
+  const char EXPORTED_FILE[]="testSerieExportAfterRun.npy";
+  std::vector< std::vector<double> > ref(Run3DVarCurrentOptimum(nullptr));
+  NonParallelFunctor functor(funcBase);
+  MainModel mm;
+  AdaoExchangeLayer adao;
+  adao.init();
+  adao.setSerieExport("CurrentOptimum",STREAMED_FILE);
+  adao.setSerieExport("Analysis",ANALYSIS_FILE);
+  adao.setFunctionCallbackInModel(&mm);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  RunCase(adao,mm,visitorPythonObj,functor);
+  adao.exportSerie("CurrentOptimum",EXPORTED_FILE);
+  std::vector< std::vector<double> > streamed(ReadNpyRows(STREAMED_FILE,3)),analysis(ReadNpyRows(ANALYSIS_FILE,3)),exported(ReadNpyRows(EXPORTED_FILE,3));
+  std::remove(STREAMED_FILE); std::remove(ANALYSIS_FILE); std::remove(EXPORTED_FILE);
+  CPPUNIT_ASSERT(ref.size()>1);
+  CPPUNIT_ASSERT_EQUAL(ref.size(),streamed.size());
+  CPPUNIT_ASSERT_EQUAL(ref.size(),exported.size());
+  for(std::size_t i=0;i<ref.size();++i)
+    for(std::size_t j=0;j<3;++j)
+      {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(ref[i][j],streamed[i][j],1e-12);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(ref[i][j],exported[i][j],1e-12);
+      }
+  CPPUNIT_ASSERT_EQUAL(1,(int)analysis.size());
+  for(std::size_t j=0;j<3;++j)
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(ref.back()[j],analysis[0][j],1e-12);
+  // rows of an exported serie have all the same size
+  AdaoNpyAppender appender(STREAMED_FILE);
+  std::vector<double> row{1.,2.,3.};
+  appender.append(3,row.data());
+  bool hasThrown(false);
+  try
+    {
+      appender.append(2,row.data());
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      hasThrown = true;
+    }
+  std::remove(STREAMED_FILE);
+  CPPUNIT_ASSERT(hasThrown);
+  CPPUNIT_ASSERT_EQUAL(1,(int)appender.getNumberOfRows());
+}
+
+struct AnalyticOperator
+{
+  template<class T>
+  std::vector<T> operator()(const std::vector<T>& x) const { return {x[0]*x[1]-2.*x[2], exp(x[0])/x[2], sin(x[1])+pow(x[0],x[2]), 3.-x[0]/2., tanh(x[0]*x[1])}; }
+};
+
+/* CrueOperator evaluated with dual numbers, counting direct evaluations and tangents */
+class CountingCrueEvaluator : public AdaoForwardDiffEvaluator<CrueOperator,2>
+{
+public:
+  void evaluate(std::size_t nbOfSamples, std::size_t inputSize, const double *inputs, std::size_t outputSize, double *outputs) override
+  {
+    _nb_of_evaluations += nbOfSamples;
+    AdaoForwardDiffEvaluator<CrueOperator,2>::evaluate(nbOfSamples,inputSize,inputs,outputSize,outputs);
+  }
+  void transposeOfTangent(std::size_t inputSize, const double *x, std::size_t outputSize, double *hx, double *ht) override
+  {
+    _nb_of_tangents++;
+    AdaoForwardDiffEvaluator<CrueOperator,2>::transposeOfTangent(inputSize,x,outputSize,hx,ht);
+  }
+public:
+  std::size_t _nb_of_evaluations = 0;
+  std::size_t _nb_of_tangents = 0;
+};
+
+/* Crue case in push mode, solved with the exact tangent of funcCrue or with finite differences. Direct evaluations go through \a storeFile if not empty */
+static std::vector<double> ComputeCrueAnalysisInPushMode(EnumEngine engine, EnumJacobianMode jacobianMode, CountingCrueEvaluator& evaluator, const std::string& storeFile = std::string())
+{
+  MainModel mm;
+  mm.setEngine(engine);
+  mm.setJacobianMode(jacobianMode);
+  AdaoExchangeLayer adao;
+  adao.init();
+  if(!storeFile.empty())
+    adao.setEvaluationStore(storeFile,"crue");
+  adao.setEvaluatorInModel(&mm,&evaluator);
+  VisitorCruePython visitorPythonObj(adao.getPythonContext());
+  return RunCase(adao,mm,visitorPythonObj);
+}
+
+void AdaoExchangeTest::testForwardDiffEvaluator()
+{
+  // derivatives of dual numbers against centered finite differences, more inputs than directions
+  AdaoForwardDiffEvaluator<AnalyticOperator,2> analytic;
+  std::vector<double> x{1.2,0.7,2.5},hx(5),ht(3*5);
+  analytic.transposeOfTangent(3,x.data(),5,hx.data(),ht.data());
+  std::vector<double> ref(AnalyticOperator()(x));
+  for(std::size_t k=0;k<5;++k)
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(ref[k],hx[k],1e-15);
+  for(std::size_t j=0;j<3;++j)
+    {
+      std::vector<double> xp(x),xm(x);
+      xp[j] += 1e-6; xm[j] -= 1e-6;
+      std::vector<double> yp(AnalyticOperator()(xp)),ym(AnalyticOperator()(xm));
+      for(std::size_t k=0;k<5;++k)
+        CPPUNIT_ASSERT_DOUBLES_EQUAL((yp[k]-ym[k])/2e-6,ht[j*5+k],1e-8);
+    }
+  // native engine : one tangent per gradient instead of finite differences
+  CountingCrueEvaluator nativeEvaluator;
+  std::vector<double> vectNative(ComputeCrueAnalysisInPushMode(EnumEngine::Native,EnumJacobianMode::Exact,nativeEvaluator));
+  CPPUNIT_ASSERT_EQUAL(1,(int)vectNative.size());
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(25.,vectNative[0],1e-3);
+  CPPUNIT_ASSERT(nativeEvaluator._nb_of_tangents>0);
+  std::vector<double> vectFD(Compute3DVarAnalysis<VisitorCruePython>(EnumEngine::Native,funcCrue));
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(vectFD[0],vectNative[0],2e-3);
+  // python engine : Tangent and Adjoint given to ADAO
+  CountingCrueEvaluator pyEvaluator;
+  std::vector<double> vectPy(ComputeCrueAnalysisInPushMode(EnumEngine::Python,EnumJacobianMode::Exact,pyEvaluator));
+  CPPUNIT_ASSERT_EQUAL(1,(int)vectPy.size());
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(25.,vectPy[0],1e-3);
+  CPPUNIT_ASSERT(pyEvaluator._nb_of_tangents>0);
+  // same case with finite differences : more direct evaluations
+  CountingCrueEvaluator nativeFDEvaluator,pyFDEvaluator;
+  ComputeCrueAnalysisInPushMode(EnumEngine::Native,EnumJacobianMode::FiniteDifferences,nativeFDEvaluator);
+  ComputeCrueAnalysisInPushMode(EnumEngine::Python,EnumJacobianMode::FiniteDifferences,pyFDEvaluator);
+  CPPUNIT_ASSERT(nativeEvaluator._nb_of_evaluations<nativeFDEvaluator._nb_of_evaluations);
+  CPPUNIT_ASSERT(pyEvaluator._nb_of_evaluations<pyFDEvaluator._nb_of_evaluations);
+  // evaluator wrapped by the evaluation store : tangent still given by the evaluator
+  const char STORE_FILE[]="testForwardDiffEvaluator.store";
+  std::remove(STORE_FILE);
+  CountingCrueEvaluator storedEvaluator;
+  std::vector<double> vectStored(ComputeCrueAnalysisInPushMode(EnumEngine::Python,EnumJacobianMode::Exact,storedEvaluator,STORE_FILE));
+  std::remove(STORE_FILE);
+  CPPUNIT_ASSERT_EQUAL(1,(int)vectStored.size());
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(vectPy[0],vectStored[0],1e-12);
+  CPPUNIT_ASSERT(storedEvaluator._nb_of_tangents>0);
+  // speculation would evaluate finite difference points never requested
+  {
+    MainModel mm;
+    mm.setJacobianMode(EnumJacobianMode::Exact);
+    AdaoExchangeLayer adao;
+    adao.init();
+    adao.setSpeculation(0);
+    adao.setEvaluatorInModel(&mm,&storedEvaluator);
+    VisitorCruePython visitorPythonObj(adao.getPythonContext());
+    {
+      AutoGIL agil;
+      mm.visitPythonLeaves(&visitorPythonObj);
+    }
+    bool hasThrown(false);
+    try
+      {
+        adao.loadTemplate(&mm);
+      }
+    catch(AdaoExchangeLayerException& e)
+      {
+        hasThrown = true;
+      }
+    CPPUNIT_ASSERT(hasThrown);
+  }
+  // pull mode has no tangent to give
+  MainModel mm;
+  mm.setJacobianMode(EnumJacobianMode::Exact);
+  AdaoExchangeLayer adao;
+  adao.init();
+  bool hasThrown(false);
+  try
+    {
+      adao.setFunctionCallbackInModel(&mm);
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      hasThrown = true;
+    }
+  CPPUNIT_ASSERT(hasThrown);
+}
+
+/* Number of objects tracked by python garbage collector */
+static std::size_t NumberOfPythonObjects()
+{
+  AutoGIL agil;
+  PyObjectRAII gc(PyObjectRAII::FromNew(PyImport_ImportModule("gc")));
+  CPPUNIT_ASSERT(!gc.isNull());
+  PyObjectRAII objs(PyObjectRAII::FromNew(PyObject_CallMethod(gc,"get_objects",nullptr)));
+  CPPUNIT_ASSERT(!objs.isNull());
+  return PyList_Size(objs);
+}
+
+/* Many cases in the same process : context, python objects and resident memory stay bounded when each case is released */
+void AdaoExchangeTest::testCaseLifecycle()
+{
+  class TestBlueVisitor : public RecursiveVisitor
+  {
+  public:
+    void visit(GenericKeyVal *obj)
+    {
+      EnumAlgoKeyVal *objc(dynamic_cast<EnumAlgoKeyVal *>(obj));
+      if(objc)
+        objc->setVal(EnumAlgo::Blue);
+    }
+    void enterSubDir(DictKeyVal *subdir) { }
+    void exitSubDir(DictKeyVal *subdir) { }
+  };
+  constexpr int NB_OF_CASES = 10000;
+  constexpr int NB_OF_WARMUP_CASES = 100;
+  constexpr int PYTHON_CASE_PERIOD = 10;
+  NonParallelFunctor functor(funcBase);
+  AdaoFunctionEvaluator evaluator(funcBase);
+  AdaoExchangeLayer adao;
+  adao.init();
+  // one visitor for all cases : its python objects are shared by the successive cases
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  std::size_t rssAfterWarmup(0),objectsAfterWarmup(0),objectsAtEnd(0);
+  for(int i=0;i<NB_OF_CASES;++i)
+    {
+      // python ADAO pulling one case out of PYTHON_CASE_PERIOD, native engine pushing otherwise
+      bool pythonEngine(i%PYTHON_CASE_PERIOD==0);
+      MainModel mm;
+      if(pythonEngine)
+        adao.setFunctionCallbackInModel(&mm);
+      else
+        {
+          mm.setEngine(EnumEngine::Native);
+          TestBlueVisitor vis;
+          mm.visitAll(&vis);
+          adao.setEvaluatorInModel(&mm,&evaluator);
+        }
+      std::vector<double> vect(RunCase(adao,mm,visitorPythonObj,functor));
+      CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(2.,vect[0],1e-5);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(3.,vect[1],1e-5);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(4.,vect[2],1e-5);
+      adao.releaseCase();
+      {
+        AutoGIL agil;
+        CPPUNIT_ASSERT_EQUAL(1,(int)PyDict_Size(adao.getPythonContext()));
+      }
+      if(pythonEngine)
+        objectsAtEnd = NumberOfPythonObjects();
+      if(i==NB_OF_WARMUP_CASES)
+        {
+          rssAfterWarmup = AdaoMemoryAccounting::CurrentRSS();
+          objectsAfterWarmup = objectsAtEnd;
+        }
+    }
+  std::size_t rssAtEnd(AdaoMemoryAccounting::CurrentRSS());
+  // less than one python object per 10 python cases, and less than 4 kB per python case
+  constexpr std::size_t NB_OF_PYTHON_CASES_AFTER_WARMUP((NB_OF_CASES-NB_OF_WARMUP_CASES)/PYTHON_CASE_PERIOD);
+  CPPUNIT_ASSERT(objectsAtEnd < objectsAfterWarmup + NB_OF_PYTHON_CASES_AFTER_WARMUP/10);
+  CPPUNIT_ASSERT(rssAtEnd < rssAfterWarmup + NB_OF_PYTHON_CASES_AFTER_WARMUP*4096);
+  // releasing a running case is refused
+  MainModel mm;
+  adao.setFunctionCallbackInModel(&mm);
+  {
+    AutoGIL agil;
+    mm.visitPythonLeaves(&visitorPythonObj);
+  }
+  adao.loadTemplate(&mm);
+  adao.execute();
+  PyObject *listOfElts( nullptr );
+  CPPUNIT_ASSERT(adao.next(listOfElts));
+  bool hasThrown(false);
+  try
+    {
+      adao.releaseCase();
+    }
+  catch(AdaoExchangeLayerException& e)
+    {
+      hasThrown = true;
+    }
+  CPPUNIT_ASSERT(hasThrown);
+  adao.setResult(functor(listOfElts));
+  while( adao.next(listOfElts) )
+    adao.setResult(functor(listOfElts));
+  {
+    PyObjectRAII optimum(PyObjectRAII::FromNew(adao.getResult()));
+  }
+  adao.releaseCase();
+}
+
+#ifdef AEL_WITH_MPI
+/* To be launched with mpirun -np N TestAdaoExchange. Ranks > 0 evaluate funcBase */
+void AdaoExchangeTest::test3DVarMpi()
+{
+  if(!MpiEvaluator)
+    CPPUNIT_FAIL("test3DVarMpi has to be launched with mpirun -np N, N>1 !");
+  MainModel mm;
+  AdaoExchangeLayer adao;
+  adao.init();
+  adao.setEvaluatorInModel(&mm,MpiEvaluator);
+  Visitor2 visitorPythonObj(adao.getPythonContext());
+  std::vector<double> vect(RunCase(adao,mm,visitorPythonObj));
+  std::vector<double> vectPull(Compute3DVarAnalysis<Visitor2>(EnumEngine::Python,funcBase));
+  CPPUNIT_ASSERT_EQUAL(3,(int)vect.size());
+  for(std::size_t i=0;i<vect.size();++i)
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(vectPull[i],vect[i],1e-12);
+}
+#endif
+
 CPPUNIT_TEST_SUITE_REGISTRATION( AdaoExchangeTest );
 
 #include <cppunit/CompilerOutputter.h>
@@ -325,6 +1777,25 @@ CPPUNIT_TEST_SUITE_REGISTRATION( AdaoExchangeTest );
 
 int main(int argc, char* argv[])
 {
+#ifdef AEL_WITH_MPI
+  MPI_Init(&argc,&argv);
+  int mpiSize(0);
+  MPI_Comm_size(MPI_COMM_WORLD,&mpiSize);
+  std::unique_ptr<AdaoMpiEvaluator> mpiEvaluator;
+  if(mpiSize>1)
+    {
+      mpiEvaluator.reset(new AdaoMpiEvaluator(MPI_COMM_WORLD));
+      if(!mpiEvaluator->isMaster())
+        {
+          AdaoFunctionEvaluator evaluator(funcBase);
+          mpiEvaluator->serve(&evaluator);
+          mpiEvaluator.reset();
+          MPI_Finalize();
+          return 0;
+        }
+      MpiEvaluator = mpiEvaluator.get();
+    }
+#endif
   // --- Create the event manager and test controller
   CPPUNIT_NS::TestResult controller;
 
@@ -362,6 +1833,10 @@ int main(int argc, char* argv[])
 
   bool wasSucessful = result.wasSuccessful();
   testFile.close();
+#ifdef AEL_WITH_MPI
+  mpiEvaluator.reset();
+  MPI_Finalize();
+#endif
 
   // ---  Return error code 1 if the one of test failed.
 
@@ -29,6 +29,35 @@ class AdaoExchangeTest : public CppUnit::TestFixture
   CPPUNIT_TEST(testBlue);
   CPPUNIT_TEST(testNonLinearLeastSquares);
   CPPUNIT_TEST(testCasCrue);
+  CPPUNIT_TEST(test3DVarSinglePrecision);
+  CPPUNIT_TEST(testBlueNative);
+  CPPUNIT_TEST(test3DVarNativeParity);
+  CPPUNIT_TEST(testCasCrueNativeParity);
+  CPPUNIT_TEST(testFiniteDifferenceIncrements);
+  CPPUNIT_TEST(test3DVarBroyden);
+  CPPUNIT_TEST(testEvaluationStore);
+  CPPUNIT_TEST(test3DVarOutOfProcess);
+  CPPUNIT_TEST(test3DVarPushMode);
+  CPPUNIT_TEST(test3DVarEventLoop);
+  CPPUNIT_TEST(testMemoryAccounting);
+  CPPUNIT_TEST(testStoragePolicy);
+  CPPUNIT_TEST(testSurrogate);
+  CPPUNIT_TEST(testExternalEvaluator);
+  CPPUNIT_TEST(testCovarianceOperator);
+  CPPUNIT_TEST(testPartitions);
+  CPPUNIT_TEST(testPosteriorCovariance);
+  CPPUNIT_TEST(test3DVarSpeculation);
+  CPPUNIT_TEST(test4DVar);
+  CPPUNIT_TEST(testPythonEvaluator);
+  CPPUNIT_TEST(testBatchEvaluator);
+  CPPUNIT_TEST(testExchangeRecordAndReplay);
+  CPPUNIT_TEST(testSamplingStreaming);
+  CPPUNIT_TEST(testSerieExport);
+  CPPUNIT_TEST(testForwardDiffEvaluator);
+  CPPUNIT_TEST(testCaseLifecycle);
+#ifdef AEL_WITH_MPI
+  CPPUNIT_TEST(test3DVarMpi);
+#endif
   CPPUNIT_TEST_SUITE_END();
 public:
   void setUp();
@@ -39,4 +68,33 @@ public:
   void testBlue();
   void testNonLinearLeastSquares();
   void testCasCrue();
+  void test3DVarSinglePrecision();
+  void testBlueNative();
+  void test3DVarNativeParity();
+  void testCasCrueNativeParity();
+  void testFiniteDifferenceIncrements();
+  void test3DVarBroyden();
+  void testEvaluationStore();
+  void test3DVarOutOfProcess();
+  void test3DVarPushMode();
+  void test3DVarEventLoop();
+  void testMemoryAccounting();
+  void testStoragePolicy();
+  void testSurrogate();
+  void testExternalEvaluator();
+  void testCovarianceOperator();
+  void testPartitions();
+  void testPosteriorCovariance();
+  void test3DVarSpeculation();
+  void test4DVar();
+  void testPythonEvaluator();
+  void testBatchEvaluator();
+  void testExchangeRecordAndReplay();
+  void testSamplingStreaming();
+  void testSerieExport();
+  void testForwardDiffEvaluator();
+  void testCaseLifecycle();
+#ifdef AEL_WITH_MPI
+  void test3DVarMpi();
+#endif
 };
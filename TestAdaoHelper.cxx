@@ -9,24 +9,26 @@ std::vector<double> funcBase(const std::vector<double>& vec)
   return {vec[0],2.*vec[1],3.*vec[2],vec[0]+2.*vec[1]+3.*vec[2]};
 }
 
-double funcCrueInternal(double Q, double K_s)
+/* template over scalar type : also called with AdaoDual to get exact derivatives */
+template<class T>
+T funcCrueInternal(double Q, T K_s)
 {
   constexpr double L(5.0e3);
   constexpr double B(300.);
   constexpr double Z_v(49.);
   constexpr double Z_m(51.);
   constexpr double alpha( (Z_m - Z_v)/L );
-  double H(pow((Q/(K_s*B*sqrt(alpha))),(3.0/5.0)));
+  T H(pow((Q/(K_s*B*sqrt(alpha))),(3.0/5.0)));
   return H;
 }
 
-/* func pour testCasCrue*/
-std::vector<double> funcCrue(const std::vector<double>& vec)
+template<class T>
+std::vector<T> funcCrueTemplate(const std::vector<T>& vec)
 {
-  double K_s(vec[0]);
+  T K_s(vec[0]);
   constexpr double Qs[]={10.,20.,30.,40.};
   constexpr size_t LEN(sizeof(Qs)/sizeof(double));
-  std::vector<double> ret(LEN);
+  std::vector<T> ret(LEN);
   for(std::size_t i=0;i<LEN;++i)
     {
       ret[i] = funcCrueInternal(Qs[i],K_s);
@@ -34,6 +36,19 @@ std::vector<double> funcCrue(const std::vector<double>& vec)
   return ret;
 }
 
+/* func pour testCasCrue*/
+std::vector<double> funcCrue(const std::vector<double>& vec)
+{
+  return funcCrueTemplate(vec);
+}
+
+/* funcCrue as functor for AdaoForwardDiffEvaluator */
+struct CrueOperator
+{
+  template<class T>
+  std::vector<T> operator()(const std::vector<T>& vec) const { return funcCrueTemplate(vec); }
+};
+
 /* Visitor commun pour test3DVar testBlue et testNonLinearLeastSquares*/
 class Visitor2 : public AdaoModel::PythonLeafVisitor
 {